@@ -287,7 +287,7 @@ namespace micm
     bool ParseChemicalSpecies(const json& object)
     {
       std::vector<std::string> required_keys = { "name" };
-      std::vector<std::string> optional_keys = { "absolute tolerance" };
+      std::vector<std::string> optional_keys = { "absolute tolerance", "tracer type" };
 
       for (const auto& key : required_keys)
       {
@@ -299,16 +299,20 @@ namespace micm
 
       std::string key = "absolute tolerance";
 
+      std::vector<Property> properties{};
       if (object.contains(key))
       {
         double abs_tol = object[key].get<double>();
-        auto species = Species(name, Property(key, "", abs_tol));
-        species_.push_back(species);
+        properties.push_back(Property(key, "", abs_tol));
       }
-      else
+
+      // species with a fixed concentration are folded out of the integrated system
+      key = "tracer type";
+      if (object.contains(key) && object[key].get<std::string>() == "CONSTANT")
       {
-        species_.push_back(Species(name));
+        properties.push_back(Property("constant", "", 1.0));
       }
+      species_.push_back(Species(name, properties));
 
       return true;
     }
@@ -3,11 +3,20 @@
 // SPDX-License-Identifier: Apache-2.0
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <map>
 #include <micm/process/process.hpp>
 #include <micm/solver/state.hpp>
+#include <micm/util/grid_cell_mask.hpp>
 #include <micm/util/matrix.hpp>
 #include <micm/util/sparse_matrix.hpp>
 #include <micm/util/vector_matrix.hpp>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace micm
@@ -21,6 +30,10 @@ namespace micm
     t.VectorSize();
   };
 
+  /// Concept for sparse matrices that interleave the blocks of groups of grid cells
+  template<typename T>
+  concept VectorizableSparse = requires(T t) { t.GroupVectorSize(); };
+
   /// @brief Solver function calculators for a collection of processes
   class ProcessSet
   {
@@ -30,6 +43,34 @@ namespace micm
     std::vector<std::size_t> product_ids_;
     std::vector<double> yields_;
     std::vector<std::size_t> jacobian_flat_ids_;
+    std::size_t max_number_of_reactants_{ 0 };
+
+    // species-major (CSR) form of the forcing: species i gets forcing_yields_[j] * rate[forcing_reaction_ids_[j]]
+    // for j in [forcing_row_starts_[i], forcing_row_starts_[i + 1]), with reactant losses as negative yields
+    std::vector<std::size_t> forcing_row_starts_;
+    std::vector<std::size_t> forcing_reaction_ids_;
+    std::vector<double> forcing_yields_;
+
+    /// @brief Reactions with the same number of reactants and products
+    struct ArityBucket
+    {
+      std::size_t number_of_reactants_;
+      std::size_t number_of_products_;
+      std::vector<std::size_t> reaction_ids_;  // rate constant index of each reaction
+      std::vector<std::size_t> reactant_ids_;
+      std::vector<std::size_t> product_ids_;
+      std::vector<double> yields_;
+      std::vector<std::size_t> jacobian_flat_ids_;
+    };
+    std::vector<ArityBucket> arity_buckets_;
+
+    /// @brief Template argument for kernels that read the number of reactants or products from the bucket
+    static constexpr std::size_t DYNAMIC_ARITY = static_cast<std::size_t>(-1);
+    static constexpr std::size_t MAX_SPECIALIZED_REACTANTS = 3;
+    static constexpr std::size_t MAX_SPECIALIZED_PRODUCTS = 5;
+    /// @brief Largest number of reactants for the stack buffers of AddForcingAndJacobianTerms; sets of processes
+    ///        with more reactants in a reaction are calculated with AddForcingTerms and AddJacobianTerms instead
+    static constexpr std::size_t MAX_FUSED_REACTANTS = 8;
 
    public:
     /// @brief Default constructor
@@ -38,8 +79,16 @@ namespace micm
     /// @brief Create a process set calculator for a given set of processes
     /// @param processes Processes to create calculator for
     /// @param state Solver state
+    /// @param bucket_by_arity Group the reactions by their number of reactants and products, and calculate each
+    ///                        group with kernels that have fixed loop counts
+    /// @param constant_species Names of species with fixed concentrations, which are left out of the calculated
+    ///                         terms. Their concentrations must already be included in the rate constants.
     template<template<class> class MatrixPolicy>
-    ProcessSet(const std::vector<Process>& processes, const State<MatrixPolicy>& state);
+    ProcessSet(
+        const std::vector<Process>& processes,
+        const State<MatrixPolicy>& state,
+        bool bucket_by_arity = false,
+        const std::set<std::string>& constant_species = {});
 
     /// @brief Return the full set of non-zero Jacobian elements for the set of processes
     /// @return Jacobian elements as a set of index pairs
@@ -47,51 +96,244 @@ namespace micm
 
     /// @brief Sets the indicies for each non-zero Jacobian element in the underlying vector
     /// @param matrix The sparse matrix used for the Jacobian
-    void SetJacobianFlatIds(const SparseMatrix<double>& matrix);
+    /// @param species_order The state variable of each row (and column) of the matrix, when the Jacobian is
+    ///                      reordered (see DiagonalMarkowitzReordering); empty for the state variable order
+    template<typename OrderingPolicy>
+    void SetJacobianFlatIds(
+        const SparseMatrix<double, OrderingPolicy>& matrix,
+        const std::vector<std::size_t>& species_order = {});
 
     /// @brief Add forcing terms for the set of processes for the current conditions
     /// @param rate_constants Current values for the process rate constants (grid cell, process)
     /// @param state_variables Current state variable values (grid cell, state variable)
     /// @param forcing Forcing terms for each state variable (grid cell, state variable)
+    /// @param is_active The grid cells to calculate terms for (see IsAnyGridCellActive); empty for all grid cells
     template<template<class> typename MatrixPolicy>
       requires(!Vectorizable<MatrixPolicy<double>>)
-    void AddForcingTerms(const MatrixPolicy<double>& rate_constants, const MatrixPolicy<double>& state_variables, MatrixPolicy<double>& forcing) const;
+    void AddForcingTerms(
+        const MatrixPolicy<double>& rate_constants,
+        const MatrixPolicy<double>& state_variables,
+        MatrixPolicy<double>& forcing,
+        const std::vector<bool>& is_active = {}) const;
     template<template<class> typename MatrixPolicy>
       requires Vectorizable<MatrixPolicy<double>>
-    void AddForcingTerms(const MatrixPolicy<double>& rate_constants, const MatrixPolicy<double>& state_variables, MatrixPolicy<double>& forcing)
-        const;
+    void AddForcingTerms(
+        const MatrixPolicy<double>& rate_constants,
+        const MatrixPolicy<double>& state_variables,
+        MatrixPolicy<double>& forcing,
+        const std::vector<bool>& is_active = {}) const;
 
     /// @brief Add Jacobian terms for the set of processes for the current conditions
     /// @param rate_constants Current values for the process rate constants (grid cell, process)
     /// @param state_variables Current state variable values (grid cell, state variable)
     /// @param jacobian Jacobian matrix for the system (grid cell, dependent variable, independent variable)
-    template<template<class> class MatrixPolicy>
-    void AddJacobianTerms(const MatrixPolicy<double>& rate_constants, const MatrixPolicy<double>& state_variables, SparseMatrix<double>& jacobian)
-        const;
+    /// @param is_active The grid cells to calculate terms for (see IsAnyGridCellActive); empty for all grid cells
+    template<template<class> class MatrixPolicy, typename SparseMatrixPolicy>
+      requires(!VectorizableSparse<SparseMatrixPolicy>)
+    void AddJacobianTerms(
+        const MatrixPolicy<double>& rate_constants,
+        const MatrixPolicy<double>& state_variables,
+        SparseMatrixPolicy& jacobian,
+        const std::vector<bool>& is_active = {}) const;
+    template<template<class> class MatrixPolicy, typename SparseMatrixPolicy>
+      requires(Vectorizable<MatrixPolicy<double>> && VectorizableSparse<SparseMatrixPolicy>)
+    void AddJacobianTerms(
+        const MatrixPolicy<double>& rate_constants,
+        const MatrixPolicy<double>& state_variables,
+        SparseMatrixPolicy& jacobian,
+        const std::vector<bool>& is_active = {}) const;
+
+    /// @brief Add forcing terms for the set of processes by first calculating the rate of every reaction and then
+    ///        gathering the rates that contribute to each species
+    ///
+    /// Each forcing element is written once, so the species loop has no write conflicts and can be run in
+    /// parallel. The results match AddForcingTerms up to the order of the floating-point additions.
+    /// @param rate_constants Current values for the process rate constants (grid cell, process)
+    /// @param state_variables Current state variable values (grid cell, state variable)
+    /// @param forcing Forcing terms for each state variable (grid cell, state variable)
+    /// @param rates Storage for the rate of each process (grid cell, process), with the dimensions of rate_constants;
+    ///              it is overwritten, and is supplied by the caller so no memory is allocated per call
+    /// @param is_active The grid cells to calculate terms for (see IsAnyGridCellActive); empty for all grid cells
+    template<template<class> typename MatrixPolicy>
+      requires(!Vectorizable<MatrixPolicy<double>>)
+    void AddForcingTermsByGather(
+        const MatrixPolicy<double>& rate_constants,
+        const MatrixPolicy<double>& state_variables,
+        MatrixPolicy<double>& forcing,
+        MatrixPolicy<double>& rates,
+        const std::vector<bool>& is_active = {}) const;
+    template<template<class> typename MatrixPolicy>
+      requires Vectorizable<MatrixPolicy<double>>
+    void AddForcingTermsByGather(
+        const MatrixPolicy<double>& rate_constants,
+        const MatrixPolicy<double>& state_variables,
+        MatrixPolicy<double>& forcing,
+        MatrixPolicy<double>& rates,
+        const std::vector<bool>& is_active = {}) const;
+
+    /// @brief Add forcing and Jacobian terms for the set of processes in a single pass over the reactions
+    ///
+    /// The rate constant and reactant concentrations of each reaction are read once, and the partial derivatives
+    /// are formed from prefix and suffix products of the reactant concentrations, which also give the rate.
+    /// The results are the same as calling AddForcingTerms and then AddJacobianTerms.
+    /// The products are kept in fixed-size stack buffers, so no memory is allocated (see MAX_FUSED_REACTANTS).
+    /// @param rate_constants Current values for the process rate constants (grid cell, process)
+    /// @param state_variables Current state variable values (grid cell, state variable)
+    /// @param forcing Forcing terms for each state variable (grid cell, state variable)
+    /// @param jacobian Jacobian matrix for the system (grid cell, dependent variable, independent variable)
+    /// @param is_active The grid cells to calculate terms for (see IsAnyGridCellActive); empty for all grid cells
+    template<template<class> class MatrixPolicy, typename SparseMatrixPolicy>
+      requires(!VectorizableSparse<SparseMatrixPolicy>)
+    void AddForcingAndJacobianTerms(
+        const MatrixPolicy<double>& rate_constants,
+        const MatrixPolicy<double>& state_variables,
+        MatrixPolicy<double>& forcing,
+        SparseMatrixPolicy& jacobian,
+        const std::vector<bool>& is_active = {}) const;
+    template<template<class> class MatrixPolicy, typename SparseMatrixPolicy>
+      requires(Vectorizable<MatrixPolicy<double>> && VectorizableSparse<SparseMatrixPolicy>)
+    void AddForcingAndJacobianTerms(
+        const MatrixPolicy<double>& rate_constants,
+        const MatrixPolicy<double>& state_variables,
+        MatrixPolicy<double>& forcing,
+        SparseMatrixPolicy& jacobian,
+        const std::vector<bool>& is_active = {}) const;
+
+   private:
+    /// @brief Calls func.template operator()<NR, NP>() for the bucket's arity, with NR and NP set to DYNAMIC_ARITY
+    ///        when there is no specialized kernel for it
+    template<class Func>
+    static void DispatchArity(const ArityBucket& bucket, Func&& func);
+
+    template<std::size_t NR, std::size_t NP, template<class> class MatrixPolicy>
+    void AddBucketForcingTerms(
+        const ArityBucket& bucket,
+        const MatrixPolicy<double>& rate_constants,
+        const MatrixPolicy<double>& state_variables,
+        MatrixPolicy<double>& forcing,
+        const std::vector<bool>& is_active) const;
+    template<std::size_t NR, std::size_t NP, template<class> class MatrixPolicy>
+    void AddVectorizedBucketForcingTerms(
+        const ArityBucket& bucket,
+        const MatrixPolicy<double>& rate_constants,
+        const MatrixPolicy<double>& state_variables,
+        MatrixPolicy<double>& forcing,
+        const std::vector<bool>& is_active) const;
+    template<std::size_t NR, std::size_t NP, template<class> class MatrixPolicy, typename SparseMatrixPolicy>
+    void AddBucketJacobianTerms(
+        const ArityBucket& bucket,
+        const MatrixPolicy<double>& rate_constants,
+        const MatrixPolicy<double>& state_variables,
+        SparseMatrixPolicy& jacobian,
+        const std::vector<bool>& is_active) const;
+    template<std::size_t NR, std::size_t NP, template<class> class MatrixPolicy, typename SparseMatrixPolicy>
+    void AddVectorizedBucketJacobianTerms(
+        const ArityBucket& bucket,
+        const MatrixPolicy<double>& rate_constants,
+        const MatrixPolicy<double>& state_variables,
+        SparseMatrixPolicy& jacobian,
+        const std::vector<bool>& is_active) const;
   };
 
   template<template<class> class MatrixPolicy>
-  inline ProcessSet::ProcessSet(const std::vector<Process>& processes, const State<MatrixPolicy>& state)
+  inline ProcessSet::ProcessSet(
+      const std::vector<Process>& processes,
+      const State<MatrixPolicy>& state,
+      bool bucket_by_arity,
+      const std::set<std::string>& constant_species)
       : number_of_reactants_(),
         reactant_ids_(),
         number_of_products_(),
         product_ids_(),
-        yields_()
+        yields_(),
+        max_number_of_reactants_(0),
+        forcing_row_starts_(),
+        forcing_reaction_ids_(),
+        forcing_yields_(),
+        arity_buckets_()
   {
     for (auto& process : processes)
     {
-      number_of_reactants_.push_back(process.reactants_.size());
-      number_of_products_.push_back(process.products_.size());
+      std::size_t number_of_reactants = 0;
+      std::size_t number_of_products = 0;
       for (auto& reactant : process.reactants_)
       {
+        if (constant_species.contains(reactant.name_))
+          continue;
         reactant_ids_.push_back(state.variable_map_.at(reactant.name_));
+        ++number_of_reactants;
       }
       for (auto& product : process.products_)
       {
+        if (constant_species.contains(product.first.name_))
+          continue;
         product_ids_.push_back(state.variable_map_.at(product.first.name_));
         yields_.push_back(product.second);
+        ++number_of_products;
+      }
+      number_of_reactants_.push_back(number_of_reactants);
+      number_of_products_.push_back(number_of_products);
+      max_number_of_reactants_ = std::max(max_number_of_reactants_, number_of_reactants);
+    }
+
+    // net yield of each reaction for each species, with repeated reactants and products combined
+    std::vector<std::map<std::size_t, double>> species_yields(state.variable_map_.size());
+    {
+      auto react_id = reactant_ids_.begin();
+      auto prod_id = product_ids_.begin();
+      auto yield = yields_.begin();
+      for (std::size_t i_rxn = 0; i_rxn < number_of_reactants_.size(); ++i_rxn)
+      {
+        for (std::size_t i_react = 0; i_react < number_of_reactants_[i_rxn]; ++i_react)
+          species_yields[react_id[i_react]][i_rxn] -= 1.0;
+        for (std::size_t i_prod = 0; i_prod < number_of_products_[i_rxn]; ++i_prod)
+          species_yields[prod_id[i_prod]][i_rxn] += yield[i_prod];
+        react_id += number_of_reactants_[i_rxn];
+        prod_id += number_of_products_[i_rxn];
+        yield += number_of_products_[i_rxn];
+      }
+    }
+    forcing_row_starts_.push_back(0);
+    for (const auto& yields : species_yields)
+    {
+      for (const auto& yield : yields)
+      {
+        forcing_reaction_ids_.push_back(yield.first);
+        forcing_yields_.push_back(yield.second);
       }
+      forcing_row_starts_.push_back(forcing_reaction_ids_.size());
     }
+
+    if (!bucket_by_arity)
+      return;
+
+    std::map<std::pair<std::size_t, std::size_t>, ArityBucket> buckets;
+    auto react_id = reactant_ids_.begin();
+    auto prod_id = product_ids_.begin();
+    auto yield = yields_.begin();
+    for (std::size_t i_rxn = 0; i_rxn < number_of_reactants_.size(); ++i_rxn)
+    {
+      auto& bucket = buckets
+                         .try_emplace(
+                             std::make_pair(number_of_reactants_[i_rxn], number_of_products_[i_rxn]),
+                             ArityBucket{ .number_of_reactants_ = number_of_reactants_[i_rxn],
+                                          .number_of_products_ = number_of_products_[i_rxn],
+                                          .reaction_ids_ = {},
+                                          .reactant_ids_ = {},
+                                          .product_ids_ = {},
+                                          .yields_ = {},
+                                          .jacobian_flat_ids_ = {} })
+                         .first->second;
+      bucket.reaction_ids_.push_back(i_rxn);
+      bucket.reactant_ids_.insert(bucket.reactant_ids_.end(), react_id, react_id + number_of_reactants_[i_rxn]);
+      bucket.product_ids_.insert(bucket.product_ids_.end(), prod_id, prod_id + number_of_products_[i_rxn]);
+      bucket.yields_.insert(bucket.yields_.end(), yield, yield + number_of_products_[i_rxn]);
+      react_id += number_of_reactants_[i_rxn];
+      prod_id += number_of_products_[i_rxn];
+      yield += number_of_products_[i_rxn];
+    }
+    for (auto& bucket : buckets)
+      arity_buckets_.push_back(std::move(bucket.second));
   };
 
   std::set<std::pair<std::size_t, std::size_t>> ProcessSet::NonZeroJacobianElements() const
@@ -118,8 +360,16 @@ namespace micm
     return ids;
   }
 
-  void ProcessSet::SetJacobianFlatIds(const SparseMatrix<double>& matrix)
+  template<typename OrderingPolicy>
+  inline void ProcessSet::SetJacobianFlatIds(
+      const SparseMatrix<double, OrderingPolicy>& matrix,
+      const std::vector<std::size_t>& species_order)
   {
+    std::vector<std::size_t> row(matrix[0].size());
+    for (std::size_t i = 0; i < row.size(); ++i)
+      row[species_order.empty() ? i : species_order[i]] = i;
+    auto flat_id = [&](std::size_t dependent, std::size_t independent)
+    { return matrix.VectorIndex(0, row[dependent], row[independent]); };
     jacobian_flat_ids_.clear();
     auto react_id = reactant_ids_.begin();
     auto prod_id = product_ids_.begin();
@@ -129,26 +379,74 @@ namespace micm
       {
         for (std::size_t i_dep = 0; i_dep < number_of_reactants_[i_rxn]; ++i_dep)
         {
-          jacobian_flat_ids_.push_back(matrix.VectorIndex(0, react_id[i_dep], react_id[i_ind]));
+          jacobian_flat_ids_.push_back(flat_id(react_id[i_dep], react_id[i_ind]));
         }
         for (std::size_t i_dep = 0; i_dep < number_of_products_[i_rxn]; ++i_dep)
         {
-          jacobian_flat_ids_.push_back(matrix.VectorIndex(0, prod_id[i_dep], react_id[i_ind]));
+          jacobian_flat_ids_.push_back(flat_id(prod_id[i_dep], react_id[i_ind]));
         }
       }
       react_id += number_of_reactants_[i_rxn];
       prod_id += number_of_products_[i_rxn];
     }
+    for (auto& bucket : arity_buckets_)
+    {
+      bucket.jacobian_flat_ids_.clear();
+      auto react_id = bucket.reactant_ids_.begin();
+      auto prod_id = bucket.product_ids_.begin();
+      for (std::size_t i_rxn = 0; i_rxn < bucket.reaction_ids_.size(); ++i_rxn)
+      {
+        for (std::size_t i_ind = 0; i_ind < bucket.number_of_reactants_; ++i_ind)
+        {
+          for (std::size_t i_dep = 0; i_dep < bucket.number_of_reactants_; ++i_dep)
+            bucket.jacobian_flat_ids_.push_back(flat_id(react_id[i_dep], react_id[i_ind]));
+          for (std::size_t i_dep = 0; i_dep < bucket.number_of_products_; ++i_dep)
+            bucket.jacobian_flat_ids_.push_back(flat_id(prod_id[i_dep], react_id[i_ind]));
+        }
+        react_id += bucket.number_of_reactants_;
+        prod_id += bucket.number_of_products_;
+      }
+    }
+  }
+
+  template<class Func>
+  inline void ProcessSet::DispatchArity(const ArityBucket& bucket, Func&& func)
+  {
+    auto dispatch_products = [&]<std::size_t NR, std::size_t... NP>(std::index_sequence<NP...>)
+    { return ((bucket.number_of_products_ == NP && (func.template operator()<NR, NP>(), true)) || ...); };
+    bool is_specialized = [&]<std::size_t... NR>(std::index_sequence<NR...>)
+    {
+      return (
+          (bucket.number_of_reactants_ == NR &&
+           dispatch_products.template operator()<NR>(std::make_index_sequence<MAX_SPECIALIZED_PRODUCTS + 1>{})) ||
+          ...);
+    }(std::make_index_sequence<MAX_SPECIALIZED_REACTANTS + 1>{});
+    if (!is_specialized)
+      func.template operator()<DYNAMIC_ARITY, DYNAMIC_ARITY>();
   }
 
   template<template<class> typename MatrixPolicy>
     requires(!Vectorizable<MatrixPolicy<double>>)
-  inline void
-  ProcessSet::AddForcingTerms(const MatrixPolicy<double>& rate_constants, const MatrixPolicy<double>& state_variables, MatrixPolicy<double>& forcing) const
+  inline void ProcessSet::AddForcingTerms(
+      const MatrixPolicy<double>& rate_constants,
+      const MatrixPolicy<double>& state_variables,
+      MatrixPolicy<double>& forcing,
+      const std::vector<bool>& is_active) const
   {
+    if (!arity_buckets_.empty())
+    {
+      for (const auto& bucket : arity_buckets_)
+        DispatchArity(
+            bucket,
+            [&]<std::size_t NR, std::size_t NP>()
+            { AddBucketForcingTerms<NR, NP, MatrixPolicy>(bucket, rate_constants, state_variables, forcing, is_active); });
+      return;
+    }
     // loop over grid cells
     for (std::size_t i_cell = 0; i_cell < state_variables.size(); ++i_cell)
     {
+      if (!IsAnyGridCellActive(is_active, i_cell))
+        continue;
       auto cell_rate_constants = rate_constants[i_cell];
       auto cell_state = state_variables[i_cell];
       auto cell_forcing = forcing[i_cell];
@@ -173,9 +471,24 @@ namespace micm
 
   template<template<class> typename MatrixPolicy>
     requires Vectorizable<MatrixPolicy<double>>
-  inline void
-  ProcessSet::AddForcingTerms(const MatrixPolicy<double>& rate_constants, const MatrixPolicy<double>& state_variables, MatrixPolicy<double>& forcing) const
+  inline void ProcessSet::AddForcingTerms(
+      const MatrixPolicy<double>& rate_constants,
+      const MatrixPolicy<double>& state_variables,
+      MatrixPolicy<double>& forcing,
+      const std::vector<bool>& is_active) const
   {
+    if (!arity_buckets_.empty())
+    {
+      for (const auto& bucket : arity_buckets_)
+        DispatchArity(
+            bucket,
+            [&]<std::size_t NR, std::size_t NP>()
+            {
+              AddVectorizedBucketForcingTerms<NR, NP, MatrixPolicy>(
+                  bucket, rate_constants, state_variables, forcing, is_active);
+            });
+      return;
+    }
     const auto& v_rate_constants = rate_constants.AsVector();
     const auto& v_state_variables = state_variables.AsVector();
     auto& v_forcing = forcing.AsVector();
@@ -183,6 +496,8 @@ namespace micm
     for (std::size_t i_block = 0; i_block < state_variables.NumberOfBlocks(); ++i_block)
     {
       std::size_t L = rate_constants.VectorSize();
+      if (!IsAnyGridCellActive(is_active, i_block * L, L))
+        continue;
       auto react_id = reactant_ids_.begin();
       auto prod_id = product_ids_.begin();
       auto yield = yields_.begin();
@@ -210,16 +525,29 @@ namespace micm
     }
   }
 
-  template<template<class> class MatrixPolicy>
+  template<template<class> class MatrixPolicy, typename SparseMatrixPolicy>
+    requires(!VectorizableSparse<SparseMatrixPolicy>)
   inline void ProcessSet::AddJacobianTerms(
       const MatrixPolicy<double>& rate_constants,
       const MatrixPolicy<double>& state_variables,
-      SparseMatrix<double>& jacobian) const
+      SparseMatrixPolicy& jacobian,
+      const std::vector<bool>& is_active) const
   {
-    auto cell_jacobian = jacobian.AsVector().begin();
+    if (!arity_buckets_.empty())
+    {
+      for (const auto& bucket : arity_buckets_)
+        DispatchArity(
+            bucket,
+            [&]<std::size_t NR, std::size_t NP>()
+            { AddBucketJacobianTerms<NR, NP, MatrixPolicy>(bucket, rate_constants, state_variables, jacobian, is_active); });
+      return;
+    }
     // loop over grid cells
     for (std::size_t i_cell = 0; i_cell < state_variables.size(); ++i_cell)
     {
+      if (!IsAnyGridCellActive(is_active, i_cell))
+        continue;
+      auto cell_jacobian = std::next(jacobian.AsVector().begin(), i_cell * jacobian.FlatBlockSize());
       auto cell_rate_constants = rate_constants[i_cell];
       auto cell_state = state_variables[i_cell];
       auto react_id = reactant_ids_.begin();
@@ -244,8 +572,500 @@ namespace micm
         react_id += number_of_reactants_[i_rxn];
         yield += number_of_products_[i_rxn];
       }
-      cell_jacobian += jacobian.FlatBlockSize();
     }
   }
 
-}  // namespace micm
\ No newline at end of file
+  template<template<class> class MatrixPolicy, typename SparseMatrixPolicy>
+    requires(Vectorizable<MatrixPolicy<double>> && VectorizableSparse<SparseMatrixPolicy>)
+  inline void ProcessSet::AddJacobianTerms(
+      const MatrixPolicy<double>& rate_constants,
+      const MatrixPolicy<double>& state_variables,
+      SparseMatrixPolicy& jacobian,
+      const std::vector<bool>& is_active) const
+  {
+    constexpr std::size_t L = SparseMatrixPolicy::GroupVectorSize();
+    if (L != rate_constants.VectorSize())
+      throw std::invalid_argument("Jacobian group size must match the vector size of the state matrices");
+    if (!arity_buckets_.empty())
+    {
+      for (const auto& bucket : arity_buckets_)
+        DispatchArity(
+            bucket,
+            [&]<std::size_t NR, std::size_t NP>()
+            {
+              AddVectorizedBucketJacobianTerms<NR, NP, MatrixPolicy>(
+                  bucket, rate_constants, state_variables, jacobian, is_active);
+            });
+      return;
+    }
+    const auto& v_rate_constants = rate_constants.AsVector();
+    const auto& v_state_variables = state_variables.AsVector();
+    auto& v_jacobian = jacobian.AsVector();
+    // loop over blocks of grid cells
+    for (std::size_t i_block = 0; i_block < state_variables.NumberOfBlocks(); ++i_block)
+    {
+      if (!IsAnyGridCellActive(is_active, i_block * L, L))
+        continue;
+      auto react_id = reactant_ids_.begin();
+      auto yield = yields_.begin();
+      auto flat_id = jacobian_flat_ids_.begin();
+      std::size_t offset_rc = i_block * rate_constants.BlockSize();
+      std::size_t offset_state = i_block * state_variables.BlockSize();
+      std::size_t offset_jacobian = i_block * L * jacobian.FlatBlockSize();
+      for (std::size_t i_rxn = 0; i_rxn < number_of_reactants_.size(); ++i_rxn)
+      {
+        for (std::size_t i_ind = 0; i_ind < number_of_reactants_[i_rxn]; ++i_ind)
+        {
+          std::array<double, L> d_rate_d_ind;
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            d_rate_d_ind[i_cell] = v_rate_constants[offset_rc + i_rxn * L + i_cell];
+          for (std::size_t i_react = 0; i_react < number_of_reactants_[i_rxn]; ++i_react)
+          {
+            if (i_react == i_ind)
+              continue;
+            for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+              d_rate_d_ind[i_cell] *= v_state_variables[offset_state + react_id[i_react] * L + i_cell];
+          }
+          // the flat ids are the offsets of each element for the first grid cell in a group
+          for (std::size_t i_dep = 0; i_dep < number_of_reactants_[i_rxn]; ++i_dep)
+          {
+            auto jacobian_elem = std::next(v_jacobian.begin(), offset_jacobian + *(flat_id++));
+            for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+              jacobian_elem[i_cell] -= d_rate_d_ind[i_cell];
+          }
+          for (std::size_t i_dep = 0; i_dep < number_of_products_[i_rxn]; ++i_dep)
+          {
+            auto jacobian_elem = std::next(v_jacobian.begin(), offset_jacobian + *(flat_id++));
+            for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+              jacobian_elem[i_cell] += yield[i_dep] * d_rate_d_ind[i_cell];
+          }
+        }
+        react_id += number_of_reactants_[i_rxn];
+        yield += number_of_products_[i_rxn];
+      }
+    }
+  }
+
+  template<template<class> typename MatrixPolicy>
+    requires(!Vectorizable<MatrixPolicy<double>>)
+  inline void ProcessSet::AddForcingTermsByGather(
+      const MatrixPolicy<double>& rate_constants,
+      const MatrixPolicy<double>& state_variables,
+      MatrixPolicy<double>& forcing,
+      MatrixPolicy<double>& rates,
+      const std::vector<bool>& is_active) const
+  {
+    const std::size_t number_of_species = forcing_row_starts_.size() - 1;
+    // loop over grid cells
+    for (std::size_t i_cell = 0; i_cell < state_variables.size(); ++i_cell)
+    {
+      if (!IsAnyGridCellActive(is_active, i_cell))
+        continue;
+      auto cell_rate_constants = rate_constants[i_cell];
+      auto cell_state = state_variables[i_cell];
+      auto cell_forcing = forcing[i_cell];
+      auto cell_rates = rates[i_cell];
+      auto react_id = reactant_ids_.begin();
+      for (std::size_t i_rxn = 0; i_rxn < number_of_reactants_.size(); ++i_rxn)
+      {
+        double rate = cell_rate_constants[i_rxn];
+        for (std::size_t i_react = 0; i_react < number_of_reactants_[i_rxn]; ++i_react)
+          rate *= cell_state[react_id[i_react]];
+        cell_rates[i_rxn] = rate;
+        react_id += number_of_reactants_[i_rxn];
+      }
+      for (std::size_t i_species = 0; i_species < number_of_species; ++i_species)
+      {
+        double species_forcing = 0.0;
+        for (std::size_t i_elem = forcing_row_starts_[i_species]; i_elem < forcing_row_starts_[i_species + 1]; ++i_elem)
+          species_forcing += forcing_yields_[i_elem] * cell_rates[forcing_reaction_ids_[i_elem]];
+        cell_forcing[i_species] += species_forcing;
+      }
+    }
+  }
+
+  template<template<class> typename MatrixPolicy>
+    requires Vectorizable<MatrixPolicy<double>>
+  inline void ProcessSet::AddForcingTermsByGather(
+      const MatrixPolicy<double>& rate_constants,
+      const MatrixPolicy<double>& state_variables,
+      MatrixPolicy<double>& forcing,
+      MatrixPolicy<double>& rates,
+      const std::vector<bool>& is_active) const
+  {
+    const std::size_t number_of_species = forcing_row_starts_.size() - 1;
+    const std::size_t L = rate_constants.VectorSize();
+    const auto& v_rate_constants = rate_constants.AsVector();
+    const auto& v_state_variables = state_variables.AsVector();
+    auto& v_forcing = forcing.AsVector();
+    auto& v_rates = rates.AsVector();
+    // loop over blocks of grid cells
+    for (std::size_t i_block = 0; i_block < state_variables.NumberOfBlocks(); ++i_block)
+    {
+      if (!IsAnyGridCellActive(is_active, i_block * L, L))
+        continue;
+      auto react_id = reactant_ids_.begin();
+      std::size_t offset_rc = i_block * rate_constants.BlockSize();
+      std::size_t offset_state = i_block * state_variables.BlockSize();
+      std::size_t offset_forcing = i_block * forcing.BlockSize();
+      // the rates have the same (reaction, grid cell) layout as the rate constants
+      auto block_rates = std::next(v_rates.begin(), offset_rc);
+      std::copy_n(std::next(v_rate_constants.begin(), offset_rc), number_of_reactants_.size() * L, block_rates);
+      for (std::size_t i_rxn = 0; i_rxn < number_of_reactants_.size(); ++i_rxn)
+      {
+        auto rate = std::next(block_rates, i_rxn * L);
+        for (std::size_t i_react = 0; i_react < number_of_reactants_[i_rxn]; ++i_react)
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            rate[i_cell] *= v_state_variables[offset_state + react_id[i_react] * L + i_cell];
+        react_id += number_of_reactants_[i_rxn];
+      }
+      for (std::size_t i_species = 0; i_species < number_of_species; ++i_species)
+      {
+        auto species_forcing = std::next(v_forcing.begin(), offset_forcing + i_species * L);
+        for (std::size_t i_elem = forcing_row_starts_[i_species]; i_elem < forcing_row_starts_[i_species + 1]; ++i_elem)
+        {
+          const double yield = forcing_yields_[i_elem];
+          auto rate = std::next(block_rates, forcing_reaction_ids_[i_elem] * L);
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            species_forcing[i_cell] += yield * rate[i_cell];
+        }
+      }
+    }
+  }
+
+  template<template<class> class MatrixPolicy, typename SparseMatrixPolicy>
+    requires(!VectorizableSparse<SparseMatrixPolicy>)
+  inline void ProcessSet::AddForcingAndJacobianTerms(
+      const MatrixPolicy<double>& rate_constants,
+      const MatrixPolicy<double>& state_variables,
+      MatrixPolicy<double>& forcing,
+      SparseMatrixPolicy& jacobian,
+      const std::vector<bool>& is_active) const
+  {
+    if (!arity_buckets_.empty() || max_number_of_reactants_ > MAX_FUSED_REACTANTS)
+    {
+      AddForcingTerms<MatrixPolicy>(rate_constants, state_variables, forcing, is_active);
+      AddJacobianTerms<MatrixPolicy>(rate_constants, state_variables, jacobian, is_active);
+      return;
+    }
+    // prefix[i] = k * y_0 * ... * y_(i-1) and suffix[i] = y_i * ... * y_(n-1)
+    std::array<double, MAX_FUSED_REACTANTS + 1> prefix;
+    std::array<double, MAX_FUSED_REACTANTS + 1> suffix;
+    // loop over grid cells
+    for (std::size_t i_cell = 0; i_cell < state_variables.size(); ++i_cell)
+    {
+      if (!IsAnyGridCellActive(is_active, i_cell))
+        continue;
+      auto cell_jacobian = std::next(jacobian.AsVector().begin(), i_cell * jacobian.FlatBlockSize());
+      auto cell_rate_constants = rate_constants[i_cell];
+      auto cell_state = state_variables[i_cell];
+      auto cell_forcing = forcing[i_cell];
+      auto react_id = reactant_ids_.begin();
+      auto prod_id = product_ids_.begin();
+      auto yield = yields_.begin();
+      auto flat_id = jacobian_flat_ids_.begin();
+      for (std::size_t i_rxn = 0; i_rxn < number_of_reactants_.size(); ++i_rxn)
+      {
+        const std::size_t n_react = number_of_reactants_[i_rxn];
+        const std::size_t n_prod = number_of_products_[i_rxn];
+        prefix[0] = cell_rate_constants[i_rxn];
+        suffix[n_react] = 1.0;
+        for (std::size_t i_react = 0; i_react < n_react; ++i_react)
+          prefix[i_react + 1] = prefix[i_react] * cell_state[react_id[i_react]];
+        for (std::size_t i_react = n_react; i_react-- > 0;)
+          suffix[i_react] = suffix[i_react + 1] * cell_state[react_id[i_react]];
+        const double rate = prefix[n_react];
+        for (std::size_t i_react = 0; i_react < n_react; ++i_react)
+          cell_forcing[react_id[i_react]] -= rate;
+        for (std::size_t i_prod = 0; i_prod < n_prod; ++i_prod)
+          cell_forcing[prod_id[i_prod]] += yield[i_prod] * rate;
+        for (std::size_t i_ind = 0; i_ind < n_react; ++i_ind)
+        {
+          const double d_rate_d_ind = prefix[i_ind] * suffix[i_ind + 1];
+          for (std::size_t i_dep = 0; i_dep < n_react; ++i_dep)
+            cell_jacobian[*(flat_id++)] -= d_rate_d_ind;
+          for (std::size_t i_dep = 0; i_dep < n_prod; ++i_dep)
+            cell_jacobian[*(flat_id++)] += yield[i_dep] * d_rate_d_ind;
+        }
+        react_id += n_react;
+        prod_id += n_prod;
+        yield += n_prod;
+      }
+    }
+  }
+
+  template<template<class> class MatrixPolicy, typename SparseMatrixPolicy>
+    requires(Vectorizable<MatrixPolicy<double>> && VectorizableSparse<SparseMatrixPolicy>)
+  inline void ProcessSet::AddForcingAndJacobianTerms(
+      const MatrixPolicy<double>& rate_constants,
+      const MatrixPolicy<double>& state_variables,
+      MatrixPolicy<double>& forcing,
+      SparseMatrixPolicy& jacobian,
+      const std::vector<bool>& is_active) const
+  {
+    constexpr std::size_t L = SparseMatrixPolicy::GroupVectorSize();
+    if (L != rate_constants.VectorSize())
+      throw std::invalid_argument("Jacobian group size must match the vector size of the state matrices");
+    if (!arity_buckets_.empty() || max_number_of_reactants_ > MAX_FUSED_REACTANTS)
+    {
+      AddForcingTerms<MatrixPolicy>(rate_constants, state_variables, forcing, is_active);
+      AddJacobianTerms<MatrixPolicy>(rate_constants, state_variables, jacobian, is_active);
+      return;
+    }
+    // prefix[i] = k * y_0 * ... * y_(i-1) and suffix[i] = y_i * ... * y_(n-1), for each grid cell in a group
+    std::array<double, (MAX_FUSED_REACTANTS + 1) * L> prefix;
+    std::array<double, (MAX_FUSED_REACTANTS + 1) * L> suffix;
+    const auto& v_rate_constants = rate_constants.AsVector();
+    const auto& v_state_variables = state_variables.AsVector();
+    auto& v_forcing = forcing.AsVector();
+    auto& v_jacobian = jacobian.AsVector();
+    // loop over blocks of grid cells
+    for (std::size_t i_block = 0; i_block < state_variables.NumberOfBlocks(); ++i_block)
+    {
+      if (!IsAnyGridCellActive(is_active, i_block * L, L))
+        continue;
+      auto react_id = reactant_ids_.begin();
+      auto prod_id = product_ids_.begin();
+      auto yield = yields_.begin();
+      auto flat_id = jacobian_flat_ids_.begin();
+      std::size_t offset_rc = i_block * rate_constants.BlockSize();
+      std::size_t offset_state = i_block * state_variables.BlockSize();
+      std::size_t offset_forcing = i_block * forcing.BlockSize();
+      std::size_t offset_jacobian = i_block * L * jacobian.FlatBlockSize();
+      for (std::size_t i_rxn = 0; i_rxn < number_of_reactants_.size(); ++i_rxn)
+      {
+        const std::size_t n_react = number_of_reactants_[i_rxn];
+        const std::size_t n_prod = number_of_products_[i_rxn];
+        for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+        {
+          prefix[i_cell] = v_rate_constants[offset_rc + i_rxn * L + i_cell];
+          suffix[n_react * L + i_cell] = 1.0;
+        }
+        for (std::size_t i_react = 0; i_react < n_react; ++i_react)
+        {
+          auto y = std::next(v_state_variables.begin(), offset_state + react_id[i_react] * L);
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            prefix[(i_react + 1) * L + i_cell] = prefix[i_react * L + i_cell] * y[i_cell];
+        }
+        for (std::size_t i_react = n_react; i_react-- > 0;)
+        {
+          auto y = std::next(v_state_variables.begin(), offset_state + react_id[i_react] * L);
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            suffix[i_react * L + i_cell] = suffix[(i_react + 1) * L + i_cell] * y[i_cell];
+        }
+        const double* rate = prefix.data() + n_react * L;
+        for (std::size_t i_react = 0; i_react < n_react; ++i_react)
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            v_forcing[offset_forcing + react_id[i_react] * L + i_cell] -= rate[i_cell];
+        for (std::size_t i_prod = 0; i_prod < n_prod; ++i_prod)
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            v_forcing[offset_forcing + prod_id[i_prod] * L + i_cell] += yield[i_prod] * rate[i_cell];
+        for (std::size_t i_ind = 0; i_ind < n_react; ++i_ind)
+        {
+          double d_rate_d_ind[L];
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            d_rate_d_ind[i_cell] = prefix[i_ind * L + i_cell] * suffix[(i_ind + 1) * L + i_cell];
+          // the flat ids are the offsets of each element for the first grid cell in a group
+          for (std::size_t i_dep = 0; i_dep < n_react; ++i_dep)
+          {
+            auto jacobian_elem = std::next(v_jacobian.begin(), offset_jacobian + *(flat_id++));
+            for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+              jacobian_elem[i_cell] -= d_rate_d_ind[i_cell];
+          }
+          for (std::size_t i_dep = 0; i_dep < n_prod; ++i_dep)
+          {
+            auto jacobian_elem = std::next(v_jacobian.begin(), offset_jacobian + *(flat_id++));
+            for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+              jacobian_elem[i_cell] += yield[i_dep] * d_rate_d_ind[i_cell];
+          }
+        }
+        react_id += n_react;
+        prod_id += n_prod;
+        yield += n_prod;
+      }
+    }
+  }
+
+  template<std::size_t NR, std::size_t NP, template<class> class MatrixPolicy>
+  inline void ProcessSet::AddBucketForcingTerms(
+      const ArityBucket& bucket,
+      const MatrixPolicy<double>& rate_constants,
+      const MatrixPolicy<double>& state_variables,
+      MatrixPolicy<double>& forcing,
+      const std::vector<bool>& is_active) const
+  {
+    // these are compile-time constants for specialized kernels
+    const std::size_t number_of_reactants = NR == DYNAMIC_ARITY ? bucket.number_of_reactants_ : NR;
+    const std::size_t number_of_products = NP == DYNAMIC_ARITY ? bucket.number_of_products_ : NP;
+    // loop over grid cells
+    for (std::size_t i_cell = 0; i_cell < state_variables.size(); ++i_cell)
+    {
+      if (!IsAnyGridCellActive(is_active, i_cell))
+        continue;
+      auto cell_rate_constants = rate_constants[i_cell];
+      auto cell_state = state_variables[i_cell];
+      auto cell_forcing = forcing[i_cell];
+      auto react_id = bucket.reactant_ids_.begin();
+      auto prod_id = bucket.product_ids_.begin();
+      auto yield = bucket.yields_.begin();
+      for (const auto& i_rxn : bucket.reaction_ids_)
+      {
+        double rate = cell_rate_constants[i_rxn];
+        for (std::size_t i_react = 0; i_react < number_of_reactants; ++i_react)
+          rate *= cell_state[react_id[i_react]];
+        for (std::size_t i_react = 0; i_react < number_of_reactants; ++i_react)
+          cell_forcing[react_id[i_react]] -= rate;
+        for (std::size_t i_prod = 0; i_prod < number_of_products; ++i_prod)
+          cell_forcing[prod_id[i_prod]] += yield[i_prod] * rate;
+        react_id += number_of_reactants;
+        prod_id += number_of_products;
+        yield += number_of_products;
+      }
+    }
+  }
+
+  template<std::size_t NR, std::size_t NP, template<class> class MatrixPolicy>
+  inline void ProcessSet::AddVectorizedBucketForcingTerms(
+      const ArityBucket& bucket,
+      const MatrixPolicy<double>& rate_constants,
+      const MatrixPolicy<double>& state_variables,
+      MatrixPolicy<double>& forcing,
+      const std::vector<bool>& is_active) const
+  {
+    const std::size_t number_of_reactants = NR == DYNAMIC_ARITY ? bucket.number_of_reactants_ : NR;
+    const std::size_t number_of_products = NP == DYNAMIC_ARITY ? bucket.number_of_products_ : NP;
+    constexpr std::size_t L = MatrixPolicy<double>::VectorSize();
+    const auto& v_rate_constants = rate_constants.AsVector();
+    const auto& v_state_variables = state_variables.AsVector();
+    auto& v_forcing = forcing.AsVector();
+    // loop over blocks of grid cells
+    for (std::size_t i_block = 0; i_block < state_variables.NumberOfBlocks(); ++i_block)
+    {
+      if (!IsAnyGridCellActive(is_active, i_block * L, L))
+        continue;
+      auto react_id = bucket.reactant_ids_.begin();
+      auto prod_id = bucket.product_ids_.begin();
+      auto yield = bucket.yields_.begin();
+      std::size_t offset_rc = i_block * rate_constants.BlockSize();
+      std::size_t offset_state = i_block * state_variables.BlockSize();
+      std::size_t offset_forcing = i_block * forcing.BlockSize();
+      for (const auto& i_rxn : bucket.reaction_ids_)
+      {
+        std::array<double, L> rate;
+        for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+          rate[i_cell] = v_rate_constants[offset_rc + i_rxn * L + i_cell];
+        for (std::size_t i_react = 0; i_react < number_of_reactants; ++i_react)
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            rate[i_cell] *= v_state_variables[offset_state + react_id[i_react] * L + i_cell];
+        for (std::size_t i_react = 0; i_react < number_of_reactants; ++i_react)
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            v_forcing[offset_forcing + react_id[i_react] * L + i_cell] -= rate[i_cell];
+        for (std::size_t i_prod = 0; i_prod < number_of_products; ++i_prod)
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            v_forcing[offset_forcing + prod_id[i_prod] * L + i_cell] += yield[i_prod] * rate[i_cell];
+        react_id += number_of_reactants;
+        prod_id += number_of_products;
+        yield += number_of_products;
+      }
+    }
+  }
+
+  template<std::size_t NR, std::size_t NP, template<class> class MatrixPolicy, typename SparseMatrixPolicy>
+  inline void ProcessSet::AddBucketJacobianTerms(
+      const ArityBucket& bucket,
+      const MatrixPolicy<double>& rate_constants,
+      const MatrixPolicy<double>& state_variables,
+      SparseMatrixPolicy& jacobian,
+      const std::vector<bool>& is_active) const
+  {
+    const std::size_t number_of_reactants = NR == DYNAMIC_ARITY ? bucket.number_of_reactants_ : NR;
+    const std::size_t number_of_products = NP == DYNAMIC_ARITY ? bucket.number_of_products_ : NP;
+    // loop over grid cells
+    for (std::size_t i_cell = 0; i_cell < state_variables.size(); ++i_cell)
+    {
+      if (!IsAnyGridCellActive(is_active, i_cell))
+        continue;
+      auto cell_jacobian = std::next(jacobian.AsVector().begin(), i_cell * jacobian.FlatBlockSize());
+      auto cell_rate_constants = rate_constants[i_cell];
+      auto cell_state = state_variables[i_cell];
+      auto react_id = bucket.reactant_ids_.begin();
+      auto yield = bucket.yields_.begin();
+      auto flat_id = bucket.jacobian_flat_ids_.begin();
+      for (const auto& i_rxn : bucket.reaction_ids_)
+      {
+        for (std::size_t i_ind = 0; i_ind < number_of_reactants; ++i_ind)
+        {
+          double d_rate_d_ind = cell_rate_constants[i_rxn];
+          for (std::size_t i_react = 0; i_react < number_of_reactants; ++i_react)
+            if (i_react != i_ind)
+              d_rate_d_ind *= cell_state[react_id[i_react]];
+          for (std::size_t i_dep = 0; i_dep < number_of_reactants; ++i_dep)
+            cell_jacobian[*(flat_id++)] -= d_rate_d_ind;
+          for (std::size_t i_dep = 0; i_dep < number_of_products; ++i_dep)
+            cell_jacobian[*(flat_id++)] += yield[i_dep] * d_rate_d_ind;
+        }
+        react_id += number_of_reactants;
+        yield += number_of_products;
+      }
+    }
+  }
+
+  template<std::size_t NR, std::size_t NP, template<class> class MatrixPolicy, typename SparseMatrixPolicy>
+  inline void ProcessSet::AddVectorizedBucketJacobianTerms(
+      const ArityBucket& bucket,
+      const MatrixPolicy<double>& rate_constants,
+      const MatrixPolicy<double>& state_variables,
+      SparseMatrixPolicy& jacobian,
+      const std::vector<bool>& is_active) const
+  {
+    const std::size_t number_of_reactants = NR == DYNAMIC_ARITY ? bucket.number_of_reactants_ : NR;
+    const std::size_t number_of_products = NP == DYNAMIC_ARITY ? bucket.number_of_products_ : NP;
+    constexpr std::size_t L = MatrixPolicy<double>::VectorSize();
+    const auto& v_rate_constants = rate_constants.AsVector();
+    const auto& v_state_variables = state_variables.AsVector();
+    auto& v_jacobian = jacobian.AsVector();
+    // loop over blocks of grid cells
+    for (std::size_t i_block = 0; i_block < state_variables.NumberOfBlocks(); ++i_block)
+    {
+      if (!IsAnyGridCellActive(is_active, i_block * L, L))
+        continue;
+      auto react_id = bucket.reactant_ids_.begin();
+      auto yield = bucket.yields_.begin();
+      auto flat_id = bucket.jacobian_flat_ids_.begin();
+      std::size_t offset_rc = i_block * rate_constants.BlockSize();
+      std::size_t offset_state = i_block * state_variables.BlockSize();
+      std::size_t offset_jacobian = i_block * L * jacobian.FlatBlockSize();
+      for (const auto& i_rxn : bucket.reaction_ids_)
+      {
+        for (std::size_t i_ind = 0; i_ind < number_of_reactants; ++i_ind)
+        {
+          std::array<double, L> d_rate_d_ind;
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            d_rate_d_ind[i_cell] = v_rate_constants[offset_rc + i_rxn * L + i_cell];
+          for (std::size_t i_react = 0; i_react < number_of_reactants; ++i_react)
+          {
+            if (i_react == i_ind)
+              continue;
+            for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+              d_rate_d_ind[i_cell] *= v_state_variables[offset_state + react_id[i_react] * L + i_cell];
+          }
+          for (std::size_t i_dep = 0; i_dep < number_of_reactants; ++i_dep)
+          {
+            auto jacobian_elem = std::next(v_jacobian.begin(), offset_jacobian + *(flat_id++));
+            for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+              jacobian_elem[i_cell] -= d_rate_d_ind[i_cell];
+          }
+          for (std::size_t i_dep = 0; i_dep < number_of_products; ++i_dep)
+          {
+            auto jacobian_elem = std::next(v_jacobian.begin(), offset_jacobian + *(flat_id++));
+            for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+              jacobian_elem[i_cell] += yield[i_dep] * d_rate_d_ind[i_cell];
+          }
+        }
+        react_id += number_of_reactants;
+        yield += number_of_products;
+      }
+    }
+  }
+
+}  // namespace micm
@@ -70,7 +70,7 @@ namespace micm
     /// @param dforce_dy
     /// @param alpha
     /// @return An jacobian decomposition
-    std::vector<double> factored_alpha_minus_jac(const std::vector<double>& dforce_dy, const double& alpha) override;
+    std::vector<double> factored_alpha_minus_jac(const std::vector<double>& dforce_dy, const double& alpha);
 
     /// @brief Computes product of [dforce_dy * vector]
     /// @param dforce_dy  jacobian of forcing
@@ -87,7 +87,7 @@ namespace micm
     /// @param K idk, something
     /// @param ode_jacobian the jacobian
     /// @return the new state?
-    std::vector<double> lin_solve(const std::vector<double>& K, const std::vector<double>& ode_jacobian) override;
+    std::vector<double> lin_solve(const std::vector<double>& K, const std::vector<double>& ode_jacobian);
 
     /// @brief Compute the derivative of the forcing w.r.t. each chemical, the jacobian
     /// @param rate_constants List of rate constants for each needed species
@@ -114,10 +114,20 @@ namespace micm
 
     /// @brief Factor
     /// @param jacobian
-    void factor(std::vector<double>& jacobian) override;
-
-    std::vector<double> backsolve_L_y_eq_b(const std::vector<double>& jacobian, const std::vector<double>& b) override;
-    std::vector<double> backsolve_U_x_eq_b(const std::vector<double>& jacobian, const std::vector<double>& y) override;
+    void factor(std::vector<double>& jacobian);
+
+    std::vector<double> backsolve_L_y_eq_b(const std::vector<double>& jacobian, const std::vector<double>& b);
+    std::vector<double> backsolve_U_x_eq_b(const std::vector<double>& jacobian, const std::vector<double>& y);
+
+    /// @brief Computes the scaled norm of the vector errors
+    /// @param original_number_densities the original number densities
+    /// @param new_number_densities the new number densities
+    /// @param errors The computed errors
+    /// @return
+    double error_norm(
+        const std::vector<double>& original_number_densities,
+        const std::vector<double>& new_number_densities,
+        const std::vector<double>& errors) const;
   };
 
   inline ChapmanODESolver::ChapmanODESolver()
@@ -667,6 +677,26 @@ namespace micm
     return x;
   }
 
+  inline double ChapmanODESolver::error_norm(
+      const std::vector<double>& Y,
+      const std::vector<double>& Ynew,
+      const std::vector<double>& errors) const
+  {
+    // Solving Ordinary Differential Equations II, page 123
+    // https://link-springer-com.cuucar.idm.oclc.org/book/10.1007/978-3-642-05221-7
+    double sum = 0;
+    for (uint64_t idx = 0; idx < Y.size(); ++idx)
+    {
+      double scale =
+          parameters_.absolute_tolerance_ + parameters_.relative_tolerance_ * std::max(std::abs(Y[idx]), std::abs(Ynew[idx]));
+      double ratio = errors[idx] / scale;
+      sum += ratio * ratio;
+    }
+
+    double error_min_ = 1.0e-10;
+    return std::max(std::sqrt(sum / Y.size()), error_min_);
+  }
+
   inline std::vector<double> ChapmanODESolver::dforce_dy(
       const std::vector<double>& rate_constants,
       const std::vector<double>& number_densities,
@@ -0,0 +1,263 @@
+// Copyright (C) 2023 National Center for Atmospheric Research
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <micm/process/process.hpp>
+#include <micm/solver/solver_code_generator.hpp>
+#include <micm/system/system.hpp>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MICM_HAS_DLOPEN
+#endif
+
+namespace micm
+{
+
+  /// @brief Options for compiling mechanism-specific solver kernels at runtime
+  struct CompiledKernelsParameters
+  {
+    std::string cache_directory_{};  // Where compiled kernels are kept (default: $XDG_CACHE_HOME/micm or ~/.cache/micm)
+    std::string compiler_{ "c++" };
+    std::string compiler_flags_{ "-O3 -shared -fPIC" };
+  };
+
+  /// @brief Solver kernels generated for one mechanism, compiled, and loaded at runtime
+  ///
+  /// The source from GenerateSolverSource is compiled into a shared library with the system compiler and loaded
+  /// with dlopen. Libraries are kept in a cache directory under a name made from a hash of the generated source
+  /// and the compiler options, so later runs with the same mechanism load the cached library without compiling.
+  /// A cached library is only loaded if it and the cache directory belong to the current user and no one else
+  /// can write to them; a library that fails this check is rebuilt, and a cache directory that fails it is not used.
+  /// If the library cannot be built or loaded (for example, when there is no compiler) IsLoaded() is false and
+  /// callers use the general kernels instead.
+  ///
+  /// The kernels work on the data of Matrix and standard-ordered SparseMatrix containers, with the Jacobian
+  /// sparsity structure used by RosenbrockSolver.
+  class CompiledKernels
+  {
+    using TermsFunction = void (*)(const double*, const double*, double*, std::size_t);
+    using DecomposeFunction = void (*)(const double*, double*, double*, std::size_t);
+    using SolveFunction = void (*)(const double*, double*, const double*, const double*, std::size_t);
+
+    std::shared_ptr<void> library_{};
+    TermsFunction add_forcing_terms_{ nullptr };
+    TermsFunction add_jacobian_terms_{ nullptr };
+    DecomposeFunction decompose_{ nullptr };
+    SolveFunction solve_{ nullptr };
+    std::filesystem::path library_path_{};
+
+   public:
+    /// @brief Default constructor, with no kernels loaded
+    CompiledKernels() = default;
+
+    /// @brief Loads the kernels for a mechanism from the cache, compiling them first if needed
+    /// @param system The chemical system
+    /// @param processes The chemical processes, in the order of their rate constants
+    /// @param parameters Compiler and cache options
+    /// @param reorder_species Reorder the Jacobian as RosenbrockSolver does with reorder_species_
+    CompiledKernels(
+        const System& system,
+        const std::vector<Process>& processes,
+        const CompiledKernelsParameters& parameters = {},
+        bool reorder_species = true);
+
+    /// @brief Returns true if the compiled kernels are available
+    bool IsLoaded() const
+    {
+      return library_ != nullptr;
+    }
+
+    /// @brief Path to the shared library the kernels were loaded from
+    const std::filesystem::path& LibraryPath() const
+    {
+      return library_path_;
+    }
+
+    /// @brief Returns the 64-bit FNV-1a hash of a string as 16 hexadecimal digits
+    static std::string Hash(const std::string& text);
+
+    /// @brief Returns the default cache directory, $XDG_CACHE_HOME/micm or ~/.cache/micm, or an empty path if
+    ///        neither variable is set
+    static std::filesystem::path DefaultCacheDirectory();
+
+    /// @brief Returns true if a file or directory (not a symbolic link) belongs to the current user and
+    ///        neither its group nor other users can write to it
+    static bool IsPrivate(const std::filesystem::path& path);
+
+    /// @brief Adds forcing terms for each grid cell (see ProcessSet::AddForcingTerms)
+    void AddForcingTerms(const double* rate_constants, const double* state_variables, double* forcing, std::size_t number_of_grid_cells)
+        const
+    {
+      add_forcing_terms_(rate_constants, state_variables, forcing, number_of_grid_cells);
+    }
+
+    /// @brief Adds Jacobian terms for each grid cell (see ProcessSet::AddJacobianTerms)
+    void AddJacobianTerms(const double* rate_constants, const double* state_variables, double* jacobian, std::size_t number_of_grid_cells)
+        const
+    {
+      add_jacobian_terms_(rate_constants, state_variables, jacobian, number_of_grid_cells);
+    }
+
+    /// @brief Computes the LU decomposition of each block of A (see LuDecomposition::Decompose)
+    void Decompose(const double* A, double* L, double* U, std::size_t number_of_grid_cells) const
+    {
+      decompose_(A, L, U, number_of_grid_cells);
+    }
+
+    /// @brief Solves LUx = b for each grid cell; b and x may be the same array (see LinearSolver::Solve)
+    void Solve(const double* b, double* x, const double* L, const double* U, std::size_t number_of_grid_cells) const
+    {
+      solve_(b, x, L, U, number_of_grid_cells);
+    }
+  };
+
+  inline CompiledKernels::CompiledKernels(
+      const System& system,
+      const std::vector<Process>& processes,
+      const CompiledKernelsParameters& parameters,
+      bool reorder_species)
+  {
+#ifdef MICM_HAS_DLOPEN
+    std::string source = GenerateSolverSource(
+        system,
+        processes,
+        SolverCodeGeneratorParameters{ .namespace_ = "micm_compiled", .reorder_species_ = reorder_species });
+    source +=
+        "\nextern \"C\"\n{\n"
+        "  void micm_add_forcing_terms(const double* k, const double* y, double* f, std::size_t n)\n"
+        "  {\n    micm_compiled::AddForcingTerms(k, y, f, n);\n  }\n"
+        "  void micm_add_jacobian_terms(const double* k, const double* y, double* j, std::size_t n)\n"
+        "  {\n    micm_compiled::AddJacobianTerms(k, y, j, n);\n  }\n"
+        "  void micm_decompose(const double* A, double* L, double* U, std::size_t n)\n"
+        "  {\n    micm_compiled::Decompose(A, L, U, n);\n  }\n"
+        "  void micm_solve(const double* b, double* x, const double* L, const double* U, std::size_t n)\n"
+        "  {\n    micm_compiled::Solve(b, x, L, U, n);\n  }\n"
+        "}\n";
+
+    std::error_code error;
+    std::filesystem::path cache_directory = parameters.cache_directory_;
+    if (cache_directory.empty())
+      cache_directory = DefaultCacheDirectory();
+    if (cache_directory.empty())
+      return;
+    // other users must not be able to place a library in the cache for this process to load
+    if (std::filesystem::create_directories(cache_directory, error))
+      std::filesystem::permissions(cache_directory, std::filesystem::perms::owner_all, error);
+    if (error || !IsPrivate(cache_directory))
+      return;
+
+    const std::string name =
+        "micm_kernels_" + Hash(source + '\n' + parameters.compiler_ + '\n' + parameters.compiler_flags_);
+    const auto library_path = cache_directory / (name + ".so");
+
+    if (std::filesystem::exists(library_path) && !IsPrivate(library_path))
+      std::filesystem::remove(library_path, error);
+    if (!std::filesystem::exists(library_path))
+    {
+      // build under a name that is unique to this process and call and rename it, so concurrent processes
+      // and threads never write the same files or load a partly written library
+      static std::atomic<std::uint64_t> build_counter{ 0 };
+      const std::string unique =
+          name + "." + std::to_string(static_cast<long>(getpid())) + "." + std::to_string(build_counter++);
+      const auto source_path = cache_directory / (unique + ".cpp");
+      const auto build_path = cache_directory / (unique + ".so");
+      {
+        std::ofstream source_file(source_path);
+        source_file << source;
+        if (!source_file)
+          return;
+      }
+      const std::string command = parameters.compiler_ + " " + parameters.compiler_flags_ + " -o \"" + build_path.string() +
+                                  "\" \"" + source_path.string() + "\" > /dev/null 2>&1";
+      const int status = std::system(command.c_str());
+      std::filesystem::remove(source_path, error);
+      if (status != 0 || !std::filesystem::exists(build_path))
+      {
+        std::filesystem::remove(build_path, error);
+        return;
+      }
+      std::filesystem::permissions(
+          build_path,
+          std::filesystem::perms::group_write | std::filesystem::perms::others_write,
+          std::filesystem::perm_options::remove,
+          error);
+      std::filesystem::rename(build_path, library_path, error);
+      if (error)
+      {
+        std::filesystem::remove(build_path, error);
+        return;
+      }
+    }
+
+    void* handle = dlopen(library_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle)
+      return;
+    std::shared_ptr<void> library(handle, [](void* h) { dlclose(h); });
+    auto forcing = reinterpret_cast<TermsFunction>(dlsym(handle, "micm_add_forcing_terms"));
+    auto jacobian = reinterpret_cast<TermsFunction>(dlsym(handle, "micm_add_jacobian_terms"));
+    auto decompose = reinterpret_cast<DecomposeFunction>(dlsym(handle, "micm_decompose"));
+    auto solve = reinterpret_cast<SolveFunction>(dlsym(handle, "micm_solve"));
+    if (!forcing || !jacobian || !decompose || !solve)
+      return;
+    library_ = std::move(library);
+    add_forcing_terms_ = forcing;
+    add_jacobian_terms_ = jacobian;
+    decompose_ = decompose;
+    solve_ = solve;
+    library_path_ = library_path;
+#endif
+  }
+
+  inline std::filesystem::path CompiledKernels::DefaultCacheDirectory()
+  {
+    const char* xdg_cache_home = std::getenv("XDG_CACHE_HOME");
+    if (xdg_cache_home && std::filesystem::path(xdg_cache_home).is_absolute())
+      return std::filesystem::path(xdg_cache_home) / "micm";
+    const char* home = std::getenv("HOME");
+    if (home && std::filesystem::path(home).is_absolute())
+      return std::filesystem::path(home) / ".cache" / "micm";
+    return {};
+  }
+
+  inline bool CompiledKernels::IsPrivate(const std::filesystem::path& path)
+  {
+#ifdef MICM_HAS_DLOPEN
+    struct stat status;
+    if (lstat(path.c_str(), &status) != 0 || S_ISLNK(status.st_mode))
+      return false;
+    return status.st_uid == geteuid() && (status.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+#else
+    return false;
+#endif
+  }
+
+  inline std::string CompiledKernels::Hash(const std::string& text)
+  {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : text)
+    {
+      hash ^= c;
+      hash *= 1099511628211ull;
+    }
+    std::ostringstream hex;
+    hex << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return hex.str();
+  }
+
+}  // namespace micm
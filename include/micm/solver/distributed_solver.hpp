@@ -0,0 +1,338 @@
+// Copyright (C) 2023 National Center for Atmospheric Research
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <mpi.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <micm/process/process.hpp>
+#include <micm/solver/rosenbrock.hpp>
+#include <micm/solver/solver.hpp>
+#include <micm/solver/state.hpp>
+#include <micm/system/system.hpp>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace micm
+{
+
+  /// @brief Parameters for distributing grid cells across MPI ranks
+  struct DistributedSolverParameters
+  {
+    std::size_t number_of_grid_cells_{ 1 };  // Total number of grid cells on all ranks
+    std::size_t rebalance_interval_{ 10 };   // Number of calls to Solve between rebalancing (0 to never rebalance)
+  };
+
+  /// @brief Returns the relative cost of solving a grid cell from its solver statistics
+  ///
+  /// Every step, accepted or rejected, costs at least one factorization and one set of stage
+  /// calculations, and a rejected step also wastes the work done for it.
+  /// @param stats Statistics for the grid cell
+  /// @return The cost of the grid cell
+  inline double GridCellCost(const Solver::Rosenbrock_stats& stats)
+  {
+    return static_cast<double>(stats.number_of_steps + stats.rejected + stats.decompositions);
+  }
+
+  /// @brief Divides a sequence of grid cells into contiguous ranges with about the same total cost
+  ///
+  /// Each range gets at least one grid cell.
+  /// @param cost The cost of each grid cell
+  /// @param number_of_ranges The number of ranges (must not exceed the number of grid cells)
+  /// @return The index of the first grid cell in each range, followed by the total number of grid cells
+  inline std::vector<std::size_t> PartitionGridCells(const std::vector<double>& cost, std::size_t number_of_ranges)
+  {
+    const std::size_t number_of_cells = cost.size();
+    if (number_of_ranges == 0 || number_of_ranges > number_of_cells)
+      throw std::invalid_argument("Grid cells cannot be partitioned into the requested number of ranges");
+    double total_cost = std::accumulate(cost.begin(), cost.end(), 0.0);
+    if (total_cost <= 0.0)
+      return PartitionGridCells(std::vector<double>(number_of_cells, 1.0), number_of_ranges);
+
+    std::vector<std::size_t> first_cell(number_of_ranges + 1, 0);
+    first_cell[number_of_ranges] = number_of_cells;
+    double cumulative_cost = 0.0;
+    std::size_t i_cell = 0;
+    for (std::size_t i_range = 1; i_range < number_of_ranges; ++i_range)
+    {
+      const double target = total_cost * i_range / number_of_ranges;
+      // a grid cell goes to the previous range if more than half of its cost falls below the target,
+      // leaving at least one grid cell for each of the remaining ranges
+      while (i_cell < number_of_cells - (number_of_ranges - i_range) &&
+             (i_cell == first_cell[i_range - 1] || cumulative_cost + 0.5 * cost[i_cell] < target))
+      {
+        cumulative_cost += cost[i_cell++];
+      }
+      first_cell[i_range] = i_cell;
+    }
+    return first_cell;
+  }
+
+  /// @brief Solves a chemical system whose grid cells are distributed across MPI ranks
+  ///
+  /// Each rank owns a contiguous range of the global grid cells and solves them with its own
+  /// RosenbrockSolver. The cost of each grid cell is accumulated from the solver statistics
+  /// (per grid cell when RosenbrockSolverParameters::per_cell_step_control_ is set, otherwise
+  /// every grid cell on a rank is charged the cost of the rank's solve). Rebalance moves grid
+  /// cells between ranks so that each rank has about the same total cost.
+  ///
+  /// All of the public functions, except the accessors, are collective over the communicator.
+  template<template<class> class MatrixPolicy>
+  class DistributedSolver
+  {
+    MPI_Comm comm_;
+    int rank_;
+    int number_of_ranks_;
+    System system_;
+    std::vector<Process> processes_;
+    DistributedSolverParameters distributed_parameters_;
+    /// Index of the first global grid cell on each rank, followed by the total number of grid cells
+    std::vector<std::size_t> first_cell_;
+    /// Cost of each local grid cell since the last rebalance
+    std::vector<double> cell_cost_;
+    std::size_t solves_since_rebalance_{ 0 };
+    std::unique_ptr<RosenbrockSolver<MatrixPolicy>> solver_;
+
+   public:
+    /// @brief Distributes the grid cells evenly across the ranks of a communicator
+    /// @param system The chemical system to create the solver for
+    /// @param processes The collection of chemical processes that will be applied during solving
+    /// @param parameters Parameters for the solver on each rank (number_of_grid_cells_ is set for each rank)
+    /// @param distributed_parameters Parameters for the distribution of grid cells
+    /// @param comm The MPI communicator
+    DistributedSolver(
+        const System& system,
+        const std::vector<Process>& processes,
+        const RosenbrockSolverParameters& parameters,
+        const DistributedSolverParameters& distributed_parameters,
+        MPI_Comm comm = MPI_COMM_WORLD);
+
+    /// @brief Returns a state that holds the grid cells owned by this rank
+    State<MatrixPolicy> GetState() const;
+
+    /// @brief Update the rate constants for the environment state of the local grid cells
+    /// @param state The local state of the chemical system
+    void UpdateState(State<MatrixPolicy>& state);
+
+    /// @brief Solves the local grid cells and records their cost
+    /// @param time_start Time step to start at
+    /// @param time_end Time step to end at
+    /// @param state The local state of the chemical system
+    /// @return A struct containing results and a status code for the local grid cells
+    Solver::SolverResult Solve(double time_start, double time_end, State<MatrixPolicy>& state) noexcept;
+
+    /// @brief Returns true once DistributedSolverParameters::rebalance_interval_ solves have been done since
+    ///        the last rebalance (the result is the same on every rank)
+    bool NeedsRebalance() const;
+
+    /// @brief Moves grid cells between ranks so that each rank has about the same total cost
+    ///
+    /// The state variables, conditions, custom rate parameters, and rate constants of each grid
+    /// cell move with it, and the local state is replaced by one for the new local grid cells.
+    /// The local solver is resized in place, so it keeps the method selected with SetTableau.
+    /// @param state The local state of the chemical system
+    void Rebalance(State<MatrixPolicy>& state);
+
+    /// @brief Returns the global index of the first grid cell owned by this rank
+    std::size_t FirstLocalGridCell() const;
+
+    /// @brief Returns the number of grid cells owned by this rank
+    std::size_t NumberOfLocalGridCells() const;
+
+    /// @brief Returns the solver for the local grid cells
+    RosenbrockSolver<MatrixPolicy>& LocalSolver();
+
+   private:
+    /// @brief Creates the solver for the local grid cells
+    void CreateLocalSolver(RosenbrockSolverParameters parameters);
+  };
+
+  template<template<class> class MatrixPolicy>
+  inline DistributedSolver<MatrixPolicy>::DistributedSolver(
+      const System& system,
+      const std::vector<Process>& processes,
+      const RosenbrockSolverParameters& parameters,
+      const DistributedSolverParameters& distributed_parameters,
+      MPI_Comm comm)
+      : comm_(comm),
+        rank_(0),
+        number_of_ranks_(1),
+        system_(system),
+        processes_(processes),
+        distributed_parameters_(distributed_parameters),
+        first_cell_(),
+        cell_cost_(),
+        solves_since_rebalance_(0),
+        solver_()
+  {
+    MPI_Comm_rank(comm_, &rank_);
+    MPI_Comm_size(comm_, &number_of_ranks_);
+    first_cell_ = PartitionGridCells(
+        std::vector<double>(distributed_parameters_.number_of_grid_cells_, 1.0), static_cast<std::size_t>(number_of_ranks_));
+    cell_cost_.assign(NumberOfLocalGridCells(), 0.0);
+    CreateLocalSolver(parameters);
+  }
+
+  template<template<class> class MatrixPolicy>
+  inline State<MatrixPolicy> DistributedSolver<MatrixPolicy>::GetState() const
+  {
+    return solver_->GetState();
+  }
+
+  template<template<class> class MatrixPolicy>
+  inline void DistributedSolver<MatrixPolicy>::UpdateState(State<MatrixPolicy>& state)
+  {
+    solver_->UpdateState(state);
+  }
+
+  template<template<class> class MatrixPolicy>
+  inline Solver::SolverResult
+  DistributedSolver<MatrixPolicy>::Solve(double time_start, double time_end, State<MatrixPolicy>& state) noexcept
+  {
+    Solver::SolverResult result = solver_->Solve(time_start, time_end, state);
+    if (result.cell_stats_.size() == cell_cost_.size())
+    {
+      for (std::size_t i_cell = 0; i_cell < cell_cost_.size(); ++i_cell)
+        cell_cost_[i_cell] += GridCellCost(result.cell_stats_[i_cell]);
+    }
+    else
+    {
+      // all of the local grid cells took the same steps
+      const double cost = GridCellCost(result.stats_);
+      for (auto& cell_cost : cell_cost_)
+        cell_cost += cost;
+    }
+    ++solves_since_rebalance_;
+    return result;
+  }
+
+  template<template<class> class MatrixPolicy>
+  inline bool DistributedSolver<MatrixPolicy>::NeedsRebalance() const
+  {
+    return number_of_ranks_ > 1 && distributed_parameters_.rebalance_interval_ > 0 &&
+           solves_since_rebalance_ >= distributed_parameters_.rebalance_interval_;
+  }
+
+  template<template<class> class MatrixPolicy>
+  inline void DistributedSolver<MatrixPolicy>::Rebalance(State<MatrixPolicy>& state)
+  {
+    const std::size_t number_of_ranks = static_cast<std::size_t>(number_of_ranks_);
+    const std::size_t rank = static_cast<std::size_t>(rank_);
+
+    // gather the cost of every grid cell, so every rank calculates the same new partition
+    std::vector<int> counts(number_of_ranks);
+    std::vector<int> displacements(number_of_ranks);
+    for (std::size_t i_rank = 0; i_rank < number_of_ranks; ++i_rank)
+    {
+      counts[i_rank] = static_cast<int>(first_cell_[i_rank + 1] - first_cell_[i_rank]);
+      displacements[i_rank] = static_cast<int>(first_cell_[i_rank]);
+    }
+    std::vector<double> cost(first_cell_.back(), 0.0);
+    MPI_Allgatherv(
+        cell_cost_.data(), counts[rank], MPI_DOUBLE, cost.data(), counts.data(), displacements.data(), MPI_DOUBLE, comm_);
+    std::vector<std::size_t> new_first_cell = PartitionGridCells(cost, number_of_ranks);
+
+    // pack each local grid cell for its new owner; the local grid cells and the ranges owned
+    // by each rank are both in global order, so the send buffer is already grouped by rank
+    const std::size_t number_of_species = state.variables_[0].size();
+    const std::size_t number_of_custom_parameters = state.custom_rate_parameters_[0].size();
+    const std::size_t number_of_rate_constants = state.rate_constants_[0].size();
+    const std::size_t record_size = number_of_species + 3 + number_of_custom_parameters + number_of_rate_constants;
+    std::vector<double> send_buffer;
+    send_buffer.reserve(NumberOfLocalGridCells() * record_size);
+    std::vector<int> send_counts(number_of_ranks, 0);
+    for (std::size_t i_cell = 0; i_cell < NumberOfLocalGridCells(); ++i_cell)
+    {
+      std::size_t global_cell = first_cell_[rank] + i_cell;
+      std::size_t owner = std::upper_bound(new_first_cell.begin(), new_first_cell.end(), global_cell) -
+                          new_first_cell.begin() - 1;
+      send_counts[owner] += static_cast<int>(record_size);
+      for (std::size_t i = 0; i < number_of_species; ++i)
+        send_buffer.push_back(state.variables_[i_cell][i]);
+      send_buffer.push_back(state.conditions_[i_cell].temperature_);
+      send_buffer.push_back(state.conditions_[i_cell].pressure_);
+      send_buffer.push_back(state.conditions_[i_cell].air_density_);
+      for (std::size_t i = 0; i < number_of_custom_parameters; ++i)
+        send_buffer.push_back(state.custom_rate_parameters_[i_cell][i]);
+      for (std::size_t i = 0; i < number_of_rate_constants; ++i)
+        send_buffer.push_back(state.rate_constants_[i_cell][i]);
+    }
+    std::vector<int> receive_counts(number_of_ranks, 0);
+    MPI_Alltoall(send_counts.data(), 1, MPI_INT, receive_counts.data(), 1, MPI_INT, comm_);
+    std::vector<int> send_displacements(number_of_ranks, 0);
+    std::vector<int> receive_displacements(number_of_ranks, 0);
+    for (std::size_t i_rank = 1; i_rank < number_of_ranks; ++i_rank)
+    {
+      send_displacements[i_rank] = send_displacements[i_rank - 1] + send_counts[i_rank - 1];
+      receive_displacements[i_rank] = receive_displacements[i_rank - 1] + receive_counts[i_rank - 1];
+    }
+    std::vector<double> receive_buffer(receive_displacements.back() + receive_counts.back());
+    MPI_Alltoallv(
+        send_buffer.data(),
+        send_counts.data(),
+        send_displacements.data(),
+        MPI_DOUBLE,
+        receive_buffer.data(),
+        receive_counts.data(),
+        receive_displacements.data(),
+        MPI_DOUBLE,
+        comm_);
+
+    // the received grid cells are also in global order, because lower ranks own lower grid cells
+    const std::size_t number_of_local_cells = new_first_cell[rank + 1] - new_first_cell[rank];
+    const bool is_resized = number_of_local_cells != NumberOfLocalGridCells();
+    first_cell_ = std::move(new_first_cell);
+    // resizing keeps the tableau selected for the local solver, and its species reordering, LU plan, and kernels
+    if (is_resized)
+      solver_->SetNumberOfGridCells(number_of_local_cells);
+    State<MatrixPolicy> new_state = solver_->GetState();
+    auto record = receive_buffer.begin();
+    for (std::size_t i_cell = 0; i_cell < number_of_local_cells; ++i_cell)
+    {
+      for (std::size_t i = 0; i < number_of_species; ++i)
+        new_state.variables_[i_cell][i] = *(record++);
+      new_state.conditions_[i_cell].temperature_ = *(record++);
+      new_state.conditions_[i_cell].pressure_ = *(record++);
+      new_state.conditions_[i_cell].air_density_ = *(record++);
+      for (std::size_t i = 0; i < number_of_custom_parameters; ++i)
+        new_state.custom_rate_parameters_[i_cell][i] = *(record++);
+      for (std::size_t i = 0; i < number_of_rate_constants; ++i)
+        new_state.rate_constants_[i_cell][i] = *(record++);
+    }
+    state = std::move(new_state);
+    cell_cost_.assign(number_of_local_cells, 0.0);
+    solves_since_rebalance_ = 0;
+  }
+
+  template<template<class> class MatrixPolicy>
+  inline std::size_t DistributedSolver<MatrixPolicy>::FirstLocalGridCell() const
+  {
+    return first_cell_[rank_];
+  }
+
+  template<template<class> class MatrixPolicy>
+  inline std::size_t DistributedSolver<MatrixPolicy>::NumberOfLocalGridCells() const
+  {
+    return first_cell_[rank_ + 1] - first_cell_[rank_];
+  }
+
+  template<template<class> class MatrixPolicy>
+  inline RosenbrockSolver<MatrixPolicy>& DistributedSolver<MatrixPolicy>::LocalSolver()
+  {
+    return *solver_;
+  }
+
+  template<template<class> class MatrixPolicy>
+  inline void DistributedSolver<MatrixPolicy>::CreateLocalSolver(RosenbrockSolverParameters parameters)
+  {
+    parameters.number_of_grid_cells_ = NumberOfLocalGridCells();
+    solver_ = std::make_unique<RosenbrockSolver<MatrixPolicy>>(
+        system_, std::vector<Process>(processes_), parameters);
+  }
+
+}  // namespace micm
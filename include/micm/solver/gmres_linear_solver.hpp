@@ -0,0 +1,361 @@
+// Copyright (C) 2023 National Center for Atmospheric Research
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <micm/solver/linear_solver.hpp>
+#include <micm/solver/lu_decomposition.hpp>
+#include <micm/solver/sparse_matrix_vector_product.hpp>
+#include <micm/util/sparse_matrix.hpp>
+#include <utility>
+#include <vector>
+
+namespace micm
+{
+
+  /// @brief Options for the GMRES linear solver
+  struct GmresParameters
+  {
+    std::size_t max_iterations_{ 30 };      // Size of the Krylov subspace before each restart (at most the matrix size)
+    std::size_t max_restarts_{ 20 };        // Number of restarts before giving up on convergence
+    double relative_tolerance_{ 1.0e-12 };  // Required reduction of the residual norm, relative to the norm of b
+  };
+
+  /// @brief Working memory for GmresLinearSolver::Solve
+  ///
+  /// Holds the Krylov basis, Hessenberg matrices and Givens rotations of every block, so a solver can be called
+  /// repeatedly without allocating memory. After a call to Solve, is_converged_ flags the blocks whose residual
+  /// norm reached the tolerance.
+  template<typename T, template<class> class MatrixPolicy>
+  struct GmresWorkspace
+  {
+    std::size_t number_of_blocks_{ 0 };
+    std::size_t block_size_{ 0 };
+    std::size_t max_krylov_size_{ 0 };      // Krylov subspace size before each restart (m)
+    MatrixPolicy<T> rhs_;                   // copy of b, which may be the same object as x
+    std::vector<MatrixPolicy<T>> V_;        // Krylov basis (m + 1 vectors)
+    MatrixPolicy<T> w_;
+    MatrixPolicy<T> z_;
+    std::vector<T> H_;                      // Hessenberg matrix of each block, stored by row
+    std::vector<T> cs_;                     // Givens rotation cosines of each block
+    std::vector<T> sn_;                     // Givens rotation sines of each block
+    std::vector<T> g_;                      // rotated residual vector of each block
+    std::vector<T> tolerance_;              // residual norm at which each block is converged
+    std::vector<T> y_;
+    std::vector<std::size_t> krylov_size_;  // current Krylov subspace size of each block
+    std::vector<bool> is_active_;
+    std::vector<bool> is_converged_;
+
+    /// @brief Default constructor
+    GmresWorkspace() = default;
+
+    /// @brief Allocates the working memory for systems of a given size
+    /// @param number_of_blocks Number of blocks (grid cells)
+    /// @param block_size Number of variables in each block
+    /// @param parameters GMRES options of the solver the workspace is used with
+    GmresWorkspace(std::size_t number_of_blocks, std::size_t block_size, const GmresParameters& parameters)
+        : number_of_blocks_(number_of_blocks),
+          block_size_(block_size),
+          max_krylov_size_(std::max(std::min(parameters.max_iterations_, block_size), std::size_t{ 1 })),
+          rhs_(number_of_blocks, block_size, 0.0),
+          V_(max_krylov_size_ + 1, MatrixPolicy<T>(number_of_blocks, block_size, 0.0)),
+          w_(number_of_blocks, block_size, 0.0),
+          z_(number_of_blocks, block_size, 0.0),
+          H_(number_of_blocks * (max_krylov_size_ + 1) * max_krylov_size_, 0.0),
+          cs_(number_of_blocks * max_krylov_size_, 0.0),
+          sn_(number_of_blocks * max_krylov_size_, 0.0),
+          g_(number_of_blocks * (max_krylov_size_ + 1), 0.0),
+          tolerance_(number_of_blocks, 0.0),
+          y_(max_krylov_size_, 0.0),
+          krylov_size_(number_of_blocks, 0),
+          is_active_(number_of_blocks, false),
+          is_converged_(number_of_blocks, true)
+    {
+    }
+
+    /// @brief Returns true if every block converged in the most recent solve
+    bool IsConverged() const
+    {
+      return std::all_of(is_converged_.begin(), is_converged_.end(), [](bool converged) { return converged; });
+    }
+  };
+
+  /// @brief A block-diagonal sparse-matrix linear solver that uses restarted GMRES with an ILU(0) preconditioner
+  ///
+  /// The matrix is never factored completely. Factor computes the incomplete LU decomposition ILU(0), which has
+  /// the sparsity structure of the matrix (see LuDecomposition), and Solve applies right-preconditioned GMRES(m)
+  /// to each block. The only operations on the matrix are sparse matrix-vector products, so the memory use grows
+  /// with the number of non-zero elements of the matrix instead of with the fill-in of its LU decomposition,
+  /// which suits very large mechanisms.
+  ///
+  /// All of the blocks are iterated together, with a separate Krylov subspace for each block, so the products
+  /// and triangular solves run over every grid cell at once. A block stops iterating when its residual norm
+  /// is reduced by GmresParameters::relative_tolerance_. The OrderingPolicy of the sparse matrices must match the
+  /// layout of the vectors passed to Solve (see SparseMatrixOrderingFor).
+  template<typename T, class OrderingPolicy = SparseMatrixStandardOrdering>
+  class GmresLinearSolver
+  {
+    LinearSolver<T, OrderingPolicy> preconditioner_;
+    std::vector<std::size_t> variable_order_;
+    GmresParameters parameters_;
+
+   public:
+    /// @brief default constructor
+    GmresLinearSolver() = default;
+
+    /// @brief Constructs a GMRES linear solver for the sparsity structure of the given matrix
+    /// @param matrix Sparse matrix
+    /// @param species_order The element of b and x for each row (and column) of the matrix, when the rows and columns
+    ///                      are reordered (see DiagonalMarkowitzReordering); empty when they are in the same order
+    /// @param parameters GMRES options
+    GmresLinearSolver(
+        const SparseMatrix<T, OrderingPolicy>& matrix,
+        const std::vector<std::size_t>& species_order = {},
+        const GmresParameters& parameters = {});
+
+    /// @brief Create the sparse L and U matrices of the ILU(0) preconditioner for a given A matrix
+    static std::pair<SparseMatrix<T, OrderingPolicy>, SparseMatrix<T, OrderingPolicy>> GetLUMatrices(
+        const SparseMatrix<T, OrderingPolicy>& A)
+    {
+      return LuDecomposition::GetLUMatrices(A, true);
+    }
+
+    /// @brief Computes the ILU(0) preconditioner of a matrix
+    /// @param matrix Matrix to precondition (must have the sparsity structure the solver was created with)
+    /// @param lower_matrix Lower triangular matrix of the preconditioner (see GetLUMatrices)
+    /// @param upper_matrix Upper triangular matrix of the preconditioner (see GetLUMatrices)
+    /// @param is_active The blocks (grid cells) to decompose (see IsAnyGridCellActive); empty for all blocks
+    void Factor(
+        const SparseMatrix<T, OrderingPolicy>& matrix,
+        SparseMatrix<T, OrderingPolicy>& lower_matrix,
+        SparseMatrix<T, OrderingPolicy>& upper_matrix,
+        const std::vector<bool>& is_active = {}) const;
+
+    /// @brief Solve for x in Ax = b
+    /// @param b Right-hand side vector for each block (grid cell, variable)
+    /// @param x Solution vector for each block (grid cell, variable), which may be the same object as b
+    /// @param matrix The matrix A
+    /// @param lower_matrix Lower triangular matrix of the preconditioner from a call to Factor
+    /// @param upper_matrix Upper triangular matrix of the preconditioner from a call to Factor
+    /// @param workspace Working memory, which is re-allocated only if it was not sized for b and this solver
+    /// @return The number of GMRES iterations (see GmresWorkspace::IsConverged for whether the solve converged)
+    template<template<class> class MatrixPolicy>
+    std::size_t Solve(
+        const MatrixPolicy<T>& b,
+        MatrixPolicy<T>& x,
+        const SparseMatrix<T, OrderingPolicy>& matrix,
+        const SparseMatrix<T, OrderingPolicy>& lower_matrix,
+        const SparseMatrix<T, OrderingPolicy>& upper_matrix,
+        GmresWorkspace<T, MatrixPolicy>& workspace) const;
+  };
+
+  template<typename T, class OrderingPolicy>
+  inline GmresLinearSolver<T, OrderingPolicy>::GmresLinearSolver(
+      const SparseMatrix<T, OrderingPolicy>& matrix,
+      const std::vector<std::size_t>& species_order,
+      const GmresParameters& parameters)
+      : preconditioner_(matrix, species_order, true),
+        variable_order_(species_order),
+        parameters_(parameters)
+  {
+  }
+
+  template<typename T, class OrderingPolicy>
+  inline void GmresLinearSolver<T, OrderingPolicy>::Factor(
+      const SparseMatrix<T, OrderingPolicy>& matrix,
+      SparseMatrix<T, OrderingPolicy>& lower_matrix,
+      SparseMatrix<T, OrderingPolicy>& upper_matrix,
+      const std::vector<bool>& is_active) const
+  {
+    preconditioner_.Factor(matrix, lower_matrix, upper_matrix, is_active);
+  }
+
+  template<typename T, class OrderingPolicy>
+  template<template<class> class MatrixPolicy>
+  inline std::size_t GmresLinearSolver<T, OrderingPolicy>::Solve(
+      const MatrixPolicy<T>& b,
+      MatrixPolicy<T>& x,
+      const SparseMatrix<T, OrderingPolicy>& matrix,
+      const SparseMatrix<T, OrderingPolicy>& lower_matrix,
+      const SparseMatrix<T, OrderingPolicy>& upper_matrix,
+      GmresWorkspace<T, MatrixPolicy>& workspace) const
+  {
+    const std::size_t number_of_cells = b.size();
+    if (number_of_cells == 0)
+      return 0;
+    const std::size_t n = b[0].size();
+    const std::size_t m = std::max(std::min(parameters_.max_iterations_, n), std::size_t{ 1 });
+    if (workspace.number_of_blocks_ != number_of_cells || workspace.block_size_ != n || workspace.max_krylov_size_ != m)
+      workspace = GmresWorkspace<T, MatrixPolicy>(number_of_cells, n, parameters_);
+
+    auto dot = [&](const MatrixPolicy<T>& u, const MatrixPolicy<T>& v, std::size_t i_cell)
+    {
+      auto u_cell = u[i_cell];
+      auto v_cell = v[i_cell];
+      T sum = 0;
+      for (std::size_t i = 0; i < n; ++i)
+        sum += u_cell[i] * v_cell[i];
+      return sum;
+    };
+
+    auto& rhs = workspace.rhs_;  // b is kept for the residuals at restarts, as x may be the same object
+    auto& V = workspace.V_;
+    auto& w = workspace.w_;
+    auto& z = workspace.z_;
+    // Hessenberg matrix (after the Givens rotations, upper triangular) of each block, stored by row
+    auto& H = workspace.H_;
+    auto& cs = workspace.cs_;
+    auto& sn = workspace.sn_;
+    auto& g = workspace.g_;
+    auto& tolerance = workspace.tolerance_;
+    auto& krylov_size = workspace.krylov_size_;
+    auto& is_active = workspace.is_active_;
+    auto& is_converged = workspace.is_converged_;
+    auto& y = workspace.y_;
+
+    std::copy(b.AsVector().begin(), b.AsVector().end(), rhs.AsVector().begin());
+    std::fill(is_converged.begin(), is_converged.end(), false);
+
+    for (std::size_t i_cell = 0; i_cell < number_of_cells; ++i_cell)
+      tolerance[i_cell] = parameters_.relative_tolerance_ * std::sqrt(dot(rhs, rhs, i_cell));
+    std::fill(x.AsVector().begin(), x.AsVector().end(), 0.0);
+    std::size_t iterations = 0;
+
+    for (std::size_t i_restart = 0; i_restart <= parameters_.max_restarts_; ++i_restart)
+    {
+      // residual r = b - A x (x is zero in the first cycle)
+      if (i_restart == 0)
+        w = rhs;
+      else
+      {
+        SparseMatrixVectorProduct<MatrixPolicy>(matrix, x, w, variable_order_);
+        for (std::size_t i_cell = 0; i_cell < number_of_cells; ++i_cell)
+        {
+          auto w_cell = w[i_cell];
+          auto rhs_cell = rhs[i_cell];
+          for (std::size_t i = 0; i < n; ++i)
+            w_cell[i] = rhs_cell[i] - w_cell[i];
+        }
+      }
+      bool any_active = false;
+      for (std::size_t i_cell = 0; i_cell < number_of_cells; ++i_cell)
+      {
+        const T beta = std::sqrt(dot(w, w, i_cell));
+        auto g_cell = std::next(g.begin(), i_cell * (m + 1));
+        std::fill(g_cell, g_cell + m + 1, 0.0);
+        g_cell[0] = beta;
+        krylov_size[i_cell] = 0;
+        is_converged[i_cell] = beta <= tolerance[i_cell];
+        is_active[i_cell] = !is_converged[i_cell];
+        any_active = any_active || is_active[i_cell];
+        auto w_cell = w[i_cell];
+        auto v_cell = V[0][i_cell];
+        for (std::size_t i = 0; i < n; ++i)
+          v_cell[i] = is_active[i_cell] ? w_cell[i] / beta : 0.0;
+      }
+      if (!any_active)
+        break;
+
+      // Arnoldi iterations with modified Gram-Schmidt, applying M^-1 on the right
+      for (std::size_t k = 0; k < m && any_active; ++k)
+      {
+        preconditioner_.template Solve<MatrixPolicy>(V[k], z, lower_matrix, upper_matrix);
+        SparseMatrixVectorProduct<MatrixPolicy>(matrix, z, w, variable_order_);
+        ++iterations;
+        any_active = false;
+        for (std::size_t i_cell = 0; i_cell < number_of_cells; ++i_cell)
+        {
+          auto v_next_cell = V[k + 1][i_cell];
+          if (!is_active[i_cell])
+          {
+            for (std::size_t i = 0; i < n; ++i)
+              v_next_cell[i] = 0.0;
+            continue;
+          }
+          auto h = std::next(H.begin(), i_cell * (m + 1) * m);
+          auto c = std::next(cs.begin(), i_cell * m);
+          auto s = std::next(sn.begin(), i_cell * m);
+          auto g_cell = std::next(g.begin(), i_cell * (m + 1));
+          auto w_cell = w[i_cell];
+          for (std::size_t j = 0; j <= k; ++j)
+          {
+            const T h_jk = dot(w, V[j], i_cell);
+            h[j * m + k] = h_jk;
+            auto v_cell = V[j][i_cell];
+            for (std::size_t i = 0; i < n; ++i)
+              w_cell[i] -= h_jk * v_cell[i];
+          }
+          const T h_next = std::sqrt(dot(w, w, i_cell));
+          for (std::size_t i = 0; i < n; ++i)
+            v_next_cell[i] = h_next > 0 ? w_cell[i] / h_next : 0.0;
+          h[(k + 1) * m + k] = h_next;
+
+          // rotate the new column into upper triangular form
+          for (std::size_t j = 0; j < k; ++j)
+          {
+            const T temp = c[j] * h[j * m + k] + s[j] * h[(j + 1) * m + k];
+            h[(j + 1) * m + k] = -s[j] * h[j * m + k] + c[j] * h[(j + 1) * m + k];
+            h[j * m + k] = temp;
+          }
+          const T denominator = std::hypot(h[k * m + k], h[(k + 1) * m + k]);
+          if (denominator == 0)
+          {
+            // the subspace cannot grow, so the solution is the best one in the current subspace
+            is_active[i_cell] = false;
+            continue;
+          }
+          c[k] = h[k * m + k] / denominator;
+          s[k] = h[(k + 1) * m + k] / denominator;
+          h[k * m + k] = denominator;
+          h[(k + 1) * m + k] = 0;
+          g_cell[k + 1] = -s[k] * g_cell[k];
+          g_cell[k] = c[k] * g_cell[k];
+          krylov_size[i_cell] = k + 1;
+
+          is_converged[i_cell] = std::abs(g_cell[k + 1]) <= tolerance[i_cell] || h_next == 0;
+          is_active[i_cell] = !is_converged[i_cell];
+          any_active = any_active || is_active[i_cell];
+        }
+      }
+
+      // x += M^-1 V y, with H y = g
+      for (std::size_t i_cell = 0; i_cell < number_of_cells; ++i_cell)
+      {
+        const std::size_t k_size = krylov_size[i_cell];
+        auto h = std::next(H.begin(), i_cell * (m + 1) * m);
+        auto g_cell = std::next(g.begin(), i_cell * (m + 1));
+        for (std::size_t j = k_size; j-- > 0;)
+        {
+          T sum = g_cell[j];
+          for (std::size_t l = j + 1; l < k_size; ++l)
+            sum -= h[j * m + l] * y[l];
+          y[j] = sum / h[j * m + j];
+        }
+        auto w_cell = w[i_cell];
+        for (std::size_t i = 0; i < n; ++i)
+          w_cell[i] = 0.0;
+        for (std::size_t j = 0; j < k_size; ++j)
+        {
+          auto v_cell = V[j][i_cell];
+          for (std::size_t i = 0; i < n; ++i)
+            w_cell[i] += y[j] * v_cell[i];
+        }
+      }
+      preconditioner_.template Solve<MatrixPolicy>(w, z, lower_matrix, upper_matrix);
+      for (std::size_t i_cell = 0; i_cell < number_of_cells; ++i_cell)
+      {
+        auto x_cell = x[i_cell];
+        auto z_cell = z[i_cell];
+        for (std::size_t i = 0; i < n; ++i)
+          x_cell[i] += z_cell[i];
+      }
+      if (std::all_of(is_converged.begin(), is_converged.end(), [](bool converged) { return converged; }))
+        break;
+    }
+    return iterations;
+  }
+
+}  // namespace micm
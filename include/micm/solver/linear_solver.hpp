@@ -3,30 +3,544 @@
 
 #pragma once
 
+#include <iterator>
+#include <micm/process/process_set.hpp>
 #include <micm/solver/lu_decomposition.hpp>
+#include <micm/util/openmp.hpp>
 #include <micm/util/sparse_matrix.hpp>
+#include <utility>
+#include <vector>
 
 namespace micm
 {
 
-  /// @brief A general-use sparse-matrix linear solver
+  /// @brief A general-use block-diagonal sparse-matrix linear solver
+  ///
+  /// The sparsity pattern of each block in the block diagonal matrix is the same.
+  ///
+  /// The solution to A x = b is split into the numeric factorization A = L U
+  /// followed by the calculation of L y = b and then U x = y:
+  ///
+  /// y_1 = b_1
+  /// y_i = b_i - sum( j = 1...i-1 ){ L_ij * y_j }  i = 2...N
+  ///
+  /// x_N = y_N / U_NN
+  /// x_i = 1 / U_ii * [ y_i - sum( j = i+1...N ){ U_ij * x_j } ]  i = N-1...1
+  ///
+  /// L has a unit diagonal (see LuDecomposition), so no division is needed in the forward
+  /// substitution. The indices of the non-zero terms used in the forward and backward
+  /// substitutions are determined during construction, so calls to Solve only walk these arrays.
+  ///
+  /// When the solver is created with more than one thread, the rows of the factorization and of the
+  /// two substitutions are grouped into levels of rows that do not depend on each other (see
+  /// LuDecomposition::Levels), and the rows of each level are run in parallel with OpenMP, in one parallel
+  /// region per factorization or solve (levels with fewer than LuDecomposition::MIN_PARALLEL_LEVEL_SIZE rows
+  /// are run by one thread). This speeds up the solution of large matrices for a few grid cells; for many grid
+  /// cells it is better to split the cells among the threads, and the two should not be nested.
+  ///
+  /// The OrderingPolicy of the sparse matrices must match the layout of the vectors passed to Solve. With
+  /// SparseMatrixVectorOrdering and VectorMatrix, the factorization and substitutions run over the grid cells
+  /// of a group in the innermost loop (see SparseMatrixOrderingFor), and the rows of each level are shared
+  /// among the threads one group at a time.
+  template<typename T, class OrderingPolicy = SparseMatrixStandardOrdering>
   class LinearSolver
   {
+    /// Number of non-zero elements (excluding the diagonal) for each row in L
+    std::vector<std::size_t> nLij_;
+    /// Indices of non-zero combinations of L_ij and y_j
+    std::vector<std::pair<std::size_t, std::size_t>> Lij_yj_;
+    /// Number of non-zero elements (excluding the diagonal) and the element of the diagonal
+    /// for each row in U (in reverse order)
+    std::vector<std::pair<std::size_t, std::size_t>> nUij_Uii_;
+    /// Indices of non-zero combinations of U_ij and x_j
+    std::vector<std::pair<std::size_t, std::size_t>> Uij_xj_;
+    /// Element of b and x for each row of the matrix
+    std::vector<std::size_t> row_variable_ids_;
+    /// Index in Lij_yj_ of the first term of each row, and of the end
+    std::vector<std::size_t> Lij_start_;
+    /// Index in Uij_xj_ of the first term of each element of nUij_Uii_, and of the end
+    std::vector<std::size_t> Uij_start_;
+    /// Rows of each level of the forward substitution
+    std::vector<std::vector<std::size_t>> lower_levels_;
+    /// Rows of each level of the backward substitution
+    std::vector<std::vector<std::size_t>> upper_levels_;
+    /// Number of threads for the rows of each level
+    std::size_t number_of_threads_{ 1 };
+
     LuDecomposition lu_decomp_;
+    SparseMatrix<T, OrderingPolicy> lower_matrix_;
+    SparseMatrix<T, OrderingPolicy> upper_matrix_;
 
-    public:
+   public:
     /// @brief default constructor
     LinearSolver() = default;
 
     /// @brief Constructs a linear solver for the sparsity structure of the given matrix
     /// @param matrix Sparse matrix
-    template<class T>
-    LinearSolver(const SparseMatrix<T>& matrix);
+    /// @param species_order The element of b and x for each row (and column) of the matrix, when the rows and columns
+    ///                      are reordered (see DiagonalMarkowitzReordering); empty when they are in the same order
+    /// @param incomplete Use the incomplete factorization ILU(0), so that Solve applies an approximate inverse of
+    ///                   the matrix (see GmresLinearSolver)
+    /// @param number_of_threads Number of threads that factor and solve the independent rows of each level in
+    ///                          parallel (with OpenMP)
+    LinearSolver(
+        const SparseMatrix<T, OrderingPolicy>& matrix,
+        const std::vector<std::size_t>& species_order = {},
+        bool incomplete = false,
+        std::size_t number_of_threads = 1);
+
+    /// @brief Decompose the matrix into upper and lower triangular matrices
+    /// @param matrix Matrix to decompose (must have the sparsity structure the solver was created with)
+    void Factor(const SparseMatrix<T, OrderingPolicy>& matrix);
+
+    /// @brief Decompose the matrix into the given upper and lower triangular matrices
+    ///
+    /// The solver itself is not modified, so several threads can share one solver as long as
+    /// each of them has its own L and U matrices (see LuDecomposition::GetLUMatrices).
+    /// @param matrix Matrix to decompose (must have the sparsity structure the solver was created with)
+    /// @param lower_matrix Lower triangular matrix
+    /// @param upper_matrix Upper triangular matrix
+    /// @param is_active The blocks (grid cells) to decompose (see IsAnyGridCellActive); empty for all blocks
+    void Factor(
+        const SparseMatrix<T, OrderingPolicy>& matrix,
+        SparseMatrix<T, OrderingPolicy>& lower_matrix,
+        SparseMatrix<T, OrderingPolicy>& upper_matrix,
+        const std::vector<bool>& is_active = {}) const;
+
+    /// @brief Solve for x in Ax = b using the most recently factored A
+    /// @param b Right-hand side vector for each block (grid cell, variable)
+    /// @param x Solution vector for each block (grid cell, variable)
+    template<template<class> class MatrixPolicy>
+    void Solve(const MatrixPolicy<T>& b, MatrixPolicy<T>& x) const;
 
+    /// @brief Solve for x in Ax = b using the given factorization of A
+    /// @param b Right-hand side vector for each block (grid cell, variable)
+    /// @param x Solution vector for each block (grid cell, variable)
+    /// @param lower_matrix Lower triangular matrix from a call to Factor
+    /// @param upper_matrix Upper triangular matrix from a call to Factor
+    /// @param is_active The blocks (grid cells) to solve for (see IsAnyGridCellActive); empty for all blocks
+    template<template<class> class MatrixPolicy>
+      requires(!VectorizableSparse<SparseMatrix<T, OrderingPolicy>>)
+    void Solve(
+        const MatrixPolicy<T>& b,
+        MatrixPolicy<T>& x,
+        const SparseMatrix<T, OrderingPolicy>& lower_matrix,
+        const SparseMatrix<T, OrderingPolicy>& upper_matrix,
+        const std::vector<bool>& is_active = {}) const;
+    template<template<class> class MatrixPolicy>
+      requires(Vectorizable<MatrixPolicy<T>> && VectorizableSparse<SparseMatrix<T, OrderingPolicy>>)
+    void Solve(
+        const MatrixPolicy<T>& b,
+        MatrixPolicy<T>& x,
+        const SparseMatrix<T, OrderingPolicy>& lower_matrix,
+        const SparseMatrix<T, OrderingPolicy>& upper_matrix,
+        const std::vector<bool>& is_active = {}) const;
+
+   private:
+    /// @brief Solve for x in Ax = b one level of rows at a time, with the rows of each level in parallel
+    template<template<class> class MatrixPolicy>
+      requires(!VectorizableSparse<SparseMatrix<T, OrderingPolicy>>)
+    void SolveByLevel(
+        const MatrixPolicy<T>& b,
+        MatrixPolicy<T>& x,
+        const SparseMatrix<T, OrderingPolicy>& lower_matrix,
+        const SparseMatrix<T, OrderingPolicy>& upper_matrix,
+        const std::vector<bool>& is_active) const;
+    template<template<class> class MatrixPolicy>
+      requires(Vectorizable<MatrixPolicy<T>> && VectorizableSparse<SparseMatrix<T, OrderingPolicy>>)
+    void SolveByLevel(
+        const MatrixPolicy<T>& b,
+        MatrixPolicy<T>& x,
+        const SparseMatrix<T, OrderingPolicy>& lower_matrix,
+        const SparseMatrix<T, OrderingPolicy>& upper_matrix,
+        const std::vector<bool>& is_active) const;
   };
 
-  template<class T>
-  inline LinearSolver::LinearSolver(const SparseMatrix<T>& matrix)
-    : lu_decomp_(matrix) {};
+  template<typename T, class OrderingPolicy>
+  inline LinearSolver<T, OrderingPolicy>::LinearSolver(
+      const SparseMatrix<T, OrderingPolicy>& matrix,
+      const std::vector<std::size_t>& species_order,
+      bool incomplete,
+      std::size_t number_of_threads)
+      : nLij_(),
+        Lij_yj_(),
+        nUij_Uii_(),
+        Uij_xj_(),
+        row_variable_ids_(species_order),
+        Lij_start_(),
+        Uij_start_(),
+        lower_levels_(),
+        upper_levels_(),
+        number_of_threads_(number_of_threads),
+        lu_decomp_(matrix, incomplete)
+  {
+    auto lu = LuDecomposition::GetLUMatrices(matrix, incomplete);
+    lower_matrix_ = std::move(lu.first);
+    upper_matrix_ = std::move(lu.second);
+    std::size_t n = matrix[0].size();
+    if (row_variable_ids_.empty())
+      for (std::size_t i = 0; i < n; ++i)
+        row_variable_ids_.push_back(i);
+    const auto& L_row_start = lower_matrix_.RowStartVector();
+    const auto& L_row_ids = lower_matrix_.RowIdsVector();
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      Lij_start_.push_back(Lij_yj_.size());
+      std::size_t nLij = 0;
+      for (std::size_t j_id = L_row_start[i]; j_id < L_row_start[i + 1]; ++j_id)
+      {
+        std::size_t j = L_row_ids[j_id];
+        if (j >= i)
+          break;
+        Lij_yj_.push_back(std::make_pair(j_id, row_variable_ids_[j]));
+        ++nLij;
+      }
+      nLij_.push_back(nLij);
+    }
+    Lij_start_.push_back(Lij_yj_.size());
+    const auto& U_row_start = upper_matrix_.RowStartVector();
+    const auto& U_row_ids = upper_matrix_.RowIdsVector();
+    for (std::size_t i = n; i-- > 0;)
+    {
+      Uij_start_.push_back(Uij_xj_.size());
+      std::size_t nUij = 0;
+      std::size_t Uii = 0;
+      for (std::size_t j_id = U_row_start[i]; j_id < U_row_start[i + 1]; ++j_id)
+      {
+        std::size_t j = U_row_ids[j_id];
+        if (j == i)
+          Uii = j_id;
+        if (j <= i)
+          continue;
+        Uij_xj_.push_back(std::make_pair(j_id, row_variable_ids_[j]));
+        ++nUij;
+      }
+      nUij_Uii_.push_back(std::make_pair(nUij, Uii));
+    }
+    Uij_start_.push_back(Uij_xj_.size());
+    if (number_of_threads_ > 1)
+    {
+      lower_levels_ = LuDecomposition::GetSubstitutionLevels(lower_matrix_, true);
+      upper_levels_ = LuDecomposition::GetSubstitutionLevels(upper_matrix_, false);
+    }
+  }
+
+  template<typename T, class OrderingPolicy>
+  inline void LinearSolver<T, OrderingPolicy>::Factor(const SparseMatrix<T, OrderingPolicy>& matrix)
+  {
+    Factor(matrix, lower_matrix_, upper_matrix_);
+  }
+
+  template<typename T, class OrderingPolicy>
+  inline void LinearSolver<T, OrderingPolicy>::Factor(
+      const SparseMatrix<T, OrderingPolicy>& matrix,
+      SparseMatrix<T, OrderingPolicy>& lower_matrix,
+      SparseMatrix<T, OrderingPolicy>& upper_matrix,
+      const std::vector<bool>& is_active) const
+  {
+    lu_decomp_.Decompose(matrix, lower_matrix, upper_matrix, number_of_threads_, is_active);
+  }
+
+  template<typename T, class OrderingPolicy>
+  template<template<class> class MatrixPolicy>
+  inline void LinearSolver<T, OrderingPolicy>::Solve(const MatrixPolicy<T>& b, MatrixPolicy<T>& x) const
+  {
+    Solve<MatrixPolicy>(b, x, lower_matrix_, upper_matrix_);
+  }
+
+  template<typename T, class OrderingPolicy>
+  template<template<class> class MatrixPolicy>
+    requires(!VectorizableSparse<SparseMatrix<T, OrderingPolicy>>)
+  inline void LinearSolver<T, OrderingPolicy>::Solve(
+      const MatrixPolicy<T>& b,
+      MatrixPolicy<T>& x,
+      const SparseMatrix<T, OrderingPolicy>& lower_matrix,
+      const SparseMatrix<T, OrderingPolicy>& upper_matrix,
+      const std::vector<bool>& is_active) const
+  {
+    if (number_of_threads_ > 1)
+    {
+      SolveByLevel<MatrixPolicy>(b, x, lower_matrix, upper_matrix, is_active);
+      return;
+    }
+    for (std::size_t i_cell = 0; i_cell < b.size(); ++i_cell)
+    {
+      if (!IsAnyGridCellActive(is_active, i_cell))
+        continue;
+      auto b_cell = b[i_cell];
+      auto x_cell = x[i_cell];
+      auto L_cell = std::next(lower_matrix.AsVector().begin(), i_cell * lower_matrix.FlatBlockSize());
+      auto U_cell = std::next(upper_matrix.AsVector().begin(), i_cell * upper_matrix.FlatBlockSize());
+      // y is stored in x to avoid an intermediate vector. Each element of b is read before the same element
+      // of x is written, so b and x can be the same
+
+      // Forward substitution
+      {
+        auto Lij_yj = Lij_yj_.begin();
+        auto row_variable_id = row_variable_ids_.begin();
+        for (auto& nLij : nLij_)
+        {
+          T y_i = b_cell[*row_variable_id];
+          for (std::size_t ij = 0; ij < nLij; ++ij)
+          {
+            y_i -= L_cell[Lij_yj->first] * x_cell[Lij_yj->second];
+            ++Lij_yj;
+          }
+          x_cell[*(row_variable_id++)] = y_i;
+        }
+      }
+
+      // Backward substitution
+      {
+        auto Uij_xj = Uij_xj_.begin();
+        std::size_t i = nUij_Uii_.size();
+        for (auto& nUij_Uii : nUij_Uii_)
+        {
+          const std::size_t i_variable = row_variable_ids_[--i];
+          T x_i = x_cell[i_variable];
+          for (std::size_t ij = 0; ij < nUij_Uii.first; ++ij)
+          {
+            x_i -= U_cell[Uij_xj->first] * x_cell[Uij_xj->second];
+            ++Uij_xj;
+          }
+          x_cell[i_variable] = x_i / U_cell[nUij_Uii.second];
+        }
+      }
+    }
+  }
+
+  template<typename T, class OrderingPolicy>
+  template<template<class> class MatrixPolicy>
+    requires(Vectorizable<MatrixPolicy<T>> && VectorizableSparse<SparseMatrix<T, OrderingPolicy>>)
+  inline void LinearSolver<T, OrderingPolicy>::Solve(
+      const MatrixPolicy<T>& b,
+      MatrixPolicy<T>& x,
+      const SparseMatrix<T, OrderingPolicy>& lower_matrix,
+      const SparseMatrix<T, OrderingPolicy>& upper_matrix,
+      const std::vector<bool>& is_active) const
+  {
+    if (number_of_threads_ > 1)
+    {
+      SolveByLevel<MatrixPolicy>(b, x, lower_matrix, upper_matrix, is_active);
+      return;
+    }
+    constexpr std::size_t L = OrderingPolicy::GroupVectorSize();
+    for (std::size_t i_group = 0; i_group < b.NumberOfBlocks(); ++i_group)
+    {
+      if (!IsAnyGridCellActive(is_active, i_group * L, L))
+        continue;
+      auto b_group = std::next(b.AsVector().begin(), i_group * b.BlockSize());
+      auto x_group = std::next(x.AsVector().begin(), i_group * x.BlockSize());
+      auto L_group = std::next(lower_matrix.AsVector().begin(), i_group * L * lower_matrix.FlatBlockSize());
+      auto U_group = std::next(upper_matrix.AsVector().begin(), i_group * L * upper_matrix.FlatBlockSize());
+      // As for a single grid cell, y is stored in x and b and x can be the same. Each row of x is only
+      // combined with the rows of other variables, so it can be updated in place.
+
+      // Forward substitution
+      {
+        auto Lij_yj = Lij_yj_.begin();
+        for (std::size_t i = 0; i < nLij_.size(); ++i)
+        {
+          auto b_row = std::next(b_group, row_variable_ids_[i] * L);
+          auto x_row = std::next(x_group, row_variable_ids_[i] * L);
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            x_row[i_cell] = b_row[i_cell];
+          for (std::size_t ij = 0; ij < nLij_[i]; ++ij)
+          {
+            auto L_elem = std::next(L_group, Lij_yj->first * L);
+            auto y_row = std::next(x_group, Lij_yj->second * L);
+            for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+              x_row[i_cell] -= L_elem[i_cell] * y_row[i_cell];
+            ++Lij_yj;
+          }
+        }
+      }
+
+      // Backward substitution
+      {
+        auto Uij_xj = Uij_xj_.begin();
+        std::size_t i = nUij_Uii_.size();
+        for (auto& nUij_Uii : nUij_Uii_)
+        {
+          auto x_row = std::next(x_group, row_variable_ids_[--i] * L);
+          for (std::size_t ij = 0; ij < nUij_Uii.first; ++ij)
+          {
+            auto U_elem = std::next(U_group, Uij_xj->first * L);
+            auto x_j_row = std::next(x_group, Uij_xj->second * L);
+            for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+              x_row[i_cell] -= U_elem[i_cell] * x_j_row[i_cell];
+            ++Uij_xj;
+          }
+          auto U_diagonal = std::next(U_group, nUij_Uii.second * L);
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            x_row[i_cell] /= U_diagonal[i_cell];
+        }
+      }
+    }
+  }
+
+  template<typename T, class OrderingPolicy>
+  template<template<class> class MatrixPolicy>
+    requires(!VectorizableSparse<SparseMatrix<T, OrderingPolicy>>)
+  inline void LinearSolver<T, OrderingPolicy>::SolveByLevel(
+      const MatrixPolicy<T>& b,
+      MatrixPolicy<T>& x,
+      const SparseMatrix<T, OrderingPolicy>& lower_matrix,
+      const SparseMatrix<T, OrderingPolicy>& upper_matrix,
+      const std::vector<bool>& is_active) const
+  {
+    const std::size_t n = row_variable_ids_.size();
+    // Each row only reads the elements of x of rows in earlier levels, and its own element of b
+    auto forward_row = [&](std::size_t i_cell, std::size_t i, auto L_cell)
+    {
+      auto x_cell = x[i_cell];
+      T y_i = b[i_cell][row_variable_ids_[i]];
+      for (std::size_t ij = Lij_start_[i]; ij < Lij_start_[i + 1]; ++ij)
+        y_i -= L_cell[Lij_yj_[ij].first] * x_cell[Lij_yj_[ij].second];
+      x_cell[row_variable_ids_[i]] = y_i;
+    };
+    auto backward_row = [&](std::size_t i_cell, std::size_t i, auto U_cell)
+    {
+      const std::size_t position = n - 1 - i;  // position of row i in nUij_Uii_
+      auto x_cell = x[i_cell];
+      T x_i = x_cell[row_variable_ids_[i]];
+      for (std::size_t ij = Uij_start_[position]; ij < Uij_start_[position + 1]; ++ij)
+        x_i -= U_cell[Uij_xj_[ij].first] * x_cell[Uij_xj_[ij].second];
+      x_cell[row_variable_ids_[i]] = x_i / U_cell[nUij_Uii_[position].second];
+    };
+    // As in LuDecomposition::Decompose, one team of threads runs every grid cell and level, with the barrier
+    // at the end of each worksharing construct between levels
+    MICM_OMP(omp parallel num_threads(number_of_threads_))
+    for (std::size_t i_cell = 0; i_cell < b.size(); ++i_cell)
+    {
+      if (!IsAnyGridCellActive(is_active, i_cell))
+        continue;
+      auto L_cell = std::next(lower_matrix.AsVector().begin(), i_cell * lower_matrix.FlatBlockSize());
+      auto U_cell = std::next(upper_matrix.AsVector().begin(), i_cell * upper_matrix.FlatBlockSize());
+
+      // Forward substitution
+      for (const auto& level : lower_levels_)
+      {
+        if (level.size() < LuDecomposition::MIN_PARALLEL_LEVEL_SIZE)
+        {
+          MICM_OMP(omp single)
+          for (const auto& i : level)
+            forward_row(i_cell, i, L_cell);
+        }
+        else
+        {
+          MICM_OMP(omp for schedule(static))
+          for (std::size_t i_row = 0; i_row < level.size(); ++i_row)
+            forward_row(i_cell, level[i_row], L_cell);
+        }
+      }
+
+      // Backward substitution
+      for (const auto& level : upper_levels_)
+      {
+        if (level.size() < LuDecomposition::MIN_PARALLEL_LEVEL_SIZE)
+        {
+          MICM_OMP(omp single)
+          for (const auto& i : level)
+            backward_row(i_cell, i, U_cell);
+        }
+        else
+        {
+          MICM_OMP(omp for schedule(static))
+          for (std::size_t i_row = 0; i_row < level.size(); ++i_row)
+            backward_row(i_cell, level[i_row], U_cell);
+        }
+      }
+    }
+  }
+
+  template<typename T, class OrderingPolicy>
+  template<template<class> class MatrixPolicy>
+    requires(Vectorizable<MatrixPolicy<T>> && VectorizableSparse<SparseMatrix<T, OrderingPolicy>>)
+  inline void LinearSolver<T, OrderingPolicy>::SolveByLevel(
+      const MatrixPolicy<T>& b,
+      MatrixPolicy<T>& x,
+      const SparseMatrix<T, OrderingPolicy>& lower_matrix,
+      const SparseMatrix<T, OrderingPolicy>& upper_matrix,
+      const std::vector<bool>& is_active) const
+  {
+    constexpr std::size_t L = OrderingPolicy::GroupVectorSize();
+    const std::size_t n = row_variable_ids_.size();
+    // Each row only reads the rows of x of rows in earlier levels, and its own row of b
+    auto forward_row = [&](std::size_t i, auto b_group, auto x_group, auto L_group)
+    {
+      auto b_row = std::next(b_group, row_variable_ids_[i] * L);
+      auto x_row = std::next(x_group, row_variable_ids_[i] * L);
+      for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+        x_row[i_cell] = b_row[i_cell];
+      for (std::size_t ij = Lij_start_[i]; ij < Lij_start_[i + 1]; ++ij)
+      {
+        auto L_elem = std::next(L_group, Lij_yj_[ij].first * L);
+        auto y_row = std::next(x_group, Lij_yj_[ij].second * L);
+        for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+          x_row[i_cell] -= L_elem[i_cell] * y_row[i_cell];
+      }
+    };
+    auto backward_row = [&](std::size_t i, auto x_group, auto U_group)
+    {
+      const std::size_t position = n - 1 - i;  // position of row i in nUij_Uii_
+      auto x_row = std::next(x_group, row_variable_ids_[i] * L);
+      for (std::size_t ij = Uij_start_[position]; ij < Uij_start_[position + 1]; ++ij)
+      {
+        auto U_elem = std::next(U_group, Uij_xj_[ij].first * L);
+        auto x_j_row = std::next(x_group, Uij_xj_[ij].second * L);
+        for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+          x_row[i_cell] -= U_elem[i_cell] * x_j_row[i_cell];
+      }
+      auto U_diagonal = std::next(U_group, nUij_Uii_[position].second * L);
+      for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+        x_row[i_cell] /= U_diagonal[i_cell];
+    };
+    // As for the standard ordering, with each row solved for all of the grid cells of a group
+    MICM_OMP(omp parallel num_threads(number_of_threads_))
+    for (std::size_t i_group = 0; i_group < b.NumberOfBlocks(); ++i_group)
+    {
+      if (!IsAnyGridCellActive(is_active, i_group * L, L))
+        continue;
+      auto b_group = std::next(b.AsVector().begin(), i_group * b.BlockSize());
+      auto x_group = std::next(x.AsVector().begin(), i_group * x.BlockSize());
+      auto L_group = std::next(lower_matrix.AsVector().begin(), i_group * L * lower_matrix.FlatBlockSize());
+      auto U_group = std::next(upper_matrix.AsVector().begin(), i_group * L * upper_matrix.FlatBlockSize());
+
+      // Forward substitution
+      for (const auto& level : lower_levels_)
+      {
+        if (level.size() < LuDecomposition::MIN_PARALLEL_LEVEL_SIZE)
+        {
+          MICM_OMP(omp single)
+          for (const auto& i : level)
+            forward_row(i, b_group, x_group, L_group);
+        }
+        else
+        {
+          MICM_OMP(omp for schedule(static))
+          for (std::size_t i_row = 0; i_row < level.size(); ++i_row)
+            forward_row(level[i_row], b_group, x_group, L_group);
+        }
+      }
+
+      // Backward substitution
+      for (const auto& level : upper_levels_)
+      {
+        if (level.size() < LuDecomposition::MIN_PARALLEL_LEVEL_SIZE)
+        {
+          MICM_OMP(omp single)
+          for (const auto& i : level)
+            backward_row(i, x_group, U_group);
+        }
+        else
+        {
+          MICM_OMP(omp for schedule(static))
+          for (std::size_t i_row = 0; i_row < level.size(); ++i_row)
+            backward_row(level[i_row], x_group, U_group);
+        }
+      }
+    }
+  }
 
-} // namespace micm
\ No newline at end of file
+}  // namespace micm
@@ -3,7 +3,18 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <micm/util/grid_cell_mask.hpp>
+#include <micm/util/openmp.hpp>
 #include <micm/util/sparse_matrix.hpp>
+#include <queue>
+#include <stdexcept>
+#include <vector>
 
 namespace micm
 {
@@ -29,43 +40,76 @@ namespace micm
   ///       sum += L[k][j] * U[j][i];
   ///     L[k][i] = (A[k][i] - sum) / U[i][i]
   ///
-  /// For the sparse matrix algorithm, the indices of non-zero terms are stored in
-  /// several arrays during construction. These arrays are iterated through during
-  /// calls to Decompose to do the actual decomposition.
+  /// For the sparse matrix algorithm, the steps needed to calculate each non-zero
+  /// element of L and U are compiled during construction into a single stream of
+  /// operations on a running value (see Operation). Calls to Decompose replay this
+  /// stream to do the actual decomposition.
+  ///
+  /// The sparsity structure of L and U (the symbolic factorization) is found by merging
+  /// rows: the structure of row i is the structure of row i of A plus, for each column
+  /// j < i in that structure (in increasing order), the structure of row j of U. The
+  /// work is proportional to the number of fill-in and elimination terms rather than n^3,
+  /// so large mechanisms can be set up quickly.
+  ///
+  /// An incomplete decomposition (ILU(0)) keeps L and U to the sparsity structure of A
+  /// and drops all of the fill-in terms. It is used as a preconditioner (see GmresLinearSolver).
+  ///
+  /// The stored indices are for the ordering policy of the matrix used to construct the
+  /// decomposition, so Decompose must be called with matrices of the same ordering. For
+  /// matrices with SparseMatrixVectorOrdering, each operation updates the element for all
+  /// of the blocks (grid cells) of a group at once.
+  ///
+  /// Step i of the outer loop (row i of U and column i of L) only depends on the steps j < i
+  /// with L[i][j] or U[j][i] non-zero. The steps are grouped into levels during construction,
+  /// so that each step only depends on steps of earlier levels. Within a level, the steps can
+  /// be run in parallel, which lets one large grid cell use several threads.
   class LuDecomposition
   {
-    /// number of elements in the middle (k) loops for lower and upper triangular matrices, respectively,
-    /// for each iteration of the outer (i) loop
-    std::vector<std::pair<std::size_t, std::size_t>> niLU_;
-    /// True when A[i][k] is non-zero for each iteration of the middle (k) loop for the upper
-    /// triangular matrix; False otherwise
-    std::vector<bool> do_aik_;
-    /// Index in A.data_ for A[i][k] for each iteration of the middle (k) loop for the upper
-    /// triangular matrix when A[i][k] is non-zero
-    std::vector<std::size_t> aik_;
-    /// Index in U.data_ for U[i][k] for each iteration of the middle (k) loop for the upper
-    /// triangular matrix when U[i][k] is non-zero, and the corresponding number of elements
-    /// in the inner (j) loop
-    std::vector<std::pair<std::size_t, std::size_t>> uik_nkj_;
-    /// Index in L.data_ for L[i][j], and in U.data_ for U[j][k] in the upper inner (j) loop
-    /// when L[i][j] and U[j][k] are both non-zero.
-    std::vector<std::pair<std::size_t, std::size_t>> lij_ujk_;
-    /// True when A[k][i] is non-zero for each iteration of the middle (k) loop for the lower
-    /// triangular matrix; False otherwise
-    std::vector<bool> do_aki_;
-    /// Index in A.data_ for A[k][i] for each iteration of the middle (k) loop for the lower
-    /// triangular matrix when A[k][i] is non-zero
-    std::vector<std::size_t> aki_;
-    /// Index in L.data_ for L[k][i] for each iteration of the middle (k) loop for the lower
-    /// triangular matrix when L[k][i] is non-zero, and the corresponding number of elements
-    /// in the inner (j) loop
-    std::vector<std::pair<std::size_t, std::size_t>> lki_nkj_;
-    /// Index in L.data_ for L[k][j], and in U.data_ for U[j][i] in the lower inner (j) loop
-    /// when L[k][j] and U[j][i] are both non-zero.
-    std::vector<std::pair<std::size_t, std::size_t>> lkj_uji_;
-    /// Index in U.data_ for U[i][i] for each interation in the middle (k) loop for the lower
-    /// triangular matrix when L[k][i] is non-zero
-    std::vector<std::size_t> uii_;
+    /// @brief A single step of the decomposition
+    ///
+    /// Each non-zero element of L and U is calculated in a running value that is set from A
+    /// (Copy) or to zero (Zero), reduced by the products of previously calculated elements
+    /// (Fms), and then stored (StoreUpper or DivideLower). The operands are indices in the
+    /// data vectors of A, L, and U for the first block.
+    struct Operation
+    {
+      enum class Code : std::uint32_t
+      {
+        Copy,         // value = A[first_]
+        Zero,         // value = 0
+        Fms,          // value -= L[first_] * U[second_]
+        StoreUpper,   // U[first_] = value
+        One,          // L[first_] = 1
+        DivideLower,  // L[first_] = value / U[second_]
+      };
+      Code code_;
+      std::uint32_t first_;
+      std::uint32_t second_;
+    };
+    /// Operations in the order they are applied to each block
+    std::vector<Operation> operations_;
+    /// Index in operations_ of the first operation of each step of the outer (i) loop, and of the end
+    std::vector<std::size_t> step_start_;
+    /// Steps of the outer (i) loop in each level, which only depend on steps in earlier levels
+    std::vector<std::vector<std::size_t>> levels_;
+
+    /// @brief Applies a range of operations to one block
+    template<class OperationIterator, class AIterator, class LUIterator>
+    static void ApplyOperations(
+        OperationIterator begin,
+        OperationIterator end,
+        AIterator A_vector,
+        LUIterator L_vector,
+        LUIterator U_vector);
+
+    /// @brief Applies a range of operations to the L blocks of one group of a vector-ordered matrix
+    template<std::size_t L, class OperationIterator, class AIterator, class LUIterator>
+    static void ApplyVectorOperations(
+        OperationIterator begin,
+        OperationIterator end,
+        AIterator A_vector,
+        LUIterator L_vector,
+        LUIterator U_vector);
 
    public:
     /// @brief default constructor
@@ -73,209 +117,583 @@ namespace micm
 
     /// @brief Construct an LU decomposition algorithm for a given sparse matrix
     /// @param matrix Sparse matrix
-    template<class T>
-    LuDecomposition(const SparseMatrix<T>& matrix);
+    /// @param incomplete Compute the incomplete decomposition ILU(0), with no fill-in
+    template<class T, class OrderingPolicy>
+    LuDecomposition(const SparseMatrix<T, OrderingPolicy>& matrix, bool incomplete = false);
 
     /// @brief Create sparse L and U matrices for a given A matrix
     /// @param A Sparse matrix the will be decomposed
+    /// @param incomplete Create L and U with the sparsity structure of A, for the incomplete decomposition ILU(0)
     /// @return L and U Sparse matrices
-    template<class T>
-    static std::pair<SparseMatrix<T>, SparseMatrix<T>> GetLUMatrices(const SparseMatrix<T>& A);
+    template<class T, class OrderingPolicy>
+    static std::pair<SparseMatrix<T, OrderingPolicy>, SparseMatrix<T, OrderingPolicy>> GetLUMatrices(
+        const SparseMatrix<T, OrderingPolicy>& A,
+        bool incomplete = false);
 
     /// @brief Perform an LU decomposition on a given A matrix
     /// @param A Sparse matrix to decompose
     /// @param LU the lower and upper triangular matrices returned as a square matrix
     ///           The diagonal of LU belongs to the upper triangular matrix and the
     ///           diagonal of the lower triangular matrix shoud be assumed to be 1
+    ///           L and U may have a lower precision than A (see MixedPrecisionLinearSolver)
+    /// @param number_of_threads Number of threads that run the independent steps of each level in parallel
+    ///                          (with OpenMP, in one parallel region for all blocks and levels; levels with
+    ///                          fewer than MIN_PARALLEL_LEVEL_SIZE steps are run by one thread); with a single
+    ///                          thread the steps are run in order
+    /// @param is_active The blocks (grid cells) to decompose (see IsAnyGridCellActive); empty for all blocks
+    template<class AT, class T>
+    void Decompose(
+        const SparseMatrix<AT>& A,
+        SparseMatrix<T>& L,
+        SparseMatrix<T>& U,
+        std::size_t number_of_threads = 1,
+        const std::vector<bool>& is_active = {}) const;
+
+    /// @brief Perform an LU decomposition on a given A matrix with groups of L blocks interleaved
+    /// @param A Sparse matrix to decompose
+    /// @param L_matrix Lower triangular matrix (with a unit diagonal), which may have a lower precision than A
+    /// @param U_matrix Upper triangular matrix, which may have a lower precision than A
+    /// @param number_of_threads Number of threads that run the independent steps of each level in parallel, for
+    ///                          one group of blocks at a time (as for the standard ordering)
+    /// @param is_active The blocks (grid cells) to decompose; groups with no active block are skipped
+    template<class AT, class T, std::size_t L>
+    void Decompose(
+        const SparseMatrix<AT, SparseMatrixVectorOrdering<L>>& A,
+        SparseMatrix<T, SparseMatrixVectorOrdering<L>>& L_matrix,
+        SparseMatrix<T, SparseMatrixVectorOrdering<L>>& U_matrix,
+        std::size_t number_of_threads = 1,
+        const std::vector<bool>& is_active = {}) const;
+
+    /// @brief Flags the blocks of a factorization with a zero, near-zero, or NaN pivot
+    ///
+    /// The pivots are the diagonal elements of U (the first element of each of its rows). The check is a
+    /// min-abs reduction over the pivots of each block, with NaN counted as zero, so it is cheap compared
+    /// to the decomposition. Pivots smaller than the smallest normal value of T are always singular.
+    /// @param U Upper triangular matrix from a call to Decompose
+    /// @param tolerance Pivots of a block with a magnitude at or below its value are singular (one per block)
+    /// @param is_singular Set for each block (grid cell) to whether it has a singular pivot
+    /// @return True if any block has a singular pivot
     template<class T>
-    void Decompose(const SparseMatrix<T>& A, SparseMatrix<T>& L, SparseMatrix<T>& U) const;
+    static bool
+    FindSingularBlocks(const SparseMatrix<T>& U, const std::vector<double>& tolerance, std::vector<bool>& is_singular);
+    template<class T, std::size_t L>
+    static bool FindSingularBlocks(
+        const SparseMatrix<T, SparseMatrixVectorOrdering<L>>& U,
+        const std::vector<double>& tolerance,
+        std::vector<bool>& is_singular);
+
+    /// @brief Flags the blocks of a factorization with a pivot at or below the same tolerance for every block
+    template<class T, class OrderingPolicy>
+    static bool FindSingularBlocks(
+        const SparseMatrix<T, OrderingPolicy>& U,
+        double tolerance,
+        std::vector<bool>& is_singular)
+    {
+      return FindSingularBlocks(U, std::vector<double>(U.size(), tolerance), is_singular);
+    }
 
+    /// @brief Levels with fewer steps (or rows, for the substitutions of LinearSolver) than this are run by a
+    ///        single thread, as they have too little work to share among threads
+    static constexpr std::size_t MIN_PARALLEL_LEVEL_SIZE = 8;
+
+    /// @brief Returns the steps of the outer (i) loop in each level of the decomposition
+    const std::vector<std::vector<std::size_t>>& Levels() const
+    {
+      return levels_;
+    }
+
+    /// @brief Groups the rows of a triangular matrix into levels for a forward (lower) or backward (upper)
+    ///        substitution, so that each row only depends on rows of earlier levels
+    /// @param matrix Lower or upper triangular matrix
+    /// @param is_lower True for the forward substitution with L; false for the backward substitution with U
+    /// @return The rows in each level
+    template<class T, class OrderingPolicy>
+    static std::vector<std::vector<std::size_t>> GetSubstitutionLevels(
+        const SparseMatrix<T, OrderingPolicy>& matrix,
+        bool is_lower);
   };
 
   inline LuDecomposition::LuDecomposition()
   {
   }
 
-  template<class T>
-  inline LuDecomposition::LuDecomposition(const SparseMatrix<T>& matrix)
+  template<class T, class OrderingPolicy>
+  inline LuDecomposition::LuDecomposition(const SparseMatrix<T, OrderingPolicy>& matrix, bool incomplete)
   {
+    constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
     std::size_t n = matrix[0].size();
-    auto LU = GetLUMatrices(matrix);
-    const auto& L_row_start = LU.first.RowStartVector();
-    const auto& L_row_ids = LU.first.RowIdsVector();
-    const auto& U_row_start = LU.second.RowStartVector();
-    const auto& U_row_ids = LU.second.RowIdsVector();
-    for (std::size_t i = 0; i < matrix[0].size(); ++i)
+    auto LU = GetLUMatrices(matrix, incomplete);
+    const auto& L_matrix = LU.first;
+    const auto& U_matrix = LU.second;
+    if (std::max({ matrix.AsVector().size(), L_matrix.AsVector().size(), U_matrix.AsVector().size() }) >
+        std::numeric_limits<std::uint32_t>::max())
+      throw std::invalid_argument("SparseMatrix is too large for the LU decomposition operation indices");
+    auto op = [](typename Operation::Code code, std::size_t first, std::size_t second = 0)
+    { return Operation{ code, static_cast<std::uint32_t>(first), static_cast<std::uint32_t>(second) }; };
+    // Index in the data vector of the first block for each non-zero element (by position in the row ids vector)
+    auto vector_ids = [&](const SparseMatrix<T, OrderingPolicy>& m)
     {
-      std::pair<std::size_t, std::size_t> iLU(0, 0);
-      // Upper triangular matrix
-      for (std::size_t k = i; k < n; ++k)
+      std::vector<std::size_t> ids;
+      ids.reserve(m.FlatBlockSize());
+      for (std::size_t r = 0; r < n; ++r)
+        for (std::size_t e = m.RowStartVector()[r]; e < m.RowStartVector()[r + 1]; ++e)
+          ids.push_back(m.VectorIndex(0, r, m.RowIdsVector()[e]));
+      return ids;
+    };
+    const auto A_ids = vector_ids(matrix);
+    const auto L_ids = vector_ids(L_matrix);
+    const auto U_ids = vector_ids(U_matrix);
+    const auto& A_row_start = matrix.RowStartVector();
+    const auto& A_row_ids = matrix.RowIdsVector();
+    const auto& L_row_start = L_matrix.RowStartVector();
+    const auto& L_row_ids = L_matrix.RowIdsVector();
+    const auto& U_row_start = U_matrix.RowStartVector();
+    const auto& U_row_ids = U_matrix.RowIdsVector();
+
+    // Element of A (or npos) and elimination terms, L[i][j] * U[j][k] for j in increasing order,
+    // for each element of L and U
+    std::vector<std::size_t> L_a(L_row_ids.size(), npos), U_a(U_row_ids.size(), npos);
+    std::vector<std::vector<Operation>> L_terms(L_row_ids.size()), U_terms(U_row_ids.size());
+    std::vector<std::size_t> A_elem(n, npos), L_elem(n, npos), U_elem(n, npos);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      for (std::size_t e = A_row_start[i]; e < A_row_start[i + 1]; ++e)
+        A_elem[A_row_ids[e]] = e;
+      for (std::size_t e = L_row_start[i]; e < L_row_start[i + 1]; ++e)
+      {
+        L_elem[L_row_ids[e]] = e;
+        L_a[e] = A_elem[L_row_ids[e]];
+      }
+      for (std::size_t e = U_row_start[i]; e < U_row_start[i + 1]; ++e)
+      {
+        U_elem[U_row_ids[e]] = e;
+        U_a[e] = A_elem[U_row_ids[e]];
+      }
+      for (std::size_t e_ij = L_row_start[i]; e_ij < L_row_start[i + 1]; ++e_ij)
       {
-        std::size_t nkj = 0;
-        for (std::size_t j_id = L_row_start[i]; j_id < L_row_start[i + 1]; ++j_id)
+        std::size_t j = L_row_ids[e_ij];
+        if (j >= i)
+          break;
+        for (std::size_t e_jk = U_row_start[j]; e_jk < U_row_start[j + 1]; ++e_jk)
         {
-          std::size_t j = L_row_ids[j_id];
-          if (j >= i)
-            break;
-          if (LU.second.IsZero(j, k))
+          std::size_t k = U_row_ids[e_jk];
+          if (k <= j)
             continue;
-          ++nkj;
-          lij_ujk_.push_back(std::make_pair(j_id, LU.second.VectorIndex(0, j, k)));
+          auto term = op(Operation::Code::Fms, L_ids[e_ij], U_ids[e_jk]);
+          if (k < i && L_elem[k] != npos)
+            L_terms[L_elem[k]].push_back(term);
+          else if (k >= i && U_elem[k] != npos)
+            U_terms[U_elem[k]].push_back(term);
         }
-        if (matrix.IsZero(i, k))
+      }
+      for (std::size_t e = A_row_start[i]; e < A_row_start[i + 1]; ++e)
+        A_elem[A_row_ids[e]] = npos;
+      for (std::size_t e = L_row_start[i]; e < L_row_start[i + 1]; ++e)
+        L_elem[L_row_ids[e]] = npos;
+      for (std::size_t e = U_row_start[i]; e < U_row_start[i + 1]; ++e)
+        U_elem[U_row_ids[e]] = npos;
+    }
+
+    // Elements of each column of L below the diagonal, in order of increasing row
+    std::vector<std::vector<std::size_t>> L_columns(n);
+    for (std::size_t k = 0; k < n; ++k)
+      for (std::size_t e = L_row_start[k]; e < L_row_start[k + 1]; ++e)
+        if (L_row_ids[e] < k)
+          L_columns[L_row_ids[e]].push_back(e);
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      step_start_.push_back(operations_.size());
+      // Upper triangular matrix
+      for (std::size_t e = U_row_start[i]; e < U_row_start[i + 1]; ++e)
+      {
+        if (U_a[e] == npos)
         {
-          if (nkj == 0 && k != i)
+          if (U_terms[e].empty() && U_row_ids[e] != i)
             continue;
-          do_aik_.push_back(false);
+          operations_.push_back(op(Operation::Code::Zero, 0));
         }
         else
         {
-          do_aik_.push_back(true);
-          aik_.push_back(matrix.VectorIndex(0, i, k));
+          operations_.push_back(op(Operation::Code::Copy, A_ids[U_a[e]]));
         }
-        uik_nkj_.push_back(std::make_pair(LU.second.VectorIndex(0, i, k), nkj));
-        ++(iLU.second);
+        operations_.insert(operations_.end(), U_terms[e].begin(), U_terms[e].end());
+        operations_.push_back(op(Operation::Code::StoreUpper, U_ids[e]));
       }
-      // Lower triangular matrix
-      lki_nkj_.push_back(std::make_pair(LU.first.VectorIndex(0, i, i), 0));
-      for (std::size_t k = i + 1; k < n; ++k)
+      // Lower triangular matrix (the diagonal elements are the last of each row of L and the first of each row of U)
+      operations_.push_back(op(Operation::Code::One, L_ids[L_row_start[i + 1] - 1]));
+      for (const auto& e : L_columns[i])
       {
-        std::size_t nkj = 0;
-        for (std::size_t j_id = L_row_start[k]; j_id < L_row_start[k + 1]; ++j_id)
-        {
-          std::size_t j = L_row_ids[j_id];
-          if (j >= i)
-            break;
-          if (LU.second.IsZero(j, i))
-            continue;
-          ++nkj;
-          lkj_uji_.push_back(std::make_pair(j_id, LU.second.VectorIndex(0, j, i)));
-        }
-        if (matrix.IsZero(k, i))
+        if (L_a[e] == npos)
         {
-          if (nkj == 0)
+          if (L_terms[e].empty())
             continue;
-          do_aki_.push_back(false);
+          operations_.push_back(op(Operation::Code::Zero, 0));
         }
         else
         {
-          do_aki_.push_back(true);
-          aki_.push_back(matrix.VectorIndex(0, k, i));
+          operations_.push_back(op(Operation::Code::Copy, A_ids[L_a[e]]));
         }
-        uii_.push_back(LU.second.VectorIndex(0, i, i));
-        lki_nkj_.push_back(std::make_pair(LU.first.VectorIndex(0, k, i), nkj));
-        ++(iLU.first);
+        operations_.insert(operations_.end(), L_terms[e].begin(), L_terms[e].end());
+        operations_.push_back(op(Operation::Code::DivideLower, L_ids[e], U_ids[U_row_start[i]]));
       }
-      niLU_.push_back(iLU);
+    }
+    step_start_.push_back(operations_.size());
+
+    // Step i depends on the steps j < i with L[i][j] or U[j][i] non-zero
+    std::vector<std::size_t> step_level(n, 0);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      for (std::size_t e = L_row_start[i]; e < L_row_start[i + 1] && L_row_ids[e] < i; ++e)
+        step_level[i] = std::max(step_level[i], step_level[L_row_ids[e]] + 1);
+      for (std::size_t e = U_row_start[i]; e < U_row_start[i + 1]; ++e)
+        if (U_row_ids[e] > i)
+          step_level[U_row_ids[e]] = std::max(step_level[U_row_ids[e]], step_level[i] + 1);
+      if (step_level[i] >= levels_.size())
+        levels_.resize(step_level[i] + 1);
+      levels_[step_level[i]].push_back(i);
     }
   }
 
-  template<class T>
-  inline std::pair<SparseMatrix<T>, SparseMatrix<T>> LuDecomposition::GetLUMatrices(const SparseMatrix<T>& A)
+  template<class T, class OrderingPolicy>
+  inline std::pair<SparseMatrix<T, OrderingPolicy>, SparseMatrix<T, OrderingPolicy>> LuDecomposition::GetLUMatrices(
+      const SparseMatrix<T, OrderingPolicy>& A,
+      bool incomplete)
   {
     std::size_t n = A[0].size();
-    std::set<std::pair<std::size_t, std::size_t>> L_ids, U_ids;
     const auto& row_start = A.RowStartVector();
     const auto& row_ids = A.RowIdsVector();
+    // Columns of each row of L and U, in increasing order, and the position of the diagonal in each row
+    std::vector<std::vector<std::size_t>> rows(n);
+    std::vector<std::size_t> diagonal(n);
+    std::vector<bool> is_filled(n, false);
+    std::priority_queue<std::size_t, std::vector<std::size_t>, std::greater<std::size_t>> lower_columns;
     for (std::size_t i = 0; i < n; ++i)
     {
-      // Upper triangular matrix
-      for (std::size_t k = i; k < n; ++k)
+      auto& row = rows[i];
+      auto fill = [&](std::size_t k)
       {
-        if (!A.IsZero(i, k) || k == i)
-        {
-          U_ids.insert(std::make_pair(i, k));
+        if (is_filled[k])
+          return;
+        is_filled[k] = true;
+        row.push_back(k);
+        if (k < i)
+          lower_columns.push(k);
+      };
+      fill(i);
+      for (std::size_t id = row_start[i]; id < row_start[i + 1]; ++id)
+        fill(row_ids[id]);
+      // Merge in row j of U for each column j < i, including columns filled in along the way
+      while (!lower_columns.empty())
+      {
+        std::size_t j = lower_columns.top();
+        lower_columns.pop();
+        if (incomplete)
+          continue;
+        for (auto k = std::next(rows[j].begin(), diagonal[j] + 1); k != rows[j].end(); ++k)
+          fill(*k);
+      }
+      std::sort(row.begin(), row.end());
+      diagonal[i] = std::lower_bound(row.begin(), row.end(), i) - row.begin();
+      for (const auto& k : row)
+        is_filled[k] = false;
+    }
+    auto L_builder = micm::SparseMatrix<T, OrderingPolicy>::create(n).number_of_blocks(A.size());
+    auto U_builder = micm::SparseMatrix<T, OrderingPolicy>::create(n).number_of_blocks(A.size());
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      for (std::size_t id = 0; id <= diagonal[i]; ++id)
+        L_builder.with_element(i, rows[i][id]);
+      for (std::size_t id = diagonal[i]; id < rows[i].size(); ++id)
+        U_builder.with_element(i, rows[i][id]);
+    }
+    std::pair<SparseMatrix<T, OrderingPolicy>, SparseMatrix<T, OrderingPolicy>> LU(L_builder, U_builder);
+    return LU;
+  }
+
+  template<class T, class OrderingPolicy>
+  inline std::vector<std::vector<std::size_t>> LuDecomposition::GetSubstitutionLevels(
+      const SparseMatrix<T, OrderingPolicy>& matrix,
+      bool is_lower)
+  {
+    const auto& row_start = matrix.RowStartVector();
+    const auto& row_ids = matrix.RowIdsVector();
+    const std::size_t n = row_start.size() - 1;
+    std::vector<std::size_t> row_level(n, 0);
+    std::vector<std::vector<std::size_t>> levels;
+    for (std::size_t i_row = 0; i_row < n; ++i_row)
+    {
+      const std::size_t i = is_lower ? i_row : n - 1 - i_row;
+      for (std::size_t e = row_start[i]; e < row_start[i + 1]; ++e)
+        if (is_lower ? row_ids[e] < i : row_ids[e] > i)
+          row_level[i] = std::max(row_level[i], row_level[row_ids[e]] + 1);
+      if (row_level[i] >= levels.size())
+        levels.resize(row_level[i] + 1);
+      levels[row_level[i]].push_back(i);
+    }
+    return levels;
+  }
+
+  template<class OperationIterator, class AIterator, class LUIterator>
+  inline void LuDecomposition::ApplyOperations(
+      OperationIterator begin,
+      OperationIterator end,
+      AIterator A_vector,
+      LUIterator L_vector,
+      LUIterator U_vector)
+  {
+    using T = typename std::iterator_traits<LUIterator>::value_type;
+    T value{};
+    for (auto operation = begin; operation != end; ++operation)
+    {
+      switch (operation->code_)
+      {
+        case Operation::Code::Copy: value = static_cast<T>(A_vector[operation->first_]); break;
+        case Operation::Code::Zero: value = 0; break;
+        case Operation::Code::Fms: value -= L_vector[operation->first_] * U_vector[operation->second_]; break;
+        case Operation::Code::StoreUpper: U_vector[operation->first_] = value; break;
+        case Operation::Code::One: L_vector[operation->first_] = 1; break;
+        case Operation::Code::DivideLower: L_vector[operation->first_] = value / U_vector[operation->second_]; break;
+      }
+    }
+  }
+
+  template<class AT, class T>
+  inline void LuDecomposition::Decompose(
+      const SparseMatrix<AT>& A,
+      SparseMatrix<T>& L,
+      SparseMatrix<T>& U,
+      std::size_t number_of_threads,
+      const std::vector<bool>& is_active) const
+  {
+    if (number_of_threads <= 1)
+    {
+      // Loop over blocks
+      for (std::size_t i_block = 0; i_block < A.size(); ++i_block)
+      {
+        if (!IsAnyGridCellActive(is_active, i_block))
           continue;
+        auto A_vector = std::next(A.AsVector().begin(), i_block * A.FlatBlockSize());
+        auto L_vector = std::next(L.AsVector().begin(), i_block * L.FlatBlockSize());
+        auto U_vector = std::next(U.AsVector().begin(), i_block * U.FlatBlockSize());
+        ApplyOperations(operations_.begin(), operations_.end(), A_vector, L_vector, U_vector);
+      }
+      return;
+    }
+    auto apply_step = [&](std::size_t step, auto A_vector, auto L_vector, auto U_vector)
+    {
+      ApplyOperations(
+          std::next(operations_.begin(), step_start_[step]),
+          std::next(operations_.begin(), step_start_[step + 1]),
+          A_vector,
+          L_vector,
+          U_vector);
+    };
+    // A single team of threads runs every block and level. The barrier at the end of each worksharing
+    // construct keeps the levels in order, and small levels are run by one thread. Every thread skips the
+    // same inactive blocks, so they all reach the same barriers.
+    MICM_OMP(omp parallel num_threads(number_of_threads))
+    for (std::size_t i_block = 0; i_block < A.size(); ++i_block)
+    {
+      if (!IsAnyGridCellActive(is_active, i_block))
+        continue;
+      auto A_vector = std::next(A.AsVector().begin(), i_block * A.FlatBlockSize());
+      auto L_vector = std::next(L.AsVector().begin(), i_block * L.FlatBlockSize());
+      auto U_vector = std::next(U.AsVector().begin(), i_block * U.FlatBlockSize());
+      for (const auto& level : levels_)
+      {
+        if (level.size() < MIN_PARALLEL_LEVEL_SIZE)
+        {
+          MICM_OMP(omp single)
+          for (const auto& step : level)
+            apply_step(step, A_vector, L_vector, U_vector);
         }
-        for (std::size_t j = 0; j < i; ++j)
+        else
         {
-          if (L_ids.find(std::make_pair(i, j)) != L_ids.end() && U_ids.find(std::make_pair(j, k)) != U_ids.end())
-          {
-            U_ids.insert(std::make_pair(i, k));
-            break;
-          }
+          MICM_OMP(omp for schedule(static))
+          for (std::size_t i_step = 0; i_step < level.size(); ++i_step)
+            apply_step(level[i_step], A_vector, L_vector, U_vector);
         }
       }
-      // Lower triangular matrix
-      for (std::size_t k = i; k < n; ++k)
+    }
+  }
+
+  template<std::size_t L, class OperationIterator, class AIterator, class LUIterator>
+  inline void LuDecomposition::ApplyVectorOperations(
+      OperationIterator begin,
+      OperationIterator end,
+      AIterator A_vector,
+      LUIterator L_vector,
+      LUIterator U_vector)
+  {
+    using T = typename std::iterator_traits<LUIterator>::value_type;
+    T value[L]{};
+    for (auto operation = begin; operation != end; ++operation)
+    {
+      switch (operation->code_)
       {
-        if (!A.IsZero(k, i) || k == i)
+        case Operation::Code::Copy:
         {
-          L_ids.insert(std::make_pair(k, i));
-          continue;
+          auto A_elem = std::next(A_vector, operation->first_);
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            value[i_cell] = static_cast<T>(A_elem[i_cell]);
+          break;
+        }
+        case Operation::Code::Zero:
+        {
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            value[i_cell] = 0;
+          break;
+        }
+        case Operation::Code::Fms:
+        {
+          auto L_elem = std::next(L_vector, operation->first_);
+          auto U_elem = std::next(U_vector, operation->second_);
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            value[i_cell] -= L_elem[i_cell] * U_elem[i_cell];
+          break;
+        }
+        case Operation::Code::StoreUpper:
+        {
+          auto U_elem = std::next(U_vector, operation->first_);
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            U_elem[i_cell] = value[i_cell];
+          break;
+        }
+        case Operation::Code::One:
+        {
+          auto L_elem = std::next(L_vector, operation->first_);
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            L_elem[i_cell] = 1;
+          break;
         }
-        for (std::size_t j = 0; j < i; ++j)
+        case Operation::Code::DivideLower:
         {
-          if (L_ids.find(std::make_pair(k, j)) != L_ids.end() && U_ids.find(std::make_pair(j, i)) != U_ids.end())
-          {
-            L_ids.insert(std::make_pair(k, i));
-            break;
-          }
+          auto L_elem = std::next(L_vector, operation->first_);
+          auto U_elem = std::next(U_vector, operation->second_);
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            L_elem[i_cell] = value[i_cell] / U_elem[i_cell];
+          break;
         }
       }
     }
-    auto L_builder = micm::SparseMatrix<T>::create(n).number_of_blocks(A.size());
-    for (auto& pair : L_ids)
+  }
+
+  template<class AT, class T, std::size_t L>
+  inline void LuDecomposition::Decompose(
+      const SparseMatrix<AT, SparseMatrixVectorOrdering<L>>& A,
+      SparseMatrix<T, SparseMatrixVectorOrdering<L>>& L_matrix,
+      SparseMatrix<T, SparseMatrixVectorOrdering<L>>& U_matrix,
+      std::size_t number_of_threads,
+      const std::vector<bool>& is_active) const
+  {
+    const std::size_t n_groups = (A.size() + L - 1) / L;
+    if (number_of_threads <= 1)
     {
-      L_builder = L_builder.with_element(pair.first, pair.second);
+      // Loop over groups of blocks
+      for (std::size_t i_group = 0; i_group < n_groups; ++i_group)
+      {
+        if (!IsAnyGridCellActive(is_active, i_group * L, L))
+          continue;
+        auto A_vector = std::next(A.AsVector().begin(), i_group * L * A.FlatBlockSize());
+        auto L_vector = std::next(L_matrix.AsVector().begin(), i_group * L * L_matrix.FlatBlockSize());
+        auto U_vector = std::next(U_matrix.AsVector().begin(), i_group * L * U_matrix.FlatBlockSize());
+        ApplyVectorOperations<L>(operations_.begin(), operations_.end(), A_vector, L_vector, U_vector);
+      }
+      return;
     }
-    auto U_builder = micm::SparseMatrix<T>::create(n).number_of_blocks(A.size());
-    for (auto& pair : U_ids)
+    auto apply_step = [&](std::size_t step, auto A_vector, auto L_vector, auto U_vector)
+    {
+      ApplyVectorOperations<L>(
+          std::next(operations_.begin(), step_start_[step]),
+          std::next(operations_.begin(), step_start_[step + 1]),
+          A_vector,
+          L_vector,
+          U_vector);
+    };
+    // As for the standard ordering, with each step applied to all of the blocks of a group
+    MICM_OMP(omp parallel num_threads(number_of_threads))
+    for (std::size_t i_group = 0; i_group < n_groups; ++i_group)
     {
-      U_builder = U_builder.with_element(pair.first, pair.second);
+      if (!IsAnyGridCellActive(is_active, i_group * L, L))
+        continue;
+      auto A_vector = std::next(A.AsVector().begin(), i_group * L * A.FlatBlockSize());
+      auto L_vector = std::next(L_matrix.AsVector().begin(), i_group * L * L_matrix.FlatBlockSize());
+      auto U_vector = std::next(U_matrix.AsVector().begin(), i_group * L * U_matrix.FlatBlockSize());
+      for (const auto& level : levels_)
+      {
+        if (level.size() < MIN_PARALLEL_LEVEL_SIZE)
+        {
+          MICM_OMP(omp single)
+          for (const auto& step : level)
+            apply_step(step, A_vector, L_vector, U_vector);
+        }
+        else
+        {
+          MICM_OMP(omp for schedule(static))
+          for (std::size_t i_step = 0; i_step < level.size(); ++i_step)
+            apply_step(level[i_step], A_vector, L_vector, U_vector);
+        }
+      }
     }
-    std::pair<SparseMatrix<T>, SparseMatrix<T>> LU(L_builder, U_builder);
-    return LU;
   }
 
   template<class T>
-  inline void LuDecomposition::Decompose(const SparseMatrix<T>& A, SparseMatrix<T>& L, SparseMatrix<T>& U) const
+  inline bool LuDecomposition::FindSingularBlocks(
+      const SparseMatrix<T>& U,
+      const std::vector<double>& tolerance,
+      std::vector<bool>& is_singular)
   {
-    // Loop over blocks
-    for (std::size_t i_block = 0; i_block < A.size(); ++i_block)
+    const auto& row_start = U.RowStartVector();
+    const std::size_t n = row_start.size() - 1;
+    bool any_singular = false;
+    is_singular.resize(U.size());
+    for (std::size_t i_block = 0; i_block < U.size(); ++i_block)
     {
-      auto A_vector = std::next(A.AsVector().begin(), i_block * A.FlatBlockSize());
-      auto L_vector = std::next(L.AsVector().begin(), i_block * L.FlatBlockSize());
+      const T threshold = std::max(static_cast<T>(tolerance[i_block]), std::numeric_limits<T>::min());
       auto U_vector = std::next(U.AsVector().begin(), i_block * U.FlatBlockSize());
-      auto do_aik = do_aik_.begin();
-      auto aik = aik_.begin();
-      auto uik_nkj = uik_nkj_.begin();
-      auto lij_ujk = lij_ujk_.begin();
-      auto do_aki = do_aki_.begin();
-      auto aki = aki_.begin();
-      auto lki_nkj = lki_nkj_.begin();
-      auto lkj_uji = lkj_uji_.begin();
-      auto uii = uii_.begin();
-      for (auto& inLU : niLU_)
+      T min_abs = std::numeric_limits<T>::max();
+      for (std::size_t i = 0; i < n; ++i)
       {
-        // Upper trianglur matrix
-        for (std::size_t iU = 0; iU < inLU.second; ++iU)
-        {
-          if (*(do_aik++))
-            U_vector[uik_nkj->first] = A_vector[*(aik++)];
-          for (std::size_t ikj = 0; ikj < uik_nkj->second; ++ikj)
-          {
-            U_vector[uik_nkj->first] -= L_vector[lij_ujk->first] * U_vector[lij_ujk->second];
-            ++lij_ujk;
-          }
-          ++uik_nkj;
-        }
-        // Lower triangular matrix
-        L_vector[(lki_nkj++)->first] = 1.0;
-        for (std::size_t iL = 0; iL < inLU.first; ++iL)
-        {
-          if (*(do_aki++))
-            L_vector[lki_nkj->first] = A_vector[*(aki++)];
-          for (std::size_t ikj = 0; ikj < lki_nkj->second; ++ikj)
-          {
-            L_vector[lki_nkj->first] -= L_vector[lkj_uji->first] * U_vector[lkj_uji->second];
-            ++lkj_uji;
-          }
-          L_vector[lki_nkj->first] /= U_vector[*uii];
-          ++lki_nkj;
-          ++uii;
-        }
+        const T pivot = U_vector[row_start[i]];
+        min_abs = std::isnan(pivot) ? T{} : std::min(min_abs, std::abs(pivot));
+      }
+      is_singular[i_block] = min_abs <= threshold;
+      any_singular = any_singular || is_singular[i_block];
+    }
+    return any_singular;
+  }
+
+  template<class T, std::size_t L>
+  inline bool LuDecomposition::FindSingularBlocks(
+      const SparseMatrix<T, SparseMatrixVectorOrdering<L>>& U,
+      const std::vector<double>& tolerance,
+      std::vector<bool>& is_singular)
+  {
+    const auto& row_start = U.RowStartVector();
+    const std::size_t n = row_start.size() - 1;
+    const std::size_t n_groups = (U.size() + L - 1) / L;
+    bool any_singular = false;
+    is_singular.resize(U.size());
+    for (std::size_t i_group = 0; i_group < n_groups; ++i_group)
+    {
+      auto U_vector = std::next(U.AsVector().begin(), i_group * L * U.FlatBlockSize());
+      T min_abs[L];
+      for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+        min_abs[i_cell] = std::numeric_limits<T>::max();
+      for (std::size_t i = 0; i < n; ++i)
+      {
+        auto pivot = std::next(U_vector, row_start[i] * L);
+        for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+          min_abs[i_cell] = std::isnan(pivot[i_cell]) ? T{} : std::min(min_abs[i_cell], std::abs(pivot[i_cell]));
+      }
+      for (std::size_t i_cell = 0; i_cell < L && i_group * L + i_cell < U.size(); ++i_cell)
+      {
+        const T threshold = std::max(static_cast<T>(tolerance[i_group * L + i_cell]), std::numeric_limits<T>::min());
+        is_singular[i_group * L + i_cell] = min_abs[i_cell] <= threshold;
+        any_singular = any_singular || is_singular[i_group * L + i_cell];
       }
     }
+    return any_singular;
   }
 }  // namespace micm
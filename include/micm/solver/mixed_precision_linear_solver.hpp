@@ -0,0 +1,233 @@
+// Copyright (C) 2023 National Center for Atmospheric Research
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <micm/solver/linear_solver.hpp>
+#include <micm/solver/lu_decomposition.hpp>
+#include <micm/solver/sparse_matrix_vector_product.hpp>
+#include <micm/util/sparse_matrix.hpp>
+#include <utility>
+#include <vector>
+
+namespace micm
+{
+
+  /// @brief Options for the mixed-precision linear solver
+  struct MixedPrecisionParameters
+  {
+    std::size_t max_refinements_{ 2 };     // Number of iterative-refinement sweeps after the first solve
+    double relative_tolerance_{ 1.0e-12 };  // Largest residual element, relative to the largest element of b
+  };
+
+  /// @brief Working memory for MixedPrecisionLinearSolver::Solve, so the solver can be called repeatedly without
+  ///        allocating memory
+  template<typename T, typename FactorT, template<class> class MatrixPolicy>
+  struct MixedPrecisionWorkspace
+  {
+    std::size_t number_of_blocks_{ 0 };
+    std::size_t block_size_{ 0 };
+    MatrixPolicy<T> rhs_;               // copy of b, which may be the same object as x
+    MatrixPolicy<T> residual_;
+    MatrixPolicy<FactorT> correction_;  // residual_ and its correction in the factorization precision
+    std::vector<T> tolerance_;          // largest residual element at which each block is converged
+
+    /// @brief Default constructor
+    MixedPrecisionWorkspace() = default;
+
+    /// @brief Allocates the working memory for systems of a given size
+    /// @param number_of_blocks Number of blocks (grid cells)
+    /// @param block_size Number of variables in each block
+    MixedPrecisionWorkspace(std::size_t number_of_blocks, std::size_t block_size)
+        : number_of_blocks_(number_of_blocks),
+          block_size_(block_size),
+          rhs_(number_of_blocks, block_size, 0.0),
+          residual_(number_of_blocks, block_size, 0.0),
+          correction_(number_of_blocks, block_size, 0.0),
+          tolerance_(number_of_blocks, 0.0)
+    {
+    }
+  };
+
+  /// @brief A block-diagonal sparse-matrix linear solver that factors the matrix in a lower precision
+  ///
+  /// Factor computes L and U in FactorT (float by default) from the matrix in T, which halves the memory
+  /// traffic of the factorization and of the triangular solves. Solve then recovers the accuracy of T with
+  /// iterative refinement:
+  ///
+  /// x_0 = (LU)^-1 b
+  /// r_k = b - A x_k                (in T, with the original matrix)
+  /// x_k+1 = x_k + (LU)^-1 r_k
+  ///
+  /// Each sweep reduces the error by about the condition number of A times the unit round-off of FactorT,
+  /// so one or two sweeps are enough for the well-conditioned [alpha * I - dforce_dy] matrices of the
+  /// Rosenbrock solver. Refinement stops early once the residual of every block is within
+  /// MixedPrecisionParameters::relative_tolerance_. The OrderingPolicy of the sparse matrices must match the
+  /// layout of the vectors passed to Solve (see SparseMatrixOrderingFor).
+  template<typename T, typename FactorT = float, class OrderingPolicy = SparseMatrixStandardOrdering>
+  class MixedPrecisionLinearSolver
+  {
+    LuDecomposition lu_decomp_;
+    LinearSolver<FactorT, OrderingPolicy> solver_;
+    std::vector<std::size_t> variable_order_;
+    MixedPrecisionParameters parameters_;
+
+   public:
+    /// @brief default constructor
+    MixedPrecisionLinearSolver() = default;
+
+    /// @brief Constructs a mixed-precision linear solver for the sparsity structure of the given matrix
+    /// @param matrix Sparse matrix
+    /// @param species_order The element of b and x for each row (and column) of the matrix, when the rows and columns
+    ///                      are reordered (see DiagonalMarkowitzReordering); empty when they are in the same order
+    /// @param parameters Iterative refinement options
+    MixedPrecisionLinearSolver(
+        const SparseMatrix<T, OrderingPolicy>& matrix,
+        const std::vector<std::size_t>& species_order = {},
+        const MixedPrecisionParameters& parameters = {});
+
+    /// @brief Create the sparse L and U matrices, in the factorization precision, for a given A matrix
+    static std::pair<SparseMatrix<FactorT, OrderingPolicy>, SparseMatrix<FactorT, OrderingPolicy>> GetLUMatrices(
+        const SparseMatrix<T, OrderingPolicy>& A)
+    {
+      return LuDecomposition::GetLUMatrices(LowPrecisionMatrix(A));
+    }
+
+    /// @brief Decompose the matrix into lower-precision upper and lower triangular matrices
+    /// @param matrix Matrix to decompose (must have the sparsity structure the solver was created with)
+    /// @param lower_matrix Lower triangular matrix (see GetLUMatrices)
+    /// @param upper_matrix Upper triangular matrix (see GetLUMatrices)
+    /// @param is_active The blocks (grid cells) to decompose (see IsAnyGridCellActive); empty for all blocks
+    void Factor(
+        const SparseMatrix<T, OrderingPolicy>& matrix,
+        SparseMatrix<FactorT, OrderingPolicy>& lower_matrix,
+        SparseMatrix<FactorT, OrderingPolicy>& upper_matrix,
+        const std::vector<bool>& is_active = {}) const;
+
+    /// @brief Solve for x in Ax = b
+    /// @param b Right-hand side vector for each block (grid cell, variable)
+    /// @param x Solution vector for each block (grid cell, variable), which may be the same object as b
+    /// @param matrix The matrix A
+    /// @param lower_matrix Lower triangular matrix from a call to Factor
+    /// @param upper_matrix Upper triangular matrix from a call to Factor
+    /// @param workspace Working memory, which is re-allocated only if it was not sized for b
+    /// @return The number of refinement sweeps
+    template<template<class> class MatrixPolicy>
+    std::size_t Solve(
+        const MatrixPolicy<T>& b,
+        MatrixPolicy<T>& x,
+        const SparseMatrix<T, OrderingPolicy>& matrix,
+        const SparseMatrix<FactorT, OrderingPolicy>& lower_matrix,
+        const SparseMatrix<FactorT, OrderingPolicy>& upper_matrix,
+        MixedPrecisionWorkspace<T, FactorT, MatrixPolicy>& workspace) const;
+
+   private:
+    /// @brief Returns a matrix in the factorization precision with the sparsity structure of the given matrix
+    static SparseMatrix<FactorT, OrderingPolicy> LowPrecisionMatrix(const SparseMatrix<T, OrderingPolicy>& matrix)
+    {
+      const std::size_t n = matrix.RowStartVector().size() - 1;
+      auto builder = SparseMatrix<FactorT, OrderingPolicy>::create(n).number_of_blocks(matrix.size());
+      for (std::size_t i = 0; i < n; ++i)
+        for (std::size_t id = matrix.RowStartVector()[i]; id < matrix.RowStartVector()[i + 1]; ++id)
+          builder.with_element(i, matrix.RowIdsVector()[id]);
+      return SparseMatrix<FactorT, OrderingPolicy>(builder);
+    }
+  };
+
+  template<typename T, typename FactorT, class OrderingPolicy>
+  inline MixedPrecisionLinearSolver<T, FactorT, OrderingPolicy>::MixedPrecisionLinearSolver(
+      const SparseMatrix<T, OrderingPolicy>& matrix,
+      const std::vector<std::size_t>& species_order,
+      const MixedPrecisionParameters& parameters)
+      : lu_decomp_(matrix),
+        solver_(LowPrecisionMatrix(matrix), species_order),
+        variable_order_(species_order),
+        parameters_(parameters)
+  {
+  }
+
+  template<typename T, typename FactorT, class OrderingPolicy>
+  inline void MixedPrecisionLinearSolver<T, FactorT, OrderingPolicy>::Factor(
+      const SparseMatrix<T, OrderingPolicy>& matrix,
+      SparseMatrix<FactorT, OrderingPolicy>& lower_matrix,
+      SparseMatrix<FactorT, OrderingPolicy>& upper_matrix,
+      const std::vector<bool>& is_active) const
+  {
+    lu_decomp_.Decompose(matrix, lower_matrix, upper_matrix, 1, is_active);
+  }
+
+  template<typename T, typename FactorT, class OrderingPolicy>
+  template<template<class> class MatrixPolicy>
+  inline std::size_t MixedPrecisionLinearSolver<T, FactorT, OrderingPolicy>::Solve(
+      const MatrixPolicy<T>& b,
+      MatrixPolicy<T>& x,
+      const SparseMatrix<T, OrderingPolicy>& matrix,
+      const SparseMatrix<FactorT, OrderingPolicy>& lower_matrix,
+      const SparseMatrix<FactorT, OrderingPolicy>& upper_matrix,
+      MixedPrecisionWorkspace<T, FactorT, MatrixPolicy>& workspace) const
+  {
+    const std::size_t number_of_cells = b.size();
+    if (number_of_cells == 0)
+      return 0;
+    const std::size_t n = b[0].size();
+    if (workspace.number_of_blocks_ != number_of_cells || workspace.block_size_ != n)
+      workspace = MixedPrecisionWorkspace<T, FactorT, MatrixPolicy>(number_of_cells, n);
+
+    auto& rhs = workspace.rhs_;  // b is kept for the residuals, as x may be the same object
+    auto& residual = workspace.residual_;
+    auto& correction = workspace.correction_;
+    auto& tolerance = workspace.tolerance_;
+    std::copy(b.AsVector().begin(), b.AsVector().end(), rhs.AsVector().begin());
+    std::copy(b.AsVector().begin(), b.AsVector().end(), residual.AsVector().begin());
+    for (std::size_t i_cell = 0; i_cell < number_of_cells; ++i_cell)
+    {
+      auto rhs_cell = rhs[i_cell];
+      T max_b = 0;
+      for (std::size_t i = 0; i < n; ++i)
+        max_b = std::max(max_b, std::abs(rhs_cell[i]));
+      tolerance[i_cell] = parameters_.relative_tolerance_ * max_b;
+    }
+    std::fill(x.AsVector().begin(), x.AsVector().end(), 0.0);
+
+    std::size_t sweeps = 0;
+    for (;; ++sweeps)
+    {
+      // x += (LU)^-1 r, with r in the factorization precision (the layouts of residual and correction are the same)
+      std::transform(
+          residual.AsVector().begin(),
+          residual.AsVector().end(),
+          correction.AsVector().begin(),
+          [](const T& r) { return static_cast<FactorT>(r); });
+      solver_.template Solve<MatrixPolicy>(correction, correction, lower_matrix, upper_matrix);
+      std::transform(
+          x.AsVector().begin(),
+          x.AsVector().end(),
+          correction.AsVector().begin(),
+          x.AsVector().begin(),
+          [](const T& x_i, const FactorT& d_i) { return x_i + static_cast<T>(d_i); });
+      if (sweeps == parameters_.max_refinements_)
+        break;
+
+      // r = b - A x
+      SparseMatrixVectorProduct<MatrixPolicy>(matrix, x, residual, variable_order_);
+      bool is_converged = true;
+      for (std::size_t i_cell = 0; i_cell < number_of_cells; ++i_cell)
+      {
+        auto residual_cell = residual[i_cell];
+        auto rhs_cell = rhs[i_cell];
+        for (std::size_t i = 0; i < n; ++i)
+        {
+          residual_cell[i] = rhs_cell[i] - residual_cell[i];
+          is_converged = is_converged && std::abs(residual_cell[i]) <= tolerance[i_cell];
+        }
+      }
+      if (is_converged)
+        break;
+    }
+    return sweeps;
+  }
+
+}  // namespace micm
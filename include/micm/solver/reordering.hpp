@@ -0,0 +1,78 @@
+// Copyright (C) 2023 National Center for Atmospheric Research
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace micm
+{
+
+  /// @brief Finds a symmetric reordering of a sparse matrix that reduces the fill-in of its LU decomposition
+  ///
+  /// The diagonal Markowitz strategy is applied symbolically: at each step the remaining diagonal pivot with the
+  /// smallest product of off-diagonal row and column counts is eliminated, and the fill-in it creates is added to
+  /// the structure. Ties go to the lowest original index, so a matrix that cannot be improved keeps its order.
+  /// @param n Number of rows (and columns) of the matrix
+  /// @param elements Indices (row, column) of the non-zero elements
+  /// @return For each row (and column) of the reordered matrix, the index of that row in the original matrix
+  inline std::vector<std::size_t> DiagonalMarkowitzReordering(
+      std::size_t n,
+      const std::set<std::pair<std::size_t, std::size_t>>& elements)
+  {
+    std::vector<std::set<std::size_t>> row_columns(n);  // off-diagonal columns in each remaining row
+    std::vector<std::set<std::size_t>> column_rows(n);  // off-diagonal rows in each remaining column
+    for (const auto& elem : elements)
+    {
+      if (elem.first == elem.second)
+        continue;
+      row_columns[elem.first].insert(elem.second);
+      column_rows[elem.second].insert(elem.first);
+    }
+
+    std::vector<std::size_t> order;
+    std::vector<bool> is_eliminated(n, false);
+    order.reserve(n);
+    for (std::size_t step = 0; step < n; ++step)
+    {
+      std::size_t pivot = n;
+      std::size_t min_cost = std::numeric_limits<std::size_t>::max();
+      for (std::size_t i = 0; i < n; ++i)
+      {
+        if (is_eliminated[i])
+          continue;
+        std::size_t cost = row_columns[i].size() * column_rows[i].size();
+        if (cost < min_cost)
+        {
+          min_cost = cost;
+          pivot = i;
+        }
+      }
+      // eliminating the pivot couples every row with a non-zero in its column to every column in its row
+      for (const auto& row : column_rows[pivot])
+      {
+        for (const auto& column : row_columns[pivot])
+        {
+          if (row == column)
+            continue;
+          row_columns[row].insert(column);
+          column_rows[column].insert(row);
+        }
+      }
+      for (const auto& row : column_rows[pivot])
+        row_columns[row].erase(pivot);
+      for (const auto& column : row_columns[pivot])
+        column_rows[column].erase(pivot);
+      row_columns[pivot].clear();
+      column_rows[pivot].clear();
+      is_eliminated[pivot] = true;
+      order.push_back(pivot);
+    }
+    return order;
+  }
+
+}  // namespace micm
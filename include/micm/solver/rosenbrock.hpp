@@ -25,12 +25,27 @@
 #include <limits>
 #include <micm/process/process.hpp>
 #include <micm/process/process_set.hpp>
+#include <micm/solver/compiled_kernels.hpp>
+#include <micm/solver/gmres_linear_solver.hpp>
 #include <micm/solver/linear_solver.hpp>
+#include <micm/solver/mixed_precision_linear_solver.hpp>
+#include <micm/solver/reordering.hpp>
+#include <micm/solver/rosenbrock_tableaux.hpp>
 #include <micm/solver/solver.hpp>
+#include <micm/solver/sparse_matrix_vector_product.hpp>
 #include <micm/solver/state.hpp>
 #include <micm/system/system.hpp>
+#include <micm/util/grid_cell_mask.hpp>
+#include <micm/util/matrix.hpp>
+#include <micm/util/openmp.hpp>
+#include <micm/util/phase_timer.hpp>
 #include <micm/util/sparse_matrix.hpp>
+#include <micm/util/vector_matrix.hpp>
+#include <set>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace micm
@@ -54,6 +69,7 @@ namespace micm
     double h_max_{ 0.5 };      // step size max
     double h_start_{ 0.005 };  // step size start
 
+    // The method coefficients below are copied from a tableau (see rosenbrock_tableaux.hpp) by RosenbrockSolver::SetTableau
     std::array<bool, 6>
         new_function_evaluation_{};  // which steps reuse the previous iterations evaluation or do a new evaluation
 
@@ -65,26 +81,194 @@ namespace micm
     std::array<double, 6> alpha_{};
     std::array<double, 6> gamma_{};
 
-    double absolute_tolerance_{ 1e-12 };
+    double absolute_tolerance_{ 1e-12 };  // Default for species without an "absolute tolerance" property
     double relative_tolerance_{ 1e-4 };
 
-    size_t number_of_grid_cells_{ 1 };  // Number of grid cells to solve simultaneously
+    size_t number_of_grid_cells_{ 1 };     // Number of grid cells to solve simultaneously
+    // Each grid cell uses its own step size and error norm. Grid cells that have reached the end time are skipped
+    // by the general kernels and linear solver, but not by the compiled kernels (compile_kernels_) or the linear
+    // solves of gmres_linear_solver_ and mixed_precision_linear_solver_, which still compute them and discard the
+    // results
+    bool per_cell_step_control_{ false };
+    size_t number_of_threads_{ 1 };        // Number of chunks of grid cells solved in parallel (with OpenMP)
+    bool bucket_by_arity_{ false };        // Calculate reactions grouped by their number of reactants and products
+    bool reorder_species_{ true };         // Reorder the Jacobian to reduce the fill-in of its LU decomposition
+    bool gather_forcing_{ false };         // Calculate the forcing species by species (ProcessSet::AddForcingTermsByGather)
+    bool compile_kernels_{ false };        // Compile mechanism-specific kernels at runtime (Matrix solvers only)
+    CompiledKernelsParameters compiled_kernels_parameters_{};  // Compiler and cache options for compile_kernels_
+    bool gmres_linear_solver_{ false };  // Solve the linear systems with GMRES and an ILU(0) preconditioner
+    GmresParameters gmres_parameters_{};  // Options for gmres_linear_solver_
+    bool mixed_precision_linear_solver_{ false };  // Factor in float, refine in double (ignored with gmres_linear_solver_)
+    MixedPrecisionParameters mixed_precision_parameters_{};  // Options for mixed_precision_linear_solver_
+    // Factorizations with a pivot at or below pivot_tolerance_ * alpha in magnitude are singular, where
+    // alpha = 1 / (H * gamma) is the diagonal added to -dforce_dy (see LuDecomposition::FindSingularBlocks).
+    // The tolerance is for double-precision factors; for the float factors of mixed_precision_linear_solver_ it
+    // is scaled by the ratio of the float and double machine epsilons.
+    double pivot_tolerance_{ 100 * std::numeric_limits<double>::epsilon() };
+    // Number of threads for the independent rows of each level of the LU factorization and triangular solves (see
+    // LinearSolver); only one of this and number_of_threads_ can be more than 1
+    size_t number_of_linear_solver_threads_{ 1 };
+    // Accepted steps a Jacobian is reused for (with a W-method, see Ros34Pw2Tableau); 0 or 1 evaluates it every step.
+    // A step rejected with an old Jacobian gets a new one. Ignored for other tableaux, which evaluate the Jacobian
+    // every step (see IsWMethod)
+    size_t max_jacobian_age_{ 0 };
   };
 
-   /// @brief An implementation of the Chapman mechnanism solver
-   ///
-   /// The template parameter is the type of matrix to use
+  /// @brief Working memory for the Rosenbrock solver
+  ///
+  /// All of the intermediate values needed during a call to RosenbrockSolver::Solve are
+  /// allocated once, when the solver is created, and re-used for every step. When grid cells
+  /// are solved in chunks, each chunk has its own workspace.
+  template<template<class> class MatrixPolicy>
+  struct RosenbrockWorkspace
+  {
+    using SparseMatrixOrdering = typename SparseMatrixOrderingFor<MatrixPolicy<double>>::type;
+
+    std::vector<MatrixPolicy<double>> K_;        // stage values (stage, grid cell, state variable)
+    MatrixPolicy<double> Y_;                     // state at the start of the current step
+    MatrixPolicy<double> Ynew_;                  // state at the end of the current step (or at an intermediate stage)
+    MatrixPolicy<double> initial_forcing_;
+    MatrixPolicy<double> forcing_;
+    MatrixPolicy<double> Yerror_;
+    MatrixPolicy<double> rate_constants_;        // rate constants of the grid cells in a chunk (chunked solves only)
+    MatrixPolicy<double> reaction_rates_;        // rate of each process (used with gather_forcing_)
+    MatrixPolicy<double> state_variables_;       // every state variable, including the constant species (used when
+                                                 // there are constant species, and not for chunked solves)
+    SparseMatrix<double, SparseMatrixOrdering> jacobian_;              // dforce_dy at the start of the current step
+    SparseMatrix<double, SparseMatrixOrdering> alpha_minus_jacobian_;  // [alpha * I - dforce_dy]
+    SparseMatrix<double, SparseMatrixOrdering> lower_matrix_;  // lower triangular factor of [alpha * I - dforce_dy]
+    SparseMatrix<double, SparseMatrixOrdering> upper_matrix_;  // upper triangular factor of [alpha * I - dforce_dy]
+    SparseMatrix<float, SparseMatrixOrdering> float_lower_matrix_;  // lower_matrix_ for the mixed-precision linear solver
+    SparseMatrix<float, SparseMatrixOrdering> float_upper_matrix_;  // upper_matrix_ for the mixed-precision linear solver
+    std::vector<bool> is_singular_;  // grid cells with a singular pivot in the most recent factorization
+    std::vector<double> pivot_tolerance_;  // magnitude at or below which a pivot of each grid cell is singular
+
+    GmresWorkspace<double, MatrixPolicy> gmres_workspace_;                            // see GmresLinearSolver
+    MixedPrecisionWorkspace<double, float, MatrixPolicy> mixed_precision_workspace_;  // see MixedPrecisionLinearSolver
+
+    // per grid cell values used with RosenbrockSolverParameters::per_cell_step_control_
+    std::vector<double> cell_H_;            // current step size
+    std::vector<double> cell_time_;         // current time
+    std::vector<double> cell_error_;        // error norm for the current step
+    std::vector<double> cell_alpha_;        // 1 / (H * gamma) for the current step
+    std::vector<bool> cell_reject_last_h_;  // the last step was rejected
+    std::vector<bool> cell_reject_more_h_;  // the last two steps were rejected
+    std::vector<bool> cell_is_active_;      // the grid cell has not yet reached the end time
+    std::vector<bool> cell_is_factored_;    // the grid cell is (re-)factored in the current step
+
+    /// @brief Default constructor
+    RosenbrockWorkspace() = default;
+
+    /// @brief Allocates the working memory for a solver
+    /// @param number_of_grid_cells Number of grid cells solved simultaneously
+    /// @param state_size Number of state variables in each grid cell
+    /// @param stages Number of stages in the Rosenbrock method
+    /// @param jacobian Jacobian with the sparsity structure used by the solver and one block per grid cell
+    /// @param number_of_rate_constants Number of rate constants to hold for each grid cell (chunked solves only)
+    /// @param incomplete_lu Allocate L and U for the incomplete factorization ILU(0) and the GMRES working memory
+    ///                      (see GmresLinearSolver)
+    /// @param mixed_precision Allocate L and U in float instead of double and the working memory of the
+    ///                        mixed-precision linear solver (see MixedPrecisionLinearSolver)
+    /// @param number_of_reaction_rates Number of reaction rates to hold for each grid cell (see gather_forcing_)
+    /// @param number_of_state_variables Number of state variables, including the constant species, to hold for each
+    ///                                  grid cell (0 when every species is integrated)
+    RosenbrockWorkspace(
+        std::size_t number_of_grid_cells,
+        std::size_t state_size,
+        std::size_t stages,
+        const SparseMatrix<double, SparseMatrixOrdering>& jacobian,
+        std::size_t number_of_rate_constants = 0,
+        bool incomplete_lu = false,
+        bool mixed_precision = false,
+        std::size_t number_of_reaction_rates = 0,
+        std::size_t number_of_state_variables = 0,
+        const GmresParameters& gmres_parameters = {})
+        : K_(),
+          Y_(number_of_grid_cells, state_size, 0.0),
+          Ynew_(number_of_grid_cells, state_size, 0.0),
+          initial_forcing_(number_of_grid_cells, state_size, 0.0),
+          forcing_(number_of_grid_cells, state_size, 0.0),
+          Yerror_(number_of_grid_cells, state_size, 0.0),
+          rate_constants_(number_of_grid_cells, number_of_rate_constants, 0.0),
+          reaction_rates_(number_of_grid_cells, number_of_reaction_rates, 0.0),
+          state_variables_(number_of_grid_cells, number_of_state_variables, 0.0),
+          jacobian_(jacobian),
+          alpha_minus_jacobian_(jacobian),
+          lower_matrix_(),
+          upper_matrix_(),
+          float_lower_matrix_(),
+          float_upper_matrix_(),
+          is_singular_(number_of_grid_cells, false),
+          pivot_tolerance_(number_of_grid_cells, 0.0),
+          gmres_workspace_(),
+          mixed_precision_workspace_(),
+          cell_H_(number_of_grid_cells, 0.0),
+          cell_time_(number_of_grid_cells, 0.0),
+          cell_error_(number_of_grid_cells, 0.0),
+          cell_alpha_(number_of_grid_cells, 0.0),
+          cell_reject_last_h_(number_of_grid_cells, false),
+          cell_reject_more_h_(number_of_grid_cells, false),
+          cell_is_active_(number_of_grid_cells, false),
+          cell_is_factored_(number_of_grid_cells, false)
+    {
+      K_.reserve(stages);
+      for (std::size_t i = 0; i < stages; ++i)
+        K_.push_back(MatrixPolicy<double>(number_of_grid_cells, state_size, 0.0));
+      if (mixed_precision && !incomplete_lu)
+      {
+        auto lu = MixedPrecisionLinearSolver<double, float, SparseMatrixOrdering>::GetLUMatrices(jacobian);
+        float_lower_matrix_ = std::move(lu.first);
+        float_upper_matrix_ = std::move(lu.second);
+        mixed_precision_workspace_ = MixedPrecisionWorkspace<double, float, MatrixPolicy>(number_of_grid_cells, state_size);
+        return;
+      }
+      auto lu = LuDecomposition::GetLUMatrices(jacobian, incomplete_lu);
+      lower_matrix_ = std::move(lu.first);
+      upper_matrix_ = std::move(lu.second);
+      if (incomplete_lu)
+        gmres_workspace_ = GmresWorkspace<double, MatrixPolicy>(number_of_grid_cells, state_size, gmres_parameters);
+    }
+  };
+
+  /// @brief A Rosenbrock solver for the chemical system of a general mechanism over many grid cells
+  ///
+  /// The method is selected with SetTableau (Ros3 by default). The template parameter is the type of matrix to
+  /// use. The sparse matrices (the Jacobian and its LU factors) have the matching memory layout (see
+  /// SparseMatrixOrderingFor), so with a VectorMatrix every kernel runs over the grid cells of a group in its
+  /// innermost loop.
+  ///
+  /// Constant species are not integrated, and the rate constants passed to Solve must already be multiplied by
+  /// the concentrations of their constant reactants. UpdateState does this; rate constants set any other way
+  /// (e.g. with Process::UpdateState) must include them by hand.
   template<template<class> class MatrixPolicy>
   class RosenbrockSolver
   {
    public:
+    using SparseMatrixOrdering = typename RosenbrockWorkspace<MatrixPolicy>::SparseMatrixOrdering;
+
     const System system_;
     const std::vector<Process> processes_;
     RosenbrockSolverParameters parameters_;
     ProcessSet process_set_;
     Solver::Rosenbrock_stats stats_;
-    SparseMatrix<double> jacobian_;
-    LinearSolver linear_solver_;
+    std::vector<std::size_t> integrated_species_ids_;  // state variable of each integrated species
+    std::vector<std::pair<std::size_t, std::size_t>> constant_reactants_;  // (reaction, state variable) pairs
+    std::vector<std::size_t> species_order_;  // integrated species of each Jacobian row (and column)
+    SparseMatrix<double, SparseMatrixOrdering> jacobian_;
+    SparseMatrix<double> cell_jacobian_;  // one block of jacobian_ in the standard ordering (see dforce_dy_times_vector)
+    std::vector<std::size_t> jacobian_diagonal_elements_;
+    std::vector<double> absolute_tolerances_;
+    LinearSolver<double, SparseMatrixOrdering> linear_solver_;
+    /// Used in place of linear_solver_ with parameters_.gmres_linear_solver_
+    GmresLinearSolver<double, SparseMatrixOrdering> gmres_linear_solver_;
+    /// Used in place of linear_solver_ with parameters_.mixed_precision_linear_solver_
+    MixedPrecisionLinearSolver<double, float, SparseMatrixOrdering> mixed_precision_linear_solver_;
+    CompiledKernels compiled_kernels_;  // used in place of the general kernels when loaded
+    RosenbrockWorkspace<MatrixPolicy> workspace_;
+    std::vector<RosenbrockWorkspace<MatrixPolicy>> chunk_workspaces_;
+#ifdef USE_TIMING
+    PhaseTime update_rate_constants_time_{};  // Rate constant updates since the last Solve
+#endif
 
     static constexpr double delta_min_ = 1.0e-5;
 
@@ -102,12 +286,37 @@ namespace micm
     /// @return A object that can hold the full state of the chemical system
     State<MatrixPolicy> GetState() const;
 
-    /// @brief A virtual function to be defined by any solver baseclass
+    /// @brief Solves the chemical system using the Rosenbrock method selected with SetTableau (Ros3 by default)
+    /// @param time_start Time step to start at
+    /// @param time_end Time step to end at
+    /// @return A struct containing results and a status code
+    Solver::SolverResult Solve(double time_start, double time_end, State<MatrixPolicy>& state) noexcept;
+
+    /// @brief Solves the chemical system using the Rosenbrock method described by the given tableau
+    ///
+    /// The stage loop is specialized on the tableau, so the number of stages, the function evaluation
+    /// flags, and the coefficients are all known at compile time.
     /// @param time_start Time step to start at
     /// @param time_end Time step to end at
     /// @return A struct containing results and a status code
+    template<RosenbrockTableau Tableau>
     Solver::SolverResult Solve(double time_start, double time_end, State<MatrixPolicy>& state) noexcept;
 
+    /// @brief Selects the Rosenbrock method used by Solve and copies its coefficients into the solver parameters
+    ///
+    /// The workspaces are also created here: a single workspace for all grid cells, or one
+    /// workspace for each chunk of grid cells when RosenbrockSolverParameters::number_of_threads_ > 1
+    template<RosenbrockTableau Tableau>
+    void SetTableau();
+
+    /// @brief Changes the number of grid cells solved by the solver
+    ///
+    /// The selected tableau and the setup that does not depend on the number of grid cells (the
+    /// species reordering, the symbolic LU decomposition, and the compiled kernels) are kept; only
+    /// the Jacobian and the workspaces are re-created
+    /// @param number_of_grid_cells The new number of grid cells
+    void SetNumberOfGridCells(std::size_t number_of_grid_cells);
+
     /// @brief Returns a list of reaction names
     /// @return vector of strings
     virtual std::vector<std::string> reaction_names();
@@ -128,29 +337,57 @@ namespace micm
     virtual void
     force(const MatrixPolicy<double>& rate_constants, const MatrixPolicy<double>& number_densities, MatrixPolicy<double>& forcing);
 
-    /// @brief compute jacobian decomposition of [alpha * I - dforce_dy]
-    /// @param dforce_dy
+    /// @brief Compute [alpha * I - dforce_dy]
+    /// @param jacobian Jacobian matrix (dforce_dy)
     /// @param alpha
-    /// @return An jacobian decomposition
-    virtual std::vector<double> factored_alpha_minus_jac(const std::vector<double>& dforce_dy, const double& alpha);
-
-    /// @brief Computes product of [dforce_dy * vector]
-    /// @param dforce_dy  jacobian of forcing
-    /// @param vector vector ordered as the order of number density in dy
+    /// @param alpha_minus_jacobian [alpha * I - dforce_dy], which may be the same object as jacobian
+    void AlphaMinusJacobian(
+        const SparseMatrix<double, SparseMatrixOrdering>& jacobian,
+        const double& alpha,
+        SparseMatrix<double, SparseMatrixOrdering>& alpha_minus_jacobian) const
+        requires(!VectorizableSparse<SparseMatrix<double, SparseMatrixOrdering>>);
+    void AlphaMinusJacobian(
+        const SparseMatrix<double, SparseMatrixOrdering>& jacobian,
+        const double& alpha,
+        SparseMatrix<double, SparseMatrixOrdering>& alpha_minus_jacobian) const
+        requires VectorizableSparse<SparseMatrix<double, SparseMatrixOrdering>>;
+
+    /// @brief Compute [alpha * I - dforce_dy], with a separate alpha for each grid cell
+    /// @param jacobian Jacobian matrix (dforce_dy)
+    /// @param alpha Value of alpha for each grid cell (block)
+    /// @param alpha_minus_jacobian [alpha * I - dforce_dy], which may be the same object as jacobian
+    /// @param is_active The grid cells to compute (see IsAnyGridCellActive); empty for all grid cells
+    void AlphaMinusJacobian(
+        const SparseMatrix<double, SparseMatrixOrdering>& jacobian,
+        const std::vector<double>& alpha,
+        SparseMatrix<double, SparseMatrixOrdering>& alpha_minus_jacobian,
+        const std::vector<bool>& is_active = {}) const
+        requires(!VectorizableSparse<SparseMatrix<double, SparseMatrixOrdering>>);
+    void AlphaMinusJacobian(
+        const SparseMatrix<double, SparseMatrixOrdering>& jacobian,
+        const std::vector<double>& alpha,
+        SparseMatrix<double, SparseMatrixOrdering>& alpha_minus_jacobian,
+        const std::vector<bool>& is_active = {}) const
+        requires VectorizableSparse<SparseMatrix<double, SparseMatrixOrdering>>;
+
+    /// @brief Computes product of [dforce_dy * vector] for one grid cell (see SparseMatrixVectorProduct)
+    /// @param dforce_dy  jacobian of forcing, with the sparsity structure of one block of jacobian_
+    /// @param vector vector ordered as the order of number density in dy (the integrated species)
     /// @return Product of jacobian with vector
+    /// @throws std::invalid_argument if dforce_dy or vector does not have the size of one grid cell
     virtual std::vector<double> dforce_dy_times_vector(
         const std::vector<double>& dforce_dy,
         const std::vector<double>& vector);
 
-    /// @brief Update the rate constants for the environment state
+    /// @brief Update the rate constants for the environment state, including the concentrations of the constant
+    ///        reactants of each process
     /// @param state The current state of the chemical system
     void UpdateState(State<MatrixPolicy>& state);
 
-    /// @brief Solve the system
-    /// @param K idk, something
-    /// @param ode_jacobian the jacobian
-    /// @return the new state?
-    virtual std::vector<double> lin_solve(const std::vector<double>& K, const std::vector<double>& ode_jacobian);
+    /// @brief Solve the linear system [alpha * I - dforce_dy] x = b for the matrix most recently factored by lin_factor
+    /// @param b The right-hand side (grid cell, state variable)
+    /// @param x The solution (grid cell, state variable), which may be the same object as b
+    virtual void lin_solve(const MatrixPolicy<double>& b, MatrixPolicy<double>& x);
 
     /// @brief Compute the derivative of the forcing w.r.t. each chemical, the jacobian
     /// @param rate_constants List of rate constants for each needed species
@@ -160,41 +397,203 @@ namespace micm
     virtual void dforce_dy(
         const MatrixPolicy<double>& rate_constants,
         const MatrixPolicy<double>& number_densities,
-        SparseMatrix<double>& jacobian);
+        SparseMatrix<double, SparseMatrixOrdering>& jacobian);
 
-    /// @brief Prepare the rosenbrock ode solver matrix
+    /// @brief Prepare the rosenbrock ode solver matrix from the jacobian most recently evaluated in the workspace
+    ///
+    /// The jacobian is not re-evaluated, so after a rejected step only [alpha * I - dforce_dy]
+    /// is formed and factored again for the new step size.
     /// @param H time step (seconds)
     /// @param gamma time step factor for specific rosenbrock method
     /// @param singular indicates if the matrix is singular
-    /// @param number_densities constituent concentration (molec/cm^3)
-    /// @param rate_constants Rate constants for each process (molecule/cm3)^(n-1) s-1
-    virtual std::vector<double> lin_factor(
+    virtual void lin_factor(double& H, const double& gamma, bool& singular);
+
+   protected:
+    /// @brief The tableau-specialized Solve function selected with SetTableau
+    Solver::SolverResult (RosenbrockSolver::*solve_)(double, double, State<MatrixPolicy>&) noexcept = nullptr;
+
+    /// @brief Creates a Jacobian with the sparsity structure used by the solver, with rows and columns in species_order_
+    /// @param number_of_grid_cells Number of blocks in the Jacobian
+    template<class OrderingPolicy = SparseMatrixOrdering>
+    SparseMatrix<double, OrderingPolicy> BuildJacobian(std::size_t number_of_grid_cells) const;
+
+    /// @brief Creates the workspaces for the current number of grid cells and number of stages
+    void AllocateWorkspaces();
+
+    /// @brief Solves each chunk of grid cells with its own workspace, in parallel when compiled with OpenMP
+    /// @param time_start Time step to start at
+    /// @param time_end Time step to end at
+    /// @return A struct containing results and a status code
+    template<RosenbrockTableau Tableau>
+    Solver::SolverResult SolveInChunks(double time_start, double time_end, State<MatrixPolicy>& state) noexcept;
+
+    /// @brief Advances all of the grid cells in a workspace with a common step size
+    ///
+    /// The initial state is read from, and the final state is left in, workspace.Y_. Only the
+    /// workspace is modified, so separate workspaces can be integrated concurrently.
+    /// @param time_start Time step to start at
+    /// @param time_end Time step to end at
+    /// @param rate_constants Rate constants for each process (grid cell, process)
+    /// @param workspace The working memory for the grid cells
+    /// @return A struct containing the final time, statistics, and a status code
+    template<RosenbrockTableau Tableau>
+    Solver::SolverResult Integrate(
+        double time_start,
+        double time_end,
+        const MatrixPolicy<double>& rate_constants,
+        RosenbrockWorkspace<MatrixPolicy>& workspace) const noexcept;
+
+    /// @brief Advances each grid cell in a workspace independently, with its own step size and error control
+    /// @param time_start Time step to start at
+    /// @param time_end Time step to end at
+    /// @param rate_constants Rate constants for each process (grid cell, process)
+    /// @param workspace The working memory for the grid cells
+    /// @return A struct containing the final time, statistics, and a status code
+    template<RosenbrockTableau Tableau>
+    Solver::SolverResult IntegratePerCell(
+        double time_start,
+        double time_end,
+        const MatrixPolicy<double>& rate_constants,
+        RosenbrockWorkspace<MatrixPolicy>& workspace) const noexcept;
+
+    /// @brief Calculates the chemical forcing
+    /// @param reaction_rates Storage for the rate of each process, used with gather_forcing_
+    /// @param is_active The grid cells to evaluate (see IsAnyGridCellActive); empty for all grid cells. The
+    ///                  forcing of the other grid cells is zero. The compiled kernels evaluate every grid cell.
+    void CalculateForcing(
+        const MatrixPolicy<double>& rate_constants,
+        const MatrixPolicy<double>& number_densities,
+        MatrixPolicy<double>& forcing,
+        MatrixPolicy<double>& reaction_rates,
+        Solver::Rosenbrock_stats& stats,
+        const std::vector<bool>& is_active = {}) const;
+
+    /// @brief Calculates the Jacobian of the chemical forcing (dforce_dy)
+    /// @param is_active The grid cells to evaluate, as for CalculateForcing
+    void CalculateJacobian(
+        const MatrixPolicy<double>& rate_constants,
+        const MatrixPolicy<double>& number_densities,
+        SparseMatrix<double, SparseMatrixOrdering>& jacobian,
+        Solver::Rosenbrock_stats& stats,
+        const std::vector<bool>& is_active = {}) const;
+
+    /// @brief Calculates the chemical forcing and its Jacobian in a single pass over the reactions
+    /// @param is_active The grid cells to evaluate, as for CalculateForcing
+    void CalculateForcingAndJacobian(
+        const MatrixPolicy<double>& rate_constants,
+        const MatrixPolicy<double>& number_densities,
+        MatrixPolicy<double>& forcing,
+        MatrixPolicy<double>& reaction_rates,
+        SparseMatrix<double, SparseMatrixOrdering>& jacobian,
+        Solver::Rosenbrock_stats& stats,
+        const std::vector<bool>& is_active = {}) const;
+
+    /// @brief Forms and factors [alpha * I - dforce_dy] from the Jacobian in the workspace
+    void FactorAlphaMinusJacobian(
         double& H,
         const double& gamma,
         bool& singular,
-        const MatrixPolicy<double>& number_densities,
-        const MatrixPolicy<double>& rate_constants);
-
-    /// @brief Factor
-    /// @param jacobian
-    virtual void factor(std::vector<double>& jacobian);
-
-    virtual std::vector<double> backsolve_L_y_eq_b(const std::vector<double>& jacobian, const std::vector<double>& b);
-    virtual std::vector<double> backsolve_U_x_eq_b(const std::vector<double>& jacobian, const std::vector<double>& y);
+        RosenbrockWorkspace<MatrixPolicy>& workspace,
+        Solver::Rosenbrock_stats& stats) const;
+
+    /// @brief Factors [alpha * I - dforce_dy] in the workspace into its lower and upper triangular parts
+    /// @param is_active The grid cells to factor (see IsAnyGridCellActive); empty for all grid cells. The
+    ///                  compiled kernels factor every grid cell.
+    void FactorWorkspace(RosenbrockWorkspace<MatrixPolicy>& workspace, const std::vector<bool>& is_active = {}) const;
+
+    /// @brief Flags the grid cells whose most recent factorization in the workspace has a singular pivot
+    /// @param alpha 1 / (H * gamma) (a single value, or one value per grid cell), which scales the pivot
+    ///              tolerance (see RosenbrockSolverParameters::pivot_tolerance_)
+    /// @return True if any grid cell is singular
+    template<class Alpha>
+    bool FindSingularCells(RosenbrockWorkspace<MatrixPolicy>& workspace, const Alpha& alpha) const;
+
+    /// @brief Solves [alpha * I - dforce_dy] x = b using the factorization in the workspace
+    ///
+    /// Iterative solves that do not reach their tolerance are counted in Rosenbrock_stats::unconverged_solves.
+    /// Their error is then part of the stage values, so it is caught by the step error estimate.
+    /// @param is_active The grid cells to solve for (see IsAnyGridCellActive); empty for all grid cells. The
+    ///                  iterative and compiled solvers solve for every grid cell.
+    void LinearSolve(
+        const MatrixPolicy<double>& b,
+        MatrixPolicy<double>& x,
+        RosenbrockWorkspace<MatrixPolicy>& workspace,
+        Solver::Rosenbrock_stats& stats,
+        const std::vector<bool>& is_active = {}) const;
+
+    /// @brief Computes the stage values K for the current step, which are stored in the workspace
+    /// @param H Step size (a single value, or one value per grid cell)
+    /// @param rate_constants Rate constants for each process (grid cell, process)
+    /// @param is_active With one step size per grid cell, the grid cells to compute stages for; empty for all
+    ///                  grid cells. The stage values of the other grid cells are left unchanged.
+    template<RosenbrockTableau Tableau, class StepSize>
+    void ComputeStages(
+        const StepSize& H,
+        const MatrixPolicy<double>& rate_constants,
+        RosenbrockWorkspace<MatrixPolicy>& workspace,
+        Solver::Rosenbrock_stats& stats,
+        const std::vector<bool>& is_active = {}) const;
+
+    /// @brief Computes the stage values K for one stage after the first
+    template<RosenbrockTableau Tableau, std::size_t stage, class StepSize>
+    void ComputeStage(
+        const StepSize& H,
+        const MatrixPolicy<double>& rate_constants,
+        RosenbrockWorkspace<MatrixPolicy>& workspace,
+        Solver::Rosenbrock_stats& stats,
+        const std::vector<bool>& is_active) const;
+
+    /// @brief Computes the new solution Ynew and the error estimation Yerror from the stage values
+    template<RosenbrockTableau Tableau>
+    static void ComputeSolutionAndError(RosenbrockWorkspace<MatrixPolicy>& workspace);
+
+    /// @brief Computes Ynew and Yerror for the active grid cells only; the other grid cells are left unchanged
+    template<RosenbrockTableau Tableau>
+    void ComputeSolutionAndError(RosenbrockWorkspace<MatrixPolicy>& workspace, const std::vector<bool>& is_active) const;
+
+    /// @brief y += coefficient * x, which is skipped at compile time for zero coefficients
+    template<double coefficient>
+    static void AddScaled(const std::vector<double>& x, std::vector<double>& y);
+
+    /// @brief y += coefficient / H * x, which is skipped at compile time for zero coefficients
+    template<double coefficient>
+    static void AddStepScaled(const MatrixPolicy<double>& x, const double& H, MatrixPolicy<double>& y);
+
+    /// @brief y += coefficient / H * x, with a separate step size for each grid cell, for the active grid cells
+    template<double coefficient>
+    void AddStepScaled(
+        const MatrixPolicy<double>& x,
+        const std::vector<double>& H,
+        MatrixPolicy<double>& y,
+        const std::vector<bool>& is_active) const;
+
+    /// @brief Computes the scaled norm of the errors over all grid cells in a single pass
+    ///
+    /// Each species is scaled by its own absolute tolerance (see absolute_tolerances_)
+    /// @param Y the original number densities
+    /// @param Ynew the new number densities
+    /// @param errors The computed errors
+    /// @return The root-mean-square of the scaled errors
+    double ErrorNorm(const MatrixPolicy<double>& Y, const MatrixPolicy<double>& Ynew, const MatrixPolicy<double>& errors)
+        const requires(!Vectorizable<MatrixPolicy<double>>);
+    double ErrorNorm(const MatrixPolicy<double>& Y, const MatrixPolicy<double>& Ynew, const MatrixPolicy<double>& errors)
+        const requires Vectorizable<MatrixPolicy<double>>;
+
+    /// @brief Computes the scaled norm of the errors separately for each grid cell
+    /// @param Y the original number densities
+    /// @param Ynew the new number densities
+    /// @param errors The computed errors
+    /// @param is_active The grid cells to compute a norm for; the norms of the other grid cells are left unchanged
+    /// @param norms The error norm for each grid cell
+    void CellErrorNorms(
+        const MatrixPolicy<double>& Y,
+        const MatrixPolicy<double>& Ynew,
+        const MatrixPolicy<double>& errors,
+        const std::vector<bool>& is_active,
+        std::vector<double>& norms) const;
 
-   protected:
     /// @brief Initializes the solving parameters for a three-stage rosenbrock solver
     void three_stage_rosenbrock();
-
-    /// @brief Computes the scaled norm of the vector errors
-    /// @param original_number_densities the original number densities
-    /// @param new_number_densities the new number densities
-    /// @param errors The computed errors
-    /// @return
-    double error_norm(
-        std::vector<double> original_number_densities,
-        std::vector<double> new_number_densities,
-        std::vector<double> errors);
   };
 
   template<template<class> class MatrixPolicy>
@@ -204,8 +603,19 @@ namespace micm
         parameters_(),
         process_set_(),
         stats_(),
+        integrated_species_ids_(),
+        constant_reactants_(),
+        species_order_(),
         jacobian_(),
-        linear_solver_()
+        cell_jacobian_(),
+        jacobian_diagonal_elements_(),
+        absolute_tolerances_(),
+        linear_solver_(),
+        gmres_linear_solver_(),
+        mixed_precision_linear_solver_(),
+        compiled_kernels_(),
+        workspace_(),
+        chunk_workspaces_()
   {
     three_stage_rosenbrock();
   }
@@ -218,18 +628,91 @@ namespace micm
       : system_(system),
         processes_(std::move(processes)),
         parameters_(parameters),
-        process_set_(processes_, GetState()),
+        process_set_(),
         stats_(),
+        integrated_species_ids_(),
+        constant_reactants_(),
+        species_order_(),
         jacobian_(),
-        linear_solver_()
+        cell_jacobian_(),
+        jacobian_diagonal_elements_(),
+        absolute_tolerances_(),
+        linear_solver_(),
+        gmres_linear_solver_(),
+        mixed_precision_linear_solver_(),
+        compiled_kernels_(),
+        workspace_(),
+        chunk_workspaces_()
   {
-    auto builder = SparseMatrix<double>::create(system_.StateSize()).number_of_blocks(parameters_.number_of_grid_cells_);
-    auto jac_elements = process_set_.NonZeroJacobianElements();
-    for (auto& elem : jac_elements)
-      builder = builder.with_element(elem.first, elem.second);
-    jacobian_ = builder;
-    linear_solver_ = LinearSolver(jacobian_);
-    process_set_.SetJacobianFlatIds(jacobian_);
+    // the linear solver would open a parallel region inside each chunk's thread, so the total number of threads
+    // would be the product of the two (or, with nesting disabled, the linear solver threads would be ignored)
+    if (parameters_.number_of_threads_ > 1 && parameters_.number_of_linear_solver_threads_ > 1)
+      throw std::invalid_argument(
+          "RosenbrockSolverParameters: number_of_threads_ and number_of_linear_solver_threads_ cannot both be more than 1");
+    // species with fixed concentrations are not integrated; their concentrations are folded into the rate
+    // constants in UpdateState, and the ODE system holds only the remaining species (see System::IntegratedNames)
+    const auto state = GetState();
+    const auto integrated_names = system_.IntegratedNames();
+    const auto constant_names = system_.ConstantNames();
+    const std::set<std::string> constant_species(constant_names.begin(), constant_names.end());
+    for (const auto& name : integrated_names)
+      integrated_species_ids_.push_back(state.variable_map_.at(name));
+    for (std::size_t i_rxn = 0; i_rxn < processes_.size(); ++i_rxn)
+      for (const auto& reactant : processes_[i_rxn].reactants_)
+        if (constant_species.contains(reactant.name_))
+          constant_reactants_.push_back(std::make_pair(i_rxn, state.variable_map_.at(reactant.name_)));
+    process_set_ = ProcessSet(
+        processes_,
+        State<MatrixPolicy>{ StateParameters{ .state_variable_names_ = integrated_names,
+                                              .number_of_grid_cells_ = 1,
+                                              .number_of_custom_parameters_ = 0,
+                                              .number_of_rate_constants_ = processes_.size() } },
+        parameters_.bucket_by_arity_,
+        constant_species);
+
+    const std::size_t number_of_species = integrated_species_ids_.size();
+    // the state variables keep their order (and variable_map_), only the Jacobian and its LU factors are reordered
+    if (parameters_.reorder_species_)
+      species_order_ = DiagonalMarkowitzReordering(number_of_species, process_set_.NonZeroJacobianElements());
+    else
+      for (std::size_t i = 0; i < number_of_species; ++i)
+        species_order_.push_back(i);
+    jacobian_ = BuildJacobian(parameters_.number_of_grid_cells_);
+    cell_jacobian_ = BuildJacobian<SparseMatrixStandardOrdering>(1);
+    for (std::size_t i = 0; i < number_of_species; ++i)
+      jacobian_diagonal_elements_.push_back(jacobian_.VectorIndex(0, i, i));
+    // species are ordered as in System::IntegratedNames()
+    auto add_tolerances = [&](const Phase& phase)
+    {
+      for (const auto& species : phase.species_)
+      {
+        if (species.IsConstant())
+          continue;
+        double tolerance = parameters_.absolute_tolerance_;
+        for (const auto& property : species.properties_)
+          if (property.name_ == "absolute tolerance")
+            tolerance = property.value_;
+        absolute_tolerances_.push_back(tolerance);
+      }
+    };
+    add_tolerances(system_.gas_phase_);
+    for (const auto& phase : system_.phases_)
+      add_tolerances(phase.second);
+    // the linear solver only holds the symbolic factorization, which is shared by all workspaces
+    if (parameters_.gmres_linear_solver_)
+      gmres_linear_solver_ = GmresLinearSolver<double, SparseMatrixOrdering>(
+          BuildJacobian(1), species_order_, parameters_.gmres_parameters_);
+    else if (parameters_.mixed_precision_linear_solver_)
+      mixed_precision_linear_solver_ = MixedPrecisionLinearSolver<double, float, SparseMatrixOrdering>(
+          BuildJacobian(1), species_order_, parameters_.mixed_precision_parameters_);
+    else
+      linear_solver_ = LinearSolver<double, SparseMatrixOrdering>(
+          BuildJacobian(1), species_order_, false, parameters_.number_of_linear_solver_threads_);
+    process_set_.SetJacobianFlatIds(jacobian_, species_order_);
+    // the compiled kernels use the row-ordered data layout of Matrix
+    if (parameters_.compile_kernels_ && std::is_same_v<MatrixPolicy<double>, Matrix<double>>)
+      compiled_kernels_ =
+          CompiledKernels(system_, processes_, parameters_.compiled_kernels_parameters_, parameters_.reorder_species_);
 
     // TODO: move three stage rosenbrock to parameter constructor
     three_stage_rosenbrock();
@@ -240,6 +723,25 @@ namespace micm
   {
   }
 
+  template<template<class> class MatrixPolicy>
+  template<class OrderingPolicy>
+  inline SparseMatrix<double, OrderingPolicy> RosenbrockSolver<MatrixPolicy>::BuildJacobian(
+      std::size_t number_of_grid_cells) const
+  {
+    const std::size_t number_of_species = integrated_species_ids_.size();
+    auto builder = SparseMatrix<double, OrderingPolicy>::create(number_of_species).number_of_blocks(number_of_grid_cells);
+    std::vector<std::size_t> row(number_of_species);
+    for (std::size_t i = 0; i < species_order_.size(); ++i)
+      row[species_order_[i]] = i;
+    auto jac_elements = process_set_.NonZeroJacobianElements();
+    for (auto& elem : jac_elements)
+      builder = builder.with_element(row[elem.first], row[elem.second]);
+    // the diagonal is always needed to form [alpha * I - dforce_dy]
+    for (std::size_t i = 0; i < number_of_species; ++i)
+      builder = builder.with_element(i, i);
+    return builder;
+  }
+
   template<template<class> class MatrixPolicy>
   inline State<MatrixPolicy> RosenbrockSolver<MatrixPolicy>::GetState() const
   {
@@ -248,33 +750,160 @@ namespace micm
     {
       n_params += process.rate_constant_->SizeCustomParameters();
     }
-    return State<>{ micm::StateParameters{ .state_variable_names_ = system_.UniqueNames(),
-                                         .number_of_grid_cells_ = parameters_.number_of_grid_cells_,
-                                         .number_of_custom_parameters_ = n_params,
-                                         .number_of_rate_constants_ = processes_.size() } };
+    return State<MatrixPolicy>{ micm::StateParameters{ .state_variable_names_ = system_.UniqueNames(),
+                                                       .number_of_grid_cells_ = parameters_.number_of_grid_cells_,
+                                                       .number_of_custom_parameters_ = n_params,
+                                                       .number_of_rate_constants_ = processes_.size() } };
+  }
+
+  template<template<class> class MatrixPolicy>
+  inline Solver::SolverResult RosenbrockSolver<MatrixPolicy>::Solve(double time_start, double time_end, State<MatrixPolicy>& state) noexcept
+  {
+    return (this->*solve_)(time_start, time_end, state);
   }
 
   template<template<class> class MatrixPolicy>
+  template<RosenbrockTableau Tableau>
   inline Solver::SolverResult RosenbrockSolver<MatrixPolicy>::Solve(double time_start, double time_end, State<MatrixPolicy>& state) noexcept
   {
-    /// TODO: Y, Ynew, and forcing will have to be removed before this works with different Matrix classes
-    std::vector<std::vector<double>> K(parameters_.stages_, std::vector<double>(parameters_.N_, 0));
-    MatrixPolicy<double> Y_matrix(state.variables_);
-    std::vector<double>& Y = Y_matrix.AsVector();
-    MatrixPolicy<double> Ynew_matrix(Y_matrix.size(), Y_matrix[0].size(), 0.0);
-    std::vector<double>& Ynew = Ynew_matrix.AsVector();
-    MatrixPolicy<double> forcing_matrix(Y_matrix.size(), Y_matrix[0].size(), 0.0);
-    std::vector<double>& forcing = forcing_matrix.AsVector();
+    if (!chunk_workspaces_.empty())
+      return SolveInChunks<Tableau>(time_start, time_end, state);
+
+    // the workspace only grows the first time a method with more stages than the selected one is used
+    if (workspace_.K_.size() < Tableau::stages_)
+      workspace_.K_.resize(Tableau::stages_, workspace_.Y_);
+
+    const bool has_constant_species = integrated_species_ids_.size() != system_.StateSize();
+    if (has_constant_species)
+    {
+      for (std::size_t i_cell = 0; i_cell < state.variables_.size(); ++i_cell)
+      {
+        auto state_cell = state.variables_[i_cell];
+        auto Y_cell = workspace_.Y_[i_cell];
+        for (std::size_t i_species = 0; i_species < integrated_species_ids_.size(); ++i_species)
+          Y_cell[i_species] = state_cell[integrated_species_ids_[i_species]];
+      }
+    }
+    else
+      std::copy(state.variables_.AsVector().begin(), state.variables_.AsVector().end(), workspace_.Y_.AsVector().begin());
+    Solver::SolverResult result =
+        parameters_.per_cell_step_control_
+            ? IntegratePerCell<Tableau>(time_start, time_end, state.rate_constants_, workspace_)
+            : Integrate<Tableau>(time_start, time_end, state.rate_constants_, workspace_);
+#ifdef USE_TIMING
+    result.stats_.timing.update_rate_constants += update_rate_constants_time_;
+    update_rate_constants_time_ = {};
+#endif
+    stats_ = result.stats_;
+    if (has_constant_species)
+    {
+      // the constant species keep their concentrations
+      auto& Y = workspace_.state_variables_;
+      std::copy(state.variables_.AsVector().begin(), state.variables_.AsVector().end(), Y.AsVector().begin());
+      for (std::size_t i_cell = 0; i_cell < Y.size(); ++i_cell)
+      {
+        auto Y_cell = Y[i_cell];
+        auto workspace_Y_cell = workspace_.Y_[i_cell];
+        for (std::size_t i_species = 0; i_species < integrated_species_ids_.size(); ++i_species)
+          Y_cell[integrated_species_ids_[i_species]] = workspace_Y_cell[i_species];
+      }
+      result.result_ = Y.AsVector();
+    }
+    else
+      result.result_ = workspace_.Y_.AsVector();
+
+    return result;
+  }
+
+  template<template<class> class MatrixPolicy>
+  template<RosenbrockTableau Tableau>
+  inline Solver::SolverResult
+  RosenbrockSolver<MatrixPolicy>::SolveInChunks(double time_start, double time_end, State<MatrixPolicy>& state) noexcept
+  {
+    const std::size_t number_of_chunks = chunk_workspaces_.size();
+    const std::size_t number_of_species = integrated_species_ids_.size();
+    const std::size_t number_of_rate_constants = processes_.size();
+    std::vector<std::size_t> first_cell(number_of_chunks, 0);
+    for (std::size_t i_chunk = 1; i_chunk < number_of_chunks; ++i_chunk)
+      first_cell[i_chunk] = first_cell[i_chunk - 1] + chunk_workspaces_[i_chunk - 1].Y_.size();
+    std::vector<Solver::SolverResult> chunk_results(number_of_chunks);
+    MatrixPolicy<double> Y = state.variables_;  // the constant species keep their concentrations
+
+    // Each chunk only reads the shared solver data (process set, symbolic LU factorization, parameters)
+    // and writes to its own workspace and to its own grid cells of Y
+    MICM_OMP(omp parallel for num_threads(parameters_.number_of_threads_) schedule(static, 1))
+    for (std::size_t i_chunk = 0; i_chunk < number_of_chunks; ++i_chunk)
+    {
+      auto& workspace = chunk_workspaces_[i_chunk];
+      if (workspace.K_.size() < Tableau::stages_)
+        workspace.K_.resize(Tableau::stages_, workspace.Y_);
+      for (std::size_t i_cell = 0; i_cell < workspace.Y_.size(); ++i_cell)
+      {
+        auto state_cell = state.variables_[first_cell[i_chunk] + i_cell];
+        auto rate_constants_cell = state.rate_constants_[first_cell[i_chunk] + i_cell];
+        auto Y_cell = workspace.Y_[i_cell];
+        auto chunk_rate_constants_cell = workspace.rate_constants_[i_cell];
+        for (std::size_t i_species = 0; i_species < number_of_species; ++i_species)
+          Y_cell[i_species] = state_cell[integrated_species_ids_[i_species]];
+        for (std::size_t i_rc = 0; i_rc < number_of_rate_constants; ++i_rc)
+          chunk_rate_constants_cell[i_rc] = rate_constants_cell[i_rc];
+      }
+      chunk_results[i_chunk] =
+          parameters_.per_cell_step_control_
+              ? IntegratePerCell<Tableau>(time_start, time_end, workspace.rate_constants_, workspace)
+              : Integrate<Tableau>(time_start, time_end, workspace.rate_constants_, workspace);
+      for (std::size_t i_cell = 0; i_cell < workspace.Y_.size(); ++i_cell)
+      {
+        auto Y_cell = Y[first_cell[i_chunk] + i_cell];
+        auto chunk_Y_cell = workspace.Y_[i_cell];
+        for (std::size_t i_species = 0; i_species < number_of_species; ++i_species)
+          Y_cell[integrated_species_ids_[i_species]] = chunk_Y_cell[i_species];
+      }
+    }
+
+    // Combine the chunk results: the statistics are summed, the final time is the earliest time
+    // reached by any chunk, and the state is the first unsuccessful one (if any)
+    Solver::SolverResult result{};
+    result.T = time_end;
+    result.state_ = Solver::SolverState::Converged;
+    for (const auto& chunk_result : chunk_results)
+    {
+      result.T = std::min(result.T, chunk_result.T);
+      if (result.state_ == Solver::SolverState::Converged)
+        result.state_ = chunk_result.state_;
+      result.stats_ += chunk_result.stats_;
+      result.cell_stats_.insert(
+          result.cell_stats_.end(), chunk_result.cell_stats_.begin(), chunk_result.cell_stats_.end());
+      result.cell_states_.insert(
+          result.cell_states_.end(), chunk_result.cell_states_.begin(), chunk_result.cell_states_.end());
+    }
+#ifdef USE_TIMING
+    result.stats_.timing.update_rate_constants += update_rate_constants_time_;
+    update_rate_constants_time_ = {};
+#endif
+    stats_ = result.stats_;
+    result.result_ = std::move(Y.AsVector());
 
-    // TODO: update for multiple-grid cell solving
-    const double number_density_air = 0.0;
+    return result;
+  }
+
+  template<template<class> class MatrixPolicy>
+  template<RosenbrockTableau Tableau>
+  inline Solver::SolverResult RosenbrockSolver<MatrixPolicy>::Integrate(
+      double time_start,
+      double time_end,
+      const MatrixPolicy<double>& rate_constants,
+      RosenbrockWorkspace<MatrixPolicy>& workspace) const noexcept
+  {
+    std::vector<double>& Y_vector = workspace.Y_.AsVector();
+    std::vector<double>& Ynew_vector = workspace.Ynew_.AsVector();
 
     double present_time = time_start;
     double H =
         std::min(std::max(std::abs(parameters_.h_min_), std::abs(parameters_.h_start_)), std::abs(parameters_.h_max_));
 
     Solver::SolverResult result{};
-    stats_.reset();
+    auto& stats = result.stats_;
 
     if (std::abs(H) <= 10 * parameters_.round_off_)
     {
@@ -283,10 +912,14 @@ namespace micm
 
     bool reject_last_h = false;
     bool reject_more_h = false;
+    // Number of accepted steps since the Jacobian was last evaluated
+    // Only W-methods keep their order with an old Jacobian; the other methods evaluate it every step
+    const std::size_t max_jacobian_age = IsWMethod<Tableau>() ? parameters_.max_jacobian_age_ : 0;
+    std::size_t jacobian_age = max_jacobian_age;
 
     while ((present_time - time_end + parameters_.round_off_) <= 0)
     {
-      if (stats_.number_of_steps > parameters_.max_number_of_steps_)
+      if (stats.number_of_steps > parameters_.max_number_of_steps_)
       {
         result.state_ = Solver::SolverState::ConvergenceExceededMaxSteps;
         break;
@@ -301,98 +934,59 @@ namespace micm
       //  Limit H if necessary to avoid going beyond time_end
       H = std::min(H, std::abs(time_end - present_time));
 
-      force(state.rate_constants_, Y_matrix, forcing_matrix);
+      // The forcing and jacobian only depend on Y and the rate constants,
+      // so they are evaluated once per step and re-used after a rejection.
+      // The jacobian can also be kept for several steps (see RosenbrockSolverParameters::max_jacobian_age_)
+      if (jacobian_age >= max_jacobian_age)
+      {
+        CalculateForcingAndJacobian(
+            rate_constants, workspace.Y_, workspace.initial_forcing_, workspace.reaction_rates_, workspace.jacobian_, stats);
+        jacobian_age = 0;
+      }
+      else
+        CalculateForcing(rate_constants, workspace.Y_, workspace.initial_forcing_, workspace.reaction_rates_, stats);
 
       bool accepted = false;
       //  Repeat step calculation until current step accepted
       while (!accepted)
       {
-        if (stats_.number_of_steps > parameters_.max_number_of_steps_)
+        if (stats.number_of_steps > parameters_.max_number_of_steps_)
         {
           break;
         }
         bool is_singular{ false };
         // Form and factor the rosenbrock ode jacobian
-        auto ode_jacobian =
-            lin_factor(H, parameters_.gamma_[0], is_singular, Y_matrix, state.rate_constants_);
-        stats_.jacobian_updates += 1;
+        FactorAlphaMinusJacobian(H, Tableau::gamma_[0], is_singular, workspace, stats);
         if (is_singular)
         {
           result.state_ = Solver::SolverState::RepeatedlySingularMatrix;
           break;
         }
 
-        // Compute the stages
+        // Compute the stages, the new solution, and the error estimation
+        ComputeStages<Tableau>(H, rate_constants, workspace, stats);
+        ComputeSolutionAndError<Tableau>(workspace);
+        double error;
         {
-          // the first stage (stage 0), inlined to remove a branch in the following for loop
-          K[0] = lin_solve(forcing, ode_jacobian);
-
-          // stages (1-# of stages)
-          for (uint64_t stage = 1; stage < parameters_.stages_; ++stage)
-          {
-            double stage_combinations = ((stage + 1) - 1) * ((stage + 1) - 2) / 2;
-            if (parameters_.new_function_evaluation_[stage])
-            {
-              Ynew = Y;
-              for (uint64_t j = 0; j <= stage; ++j)
-              {
-                auto a = parameters_.a_[stage_combinations + j];
-                for (uint64_t idx = 0; idx < Ynew.size(); ++idx)
-                {
-                  Ynew[idx] += a * K[j][idx];
-                }
-              }
-              force(state.rate_constants_, Ynew_matrix, forcing_matrix);
-            }
-            K[stage] = forcing;
-            for (uint64_t j = 0; j < stage; ++j)
-            {
-              auto HC = parameters_.c_[stage_combinations + j] / H;
-              for (uint64_t idx = 0; idx < K[stage].size(); ++idx)
-              {
-                K[stage][idx] += HC * K[j][idx];
-              }
-            }
-            K[stage] = lin_solve(K[stage], ode_jacobian);
-          }
-        }
-
-        // Compute the new solution
-        Ynew = Y;
-        for (uint64_t stage = 0; stage < parameters_.stages_; ++stage)
-        {
-          for (uint64_t idx = 0; idx < Ynew.size(); ++idx)
-          {
-            Ynew[idx] += parameters_.m_[stage] * K[stage][idx];
-          }
-        }
-
-        // Compute the error estimation
-        std::vector<double> Yerror(Y.size(), 0);
-        for (uint64_t stage = 0; stage < parameters_.stages_; ++stage)
-        {
-          for (uint64_t idx = 0; idx < Yerror.size(); ++idx)
-          {
-            Yerror[idx] += parameters_.e_[stage] * K[stage][idx];
-          }
+          MICM_TIME_PHASE(stats.timing.error_norm);
+          error = ErrorNorm(workspace.Y_, workspace.Ynew_, workspace.Yerror_);
         }
-        auto error = error_norm(Y, Ynew, Yerror);
 
         // New step size is bounded by FacMin <= Hnew/H <= FacMax
         double Hnew = H * std::min(
                               parameters_.factor_max_,
                               std::max(
                                   parameters_.factor_min_,
-                                  parameters_.safety_factor_ / std::pow(error, 1 / parameters_.estimator_of_local_order_)));
+                                  parameters_.safety_factor_ / std::pow(error, 1 / Tableau::estimator_of_local_order_)));
 
         // Check the error magnitude and adjust step size
-        stats_.number_of_steps += 1;
-        stats_.total_steps += 1;
+        stats.number_of_steps += 1;
+        stats.total_steps += 1;
         if ((error < 1) || (H < parameters_.h_min_))
         {
-          stats_.accepted += 1;
+          stats.accepted += 1;
           present_time = present_time + H;
-          Y = Ynew;
+          std::swap(Y_vector, Ynew_vector);
           Hnew = std::max(parameters_.h_min_, std::min(Hnew, parameters_.h_max_));
           if (reject_last_h)
           {
@@ -403,6 +997,7 @@ namespace micm
           reject_more_h = false;
           H = Hnew;
           accepted = true;
+          ++jacobian_age;
         }
         else
         {
@@ -414,22 +1009,558 @@ namespace micm
           reject_more_h = reject_last_h;
           reject_last_h = true;
           H = Hnew;
-          if (stats_.accepted >= 1)
+          if (stats.accepted >= 1)
           {
-            stats_.rejected += 1;
+            stats.rejected += 1;
+          }
+          // A step rejected with a jacobian from an earlier step is retried with a new one
+          if (jacobian_age > 0)
+          {
+            CalculateJacobian(rate_constants, workspace.Y_, workspace.jacobian_, stats);
+            jacobian_age = 0;
           }
         }
       }
+      if (result.state_ == Solver::SolverState::RepeatedlySingularMatrix)
+        break;
     }
 
     result.T = present_time;
-    result.stats_ = stats_;
-    result.result_ = std::move(Y);
-    result.state_ = Solver::SolverState::Converged;
+    if (result.state_ == Solver::SolverState::NotYetCalled)
+      result.state_ = Solver::SolverState::Converged;
+
+    return result;
+  }
+
+  template<template<class> class MatrixPolicy>
+  template<RosenbrockTableau Tableau>
+  inline Solver::SolverResult RosenbrockSolver<MatrixPolicy>::IntegratePerCell(
+      double time_start,
+      double time_end,
+      const MatrixPolicy<double>& rate_constants,
+      RosenbrockWorkspace<MatrixPolicy>& workspace) const noexcept
+  {
+    auto& Y = workspace.Y_;
+    auto& Ynew = workspace.Ynew_;
+    auto& H = workspace.cell_H_;
+    auto& present_time = workspace.cell_time_;
+    auto& error = workspace.cell_error_;
+    auto& alpha = workspace.cell_alpha_;
+    auto& reject_last_h = workspace.cell_reject_last_h_;
+    auto& reject_more_h = workspace.cell_reject_more_h_;
+    auto& is_active = workspace.cell_is_active_;
+
+    const std::size_t number_of_cells = Y.size();
+    const std::size_t number_of_species = integrated_species_ids_.size();
+
+    double H_start =
+        std::min(std::max(std::abs(parameters_.h_min_), std::abs(parameters_.h_start_)), std::abs(parameters_.h_max_));
+    if (std::abs(H_start) <= 10 * parameters_.round_off_)
+    {
+      H_start = delta_min_;
+    }
+    std::fill(H.begin(), H.end(), H_start);
+    std::fill(present_time.begin(), present_time.end(), time_start);
+    std::fill(reject_last_h.begin(), reject_last_h.end(), false);
+    std::fill(reject_more_h.begin(), reject_more_h.end(), false);
+    std::fill(is_active.begin(), is_active.end(), (time_start - time_end + parameters_.round_off_) <= 0);
+
+    Solver::SolverResult result{};
+    auto& stats = result.stats_;
+    auto& cell_stats = result.cell_stats_;
+    auto& cell_states = result.cell_states_;
+    cell_stats.resize(number_of_cells);
+    cell_states.assign(number_of_cells, Solver::SolverState::NotYetCalled);
+    bool is_Y_updated = true;
+    // Number of iterations with an accepted step since the Jacobian was last evaluated, and whether a grid cell
+    // rejected a step with a Jacobian from an earlier iteration
+    // Only W-methods keep their order with an old Jacobian; the other methods evaluate it every step
+    const std::size_t max_jacobian_age = IsWMethod<Tableau>() ? parameters_.max_jacobian_age_ : 0;
+    std::size_t jacobian_age = max_jacobian_age;
+    bool is_jacobian_rejected = false;
+
+    // Every active grid cell takes one (accepted or rejected) step per iteration.
+    // Grid cells that have reached time_end, or whose step size became too small, or whose factorization stayed
+    // singular, are masked out and their state is left unchanged.
+    while (std::find(is_active.begin(), is_active.end(), true) != is_active.end())
+    {
+      if (stats.number_of_steps > parameters_.max_number_of_steps_)
+      {
+        result.state_ = Solver::SolverState::ConvergenceExceededMaxSteps;
+        break;
+      }
+
+      bool any_active = false;
+      for (std::size_t i_cell = 0; i_cell < number_of_cells; ++i_cell)
+      {
+        if (!is_active[i_cell])
+          continue;
+        if (((present_time[i_cell] + 0.1 * H[i_cell]) == present_time[i_cell]) || (H[i_cell] <= parameters_.round_off_))
+        {
+          // only this grid cell stops
+          cell_states[i_cell] = Solver::SolverState::StepSizeTooSmall;
+          is_active[i_cell] = false;
+          continue;
+        }
+        //  Limit H if necessary to avoid going beyond time_end
+        H[i_cell] = std::min(H[i_cell], std::abs(time_end - present_time[i_cell]));
+        alpha[i_cell] = 1 / (H[i_cell] * Tableau::gamma_[0]);
+        any_active = true;
+      }
+      if (!any_active)
+        break;
+
+      // The forcing and jacobian are only re-evaluated if at least one grid cell accepted its last step.
+      // The jacobian can also be kept for several steps (see RosenbrockSolverParameters::max_jacobian_age_)
+      // Only the active grid cells are evaluated, factored, and solved for; the evaluations and solves of the
+      // step are counted for each of them.
+      const auto function_calls = stats.function_calls;
+      const auto jacobian_updates = stats.jacobian_updates;
+      const auto solves = stats.solves;
+      const bool update_jacobian = (is_Y_updated && jacobian_age >= max_jacobian_age) || is_jacobian_rejected;
+      if (is_Y_updated && update_jacobian)
+        CalculateForcingAndJacobian(
+            rate_constants, Y, workspace.initial_forcing_, workspace.reaction_rates_, workspace.jacobian_, stats, is_active);
+      else if (is_Y_updated)
+        CalculateForcing(rate_constants, Y, workspace.initial_forcing_, workspace.reaction_rates_, stats, is_active);
+      else if (update_jacobian)
+        CalculateJacobian(rate_constants, Y, workspace.jacobian_, stats, is_active);
+      if (update_jacobian)
+        jacobian_age = 0;
+      is_Y_updated = false;
+      is_jacobian_rejected = false;
+
+      // Form and factor the rosenbrock ode jacobian. Grid cells with a singular pivot halve their step size and
+      // only they are factored again; a grid cell that is still singular after 5 halvings in a row stops, and
+      // the other grid cells keep their step size. Each factorization of a grid cell is counted, so the grid
+      // cell counts add up to the total.
+      auto& is_factored = workspace.cell_is_factored_;
+      is_factored = is_active;
+      for (std::size_t n_consecutive = 0;; ++n_consecutive)
+      {
+        {
+          MICM_TIME_PHASE(stats.timing.decomposition);
+          AlphaMinusJacobian(workspace.jacobian_, alpha, workspace.alpha_minus_jacobian_, is_factored);
+          FactorWorkspace(workspace, is_factored);
+        }
+        FindSingularCells(workspace, alpha);
+        bool is_retried = false;
+        for (std::size_t i_cell = 0; i_cell < number_of_cells; ++i_cell)
+        {
+          if (!is_factored[i_cell])
+            continue;
+          stats.decompositions += 1;
+          cell_stats[i_cell].decompositions += 1;
+          is_factored[i_cell] = workspace.is_singular_[i_cell];
+          if (!is_factored[i_cell])
+            continue;
+          stats.singular += 1;
+          cell_stats[i_cell].singular += 1;
+          if (n_consecutive == 5)
+          {
+            // only this grid cell stops
+            cell_states[i_cell] = Solver::SolverState::RepeatedlySingularMatrix;
+            cell_stats[i_cell].function_calls += stats.function_calls - function_calls;
+            cell_stats[i_cell].jacobian_updates += stats.jacobian_updates - jacobian_updates;
+            is_active[i_cell] = false;
+            is_factored[i_cell] = false;
+            continue;
+          }
+          H[i_cell] /= 2;
+          alpha[i_cell] = 1 / (H[i_cell] * Tableau::gamma_[0]);
+          is_retried = true;
+        }
+        if (!is_retried)
+          break;
+      }
+      if (std::find(is_active.begin(), is_active.end(), true) == is_active.end())
+        break;
+
+      // Compute the stages, the new solution, and the error estimation
+      ComputeStages<Tableau>(H, rate_constants, workspace, stats, is_active);
+      ComputeSolutionAndError<Tableau>(workspace, is_active);
+      {
+        MICM_TIME_PHASE(stats.timing.error_norm);
+        CellErrorNorms(Y, Ynew, workspace.Yerror_, is_active, error);
+      }
+
+      stats.number_of_steps += 1;
+      stats.total_steps += 1;
+
+      // Check the error magnitude and adjust the step size of each grid cell
+      for (std::size_t i_cell = 0; i_cell < number_of_cells; ++i_cell)
+      {
+        if (!is_active[i_cell])
+          continue;
+        cell_stats[i_cell].function_calls += stats.function_calls - function_calls;
+        cell_stats[i_cell].jacobian_updates += stats.jacobian_updates - jacobian_updates;
+        cell_stats[i_cell].solves += stats.solves - solves;
+        cell_stats[i_cell].number_of_steps += 1;
+        cell_stats[i_cell].total_steps += 1;
+
+        // New step size is bounded by FacMin <= Hnew/H <= FacMax
+        double Hnew = H[i_cell] * std::min(
+                                      parameters_.factor_max_,
+                                      std::max(
+                                          parameters_.factor_min_,
+                                          parameters_.safety_factor_ /
+                                              std::pow(error[i_cell], 1 / Tableau::estimator_of_local_order_)));
+
+        if ((error[i_cell] < 1) || (H[i_cell] < parameters_.h_min_))
+        {
+          stats.accepted += 1;
+          cell_stats[i_cell].accepted += 1;
+          present_time[i_cell] = present_time[i_cell] + H[i_cell];
+          auto Y_cell = Y[i_cell];
+          auto Ynew_cell = Ynew[i_cell];
+          for (std::size_t i_species = 0; i_species < number_of_species; ++i_species)
+          {
+            Y_cell[i_species] = Ynew_cell[i_species];
+          }
+          is_Y_updated = true;
+          Hnew = std::max(parameters_.h_min_, std::min(Hnew, parameters_.h_max_));
+          if (reject_last_h[i_cell])
+          {
+            // No step size increase after a rejected step
+            Hnew = std::min(Hnew, H[i_cell]);
+          }
+          reject_last_h[i_cell] = false;
+          reject_more_h[i_cell] = false;
+          H[i_cell] = Hnew;
+          is_active[i_cell] = (present_time[i_cell] - time_end + parameters_.round_off_) <= 0;
+        }
+        else
+        {
+          // Reject step
+          if (reject_more_h[i_cell])
+          {
+            Hnew = H[i_cell] * parameters_.rejection_factor_decrease_;
+          }
+          reject_more_h[i_cell] = reject_last_h[i_cell];
+          reject_last_h[i_cell] = true;
+          H[i_cell] = Hnew;
+          if (stats.accepted >= 1)
+          {
+            stats.rejected += 1;
+          }
+          if (cell_stats[i_cell].accepted >= 1)
+          {
+            cell_stats[i_cell].rejected += 1;
+          }
+          is_jacobian_rejected = is_jacobian_rejected || jacobian_age > 0;
+        }
+      }
+      if (is_Y_updated)
+        ++jacobian_age;
+    }
+
+    result.T = *std::min_element(present_time.begin(), present_time.end());
+    // grid cells that were still active stopped with the whole batch; the batch fails if any grid cell failed
+    for (std::size_t i_cell = 0; i_cell < number_of_cells; ++i_cell)
+    {
+      if (cell_states[i_cell] == Solver::SolverState::NotYetCalled)
+        cell_states[i_cell] = is_active[i_cell] ? result.state_ : Solver::SolverState::Converged;
+      else if (result.state_ == Solver::SolverState::NotYetCalled)
+        result.state_ = cell_states[i_cell];
+    }
+    if (result.state_ == Solver::SolverState::NotYetCalled)
+      result.state_ = Solver::SolverState::Converged;
 
     return result;
   }
 
+  template<template<class> class MatrixPolicy>
+  template<RosenbrockTableau Tableau>
+  inline void RosenbrockSolver<MatrixPolicy>::SetTableau()
+  {
+    static_assert(Tableau::stages_ <= 6, "RosenbrockSolverParameters can hold at most 6 stages");
+
+    parameters_.stages_ = Tableau::stages_;
+    parameters_.estimator_of_local_order_ = Tableau::estimator_of_local_order_;
+    parameters_.new_function_evaluation_.fill(false);
+    parameters_.a_.fill(0);
+    parameters_.c_.fill(0);
+    parameters_.m_.fill(0);
+    parameters_.e_.fill(0);
+    parameters_.alpha_.fill(0);
+    parameters_.gamma_.fill(0);
+    std::copy(
+        Tableau::new_function_evaluation_.begin(),
+        Tableau::new_function_evaluation_.end(),
+        parameters_.new_function_evaluation_.begin());
+    std::copy(Tableau::a_.begin(), Tableau::a_.end(), parameters_.a_.begin());
+    std::copy(Tableau::c_.begin(), Tableau::c_.end(), parameters_.c_.begin());
+    std::copy(Tableau::m_.begin(), Tableau::m_.end(), parameters_.m_.begin());
+    std::copy(Tableau::e_.begin(), Tableau::e_.end(), parameters_.e_.begin());
+    std::copy(Tableau::alpha_.begin(), Tableau::alpha_.end(), parameters_.alpha_.begin());
+    std::copy(Tableau::gamma_.begin(), Tableau::gamma_.end(), parameters_.gamma_.begin());
+
+    solve_ = &RosenbrockSolver<MatrixPolicy>::template Solve<Tableau>;
+    AllocateWorkspaces();
+  }
+
+  template<template<class> class MatrixPolicy>
+  inline void RosenbrockSolver<MatrixPolicy>::SetNumberOfGridCells(std::size_t number_of_grid_cells)
+  {
+    parameters_.number_of_grid_cells_ = number_of_grid_cells;
+    parameters_.N_ = integrated_species_ids_.size() * number_of_grid_cells;
+    jacobian_ = BuildJacobian(number_of_grid_cells);
+    AllocateWorkspaces();
+  }
+
+  template<template<class> class MatrixPolicy>
+  inline void RosenbrockSolver<MatrixPolicy>::AllocateWorkspaces()
+  {
+    // the grid cells are divided as evenly as possible among the chunks
+    const std::size_t number_of_chunks = std::min(parameters_.number_of_threads_, parameters_.number_of_grid_cells_);
+    chunk_workspaces_.clear();
+    if (number_of_chunks > 1)
+    {
+      workspace_ = RosenbrockWorkspace<MatrixPolicy>();
+      chunk_workspaces_.reserve(number_of_chunks);
+      for (std::size_t i_chunk = 0; i_chunk < number_of_chunks; ++i_chunk)
+      {
+        std::size_t number_of_cells = parameters_.number_of_grid_cells_ / number_of_chunks +
+                                      (i_chunk < parameters_.number_of_grid_cells_ % number_of_chunks ? 1 : 0);
+        chunk_workspaces_.push_back(RosenbrockWorkspace<MatrixPolicy>(
+            number_of_cells,
+            integrated_species_ids_.size(),
+            parameters_.stages_,
+            BuildJacobian(number_of_cells),
+            processes_.size(),
+            parameters_.gmres_linear_solver_,
+            parameters_.mixed_precision_linear_solver_,
+            parameters_.gather_forcing_ ? processes_.size() : 0,
+            0,
+            parameters_.gmres_parameters_));
+      }
+      return;
+    }
+    workspace_ = RosenbrockWorkspace<MatrixPolicy>(
+        parameters_.number_of_grid_cells_,
+        integrated_species_ids_.size(),
+        parameters_.stages_,
+        BuildJacobian(parameters_.number_of_grid_cells_),
+        0,
+        parameters_.gmres_linear_solver_,
+        parameters_.mixed_precision_linear_solver_,
+        parameters_.gather_forcing_ ? processes_.size() : 0,
+        integrated_species_ids_.size() != system_.StateSize() ? system_.StateSize() : 0,
+        parameters_.gmres_parameters_);
+  }
+
+  template<template<class> class MatrixPolicy>
+  template<RosenbrockTableau Tableau, class StepSize>
+  inline void RosenbrockSolver<MatrixPolicy>::ComputeStages(
+      const StepSize& H,
+      const MatrixPolicy<double>& rate_constants,
+      RosenbrockWorkspace<MatrixPolicy>& workspace,
+      Solver::Rosenbrock_stats& stats,
+      const std::vector<bool>& is_active) const
+  {
+    // the first stage (stage 0), which always uses the initial forcing
+    LinearSolve(workspace.initial_forcing_, workspace.K_[0], workspace, stats, is_active);
+
+    // stages (1-# of stages), unrolled at compile time
+    [&]<std::size_t... stage>(std::index_sequence<stage...>)
+    {
+      (ComputeStage<Tableau, stage + 1>(H, rate_constants, workspace, stats, is_active), ...);
+    }(std::make_index_sequence<Tableau::stages_ - 1>{});
+  }
+
+  template<template<class> class MatrixPolicy>
+  template<RosenbrockTableau Tableau, std::size_t stage, class StepSize>
+  inline void RosenbrockSolver<MatrixPolicy>::ComputeStage(
+      const StepSize& H,
+      const MatrixPolicy<double>& rate_constants,
+      RosenbrockWorkspace<MatrixPolicy>& workspace,
+      Solver::Rosenbrock_stats& stats,
+      const std::vector<bool>& is_active) const
+  {
+    constexpr std::size_t stage_combinations = stage * (stage - 1) / 2;
+    auto& K = workspace.K_;
+    const auto& stage_forcing = UsesInitialForcing<Tableau>(stage) ? workspace.initial_forcing_ : workspace.forcing_;
+
+    if constexpr (std::is_same_v<StepSize, double>)
+    {
+      if constexpr (Tableau::new_function_evaluation_[stage])
+      {
+        auto& Ynew_vector = workspace.Ynew_.AsVector();
+        std::copy(workspace.Y_.AsVector().begin(), workspace.Y_.AsVector().end(), Ynew_vector.begin());
+        [&]<std::size_t... j>(std::index_sequence<j...>)
+        {
+          (AddScaled<Tableau::a_[stage_combinations + j]>(K[j].AsVector(), Ynew_vector), ...);
+        }(std::make_index_sequence<stage>{});
+        CalculateForcing(rate_constants, workspace.Ynew_, workspace.forcing_, workspace.reaction_rates_, stats);
+      }
+
+      std::copy(stage_forcing.AsVector().begin(), stage_forcing.AsVector().end(), K[stage].AsVector().begin());
+      [&]<std::size_t... j>(std::index_sequence<j...>)
+      {
+        (AddStepScaled<Tableau::c_[stage_combinations + j]>(K[j], H, K[stage]), ...);
+      }(std::make_index_sequence<stage>{});
+      LinearSolve(K[stage], K[stage], workspace, stats);
+    }
+    else
+    {
+      // with one step size per grid cell, only the active grid cells are computed (see IntegratePerCell)
+      const std::size_t number_of_species = integrated_species_ids_.size();
+      if constexpr (Tableau::new_function_evaluation_[stage])
+      {
+        for (std::size_t i_cell = 0; i_cell < workspace.Y_.size(); ++i_cell)
+        {
+          if (!IsAnyGridCellActive(is_active, i_cell))
+            continue;
+          auto Y_cell = workspace.Y_[i_cell];
+          auto Ynew_cell = workspace.Ynew_[i_cell];
+          for (std::size_t i_species = 0; i_species < number_of_species; ++i_species)
+            Ynew_cell[i_species] = Y_cell[i_species];
+          [&]<std::size_t... j>(std::index_sequence<j...>)
+          {
+            (
+                [&]
+                {
+                  if constexpr (Tableau::a_[stage_combinations + j] != 0.0)
+                  {
+                    auto K_cell = K[j][i_cell];
+                    for (std::size_t i_species = 0; i_species < number_of_species; ++i_species)
+                      Ynew_cell[i_species] += Tableau::a_[stage_combinations + j] * K_cell[i_species];
+                  }
+                }(),
+                ...);
+          }(std::make_index_sequence<stage>{});
+        }
+        CalculateForcing(
+            rate_constants, workspace.Ynew_, workspace.forcing_, workspace.reaction_rates_, stats, is_active);
+      }
+
+      for (std::size_t i_cell = 0; i_cell < K[stage].size(); ++i_cell)
+      {
+        if (!IsAnyGridCellActive(is_active, i_cell))
+          continue;
+        auto forcing_cell = stage_forcing[i_cell];
+        auto K_cell = K[stage][i_cell];
+        for (std::size_t i_species = 0; i_species < number_of_species; ++i_species)
+          K_cell[i_species] = forcing_cell[i_species];
+      }
+      [&]<std::size_t... j>(std::index_sequence<j...>)
+      {
+        (AddStepScaled<Tableau::c_[stage_combinations + j]>(K[j], H, K[stage], is_active), ...);
+      }(std::make_index_sequence<stage>{});
+      LinearSolve(K[stage], K[stage], workspace, stats, is_active);
+    }
+  }
+
+  template<template<class> class MatrixPolicy>
+  template<RosenbrockTableau Tableau>
+  inline void RosenbrockSolver<MatrixPolicy>::ComputeSolutionAndError(RosenbrockWorkspace<MatrixPolicy>& workspace)
+  {
+    auto& Ynew_vector = workspace.Ynew_.AsVector();
+    auto& Yerror_vector = workspace.Yerror_.AsVector();
+    std::copy(workspace.Y_.AsVector().begin(), workspace.Y_.AsVector().end(), Ynew_vector.begin());
+    std::fill(Yerror_vector.begin(), Yerror_vector.end(), 0.0);
+    [&]<std::size_t... stage>(std::index_sequence<stage...>)
+    {
+      (AddScaled<Tableau::m_[stage]>(workspace.K_[stage].AsVector(), Ynew_vector), ...);
+      (AddScaled<Tableau::e_[stage]>(workspace.K_[stage].AsVector(), Yerror_vector), ...);
+    }(std::make_index_sequence<Tableau::stages_>{});
+  }
+
+  template<template<class> class MatrixPolicy>
+  template<RosenbrockTableau Tableau>
+  inline void RosenbrockSolver<MatrixPolicy>::ComputeSolutionAndError(
+      RosenbrockWorkspace<MatrixPolicy>& workspace,
+      const std::vector<bool>& is_active) const
+  {
+    const std::size_t number_of_species = integrated_species_ids_.size();
+    for (std::size_t i_cell = 0; i_cell < workspace.Y_.size(); ++i_cell)
+    {
+      if (!is_active[i_cell])
+        continue;
+      auto Y_cell = workspace.Y_[i_cell];
+      auto Ynew_cell = workspace.Ynew_[i_cell];
+      auto Yerror_cell = workspace.Yerror_[i_cell];
+      for (std::size_t i_species = 0; i_species < number_of_species; ++i_species)
+      {
+        Ynew_cell[i_species] = Y_cell[i_species];
+        Yerror_cell[i_species] = 0.0;
+      }
+      // the terms with zero coefficients are skipped at compile time
+      [&]<std::size_t... stage>(std::index_sequence<stage...>)
+      {
+        (
+            [&]
+            {
+              auto K_cell = workspace.K_[stage][i_cell];
+              for (std::size_t i_species = 0; i_species < number_of_species; ++i_species)
+              {
+                if constexpr (Tableau::m_[stage] != 0.0)
+                  Ynew_cell[i_species] += Tableau::m_[stage] * K_cell[i_species];
+                if constexpr (Tableau::e_[stage] != 0.0)
+                  Yerror_cell[i_species] += Tableau::e_[stage] * K_cell[i_species];
+              }
+            }(),
+            ...);
+      }(std::make_index_sequence<Tableau::stages_>{});
+    }
+  }
+
+  template<template<class> class MatrixPolicy>
+  template<double coefficient>
+  inline void RosenbrockSolver<MatrixPolicy>::AddScaled(const std::vector<double>& x, std::vector<double>& y)
+  {
+    if constexpr (coefficient != 0.0)
+    {
+      for (std::size_t idx = 0; idx < y.size(); ++idx)
+      {
+        y[idx] += coefficient * x[idx];
+      }
+    }
+  }
+
+  template<template<class> class MatrixPolicy>
+  template<double coefficient>
+  inline void
+  RosenbrockSolver<MatrixPolicy>::AddStepScaled(const MatrixPolicy<double>& x, const double& H, MatrixPolicy<double>& y)
+  {
+    if constexpr (coefficient != 0.0)
+    {
+      const double HC = coefficient / H;
+      const auto& x_vector = x.AsVector();
+      auto& y_vector = y.AsVector();
+      for (std::size_t idx = 0; idx < y_vector.size(); ++idx)
+      {
+        y_vector[idx] += HC * x_vector[idx];
+      }
+    }
+  }
+
+  template<template<class> class MatrixPolicy>
+  template<double coefficient>
+  inline void RosenbrockSolver<MatrixPolicy>::AddStepScaled(
+      const MatrixPolicy<double>& x,
+      const std::vector<double>& H,
+      MatrixPolicy<double>& y,
+      const std::vector<bool>& is_active) const
+  {
+    if constexpr (coefficient != 0.0)
+    {
+      const std::size_t number_of_species = integrated_species_ids_.size();
+      for (std::size_t i_cell = 0; i_cell < y.size(); ++i_cell)
+      {
+        if (!IsAnyGridCellActive(is_active, i_cell))
+          continue;
+        const double HC = coefficient / H[i_cell];
+        auto x_cell = x[i_cell];
+        auto y_cell = y[i_cell];
+        for (std::size_t i_species = 0; i_species < number_of_species; ++i_species)
+        {
+          y_cell[i_species] += HC * x_cell[i_species];
+        }
+      }
+    }
+  }
+
   template<template<class> class MatrixPolicy>
   inline std::vector<std::string> RosenbrockSolver<MatrixPolicy>::reaction_names()
   {
@@ -454,64 +1585,200 @@ namespace micm
       const MatrixPolicy<double>& number_densities,
       MatrixPolicy<double>& forcing)
   {
+    // the reaction rates are only stored with gather_forcing_, and are kept in the workspace between calls
+    if (parameters_.gather_forcing_ && workspace_.reaction_rates_.size() != rate_constants.size())
+      workspace_.reaction_rates_ = MatrixPolicy<double>(rate_constants.size(), processes_.size(), 0.0);
+    CalculateForcing(rate_constants, number_densities, forcing, workspace_.reaction_rates_, stats_);
+  }
+
+  template<template<class> class MatrixPolicy>
+  inline void RosenbrockSolver<MatrixPolicy>::CalculateForcing(
+      const MatrixPolicy<double>& rate_constants,
+      const MatrixPolicy<double>& number_densities,
+      MatrixPolicy<double>& forcing,
+      MatrixPolicy<double>& reaction_rates,
+      Solver::Rosenbrock_stats& stats,
+      const std::vector<bool>& is_active) const
+  {
+    MICM_TIME_PHASE(stats.timing.forcing);
     std::fill(forcing.AsVector().begin(), forcing.AsVector().end(), 0.0);
-    process_set_.AddForcingTerms(rate_constants, number_densities, forcing);
-    stats_.function_calls += 1;
+    if (compiled_kernels_.IsLoaded())
+      compiled_kernels_.AddForcingTerms(
+          rate_constants.AsVector().data(), number_densities.AsVector().data(), forcing.AsVector().data(), forcing.size());
+    else if (parameters_.gather_forcing_)
+      process_set_.template AddForcingTermsByGather<MatrixPolicy>(
+          rate_constants, number_densities, forcing, reaction_rates, is_active);
+    else
+      process_set_.template AddForcingTerms<MatrixPolicy>(rate_constants, number_densities, forcing, is_active);
+    stats.function_calls += 1;
   }
 
   template<template<class> class MatrixPolicy>
-  inline std::vector<double> RosenbrockSolver<MatrixPolicy>::factored_alpha_minus_jac(
-      const std::vector<double>& dforce_dy,
-      const double& alpha)
+  inline void RosenbrockSolver<MatrixPolicy>::AlphaMinusJacobian(
+      const SparseMatrix<double, SparseMatrixOrdering>& jacobian,
+      const double& alpha,
+      SparseMatrix<double, SparseMatrixOrdering>& alpha_minus_jacobian) const
+      requires(!VectorizableSparse<SparseMatrix<double, SparseMatrixOrdering>>)
   {
-    std::vector<double> jacobian(23); // TODO - remove hard-coded Chapman dimensions
+    const auto& jacobian_vector = jacobian.AsVector();
+    auto& alpha_minus_jacobian_vector = alpha_minus_jacobian.AsVector();
+    for (std::size_t i_elem = 0; i_elem < jacobian_vector.size(); ++i_elem)
+      alpha_minus_jacobian_vector[i_elem] = -jacobian_vector[i_elem];
+    for (std::size_t i_block = 0; i_block < alpha_minus_jacobian.size(); ++i_block)
+    {
+      auto block_vector =
+          std::next(alpha_minus_jacobian_vector.begin(), i_block * alpha_minus_jacobian.FlatBlockSize());
+      for (const auto& i_elem : jacobian_diagonal_elements_)
+        block_vector[i_elem] += alpha;
+    }
+  }
 
-    factor(jacobian);
-    return jacobian;
+  template<template<class> class MatrixPolicy>
+  inline void RosenbrockSolver<MatrixPolicy>::AlphaMinusJacobian(
+      const SparseMatrix<double, SparseMatrixOrdering>& jacobian,
+      const double& alpha,
+      SparseMatrix<double, SparseMatrixOrdering>& alpha_minus_jacobian) const
+      requires VectorizableSparse<SparseMatrix<double, SparseMatrixOrdering>>
+  {
+    constexpr std::size_t L = SparseMatrixOrdering::GroupVectorSize();
+    const auto& jacobian_vector = jacobian.AsVector();
+    auto& alpha_minus_jacobian_vector = alpha_minus_jacobian.AsVector();
+    for (std::size_t i_elem = 0; i_elem < jacobian_vector.size(); ++i_elem)
+      alpha_minus_jacobian_vector[i_elem] = -jacobian_vector[i_elem];
+    // the padding blocks of the last group are also given alpha * I, so they are never singular
+    const std::size_t group_size = L * alpha_minus_jacobian.FlatBlockSize();
+    for (std::size_t i_group = 0; i_group * group_size < alpha_minus_jacobian_vector.size(); ++i_group)
+    {
+      auto group_vector = std::next(alpha_minus_jacobian_vector.begin(), i_group * group_size);
+      for (const auto& i_elem : jacobian_diagonal_elements_)
+        for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+          group_vector[i_elem + i_cell] += alpha;
+    }
   }
 
   template<template<class> class MatrixPolicy>
-  inline void RosenbrockSolver<MatrixPolicy>::dforce_dy(
-      const MatrixPolicy<double>& rate_constants,
-      const MatrixPolicy<double>& number_densities,
-      SparseMatrix<double>& jacobian)
+  inline void RosenbrockSolver<MatrixPolicy>::AlphaMinusJacobian(
+      const SparseMatrix<double, SparseMatrixOrdering>& jacobian,
+      const std::vector<double>& alpha,
+      SparseMatrix<double, SparseMatrixOrdering>& alpha_minus_jacobian,
+      const std::vector<bool>& is_active) const
+      requires(!VectorizableSparse<SparseMatrix<double, SparseMatrixOrdering>>)
   {
-    std::fill(jacobian.AsVector().begin(), jacobian.AsVector().end(), 0.0);
-    process_set_.AddJacobianTerms(rate_constants, number_densities, jacobian);
-    stats_.jacobian_updates += 1;
+    const std::size_t block_size = alpha_minus_jacobian.FlatBlockSize();
+    for (std::size_t i_block = 0; i_block < alpha_minus_jacobian.size(); ++i_block)
+    {
+      if (!IsAnyGridCellActive(is_active, i_block))
+        continue;
+      auto jacobian_vector = std::next(jacobian.AsVector().begin(), i_block * block_size);
+      auto block_vector = std::next(alpha_minus_jacobian.AsVector().begin(), i_block * block_size);
+      for (std::size_t i_elem = 0; i_elem < block_size; ++i_elem)
+        block_vector[i_elem] = -jacobian_vector[i_elem];
+      for (const auto& i_elem : jacobian_diagonal_elements_)
+        block_vector[i_elem] += alpha[i_block];
+    }
   }
 
   template<template<class> class MatrixPolicy>
-  inline void RosenbrockSolver<MatrixPolicy>::factor(std::vector<double>& jacobian)
+  inline void RosenbrockSolver<MatrixPolicy>::AlphaMinusJacobian(
+      const SparseMatrix<double, SparseMatrixOrdering>& jacobian,
+      const std::vector<double>& alpha,
+      SparseMatrix<double, SparseMatrixOrdering>& alpha_minus_jacobian,
+      const std::vector<bool>& is_active) const
+      requires VectorizableSparse<SparseMatrix<double, SparseMatrixOrdering>>
   {
+    constexpr std::size_t L = SparseMatrixOrdering::GroupVectorSize();
+    // the padding blocks of the last group take the alpha of the first block of the group, so they are never singular
+    const std::size_t group_size = L * alpha_minus_jacobian.FlatBlockSize();
+    for (std::size_t i_group = 0; i_group * L < alpha_minus_jacobian.size(); ++i_group)
+    {
+      if (!IsAnyGridCellActive(is_active, i_group * L, L))
+        continue;
+      auto jacobian_vector = std::next(jacobian.AsVector().begin(), i_group * group_size);
+      auto group_vector = std::next(alpha_minus_jacobian.AsVector().begin(), i_group * group_size);
+      for (std::size_t i_elem = 0; i_elem < group_size; ++i_elem)
+        group_vector[i_elem] = -jacobian_vector[i_elem];
+      double group_alpha[L];
+      for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+        group_alpha[i_cell] = alpha[i_group * L + i_cell < alpha.size() ? i_group * L + i_cell : i_group * L];
+      for (const auto& i_elem : jacobian_diagonal_elements_)
+        for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+          group_vector[i_elem + i_cell] += group_alpha[i_cell];
+    }
   }
 
   template<template<class> class MatrixPolicy>
-  inline std::vector<double> RosenbrockSolver<MatrixPolicy>::dforce_dy_times_vector(
-      const std::vector<double>& dforce_dy,
-      const std::vector<double>& vector)
+  inline void RosenbrockSolver<MatrixPolicy>::dforce_dy(
+      const MatrixPolicy<double>& rate_constants,
+      const MatrixPolicy<double>& number_densities,
+      SparseMatrix<double, SparseMatrixOrdering>& jacobian)
   {
-    std::vector<double> result(dforce_dy.size(), 0);
+    CalculateJacobian(rate_constants, number_densities, jacobian, stats_);
+  }
 
-    return result;
+  template<template<class> class MatrixPolicy>
+  inline void RosenbrockSolver<MatrixPolicy>::CalculateJacobian(
+      const MatrixPolicy<double>& rate_constants,
+      const MatrixPolicy<double>& number_densities,
+      SparseMatrix<double, SparseMatrixOrdering>& jacobian,
+      Solver::Rosenbrock_stats& stats,
+      const std::vector<bool>& is_active) const
+  {
+    MICM_TIME_PHASE(stats.timing.jacobian);
+    std::fill(jacobian.AsVector().begin(), jacobian.AsVector().end(), 0.0);
+    if (compiled_kernels_.IsLoaded())
+      compiled_kernels_.AddJacobianTerms(
+          rate_constants.AsVector().data(), number_densities.AsVector().data(), jacobian.AsVector().data(), jacobian.size());
+    else
+      process_set_.template AddJacobianTerms<MatrixPolicy>(rate_constants, number_densities, jacobian, is_active);
+    stats.jacobian_updates += 1;
   }
 
   template<template<class> class MatrixPolicy>
-  inline std::vector<double> RosenbrockSolver<MatrixPolicy>::backsolve_L_y_eq_b(
-      const std::vector<double>& jacobian,
-      const std::vector<double>& b)
+  inline void RosenbrockSolver<MatrixPolicy>::CalculateForcingAndJacobian(
+      const MatrixPolicy<double>& rate_constants,
+      const MatrixPolicy<double>& number_densities,
+      MatrixPolicy<double>& forcing,
+      MatrixPolicy<double>& reaction_rates,
+      SparseMatrix<double, SparseMatrixOrdering>& jacobian,
+      Solver::Rosenbrock_stats& stats,
+      const std::vector<bool>& is_active) const
   {
-    std::vector<double> y(parameters_.N_, 0);
-    return y;
+    // the compiled kernels and the species-major forcing have no fused variant
+    if (compiled_kernels_.IsLoaded() || parameters_.gather_forcing_)
+    {
+      CalculateForcing(rate_constants, number_densities, forcing, reaction_rates, stats, is_active);
+      CalculateJacobian(rate_constants, number_densities, jacobian, stats, is_active);
+      return;
+    }
+    {
+      // the fused evaluation is timed as part of the Jacobian phase
+      MICM_TIME_PHASE(stats.timing.jacobian);
+      std::fill(forcing.AsVector().begin(), forcing.AsVector().end(), 0.0);
+      std::fill(jacobian.AsVector().begin(), jacobian.AsVector().end(), 0.0);
+      process_set_.template AddForcingAndJacobianTerms<MatrixPolicy>(
+          rate_constants, number_densities, forcing, jacobian, is_active);
+    }
+    stats.function_calls += 1;
+    stats.jacobian_updates += 1;
   }
 
   template<template<class> class MatrixPolicy>
-  inline std::vector<double> RosenbrockSolver<MatrixPolicy>::backsolve_U_x_eq_b(
-      const std::vector<double>& jacobian,
-      const std::vector<double>& y)
+  inline std::vector<double> RosenbrockSolver<MatrixPolicy>::dforce_dy_times_vector(
+      const std::vector<double>& dforce_dy,
+      const std::vector<double>& vector)
   {
-    std::vector<double> x(y.size(), 0);
-    return x;
+    if (dforce_dy.size() != cell_jacobian_.FlatBlockSize())
+      throw std::invalid_argument("Jacobian size must match one grid cell block of the solver Jacobian");
+    if (vector.size() != integrated_species_ids_.size())
+      throw std::invalid_argument("Vector size must match the number of integrated species");
+    // the product is for a single grid cell, so it uses the standard ordering whatever the MatrixPolicy, and
+    // only the values of the Jacobian built with the solver are replaced
+    cell_jacobian_.AsVector() = dforce_dy;
+    Matrix<double> x(1, vector.size(), 0.0);
+    Matrix<double> product(1, vector.size(), 0.0);
+    x[0] = vector;
+    SparseMatrixVectorProduct<Matrix>(cell_jacobian_, x, product, species_order_);
+    return product.AsVector();
   }
 
   template<template<class> class MatrixPolicy>
@@ -524,84 +1791,40 @@ namespace micm
     // Benchmarking stiff ode solvers for atmospheric chemistry problems II: Rosenbrock solvers.
     // Atmospheric Environment 31, 3459–3472. https://doi.org/10.1016/S1352-2310(97)83212-8
 
-    parameters_.stages_ = 3;
-    parameters_.N_ = system_.StateSize() * parameters_.number_of_grid_cells_;
-
-    //  The coefficient matrices A and C are strictly lower triangular.
-    //  The lower triangular (subdiagonal) elements are stored in row-wise order:
-    //  A(2,1) = ros_A(1), A(3,1)=ros_A(2), A(3,2)=ros_A(3), etc.
-    //  The general mapping formula is:
-    //      A(i,j) = ros_A( (i-1)*(i-2)/2 + j )
-    //      C(i,j) = ros_C( (i-1)*(i-2)/2 + j )
-
-    parameters_.a_.fill(0);
-    parameters_.a_[0] = 1;
-    parameters_.a_[1] = 1;
-    parameters_.a_[2] = 0;
-
-    parameters_.c_.fill(0);
-    parameters_.c_[0] = -0.10156171083877702091975600115545e+01;
-    parameters_.c_[1] = 0.40759956452537699824805835358067e+01;
-    parameters_.c_[2] = 0.92076794298330791242156818474003e+01;
-
-    // Does the stage i require a new function evaluation (ros_NewF(i)=TRUE)
-    // or does it re-use the function evaluation from stage i-1 (ros_NewF(i)=FALSE)
-    parameters_.new_function_evaluation_.fill(false);
-    parameters_.new_function_evaluation_[0] = true;
-    parameters_.new_function_evaluation_[1] = true;
-    parameters_.new_function_evaluation_[2] = false;
-
-    // Coefficients for new step solution
-    parameters_.m_.fill(0);
-    parameters_.m_[0] = 0.1e+01;
-    parameters_.m_[1] = 0.61697947043828245592553615689730e+01;
-    parameters_.m_[2] = -0.42772256543218573326238373806514;
-
-    // Coefficients for error estimator
-    parameters_.e_.fill(0);
-    parameters_.e_[0] = 0.5;
-    parameters_.e_[1] = -0.29079558716805469821718236208017e+01;
-    parameters_.e_[2] = 0.22354069897811569627360909276199;
-
-    // ros_ELO = estimator of local order - the minimum between the
-    // main and the embedded scheme orders plus 1
-    parameters_.estimator_of_local_order_ = 3;
-
-    // Y_stage_i ~ Y( T + H*Alpha_i )
-    parameters_.alpha_.fill(0);
-    parameters_.alpha_[0] = 0;
-    parameters_.alpha_[1] = 0.43586652150845899941601945119356;
-    parameters_.alpha_[2] = 0.43586652150845899941601945119356;
-
-    // Gamma_i = \sum_j  gamma_{i,j}
-    parameters_.gamma_.fill(0);
-    parameters_.gamma_[0] = 0.43586652150845899941601945119356;
-    parameters_.gamma_[1] = 0.24291996454816804366592249683314;
-    parameters_.gamma_[2] = 0.21851380027664058511513169485832e+01;
+    parameters_.N_ = integrated_species_ids_.size() * parameters_.number_of_grid_cells_;
+    SetTableau<Ros3Tableau>();
   }
 
   template<template<class> class MatrixPolicy>
   inline void RosenbrockSolver<MatrixPolicy>::UpdateState(State<MatrixPolicy>& state)
   {
+    MICM_TIME_PHASE(update_rate_constants_time_);
     Process::UpdateState(processes_, state);
+    for (std::size_t i_cell = 0; i_cell < state.rate_constants_.size(); ++i_cell)
+    {
+      auto rate_constants_cell = state.rate_constants_[i_cell];
+      auto variables_cell = state.variables_[i_cell];
+      for (const auto& reactant : constant_reactants_)
+        rate_constants_cell[reactant.first] *= variables_cell[reactant.second];
+    }
   }
 
   template<template<class> class MatrixPolicy>
-  inline std::vector<double> RosenbrockSolver<MatrixPolicy>::lin_factor(
+  inline void RosenbrockSolver<MatrixPolicy>::lin_factor(double& H, const double& gamma, bool& singular)
+  {
+    FactorAlphaMinusJacobian(H, gamma, singular, workspace_, stats_);
+  }
+
+  template<template<class> class MatrixPolicy>
+  inline void RosenbrockSolver<MatrixPolicy>::FactorAlphaMinusJacobian(
       double& H,
       const double& gamma,
       bool& singular,
-      const MatrixPolicy<double>& number_densities,
-      const MatrixPolicy<double>& rate_constants)
+      RosenbrockWorkspace<MatrixPolicy>& workspace,
+      Solver::Rosenbrock_stats& stats) const
   {
-    /*
-    TODO: invesitage this function. The fortran equivalent appears to have a bug.
-
-    From my understanding the fortran do loop would only ever do one iteration and is equivalent to what's below
-    */
-
-    // std::function<bool(const std::vector<double>)> is_successful = [](const std::vector<double>& jacobian) { return true; };
-    std::vector<double> ode_jacobian;
+    // All grid cells share H, so H is halved (up to 5 times in a row) until no grid cell has a singular pivot.
+    // With per-cell step control, only the singular grid cells take a smaller step (see IntegratePerCell).
     uint64_t n_consecutive = 0;
     singular = true;
 
@@ -609,18 +1832,21 @@ namespace micm
     {
       double alpha = 1 / (H * gamma);
       // compute jacobian decomposition of alpha*I - dforce_dy
-      dforce_dy(rate_constants, number_densities, jacobian_);
-      ode_jacobian = factored_alpha_minus_jac(jacobian_.AsVector(), alpha);
-      stats_.decompositions += 1;
+      {
+        MICM_TIME_PHASE(stats.timing.decomposition);
+        AlphaMinusJacobian(workspace.jacobian_, alpha, workspace.alpha_minus_jacobian_);
+        FactorWorkspace(workspace);
+      }
+      stats.decompositions += 1;
 
-      if (true) // is_successful(ode_jacobian)) // commented out because nvidia can't handle this
+      if (!FindSingularCells(workspace, alpha))
       {
         singular = false;
         break;
       }
       else
       {
-        stats_.singular += 1;
+        stats.singular += 1;
         n_consecutive += 1;
 
         if (n_consecutive <= 5)
@@ -633,44 +1859,189 @@ namespace micm
         }
       }
     }
+  }
 
-    return ode_jacobian;
+  template<template<class> class MatrixPolicy>
+  inline void RosenbrockSolver<MatrixPolicy>::lin_solve(const MatrixPolicy<double>& b, MatrixPolicy<double>& x)
+  {
+    LinearSolve(b, x, workspace_, stats_);
   }
 
   template<template<class> class MatrixPolicy>
-  inline std::vector<double> RosenbrockSolver<MatrixPolicy>::lin_solve(const std::vector<double>& K, const std::vector<double>& jacobian)
+  inline void RosenbrockSolver<MatrixPolicy>::FactorWorkspace(
+      RosenbrockWorkspace<MatrixPolicy>& workspace,
+      const std::vector<bool>& is_active) const
   {
-    auto y = backsolve_L_y_eq_b(jacobian, K);
-    auto x = backsolve_U_x_eq_b(jacobian, y);
-    stats_.solves += 1;
-    return x;
+    if (parameters_.gmres_linear_solver_)
+      gmres_linear_solver_.Factor(
+          workspace.alpha_minus_jacobian_, workspace.lower_matrix_, workspace.upper_matrix_, is_active);
+    else if (parameters_.mixed_precision_linear_solver_)
+      mixed_precision_linear_solver_.Factor(
+          workspace.alpha_minus_jacobian_, workspace.float_lower_matrix_, workspace.float_upper_matrix_, is_active);
+    else if (compiled_kernels_.IsLoaded())
+      compiled_kernels_.Decompose(
+          workspace.alpha_minus_jacobian_.AsVector().data(),
+          workspace.lower_matrix_.AsVector().data(),
+          workspace.upper_matrix_.AsVector().data(),
+          workspace.alpha_minus_jacobian_.size());
+    else
+      linear_solver_.Factor(workspace.alpha_minus_jacobian_, workspace.lower_matrix_, workspace.upper_matrix_, is_active);
   }
 
   template<template<class> class MatrixPolicy>
-  inline double RosenbrockSolver<MatrixPolicy>::error_norm(std::vector<double> Y, std::vector<double> Ynew, std::vector<double> errors)
+  template<class Alpha>
+  inline bool RosenbrockSolver<MatrixPolicy>::FindSingularCells(
+      RosenbrockWorkspace<MatrixPolicy>& workspace,
+      const Alpha& alpha) const
   {
-    // Solving Ordinary Differential Equations II, page 123
-    // https://link-springer-com.cuucar.idm.oclc.org/book/10.1007/978-3-642-05221-7
-    std::vector<double> maxs(Y.size());
-    std::vector<double> scale(Y.size());
+    // float factors have a much larger rounding error than the double factors the tolerance is set for
+    const bool float_factors = parameters_.mixed_precision_linear_solver_ && !parameters_.gmres_linear_solver_;
+    const double epsilon_ratio =
+        static_cast<double>(std::numeric_limits<float>::epsilon()) / std::numeric_limits<double>::epsilon();
+    const double pivot_tolerance = parameters_.pivot_tolerance_ * (float_factors ? epsilon_ratio : 1.0);
+    auto& tolerance = workspace.pivot_tolerance_;
+    for (std::size_t i_cell = 0; i_cell < tolerance.size(); ++i_cell)
+    {
+      if constexpr (std::is_same_v<Alpha, double>)
+        tolerance[i_cell] = pivot_tolerance * std::abs(alpha);
+      else
+        tolerance[i_cell] = pivot_tolerance * std::abs(alpha[i_cell]);
+    }
+    if (float_factors)
+      return LuDecomposition::FindSingularBlocks(workspace.float_upper_matrix_, tolerance, workspace.is_singular_);
+    return LuDecomposition::FindSingularBlocks(workspace.upper_matrix_, tolerance, workspace.is_singular_);
+  }
 
-    for (uint64_t idx = 0; idx < Y.size(); ++idx)
+  template<template<class> class MatrixPolicy>
+  inline void RosenbrockSolver<MatrixPolicy>::LinearSolve(
+      const MatrixPolicy<double>& b,
+      MatrixPolicy<double>& x,
+      RosenbrockWorkspace<MatrixPolicy>& workspace,
+      Solver::Rosenbrock_stats& stats,
+      const std::vector<bool>& is_active) const
+  {
+    MICM_TIME_PHASE(stats.timing.solve);
+    if (parameters_.gmres_linear_solver_)
     {
-      maxs[idx] = std::max(std::abs(Y[idx]), std::abs(Ynew[idx]));
+      gmres_linear_solver_.template Solve<MatrixPolicy>(
+          b, x, workspace.alpha_minus_jacobian_, workspace.lower_matrix_, workspace.upper_matrix_, workspace.gmres_workspace_);
+      if (!workspace.gmres_workspace_.IsConverged())
+        stats.unconverged_solves += 1;
     }
+    else if (parameters_.mixed_precision_linear_solver_)
+      mixed_precision_linear_solver_.template Solve<MatrixPolicy>(
+          b,
+          x,
+          workspace.alpha_minus_jacobian_,
+          workspace.float_lower_matrix_,
+          workspace.float_upper_matrix_,
+          workspace.mixed_precision_workspace_);
+    else if (compiled_kernels_.IsLoaded())
+      compiled_kernels_.Solve(
+          b.AsVector().data(),
+          x.AsVector().data(),
+          workspace.lower_matrix_.AsVector().data(),
+          workspace.upper_matrix_.AsVector().data(),
+          b.size());
+    else
+      linear_solver_.template Solve<MatrixPolicy>(b, x, workspace.lower_matrix_, workspace.upper_matrix_, is_active);
+    stats.solves += 1;
+  }
 
-    for (uint64_t idx = 0; idx < Y.size(); ++idx)
+  template<template<class> class MatrixPolicy>
+  inline double RosenbrockSolver<MatrixPolicy>::ErrorNorm(
+      const MatrixPolicy<double>& Y,
+      const MatrixPolicy<double>& Ynew,
+      const MatrixPolicy<double>& errors) const requires(!Vectorizable<MatrixPolicy<double>>)
+  {
+    // Solving Ordinary Differential Equations II, page 123
+    const std::size_t number_of_species = absolute_tolerances_.size();
+    const double* y = Y.AsVector().data();
+    const double* y_new = Ynew.AsVector().data();
+    const double* error = errors.AsVector().data();
+    const double* tolerance = absolute_tolerances_.data();
+    double sum = 0;
+    for (std::size_t i_cell = 0; i_cell < Y.size(); ++i_cell)
     {
-      scale[idx] = parameters_.absolute_tolerance_ + parameters_.relative_tolerance_ * maxs[idx];
+      for (std::size_t i_species = 0; i_species < number_of_species; ++i_species)
+      {
+        double scale = tolerance[i_species] +
+                       parameters_.relative_tolerance_ * std::max(std::abs(y[i_species]), std::abs(y_new[i_species]));
+        double ratio = error[i_species] / scale;
+        sum += ratio * ratio;
+      }
+      y += number_of_species;
+      y_new += number_of_species;
+      error += number_of_species;
     }
 
+    double error_min_ = 1.0e-10;
+    return std::max(std::sqrt(sum / (Y.size() * number_of_species)), error_min_);
+  }
+
+  template<template<class> class MatrixPolicy>
+  inline double RosenbrockSolver<MatrixPolicy>::ErrorNorm(
+      const MatrixPolicy<double>& Y,
+      const MatrixPolicy<double>& Ynew,
+      const MatrixPolicy<double>& errors) const requires Vectorizable<MatrixPolicy<double>>
+  {
+    // Solving Ordinary Differential Equations II, page 123
+    const std::size_t L = Y.VectorSize();
+    const std::size_t number_of_species = absolute_tolerances_.size();
+    const double* y = Y.AsVector().data();
+    const double* y_new = Ynew.AsVector().data();
+    const double* error = errors.AsVector().data();
     double sum = 0;
-    for (uint64_t idx = 0; idx < Y.size(); ++idx)
+    for (std::size_t i_block = 0; i_block < Y.NumberOfBlocks(); ++i_block)
     {
-      sum += std::pow(errors[idx] / scale[idx], 2);
+      // the padding at the end of the last block is skipped
+      const std::size_t number_of_cells = std::min(L, Y.size() - i_block * L);
+      for (std::size_t i_species = 0; i_species < number_of_species; ++i_species)
+      {
+        const double tolerance = absolute_tolerances_[i_species];
+        for (std::size_t i_cell = 0; i_cell < number_of_cells; ++i_cell)
+        {
+          double scale =
+              tolerance + parameters_.relative_tolerance_ * std::max(std::abs(y[i_cell]), std::abs(y_new[i_cell]));
+          double ratio = error[i_cell] / scale;
+          sum += ratio * ratio;
+        }
+        y += L;
+        y_new += L;
+        error += L;
+      }
     }
 
     double error_min_ = 1.0e-10;
-    return std::max(std::sqrt(sum / parameters_.N_), error_min_);
+    return std::max(std::sqrt(sum / (Y.size() * number_of_species)), error_min_);
+  }
+
+  template<template<class> class MatrixPolicy>
+  inline void RosenbrockSolver<MatrixPolicy>::CellErrorNorms(
+      const MatrixPolicy<double>& Y,
+      const MatrixPolicy<double>& Ynew,
+      const MatrixPolicy<double>& errors,
+      const std::vector<bool>& is_active,
+      std::vector<double>& norms) const
+  {
+    const std::size_t number_of_species = absolute_tolerances_.size();
+    double error_min_ = 1.0e-10;
+    for (std::size_t i_cell = 0; i_cell < Y.size(); ++i_cell)
+    {
+      if (!is_active[i_cell])
+        continue;
+      auto Y_cell = Y[i_cell];
+      auto Ynew_cell = Ynew[i_cell];
+      auto errors_cell = errors[i_cell];
+      double sum = 0;
+      for (std::size_t i_species = 0; i_species < number_of_species; ++i_species)
+      {
+        double scale = absolute_tolerances_[i_species] +
+                       parameters_.relative_tolerance_ * std::max(std::abs(Y_cell[i_species]), std::abs(Ynew_cell[i_species]));
+        double ratio = errors_cell[i_species] / scale;
+        sum += ratio * ratio;
+      }
+      norms[i_cell] = std::max(std::sqrt(sum / number_of_species), error_min_);
+    }
   }
-}  // namespace micm
\ No newline at end of file
+}  // namespace micm
@@ -0,0 +1,228 @@
+/* Copyright (C) 2023 National Center for Atmospheric Research,
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Coefficients for the Rosenbrock methods are taken from the KPP Rosenbrock integrator, which uses the
+ * formulation described in:
+ * Sandu, A., Verwer, J.G., Blom, J.G., Spee, E.J., Carmichael, G.R., Potra, F.A., 1997. Benchmarking stiff ode solvers for
+ * atmospheric chemistry problems II: Rosenbrock solvers. Atmospheric Environment 31, 3459–3472.
+ * https://doi.org/10.1016/S1352-2310(97)83212-8
+ *
+ * The coefficient matrices A and C are strictly lower triangular. The subdiagonal elements are stored in row-wise order:
+ *   A(2,1) = a_[0], A(3,1) = a_[1], A(3,2) = a_[2], etc.
+ * The general mapping formula is:
+ *   A(i,j) = a_[ (i-1)*(i-2)/2 + j - 1 ]
+ *   C(i,j) = c_[ (i-1)*(i-2)/2 + j - 1 ]
+ */
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+
+namespace micm
+{
+
+  /// @brief A set of compile-time Rosenbrock method coefficients
+  template<class T>
+  concept RosenbrockTableau = requires {
+    { T::stages_ } -> std::convertible_to<std::size_t>;
+    { T::estimator_of_local_order_ } -> std::convertible_to<double>;
+    T::new_function_evaluation_[0];
+    T::a_[0];
+    T::c_[0];
+    T::m_[0];
+    T::e_[0];
+    T::alpha_[0];
+    T::gamma_[0];
+  };
+
+  /// @brief Returns true if the forcing used for a stage is the one evaluated at the start of the step
+  ///
+  /// Stages that do not require a new function evaluation re-use the most recent evaluation
+  template<RosenbrockTableau Tableau>
+  constexpr bool UsesInitialForcing(std::size_t stage)
+  {
+    for (std::size_t i = stage; i > 0; --i)
+      if (Tableau::new_function_evaluation_[i])
+        return false;
+    return true;
+  }
+
+  /// @brief Returns true if the method keeps its order with a Jacobian from an earlier step (a Rosenbrock-W method)
+  ///
+  /// Tableaux mark themselves as W-methods with a static constexpr bool is_w_method_ = true
+  template<RosenbrockTableau Tableau>
+  constexpr bool IsWMethod()
+  {
+    if constexpr (requires { Tableau::is_w_method_; })
+      return Tableau::is_w_method_;
+    else
+      return false;
+  }
+
+  /// @brief An L-stable method, 2 stages, order 2
+  struct Ros2Tableau
+  {
+    static constexpr double g_ = 1.0 + 1.0 / 1.41421356237309504880168872420969808;
+
+    static constexpr std::size_t stages_ = 2;
+    // the minimum between the main and the embedded scheme orders plus one
+    static constexpr double estimator_of_local_order_ = 2;
+    // which stages require a new function evaluation
+    static constexpr std::array<bool, stages_> new_function_evaluation_{ true, true };
+    static constexpr std::array<double, 1> a_{ 1.0 / g_ };
+    static constexpr std::array<double, 1> c_{ -2.0 / g_ };
+    // coefficients for the new step solution
+    static constexpr std::array<double, stages_> m_{ 3.0 / (2.0 * g_), 1.0 / (2.0 * g_) };
+    // coefficients for the error estimator
+    static constexpr std::array<double, stages_> e_{ 1.0 / (2.0 * g_), 1.0 / (2.0 * g_) };
+    // Y_stage_i ~ Y( T + H*Alpha_i )
+    static constexpr std::array<double, stages_> alpha_{ 0.0, 1.0 };
+    // Gamma_i = \sum_j  gamma_{i,j}
+    static constexpr std::array<double, stages_> gamma_{ g_, -g_ };
+  };
+
+  /// @brief An L-stable method, 3 stages, order 3, 2 function evaluations
+  struct Ros3Tableau
+  {
+    static constexpr std::size_t stages_ = 3;
+    static constexpr double estimator_of_local_order_ = 3;
+    static constexpr std::array<bool, stages_> new_function_evaluation_{ true, true, false };
+    static constexpr std::array<double, 3> a_{ 1.0, 1.0, 0.0 };
+    static constexpr std::array<double, 3> c_{ -0.10156171083877702091975600115545e+01,
+                                               0.40759956452537699824805835358067e+01,
+                                               0.92076794298330791242156818474003e+01 };
+    static constexpr std::array<double, stages_> m_{ 0.1e+01,
+                                                     0.61697947043828245592553615689730e+01,
+                                                     -0.42772256543218573326238373806514 };
+    static constexpr std::array<double, stages_> e_{ 0.5,
+                                                     -0.29079558716805469821718236208017e+01,
+                                                     0.22354069897811569627360909276199 };
+    static constexpr std::array<double, stages_> alpha_{ 0.0,
+                                                         0.43586652150845899941601945119356,
+                                                         0.43586652150845899941601945119356 };
+    static constexpr std::array<double, stages_> gamma_{ 0.43586652150845899941601945119356,
+                                                         0.24291996454816804366592249683314,
+                                                         0.21851380027664058511513169485832e+01 };
+  };
+
+  /// @brief L-stable embedded Rosenbrock method of order 4, with 4 stages and 3 function evaluations
+  ///
+  /// E. Hairer and G. Wanner, Solving Ordinary Differential Equations II: Stiff and Differential-Algebraic Problems,
+  /// 2nd edition, Springer-Verlag (1996)
+  struct Ros4Tableau
+  {
+    static constexpr std::size_t stages_ = 4;
+    static constexpr double estimator_of_local_order_ = 4;
+    static constexpr std::array<bool, stages_> new_function_evaluation_{ true, true, true, false };
+    static constexpr std::array<double, 6> a_{ 0.2000000000000000e+01, 0.1867943637803922e+01, 0.2344449711399156,
+                                               0.1867943637803922e+01, 0.2344449711399156,    0.0 };
+    static constexpr std::array<double, 6> c_{ -0.7137615036412310e+01, 0.2580708087951457e+01, 0.6515950076447975,
+                                               -0.2137148994382534e+01, -0.3214669691237626,   -0.6949742501781779 };
+    static constexpr std::array<double, stages_> m_{ 0.2255570073418735e+01,
+                                                     0.2870493262186792,
+                                                     0.4353179431840180,
+                                                     0.1093502252409163e+01 };
+    static constexpr std::array<double, stages_> e_{ -0.2815431932141155,
+                                                     -0.7276199124938920e-01,
+                                                     -0.1082196201495311,
+                                                     -0.1093502252409163e+01 };
+    static constexpr std::array<double, stages_> alpha_{ 0.0,
+                                                         0.1145640000000000e+01,
+                                                         0.6552168638155900,
+                                                         0.6552168638155900 };
+    static constexpr std::array<double, stages_> gamma_{ 0.5728200000000000,
+                                                         -0.1769193891319233e+01,
+                                                         0.7592633437920482,
+                                                         -0.1049021087100450 };
+  };
+
+  /// @brief Stiffly-stable Rosenbrock method of order 3, with 4 stages
+  ///
+  /// Sandu, A., Verwer, J.G., Van Loon, M., Carmichael, G.R., Potra, F.A., Dabdub, D., Seinfeld, J.H., 1997. Benchmarking
+  /// stiff ode solvers for atmospheric chemistry problems-I. Implicit vs explicit. Atmospheric Environment 31, 3151–3166.
+  /// https://doi.org/10.1016/S1352-2310(97)00059-9
+  struct Rodas3Tableau
+  {
+    static constexpr std::size_t stages_ = 4;
+    static constexpr double estimator_of_local_order_ = 3;
+    static constexpr std::array<bool, stages_> new_function_evaluation_{ true, false, true, true };
+    static constexpr std::array<double, 6> a_{ 0.0, 2.0, 0.0, 2.0, 0.0, 1.0 };
+    static constexpr std::array<double, 6> c_{ 4.0, 1.0, -1.0, 1.0, -1.0, -(8.0 / 3.0) };
+    static constexpr std::array<double, stages_> m_{ 2.0, 0.0, 1.0, 1.0 };
+    static constexpr std::array<double, stages_> e_{ 0.0, 0.0, 0.0, 1.0 };
+    static constexpr std::array<double, stages_> alpha_{ 0.0, 0.0, 1.0, 1.0 };
+    static constexpr std::array<double, stages_> gamma_{ 0.5, 1.5, 0.0, 0.0 };
+  };
+
+  /// @brief Stiffly-accurate Rosenbrock-W method of order 3, with 4 stages and an embedded method of order 2
+  ///
+  /// W-methods keep their order for any approximation of the Jacobian, so this is the method to use when the
+  /// Jacobian is reused across steps (see RosenbrockSolverParameters::max_jacobian_age_). The coefficients are
+  /// those of ROS34PW2, transformed to the formulation above.
+  ///
+  /// Rang, J., Angermann, L., 2005. New Rosenbrock W-methods of order 3 for partial differential algebraic equations
+  /// of index 1. BIT Numerical Mathematics 45, 761–787. https://doi.org/10.1007/s10543-005-0035-y
+  struct Ros34Pw2Tableau
+  {
+    static constexpr bool is_w_method_ = true;
+    static constexpr std::size_t stages_ = 4;
+    static constexpr double estimator_of_local_order_ = 3;
+    static constexpr std::array<bool, stages_> new_function_evaluation_{ true, true, true, true };
+    static constexpr std::array<double, 6> a_{ 2.0,
+                                               0.1419217317455765e+01,
+                                               -0.2592322116729698,
+                                               0.4184760482319161e+01,
+                                               -0.2851920173554960,
+                                               0.2294280360279042e+01 };
+    static constexpr std::array<double, 6> c_{ -0.4588560720558084e+01, -0.4184760482319161e+01, 0.2851920173554960,
+                                               -0.6368179200128360e+01, -0.6795620944466837e+01, 0.2870098604331055e+01 };
+    static constexpr std::array<double, stages_> m_{ 0.4184760482319161e+01,
+                                                     -0.2851920173554960,
+                                                     0.2294280360279042e+01,
+                                                     1.0 };
+    static constexpr std::array<double, stages_> e_{ 0.2777499476479686,
+                                                     -0.1403239895175999e+01,
+                                                     0.1772630127667551e+01,
+                                                     0.5 };
+    static constexpr std::array<double, stages_> alpha_{ 0.0, 0.8717330430169180, 0.7315799577888524, 1.0 };
+    static constexpr std::array<double, stages_> gamma_{ 0.4358665215084590, -0.4358665215084590, -0.4133333762338865, 0.0 };
+  };
+
+  /// @brief Stiffly-stable Rosenbrock method of order 4, with 6 stages
+  ///
+  /// E. Hairer and G. Wanner, Solving Ordinary Differential Equations II: Stiff and Differential-Algebraic Problems,
+  /// 2nd edition, Springer-Verlag (1996)
+  struct Rodas4Tableau
+  {
+    static constexpr std::size_t stages_ = 6;
+    static constexpr double estimator_of_local_order_ = 4;
+    static constexpr std::array<bool, stages_> new_function_evaluation_{ true, true, true, true, true, true };
+    static constexpr std::array<double, 15> a_{ 0.1544000000000000e+01,  0.9466785280815826,      0.2557011698983284,
+                                                0.3314825187068521e+01,  0.2896124015972201e+01,  0.9986419139977817,
+                                                0.1221224509226641e+01,  0.6019134481288629e+01,  0.1253708332932087e+02,
+                                                -0.6878860361058950,     0.1221224509226641e+01,  0.6019134481288629e+01,
+                                                0.1253708332932087e+02,  -0.6878860361058950,     1.0 };
+    static constexpr std::array<double, 15> c_{ -0.5668800000000000e+01, -0.2430093356833875e+01, -0.2063599157091915,
+                                                -0.1073529058151375,     -0.9594562251023355e+01, -0.2047028614809616e+02,
+                                                0.7496443313967647e+01,  -0.1024680431464352e+02, -0.3399990352819905e+02,
+                                                0.1170890893206160e+02,  0.8083246795921522e+01,  -0.7981132988064893e+01,
+                                                -0.3152159432874371e+02, 0.1631930543123136e+02,  -0.6058818238834054e+01 };
+    static constexpr std::array<double, stages_> m_{ 0.1221224509226641e+01,
+                                                     0.6019134481288629e+01,
+                                                     0.1253708332932087e+02,
+                                                     -0.6878860361058950,
+                                                     1.0,
+                                                     1.0 };
+    static constexpr std::array<double, stages_> e_{ 0.0, 0.0, 0.0, 0.0, 0.0, 1.0 };
+    static constexpr std::array<double, stages_> alpha_{ 0.000, 0.386, 0.210, 0.630, 1.000, 1.000 };
+    static constexpr std::array<double, stages_> gamma_{ 0.2500000000000000,
+                                                         -0.1043000000000000,
+                                                         0.1035000000000000,
+                                                         -0.3620000000000023e-01,
+                                                         0.0,
+                                                         0.0 };
+  };
+
+}  // namespace micm
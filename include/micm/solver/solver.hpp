@@ -5,6 +5,7 @@
 #pragma once
 
 #include <cstddef>
+#include <micm/util/phase_timer.hpp>
 #include <string>
 #include <vector>
 
@@ -27,17 +28,64 @@ namespace micm
       RepeatedlySingularMatrix
     };
 
+    /// @brief Time spent in each phase of a Rosenbrock solve
+    ///
+    /// Chunks of grid cells solved in parallel each add their own time, so for chunked solves
+    /// these are summed over threads rather than elapsed times
+    struct Rosenbrock_timing
+    {
+      PhaseTime update_rate_constants{};
+      PhaseTime forcing{};
+      PhaseTime jacobian{};
+      PhaseTime decomposition{};
+      PhaseTime solve{};
+      PhaseTime error_norm{};
+
+      Rosenbrock_timing& operator+=(const Rosenbrock_timing& other)
+      {
+        update_rate_constants += other.update_rate_constants;
+        forcing += other.forcing;
+        jacobian += other.jacobian;
+        decomposition += other.decomposition;
+        solve += other.solve;
+        error_norm += other.error_norm;
+        return *this;
+      }
+    };
+
     struct Rosenbrock_stats
     {
-      uint64_t function_calls{};    // Nfun
-      uint64_t jacobian_updates{};  // Njac
-      uint64_t number_of_steps{};   // Nstp
-      uint64_t accepted{};          // Nacc
-      uint64_t rejected{};          // Nrej
-      uint64_t decompositions{};    // Ndec
-      uint64_t solves{};            // Nsol
-      uint64_t singular{};          // Nsng
-      uint64_t total_steps{};       // Ntotstp
+      uint64_t function_calls{};      // Nfun
+      uint64_t jacobian_updates{};    // Njac
+      uint64_t number_of_steps{};     // Nstp
+      uint64_t accepted{};            // Nacc
+      uint64_t rejected{};            // Nrej
+      uint64_t decompositions{};      // Ndec
+      uint64_t solves{};              // Nsol
+      uint64_t singular{};            // Nsng
+      uint64_t total_steps{};         // Ntotstp
+      uint64_t unconverged_solves{};  // linear solves that did not reach their tolerance (iterative solvers only)
+#ifdef USE_TIMING
+      Rosenbrock_timing timing{};  // only collected when micm is built with ENABLE_TIMING
+#endif
+
+      Rosenbrock_stats& operator+=(const Rosenbrock_stats& other)
+      {
+        function_calls += other.function_calls;
+        jacobian_updates += other.jacobian_updates;
+        number_of_steps += other.number_of_steps;
+        accepted += other.accepted;
+        rejected += other.rejected;
+        decompositions += other.decompositions;
+        solves += other.solves;
+        singular += other.singular;
+        total_steps += other.total_steps;
+        unconverged_solves += other.unconverged_solves;
+#ifdef USE_TIMING
+        timing += other.timing;
+#endif
+        return *this;
+      }
 
       void reset()
       {
@@ -50,6 +98,10 @@ namespace micm
         solves = 0;
         singular = 0;
         total_steps = 0;
+        unconverged_solves = 0;
+#ifdef USE_TIMING
+        timing = {};
+#endif
       }
     };
 
@@ -61,6 +113,15 @@ namespace micm
       SolverState state_ = SolverState::NotYetCalled;
       /// @brief A collection of runtime state for this call of the solver
       Rosenbrock_stats stats_{};
+      /// @brief The runtime state for each grid cell, which is only collected when each grid cell
+      ///        has its own step size control. The accepted steps, decompositions, and singular
+      ///        factorizations of the grid cells add up to those in stats_. The function evaluations,
+      ///        Jacobian updates, and solves of a grid cell are those done while it was active; in stats_
+      ///        each of them is counted once for all of the grid cells.
+      std::vector<Rosenbrock_stats> cell_stats_{};
+      /// @brief The final state of each grid cell, which is only collected when each grid cell has its own step
+      ///        size control. A grid cell whose step size becomes too small stops, while the others continue.
+      std::vector<SolverState> cell_states_{};
       /// @brief The final time the solver iterated to
       double T{};
     };
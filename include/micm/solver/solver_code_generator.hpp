@@ -0,0 +1,263 @@
+// Copyright (C) 2023 National Center for Atmospheric Research
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <micm/process/process.hpp>
+#include <micm/process/process_set.hpp>
+#include <micm/solver/lu_decomposition.hpp>
+#include <micm/solver/reordering.hpp>
+#include <micm/solver/state.hpp>
+#include <micm/system/system.hpp>
+#include <micm/util/matrix.hpp>
+#include <micm/util/sparse_matrix.hpp>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace micm
+{
+
+  /// @brief Options for the generated solver source code
+  struct SolverCodeGeneratorParameters
+  {
+    std::string namespace_{ "micm_generated" };  // Namespace that holds the generated functions
+    bool reorder_species_{ true };               // Reorder the Jacobian as RosenbrockSolver does with reorder_species_
+  };
+
+  /// @brief Formats a value as a C++ double literal that round-trips exactly
+  inline std::string DoubleLiteral(double value)
+  {
+    std::ostringstream literal;
+    literal << std::setprecision(std::numeric_limits<double>::max_digits10) << value;
+    std::string str = literal.str();
+    if (str.find_first_of(".en") == std::string::npos)
+      str += ".0";
+    return str;
+  }
+
+  /// @brief Generates a C++ header with fully unrolled solver kernels for a chemical mechanism
+  ///
+  /// The generated functions have no index arrays or loops over reactions or matrix elements; every index is a
+  /// constant in straight-line code. They operate on the data of the solver's own containers for any number of
+  /// grid cells: row-ordered matrices (Matrix) for the rate constants, state variables, and forcing, and
+  /// standard-ordered sparse matrices for the Jacobian and its LU factors, with the sparsity structure and row order
+  /// used by RosenbrockSolver (the non-zero Jacobian elements from ProcessSet plus the diagonal, reordered with
+  /// DiagonalMarkowitzReordering unless parameters.reorder_species_ is false). As in RosenbrockSolver, the state
+  /// variables and forcing hold only the integrated species (System::IntegratedNames), and the concentrations of
+  /// constant reactants must already be included in the rate constants.
+  ///
+  /// The generated header defines, in the requested namespace:
+  ///   number_of_species, number_of_reactions, jacobian_size, lower_size, upper_size (per grid cell)
+  ///   AddForcingTerms(rate_constants, state_variables, forcing, number_of_grid_cells)
+  ///   AddJacobianTerms(rate_constants, state_variables, jacobian, number_of_grid_cells)
+  ///   Decompose(A, L, U, number_of_grid_cells)
+  ///   Solve(b, x, L, U, number_of_grid_cells), where b and x may be the same array
+  /// which match ProcessSet::AddForcingTerms, ProcessSet::AddJacobianTerms, LuDecomposition::Decompose, and
+  /// LinearSolver::Solve.
+  /// @param system The chemical system
+  /// @param processes The chemical processes, in the order of their rate constants
+  /// @param parameters Options for the generated code
+  /// @return The source code of the generated header
+  inline std::string GenerateSolverSource(
+      const System& system,
+      const std::vector<Process>& processes,
+      const SolverCodeGeneratorParameters& parameters = {})
+  {
+    const State<Matrix> state{ StateParameters{ .state_variable_names_ = system.IntegratedNames(),
+                                                .number_of_grid_cells_ = 1,
+                                                .number_of_custom_parameters_ = 0,
+                                                .number_of_rate_constants_ = processes.size() } };
+    const auto& variable_map = state.variable_map_;
+    const std::size_t n = variable_map.size();
+    const auto constant_names = system.ConstantNames();
+    const std::set<std::string> constant_species(constant_names.begin(), constant_names.end());
+    auto is_constant = [&](const Species& species) { return constant_species.contains(species.name_); };
+
+    // the Jacobian sparsity structure and species order of RosenbrockSolver::BuildJacobian
+    const auto jacobian_elements = ProcessSet(processes, state, false, constant_species).NonZeroJacobianElements();
+    std::vector<std::size_t> species_order;
+    if (parameters.reorder_species_)
+      species_order = DiagonalMarkowitzReordering(n, jacobian_elements);
+    else
+      for (std::size_t i = 0; i < n; ++i)
+        species_order.push_back(i);
+    std::vector<std::size_t> row(n);
+    for (std::size_t i = 0; i < n; ++i)
+      row[species_order[i]] = i;
+    auto builder = SparseMatrix<double>::create(n).number_of_blocks(1);
+    for (const auto& elem : jacobian_elements)
+      builder = builder.with_element(row[elem.first], row[elem.second]);
+    for (std::size_t i = 0; i < n; ++i)
+      builder = builder.with_element(i, i);
+    const SparseMatrix<double> jacobian{ builder };
+    const auto LU = LuDecomposition::GetLUMatrices(jacobian);
+    const auto& lower = LU.first;
+    const auto& upper = LU.second;
+
+    std::ostringstream src;
+    src << "// Generated by micm::GenerateSolverSource. Do not edit.\n"
+        << "#pragma once\n\n"
+        << "#include <cstddef>\n\n"
+        << "namespace " << parameters.namespace_ << "\n{\n\n"
+        << "  constexpr std::size_t number_of_species = " << n << ";\n"
+        << "  constexpr std::size_t number_of_reactions = " << processes.size() << ";\n"
+        << "  constexpr std::size_t jacobian_size = " << jacobian.FlatBlockSize() << ";\n"
+        << "  constexpr std::size_t lower_size = " << lower.FlatBlockSize() << ";\n"
+        << "  constexpr std::size_t upper_size = " << upper.FlatBlockSize() << ";\n\n";
+
+    // rate of each reaction, and its partial derivative with respect to each reactant
+    auto rate_expression = [&](std::size_t i_rxn, std::size_t skipped_reactant)
+    {
+      std::string expr = "k[" + std::to_string(i_rxn) + "]";
+      const auto& reactants = processes[i_rxn].reactants_;
+      for (std::size_t i_react = 0; i_react < reactants.size(); ++i_react)
+        if (i_react != skipped_reactant && !is_constant(reactants[i_react]))
+          expr += " * y[" + std::to_string(variable_map.at(reactants[i_react].name_)) + "]";
+      return expr;
+    };
+    auto scaled_term = [](double yield, const std::string& value)
+    { return yield == 1.0 ? " + " + value : " + " + DoubleLiteral(yield) + " * " + value; };
+
+    // forcing terms
+    std::vector<std::string> forcing_terms(n);
+    for (std::size_t i_rxn = 0; i_rxn < processes.size(); ++i_rxn)
+    {
+      const std::string rate = "r" + std::to_string(i_rxn);
+      for (const auto& reactant : processes[i_rxn].reactants_)
+        if (!is_constant(reactant))
+          forcing_terms[variable_map.at(reactant.name_)] += " - " + rate;
+      for (const auto& product : processes[i_rxn].products_)
+        if (!is_constant(product.first))
+          forcing_terms[variable_map.at(product.first.name_)] += scaled_term(product.second, rate);
+    }
+    src << "  inline void AddForcingTerms(\n"
+        << "      const double* rate_constants,\n"
+        << "      const double* state_variables,\n"
+        << "      double* forcing,\n"
+        << "      std::size_t number_of_grid_cells)\n"
+        << "  {\n"
+        << "    for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)\n"
+        << "    {\n"
+        << "      const double* k = rate_constants + i_cell * number_of_reactions;\n"
+        << "      const double* y = state_variables + i_cell * number_of_species;\n"
+        << "      double* f = forcing + i_cell * number_of_species;\n";
+    for (std::size_t i_rxn = 0; i_rxn < processes.size(); ++i_rxn)
+      src << "      const double r" << i_rxn << " = " << rate_expression(i_rxn, processes[i_rxn].reactants_.size()) << ";\n";
+    for (std::size_t i = 0; i < n; ++i)
+      if (!forcing_terms[i].empty())
+        src << "      f[" << i << "] +=" << forcing_terms[i] << ";\n";
+    src << "    }\n  }\n\n";
+
+    // Jacobian terms
+    std::map<std::size_t, std::string> jacobian_terms;
+    for (std::size_t i_rxn = 0; i_rxn < processes.size(); ++i_rxn)
+    {
+      const auto& reactants = processes[i_rxn].reactants_;
+      for (std::size_t i_ind = 0; i_ind < reactants.size(); ++i_ind)
+      {
+        if (is_constant(reactants[i_ind]))
+          continue;
+        const std::size_t ind = row[variable_map.at(reactants[i_ind].name_)];
+        const std::string d_rate_d_ind = rate_expression(i_rxn, i_ind);
+        for (const auto& reactant : reactants)
+          if (!is_constant(reactant))
+            jacobian_terms[jacobian.VectorIndex(0, row[variable_map.at(reactant.name_)], ind)] += " - " + d_rate_d_ind;
+        for (const auto& product : processes[i_rxn].products_)
+          if (!is_constant(product.first))
+            jacobian_terms[jacobian.VectorIndex(0, row[variable_map.at(product.first.name_)], ind)] +=
+                scaled_term(product.second, d_rate_d_ind);
+      }
+    }
+    src << "  inline void AddJacobianTerms(\n"
+        << "      const double* rate_constants,\n"
+        << "      const double* state_variables,\n"
+        << "      double* jacobian,\n"
+        << "      std::size_t number_of_grid_cells)\n"
+        << "  {\n"
+        << "    for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)\n"
+        << "    {\n"
+        << "      const double* k = rate_constants + i_cell * number_of_reactions;\n"
+        << "      const double* y = state_variables + i_cell * number_of_species;\n"
+        << "      double* j = jacobian + i_cell * jacobian_size;\n";
+    for (const auto& term : jacobian_terms)
+      src << "      j[" << term.first << "] +=" << term.second << ";\n";
+    src << "    }\n  }\n\n";
+
+    // LU decomposition, in the order of the operations in LuDecomposition::Decompose
+    auto element = [](const char* name, std::size_t index) { return std::string(name) + "[" + std::to_string(index) + "]"; };
+    const auto& L_row_start = lower.RowStartVector();
+    const auto& L_row_ids = lower.RowIdsVector();
+    src << "  inline void Decompose(const double* A, double* L, double* U, std::size_t number_of_grid_cells)\n"
+        << "  {\n"
+        << "    for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)\n"
+        << "    {\n"
+        << "      const double* a = A + i_cell * jacobian_size;\n"
+        << "      double* l = L + i_cell * lower_size;\n"
+        << "      double* u = U + i_cell * upper_size;\n";
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      for (std::size_t k = i; k < n; ++k)
+      {
+        if (upper.IsZero(i, k))
+          continue;
+        std::string expr = jacobian.IsZero(i, k) ? "0.0" : element("a", jacobian.VectorIndex(0, i, k));
+        for (std::size_t j_id = L_row_start[i]; j_id < L_row_start[i + 1] && L_row_ids[j_id] < i; ++j_id)
+          if (!upper.IsZero(L_row_ids[j_id], k))
+            expr += " - " + element("l", j_id) + " * " + element("u", upper.VectorIndex(0, L_row_ids[j_id], k));
+        src << "      " << element("u", upper.VectorIndex(0, i, k)) << " = " << expr << ";\n";
+      }
+      src << "      " << element("l", lower.VectorIndex(0, i, i)) << " = 1.0;\n";
+      for (std::size_t k = i + 1; k < n; ++k)
+      {
+        if (lower.IsZero(k, i))
+          continue;
+        std::string expr = jacobian.IsZero(k, i) ? "0.0" : element("a", jacobian.VectorIndex(0, k, i));
+        for (std::size_t j_id = L_row_start[k]; j_id < L_row_start[k + 1] && L_row_ids[j_id] < i; ++j_id)
+          if (!upper.IsZero(L_row_ids[j_id], i))
+            expr += " - " + element("l", j_id) + " * " + element("u", upper.VectorIndex(0, L_row_ids[j_id], i));
+        src << "      " << element("l", lower.VectorIndex(0, k, i)) << " = (" << expr << ") / "
+            << element("u", upper.VectorIndex(0, i, i)) << ";\n";
+      }
+    }
+    src << "    }\n  }\n\n";
+
+    // forward and backward substitution, as in LinearSolver::Solve, with b and x in the state variable order
+    const auto& U_row_start = upper.RowStartVector();
+    const auto& U_row_ids = upper.RowIdsVector();
+    src << "  inline void Solve(const double* b, double* x, const double* L, const double* U, std::size_t number_of_grid_cells)\n"
+        << "  {\n"
+        << "    for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)\n"
+        << "    {\n"
+        << "      const double* b_cell = b + i_cell * number_of_species;\n"
+        << "      double* x_cell = x + i_cell * number_of_species;\n"
+        << "      const double* l = L + i_cell * lower_size;\n"
+        << "      const double* u = U + i_cell * upper_size;\n";
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      std::string expr = element("b_cell", species_order[i]);
+      for (std::size_t j_id = L_row_start[i]; j_id < L_row_start[i + 1] && L_row_ids[j_id] < i; ++j_id)
+        expr += " - " + element("l", j_id) + " * " + element("x_cell", species_order[L_row_ids[j_id]]);
+      src << "      " << element("x_cell", species_order[i]) << " = " << expr << ";\n";
+    }
+    for (std::size_t i = n; i-- > 0;)
+    {
+      std::string expr = element("x_cell", species_order[i]);
+      for (std::size_t j_id = U_row_start[i]; j_id < U_row_start[i + 1]; ++j_id)
+        if (U_row_ids[j_id] > i)
+          expr += " - " + element("u", j_id) + " * " + element("x_cell", species_order[U_row_ids[j_id]]);
+      src << "      " << element("x_cell", species_order[i]) << " = (" << expr << ") / " << element("u", upper.VectorIndex(0, i, i))
+          << ";\n";
+    }
+    src << "    }\n  }\n\n"
+        << "}  // namespace " << parameters.namespace_ << "\n";
+
+    return src.str();
+  }
+
+}  // namespace micm
@@ -0,0 +1,89 @@
+// Copyright (C) 2023 National Center for Atmospheric Research
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <micm/process/process_set.hpp>
+#include <micm/util/sparse_matrix.hpp>
+#include <vector>
+
+namespace micm
+{
+
+  /// @brief Calculates y = A x for each block of a block-diagonal sparse matrix (e.g., y = dforce_dy * x)
+  /// @param A Sparse matrix with one block per grid cell
+  /// @param x Vector for each block (grid cell, variable)
+  /// @param y Product for each block (grid cell, variable), which must not be the same object as x
+  /// @param variable_order The element of x and y for each row (and column) of A, when the rows and columns of A are
+  ///                       reordered (see DiagonalMarkowitzReordering); empty when they are in the same order
+  template<template<class> class MatrixPolicy, class SparseMatrixPolicy>
+    requires(!VectorizableSparse<SparseMatrixPolicy>)
+  inline void SparseMatrixVectorProduct(
+      const SparseMatrixPolicy& A,
+      const MatrixPolicy<double>& x,
+      MatrixPolicy<double>& y,
+      const std::vector<std::size_t>& variable_order = {})
+  {
+    const auto& row_start = A.RowStartVector();
+    const auto& row_ids = A.RowIdsVector();
+    const std::size_t n = row_start.size() - 1;
+    for (std::size_t i_block = 0; i_block < A.size(); ++i_block)
+    {
+      auto A_block = std::next(A.AsVector().begin(), i_block * A.FlatBlockSize());
+      auto x_cell = x[i_block];
+      auto y_cell = y[i_block];
+      for (std::size_t i = 0; i < n; ++i)
+      {
+        double sum = 0.0;
+        for (std::size_t id = row_start[i]; id < row_start[i + 1]; ++id)
+          sum += A_block[id] * x_cell[variable_order.empty() ? row_ids[id] : variable_order[row_ids[id]]];
+        y_cell[variable_order.empty() ? i : variable_order[i]] = sum;
+      }
+    }
+  }
+
+  /// @brief Calculates y = A x for each block of a block-diagonal sparse matrix with the blocks of groups of grid
+  ///        cells interleaved, so that the innermost loop runs over the grid cells of a group. A, x, and y must
+  ///        interleave the same number of grid cells.
+  /// @param A Sparse matrix with one block per grid cell
+  /// @param x Vector for each block (grid cell, variable)
+  /// @param y Product for each block (grid cell, variable), which must not be the same object as x
+  /// @param variable_order The element of x and y for each row (and column) of A, when the rows and columns of A are
+  ///                       reordered (see DiagonalMarkowitzReordering); empty when they are in the same order
+  template<template<class> class MatrixPolicy, class SparseMatrixPolicy>
+    requires(Vectorizable<MatrixPolicy<double>> && VectorizableSparse<SparseMatrixPolicy>)
+  inline void SparseMatrixVectorProduct(
+      const SparseMatrixPolicy& A,
+      const MatrixPolicy<double>& x,
+      MatrixPolicy<double>& y,
+      const std::vector<std::size_t>& variable_order = {})
+  {
+    constexpr std::size_t L = SparseMatrixPolicy::GroupVectorSize();
+    const auto& row_start = A.RowStartVector();
+    const auto& row_ids = A.RowIdsVector();
+    const std::size_t n = row_start.size() - 1;
+    const std::size_t A_group_size = L * A.FlatBlockSize();
+    for (std::size_t i_group = 0; i_group < x.NumberOfBlocks(); ++i_group)
+    {
+      auto A_group = std::next(A.AsVector().begin(), i_group * A_group_size);
+      auto x_group = std::next(x.AsVector().begin(), i_group * x.BlockSize());
+      auto y_group = std::next(y.AsVector().begin(), i_group * y.BlockSize());
+      for (std::size_t i = 0; i < n; ++i)
+      {
+        auto y_row = std::next(y_group, (variable_order.empty() ? i : variable_order[i]) * L);
+        for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+          y_row[i_cell] = 0.0;
+        for (std::size_t id = row_start[i]; id < row_start[i + 1]; ++id)
+        {
+          auto A_elem = std::next(A_group, id * L);
+          auto x_row = std::next(x_group, (variable_order.empty() ? row_ids[id] : variable_order[row_ids[id]]) * L);
+          for (std::size_t i_cell = 0; i_cell < L; ++i_cell)
+            y_row[i_cell] += A_elem[i_cell] * x_row[i_cell];
+        }
+      }
+    }
+  }
+
+}  // namespace micm
@@ -31,6 +31,8 @@ namespace micm
     std::map<std::string, std::size_t> variable_map_;
     MatrixPolicy<double> variables_;
     MatrixPolicy<double> custom_rate_parameters_;
+    /// Rate constants of each process. Solvers that do not integrate constant species (see
+    /// RosenbrockSolver::UpdateState) expect these to include the concentrations of the constant reactants.
     MatrixPolicy<double> rate_constants_;
 
     /// @brief
@@ -47,6 +47,10 @@ namespace micm
     /// @param name The name of the species
     /// @param property A property of the species
     Species(const std::string& name, Property property);
+
+    /// @brief Returns true for a species with a fixed concentration, which is marked by a non-zero "constant"
+    ///        property. Fixed species are not integrated by the solvers.
+    bool IsConstant() const;
   };
 
   inline Species Species::operator=(const Species& other)
@@ -69,4 +73,12 @@ namespace micm
       : name_(name),
         properties_({ property }){};
 
+  inline bool Species::IsConstant() const
+  {
+    for (const auto& property : properties_)
+      if (property.name_ == "constant")
+        return property.value_ != 0.0;
+    return false;
+  }
+
 }  // namespace micm
@@ -43,6 +43,13 @@ namespace micm
 
     /// @brief Returns a set of unique species names
     std::vector<std::string> UniqueNames() const;
+
+    /// @brief Returns the unique names of the species integrated by the solvers, which are all of the species
+    ///        except those with a fixed concentration (see Species::IsConstant), in the order of UniqueNames()
+    std::vector<std::string> IntegratedNames() const;
+
+    /// @brief Returns the names of the species with a fixed concentration
+    std::vector<std::string> ConstantNames() const;
   };
 
   inline micm::System::System()
@@ -80,4 +87,30 @@ namespace micm
     return names;
   }
 
+  inline std::vector<std::string> System::IntegratedNames() const
+  {
+    std::vector<std::string> names{};
+    for (const auto& species : gas_phase_.species_)
+      if (!species.IsConstant())
+        names.push_back(species.name_);
+    for (const auto& phase : phases_)
+      for (const auto& species : phase.second.species_)
+        if (!species.IsConstant())
+          names.push_back(phase.first + "." + species.name_);
+    return names;
+  }
+
+  inline std::vector<std::string> System::ConstantNames() const
+  {
+    std::vector<std::string> names{};
+    for (const auto& species : gas_phase_.species_)
+      if (species.IsConstant())
+        names.push_back(species.name_);
+    for (const auto& phase : phases_)
+      for (const auto& species : phase.second.species_)
+        if (species.IsConstant())
+          names.push_back(phase.first + "." + species.name_);
+    return names;
+  }
+
 }  // namespace micm
@@ -0,0 +1,35 @@
+// Copyright (C) 2023 National Center for Atmospheric Research,
+//
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace micm
+{
+
+  /// @brief Returns true if any grid cell in a range is active
+  ///
+  /// Kernels that take a mask of active grid cells skip the grid cells that are not active, or, for
+  /// vector-ordered matrices, the groups of grid cells with no active grid cell. An empty mask has
+  /// every grid cell active.
+  /// @param is_active Whether each grid cell is active
+  /// @param first_cell The first grid cell of the range
+  /// @param number_of_cells The number of grid cells in the range (grid cells past the end of the mask are ignored)
+  inline bool IsAnyGridCellActive(
+      const std::vector<bool>& is_active,
+      std::size_t first_cell,
+      std::size_t number_of_cells = 1)
+  {
+    if (is_active.empty())
+      return true;
+    const std::size_t end_cell = std::min(first_cell + number_of_cells, is_active.size());
+    for (std::size_t i_cell = first_cell; i_cell < end_cell; ++i_cell)
+      if (is_active[i_cell])
+        return true;
+    return false;
+  }
+
+}  // namespace micm
@@ -0,0 +1,13 @@
+// Copyright (C) 2023 National Center for Atmospheric Research,
+//
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+// MICM_OMP(directive) applies an OpenMP directive, e.g. MICM_OMP(omp parallel for), to the statement
+// that follows it. Without OpenMP it expands to nothing, so builds without ENABLE_OPENMP do not see
+// unknown pragmas.
+#ifdef _OPENMP
+#define MICM_OMP(directive) _Pragma(#directive)
+#else
+#define MICM_OMP(directive)
+#endif
@@ -0,0 +1,86 @@
+/* Copyright (C) 2023 National Center for Atmospheric Research,
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// MICM_TIME_PHASE(phase) adds the time spent in the rest of the enclosing scope to a PhaseTime.
+// Without USE_TIMING it expands to nothing, and the phase expression is not evaluated.
+#ifdef USE_TIMING
+#define MICM_TIME_PHASE(phase) micm::ScopedPhaseTimer micm_scoped_phase_timer_(phase)
+#else
+#define MICM_TIME_PHASE(phase)
+#endif
+
+namespace micm
+{
+
+  /// @brief Reads the processor's cycle (time-stamp) counter
+  /// @return The current counter value, or 0 on architectures without a readable counter
+  inline uint64_t ReadCycleCounter()
+  {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t counter;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(counter));
+    return counter;
+#else
+    return 0;
+#endif
+  }
+
+  /// @brief Accumulated wall time and cycle count of one phase of a calculation
+  struct PhaseTime
+  {
+    std::chrono::nanoseconds wall_time_{};
+    uint64_t cycles_{};
+    uint64_t calls_{};
+
+    PhaseTime& operator+=(const PhaseTime& other)
+    {
+      wall_time_ += other.wall_time_;
+      cycles_ += other.cycles_;
+      calls_ += other.calls_;
+      return *this;
+    }
+  };
+
+  /// @brief Adds the time between its construction and destruction to a PhaseTime
+  class ScopedPhaseTimer
+  {
+    PhaseTime& phase_;
+    std::chrono::steady_clock::time_point start_time_;
+    uint64_t start_cycles_;
+
+   public:
+    ScopedPhaseTimer(PhaseTime& phase)
+        : phase_(phase),
+          start_time_(std::chrono::steady_clock::now()),
+          start_cycles_(ReadCycleCounter())
+    {
+    }
+
+    ScopedPhaseTimer(const ScopedPhaseTimer&) = delete;
+    ScopedPhaseTimer& operator=(const ScopedPhaseTimer&) = delete;
+
+    ~ScopedPhaseTimer()
+    {
+      phase_.cycles_ += ReadCycleCounter() - start_cycles_;
+      phase_.wall_time_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time_);
+      phase_.calls_ += 1;
+    }
+  };
+
+}  // namespace micm
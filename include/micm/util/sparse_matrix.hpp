@@ -13,23 +13,76 @@
 namespace micm
 {
 
-  template<class T>
+  /// @brief Stores the non-zero elements of each block contiguously, one block after the other
+  class SparseMatrixStandardOrdering
+  {
+   protected:
+    static std::size_t VectorSize(std::size_t number_of_blocks, std::size_t flat_block_size)
+    {
+      return number_of_blocks * flat_block_size;
+    }
+
+    static std::size_t VectorIndex(std::size_t flat_block_size, std::size_t block, std::size_t element)
+    {
+      return block * flat_block_size + element;
+    }
+  };
+
+  /// @brief Interleaves the non-zero elements of groups of L blocks
+  ///
+  /// Each non-zero element is stored for L consecutive blocks (grid cells), matching the layout
+  /// of VectorMatrix<T, L>, so calculations can run over the blocks of a group in the innermost loop.
+  /// The last group is padded to L blocks.
+  template<std::size_t L>
+  class SparseMatrixVectorOrdering
+  {
+   protected:
+    static std::size_t VectorSize(std::size_t number_of_blocks, std::size_t flat_block_size)
+    {
+      return (number_of_blocks + L - 1) / L * L * flat_block_size;
+    }
+
+    static std::size_t VectorIndex(std::size_t flat_block_size, std::size_t block, std::size_t element)
+    {
+      return (block / L) * L * flat_block_size + element * L + block % L;
+    }
+
+   public:
+    /// @brief Returns the number of blocks interleaved in each group
+    static constexpr std::size_t GroupVectorSize()
+    {
+      return L;
+    }
+  };
+
+  /// @brief Selects the sparse matrix ordering whose memory layout matches a dense matrix type
+  ///
+  /// The blocks are stored one after the other, unless the dense matrix interleaves the rows of groups of
+  /// grid cells (see VectorMatrix)
+  template<class DenseMatrix>
+  struct SparseMatrixOrderingFor
+  {
+    using type = SparseMatrixStandardOrdering;
+  };
+
+  template<class T, class OrderingPolicy>
   class SparseMatrixBuilder;
 
   /// @brief A sparse block-diagonal 2D matrix class with contiguous memory
   ///
   /// Each block sub-matrix is square and has the same structure of non-zero elements
   ///
-  /// Sparse matrix data structure follows the Compressed Sparse Row (CSR) pattern
-  template<class T>
-  class SparseMatrix
+  /// Sparse matrix data structure follows the Compressed Sparse Row (CSR) pattern.
+  /// The OrderingPolicy sets how the blocks are laid out in memory.
+  template<class T, class OrderingPolicy = SparseMatrixStandardOrdering>
+  class SparseMatrix : public OrderingPolicy
   {
     std::size_t number_of_blocks_;        // Number of block sub-matrices in the overall matrix
     std::vector<T> data_;                 // Value of each non-zero matrix element
     std::vector<std::size_t> row_ids_;    // Row indices of each non-zero element in a block
     std::vector<std::size_t> row_start_;  // Index in data_ and row_ids_ of the start of each column in a block
 
-    friend class SparseMatrixBuilder<T>;
+    friend class SparseMatrixBuilder<T, OrderingPolicy>;
     friend class ProxyRow;
     friend class ConstProxyRow;
     friend class Proxy;
@@ -132,14 +185,14 @@ namespace micm
     };
 
    public:
-    static SparseMatrixBuilder<T> create(std::size_t block_size)
+    static SparseMatrixBuilder<T, OrderingPolicy> create(std::size_t block_size)
     {
-      return SparseMatrixBuilder<T>{ block_size };
+      return SparseMatrixBuilder<T, OrderingPolicy>{ block_size };
     }
 
     SparseMatrix() = default;
 
-    SparseMatrix(SparseMatrixBuilder<T>& builder)
+    SparseMatrix(SparseMatrixBuilder<T, OrderingPolicy>& builder)
         : number_of_blocks_(builder.number_of_blocks_),
           data_(builder.NumberOfElements(), builder.initial_value_),
           row_ids_(builder.RowIdsVector()),
@@ -147,7 +200,7 @@ namespace micm
     {
     }
 
-    SparseMatrix<T>& operator=(SparseMatrixBuilder<T>& builder)
+    SparseMatrix<T, OrderingPolicy>& operator=(SparseMatrixBuilder<T, OrderingPolicy>& builder)
     {
       number_of_blocks_ = builder.number_of_blocks_;
       data_ = std::vector<T>(builder.NumberOfElements(), builder.initial_value_);
@@ -172,10 +225,10 @@ namespace micm
         throw std::invalid_argument("SparseMatrix element out of range");
       auto begin = std::next(row_ids_.begin(), row_start_[row]);
       auto end = std::next(row_ids_.begin(), row_start_[row + 1]);
-      auto elem = std::find(begin, end, column);
-      if (elem == end)
+      auto elem = std::lower_bound(begin, end, column);
+      if (elem == end || *elem != column)
         throw std::invalid_argument("SparseMatrix zero element access not allowed");
-      return std::size_t{ (elem - row_ids_.begin()) + block * row_ids_.size() };
+      return OrderingPolicy::VectorIndex(row_ids_.size(), block, elem - row_ids_.begin());
     }
 
     std::size_t VectorIndex(std::size_t row, std::size_t column) const
@@ -191,8 +244,8 @@ namespace micm
         throw std::invalid_argument("SparseMatrix element out of range");
       auto begin = std::next(row_ids_.begin(), row_start_[row]);
       auto end = std::next(row_ids_.begin(), row_start_[row + 1]);
-      auto elem = std::find(begin, end, column);
-      if (elem == end)
+      auto elem = std::lower_bound(begin, end, column);
+      if (elem == end || *elem != column)
         return true;
       return false;
     }
@@ -228,14 +281,14 @@ namespace micm
     }
   };
 
-  template<class T>
-  class SparseMatrixBuilder
+  template<class T, class OrderingPolicy = SparseMatrixStandardOrdering>
+  class SparseMatrixBuilder : public OrderingPolicy
   {
     std::size_t number_of_blocks_{ 1 };
     std::size_t block_size_;
     std::set<std::pair<std::size_t, std::size_t>> non_zero_elements_{};
     T initial_value_{};
-    friend class SparseMatrix<T>;
+    friend class SparseMatrix<T, OrderingPolicy>;
 
    public:
     SparseMatrixBuilder() = delete;
@@ -245,18 +298,18 @@ namespace micm
     {
     }
 
-    operator SparseMatrix<T>() const
+    operator SparseMatrix<T, OrderingPolicy>() const
     {
-      return SparseMatrix<T>(*this);
+      return SparseMatrix<T, OrderingPolicy>(*this);
     }
 
-    SparseMatrixBuilder<T>& number_of_blocks(std::size_t n)
+    SparseMatrixBuilder<T, OrderingPolicy>& number_of_blocks(std::size_t n)
     {
       number_of_blocks_ = n;
       return *this;
     }
 
-    SparseMatrixBuilder<T>& with_element(std::size_t x, std::size_t y)
+    SparseMatrixBuilder<T, OrderingPolicy>& with_element(std::size_t x, std::size_t y)
     {
       if (x >= block_size_ || y >= block_size_)
         throw std::invalid_argument("SparseMatrix element out of range");
@@ -264,15 +317,16 @@ namespace micm
       return *this;
     }
 
-    SparseMatrixBuilder<T>& initial_value(T inital_value)
+    SparseMatrixBuilder<T, OrderingPolicy>& initial_value(T inital_value)
     {
       initial_value_ = inital_value;
       return *this;
     }
 
+    /// @brief Returns the size of the underlying data vector, including any padding
     std::size_t NumberOfElements() const
     {
-      return non_zero_elements_.size() * number_of_blocks_;
+      return OrderingPolicy::VectorSize(number_of_blocks_, non_zero_elements_.size());
     }
 
     std::vector<std::size_t> RowIdsVector() const
@@ -297,7 +351,9 @@ namespace micm
           starts[(curr_row++) + 1] = total_elem;
         ++total_elem;
       }
-      starts[curr_row + 1] = total_elem;
+      // fill in the remaining rows, which may be empty
+      while (curr_row < block_size_)
+        starts[(curr_row++) + 1] = total_elem;
       return starts;
     }
   };
@@ -6,6 +6,7 @@
 #include <cassert>
 #include <cmath>
 #include <micm/util/exit_codes.hpp>
+#include <micm/util/sparse_matrix.hpp>
 #include <vector>
 
 namespace micm
@@ -186,7 +187,7 @@ namespace micm
       return L * y_dim_;
     }
 
-    constexpr std::size_t VectorSize() const
+    static constexpr std::size_t VectorSize()
     {
       return L;
     }
@@ -212,4 +213,11 @@ namespace micm
     }
   };
 
+  /// @brief Sparse matrices used with a VectorMatrix interleave the blocks of the same number of grid cells
+  template<class T, std::size_t L>
+  struct SparseMatrixOrderingFor<VectorMatrix<T, L>>
+  {
+    using type = SparseMatrixVectorOrdering<L>;
+  };
+
 }  // namespace micm
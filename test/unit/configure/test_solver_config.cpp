@@ -38,7 +38,7 @@ TEST(SolverConfig, ReadAndParseSystem)
 
   // Check 'name' and 'properties' in 'Species'
   std::vector<std::pair<std::string, short>> species_name_and_num_properties = {
-    std::make_pair("M", 0),   std::make_pair("Ar", 1), std::make_pair("CO2", 1),
+    std::make_pair("M", 1),   std::make_pair("Ar", 1), std::make_pair("CO2", 1),
     std::make_pair("H2O", 1), std::make_pair("N2", 1), std::make_pair("O1D", 1),
     std::make_pair("O", 1),   std::make_pair("O2", 1), std::make_pair("O3", 1)
   };
@@ -48,8 +48,11 @@ TEST(SolverConfig, ReadAndParseSystem)
   {
     EXPECT_EQ(s.name_, species_name_and_num_properties[idx].first);
     EXPECT_EQ(s.properties_.size(), species_name_and_num_properties[idx].second);
+    EXPECT_EQ(s.IsConstant(), s.name_ == "M");
     idx++;
   }
+  EXPECT_EQ(solver_params.system_.ConstantNames(), std::vector<std::string>{ "M" });
+  EXPECT_EQ(solver_params.system_.IntegratedNames().size(), 8);
 }
 
 TEST(SolverConfig, ReadAndParseProcess)
@@ -14,7 +14,7 @@ void compare_pair(const index_pair& a, const index_pair& b)
   EXPECT_EQ(a.second, b.second);
 }
 
-template<template<class> class MatrixPolicy>
+template<template<class> class MatrixPolicy, class SparseMatrixPolicy = micm::SparseMatrix<double>>
 void testProcessSet()
 {
   auto foo = micm::Species("foo");
@@ -87,10 +87,10 @@ void testProcessSet()
   compare_pair(*(++elem), index_pair(4, 0));
   compare_pair(*(++elem), index_pair(4, 2));
 
-  auto builder = micm::SparseMatrix<double>::create(5).number_of_blocks(2).initial_value(100.0);
+  auto builder = SparseMatrixPolicy::create(5).number_of_blocks(2).initial_value(100.0);
   for (auto& elem : non_zero_elements)
     builder = builder.with_element(elem.first, elem.second);
-  micm::SparseMatrix<double> jacobian{ builder };
+  SparseMatrixPolicy jacobian{ builder };
   set.SetJacobianFlatIds(jacobian);
   set.AddJacobianTerms<MatrixPolicy>(rate_constants, state.variables_, jacobian);
 
@@ -140,4 +140,255 @@ TEST(ProcessSet, VectorMatrix)
   testProcessSet<Block2VectorMatrix>();
   testProcessSet<Block3VectorMatrix>();
   testProcessSet<Block4VectorMatrix>();
-}
\ No newline at end of file
+}
+
+TEST(ProcessSet, VectorMatrixWithVectorOrderedJacobian)
+{
+  testProcessSet<Block1VectorMatrix, micm::SparseMatrix<double, micm::SparseMatrixVectorOrdering<1>>>();
+  testProcessSet<Block2VectorMatrix, micm::SparseMatrix<double, micm::SparseMatrixVectorOrdering<2>>>();
+  testProcessSet<Block3VectorMatrix, micm::SparseMatrix<double, micm::SparseMatrixVectorOrdering<3>>>();
+  testProcessSet<Block4VectorMatrix, micm::SparseMatrix<double, micm::SparseMatrixVectorOrdering<4>>>();
+}
+
+// Reactions with every arity up to max_reactants reactants and 7 products, among 8 species
+std::vector<micm::Process> allArityProcesses(const std::vector<micm::Species>& species, std::size_t max_reactants = 4)
+{
+  micm::Phase gas_phase{ species };
+  std::vector<micm::Process> processes;
+  for (std::size_t n_react = 0; n_react <= max_reactants; ++n_react)
+  {
+    for (std::size_t n_prod = 0; n_prod <= 7; ++n_prod)
+    {
+      std::vector<micm::Species> reactants;
+      std::vector<yields> products;
+      for (std::size_t i = 0; i < n_react; ++i)
+        reactants.push_back(species[(n_prod + 3 * i) % species.size()]);
+      for (std::size_t i = 0; i < n_prod; ++i)
+        products.push_back(yields(species[(n_react + 5 * i + 1) % species.size()], 0.5 + 0.25 * i));
+      processes.push_back(micm::Process::create().reactants(reactants).products(products).phase(gas_phase));
+    }
+  }
+  return processes;
+}
+
+template<template<class> class MatrixPolicy>
+micm::State<MatrixPolicy> allArityState(std::vector<micm::Species>& species, std::size_t number_of_grid_cells)
+{
+  std::vector<std::string> names;
+  for (std::size_t i = 0; i < 8; ++i)
+  {
+    names.push_back("S" + std::to_string(i));
+    species.push_back(micm::Species(names.back()));
+  }
+  micm::State<MatrixPolicy> state{ micm::StateParameters{ .state_variable_names_{ names },
+                                                          .number_of_grid_cells_ = number_of_grid_cells,
+                                                          .number_of_custom_parameters_ = 0,
+                                                          .number_of_rate_constants_ = 0 } };
+  for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)
+    for (std::size_t i_species = 0; i_species < species.size(); ++i_species)
+      state.variables_[i_cell][i_species] = 0.5 + 0.1 * i_cell + 0.05 * i_species;
+  return state;
+}
+
+// The reactions of allArityProcesses, which include arities without specialized kernels, are calculated in
+// buckets and compared with the reaction-by-reaction calculation
+template<template<class> class MatrixPolicy, class SparseMatrixPolicy = micm::SparseMatrix<double>>
+void testArityBuckets(std::size_t number_of_grid_cells)
+{
+  std::vector<micm::Species> species;
+  auto state = allArityState<MatrixPolicy>(species, number_of_grid_cells);
+  auto processes = allArityProcesses(species);
+
+  micm::ProcessSet set{ processes, state };
+  micm::ProcessSet bucket_set{ processes, state, true };
+
+  MatrixPolicy<double> rate_constants{ number_of_grid_cells, processes.size() };
+  for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)
+    for (std::size_t i_rxn = 0; i_rxn < processes.size(); ++i_rxn)
+      rate_constants[i_cell][i_rxn] = 1.0 + 0.01 * i_rxn + 0.2 * i_cell;
+
+  MatrixPolicy<double> forcing{ number_of_grid_cells, species.size(), 0.0 };
+  MatrixPolicy<double> bucket_forcing{ number_of_grid_cells, species.size(), 0.0 };
+  set.AddForcingTerms<MatrixPolicy>(rate_constants, state.variables_, forcing);
+  bucket_set.AddForcingTerms<MatrixPolicy>(rate_constants, state.variables_, bucket_forcing);
+  for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)
+    for (std::size_t i_species = 0; i_species < species.size(); ++i_species)
+      EXPECT_NEAR(bucket_forcing[i_cell][i_species], forcing[i_cell][i_species], 1.0e-10 * std::abs(forcing[i_cell][i_species]));
+
+  auto non_zero_elements = set.NonZeroJacobianElements();
+  auto builder = SparseMatrixPolicy::create(species.size()).number_of_blocks(number_of_grid_cells);
+  for (auto& elem : non_zero_elements)
+    builder = builder.with_element(elem.first, elem.second);
+  SparseMatrixPolicy jacobian{ builder };
+  SparseMatrixPolicy bucket_jacobian{ builder };
+  set.SetJacobianFlatIds(jacobian);
+  bucket_set.SetJacobianFlatIds(bucket_jacobian);
+  set.AddJacobianTerms<MatrixPolicy>(rate_constants, state.variables_, jacobian);
+  bucket_set.AddJacobianTerms<MatrixPolicy>(rate_constants, state.variables_, bucket_jacobian);
+  for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)
+    for (auto& elem : non_zero_elements)
+      EXPECT_NEAR(
+          bucket_jacobian[i_cell][elem.first][elem.second],
+          jacobian[i_cell][elem.first][elem.second],
+          1.0e-10 * std::abs(jacobian[i_cell][elem.first][elem.second]));
+}
+
+TEST(ProcessSet, ArityBuckets)
+{
+  testArityBuckets<micm::Matrix>(3);
+  testArityBuckets<Block3VectorMatrix>(5);
+  testArityBuckets<Block4VectorMatrix, micm::SparseMatrix<double, micm::SparseMatrixVectorOrdering<4>>>(5);
+}
+
+// The fused forcing and Jacobian calculation matches separate calls to AddForcingTerms and AddJacobianTerms
+template<template<class> class MatrixPolicy, class SparseMatrixPolicy = micm::SparseMatrix<double>>
+void testFusedForcingAndJacobian(std::size_t number_of_grid_cells, bool bucket_by_arity, std::size_t max_reactants = 4)
+{
+  std::vector<micm::Species> species;
+  auto state = allArityState<MatrixPolicy>(species, number_of_grid_cells);
+  auto processes = allArityProcesses(species, max_reactants);
+  micm::ProcessSet set{ processes, state, bucket_by_arity };
+
+  MatrixPolicy<double> rate_constants{ number_of_grid_cells, processes.size() };
+  for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)
+    for (std::size_t i_rxn = 0; i_rxn < processes.size(); ++i_rxn)
+      rate_constants[i_cell][i_rxn] = 1.0 + 0.01 * i_rxn + 0.2 * i_cell;
+
+  auto non_zero_elements = set.NonZeroJacobianElements();
+  auto builder = SparseMatrixPolicy::create(species.size()).number_of_blocks(number_of_grid_cells);
+  for (auto& elem : non_zero_elements)
+    builder = builder.with_element(elem.first, elem.second);
+  SparseMatrixPolicy jacobian{ builder };
+  SparseMatrixPolicy fused_jacobian{ builder };
+  set.SetJacobianFlatIds(jacobian);
+
+  MatrixPolicy<double> forcing{ number_of_grid_cells, species.size(), 0.0 };
+  MatrixPolicy<double> fused_forcing{ number_of_grid_cells, species.size(), 0.0 };
+  set.AddForcingTerms<MatrixPolicy>(rate_constants, state.variables_, forcing);
+  set.AddJacobianTerms<MatrixPolicy>(rate_constants, state.variables_, jacobian);
+  set.AddForcingAndJacobianTerms<MatrixPolicy>(rate_constants, state.variables_, fused_forcing, fused_jacobian);
+
+  for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)
+  {
+    for (std::size_t i_species = 0; i_species < species.size(); ++i_species)
+      EXPECT_NEAR(fused_forcing[i_cell][i_species], forcing[i_cell][i_species], 1.0e-10 * std::abs(forcing[i_cell][i_species]));
+    for (auto& elem : non_zero_elements)
+      EXPECT_NEAR(
+          fused_jacobian[i_cell][elem.first][elem.second],
+          jacobian[i_cell][elem.first][elem.second],
+          1.0e-10 * std::abs(jacobian[i_cell][elem.first][elem.second]));
+  }
+}
+
+TEST(ProcessSet, FusedForcingAndJacobian)
+{
+  testFusedForcingAndJacobian<micm::Matrix>(3, false);
+  testFusedForcingAndJacobian<micm::Matrix>(3, true);
+  testFusedForcingAndJacobian<Block3VectorMatrix, micm::SparseMatrix<double, micm::SparseMatrixVectorOrdering<3>>>(5, false);
+  testFusedForcingAndJacobian<Block4VectorMatrix, micm::SparseMatrix<double, micm::SparseMatrixVectorOrdering<4>>>(5, true);
+  // reactions with more reactants than the fused kernel buffers hold use the separate kernels
+  testFusedForcingAndJacobian<micm::Matrix>(3, false, 10);
+  testFusedForcingAndJacobian<Block3VectorMatrix, micm::SparseMatrix<double, micm::SparseMatrixVectorOrdering<3>>>(5, false, 10);
+}
+
+// The species-major forcing calculation matches the reaction-major one
+template<template<class> class MatrixPolicy>
+void testForcingByGather(std::size_t number_of_grid_cells)
+{
+  std::vector<micm::Species> species;
+  auto state = allArityState<MatrixPolicy>(species, number_of_grid_cells);
+  auto processes = allArityProcesses(species);
+  micm::ProcessSet set{ processes, state };
+
+  MatrixPolicy<double> rate_constants{ number_of_grid_cells, processes.size() };
+  for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)
+    for (std::size_t i_rxn = 0; i_rxn < processes.size(); ++i_rxn)
+      rate_constants[i_cell][i_rxn] = 1.0 + 0.01 * i_rxn + 0.2 * i_cell;
+
+  MatrixPolicy<double> forcing{ number_of_grid_cells, species.size(), 1.0 };
+  MatrixPolicy<double> gather_forcing{ number_of_grid_cells, species.size(), 1.0 };
+  // the rates storage is overwritten, so stale values do not affect the result
+  MatrixPolicy<double> rates{ number_of_grid_cells, processes.size(), -1.0e10 };
+  set.AddForcingTerms<MatrixPolicy>(rate_constants, state.variables_, forcing);
+  set.AddForcingTermsByGather<MatrixPolicy>(rate_constants, state.variables_, gather_forcing, rates);
+  for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)
+    for (std::size_t i_species = 0; i_species < species.size(); ++i_species)
+      EXPECT_NEAR(gather_forcing[i_cell][i_species], forcing[i_cell][i_species], 1.0e-10 * std::abs(forcing[i_cell][i_species]));
+}
+
+TEST(ProcessSet, ForcingByGather)
+{
+  testForcingByGather<micm::Matrix>(3);
+  testForcingByGather<Block3VectorMatrix>(5);
+  testForcingByGather<Block4VectorMatrix>(5);
+}
+
+// Only the active grid cells (or, for vector-ordered matrices, the groups with an active grid cell) are
+// calculated; the forcing and Jacobian of the other grid cells are left unchanged
+template<template<class> class MatrixPolicy, class SparseMatrixPolicy = micm::SparseMatrix<double>>
+void testActiveGridCells(const std::vector<bool>& is_active, std::size_t group_size, bool bucket_by_arity)
+{
+  const std::size_t number_of_grid_cells = is_active.size();
+  std::vector<micm::Species> species;
+  auto state = allArityState<MatrixPolicy>(species, number_of_grid_cells);
+  auto processes = allArityProcesses(species);
+  micm::ProcessSet set{ processes, state, bucket_by_arity };
+
+  MatrixPolicy<double> rate_constants{ number_of_grid_cells, processes.size() };
+  for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)
+    for (std::size_t i_rxn = 0; i_rxn < processes.size(); ++i_rxn)
+      rate_constants[i_cell][i_rxn] = 1.0 + 0.01 * i_rxn + 0.2 * i_cell;
+
+  auto non_zero_elements = set.NonZeroJacobianElements();
+  auto builder = SparseMatrixPolicy::create(species.size()).number_of_blocks(number_of_grid_cells);
+  for (auto& elem : non_zero_elements)
+    builder = builder.with_element(elem.first, elem.second);
+  SparseMatrixPolicy jacobian{ builder };
+  builder.initial_value(1.0);  // the masked calculations start from 1 instead of 0
+  SparseMatrixPolicy masked_jacobian{ builder };
+  SparseMatrixPolicy fused_jacobian{ builder };
+  set.SetJacobianFlatIds(jacobian);
+
+  MatrixPolicy<double> forcing{ number_of_grid_cells, species.size(), 0.0 };
+  MatrixPolicy<double> masked_forcing{ number_of_grid_cells, species.size(), 1.0 };
+  MatrixPolicy<double> gather_forcing{ number_of_grid_cells, species.size(), 1.0 };
+  MatrixPolicy<double> fused_forcing{ number_of_grid_cells, species.size(), 1.0 };
+  MatrixPolicy<double> rates{ number_of_grid_cells, processes.size(), 0.0 };
+  set.AddForcingTerms<MatrixPolicy>(rate_constants, state.variables_, forcing);
+  set.AddJacobianTerms<MatrixPolicy>(rate_constants, state.variables_, jacobian);
+  set.AddForcingTerms<MatrixPolicy>(rate_constants, state.variables_, masked_forcing, is_active);
+  set.AddJacobianTerms<MatrixPolicy>(rate_constants, state.variables_, masked_jacobian, is_active);
+  set.AddForcingTermsByGather<MatrixPolicy>(rate_constants, state.variables_, gather_forcing, rates, is_active);
+  set.AddForcingAndJacobianTerms<MatrixPolicy>(rate_constants, state.variables_, fused_forcing, fused_jacobian, is_active);
+
+  for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)
+  {
+    const bool is_calculated = micm::IsAnyGridCellActive(is_active, i_cell - i_cell % group_size, group_size);
+    EXPECT_TRUE(is_calculated || !is_active[i_cell]);
+    for (std::size_t i_species = 0; i_species < species.size(); ++i_species)
+    {
+      const double expected = is_calculated ? forcing[i_cell][i_species] + 1.0 : 1.0;
+      EXPECT_NEAR(masked_forcing[i_cell][i_species], expected, 1.0e-10 * std::abs(expected));
+      EXPECT_NEAR(gather_forcing[i_cell][i_species], expected, 1.0e-10 * std::abs(expected));
+      EXPECT_NEAR(fused_forcing[i_cell][i_species], expected, 1.0e-10 * std::abs(expected));
+    }
+    for (auto& elem : non_zero_elements)
+    {
+      const double expected = is_calculated ? jacobian[i_cell][elem.first][elem.second] + 1.0 : 1.0;
+      EXPECT_NEAR(masked_jacobian[i_cell][elem.first][elem.second], expected, 1.0e-10 * std::abs(expected));
+      EXPECT_NEAR(fused_jacobian[i_cell][elem.first][elem.second], expected, 1.0e-10 * std::abs(expected));
+    }
+  }
+}
+
+TEST(ProcessSet, ActiveGridCells)
+{
+  const std::vector<bool> is_active{ false, true, false, false, false, true, false };
+  testActiveGridCells<micm::Matrix>(is_active, 1, false);
+  testActiveGridCells<micm::Matrix>(is_active, 1, true);
+  // the first group of 3 grid cells has an active grid cell, the second one does not
+  testActiveGridCells<Block3VectorMatrix, micm::SparseMatrix<double, micm::SparseMatrixVectorOrdering<3>>>(
+      is_active, 3, false);
+  testActiveGridCells<Block3VectorMatrix, micm::SparseMatrix<double, micm::SparseMatrixVectorOrdering<3>>>(
+      is_active, 3, true);
+}
@@ -0,0 +1,35 @@
+// A small mechanism with a variety of reaction types for tests of the solver code generator
+#pragma once
+
+#include <micm/process/arrhenius_rate_constant.hpp>
+#include <micm/process/process.hpp>
+#include <micm/system/phase.hpp>
+#include <micm/system/system.hpp>
+#include <utility>
+#include <vector>
+
+inline std::pair<micm::System, std::vector<micm::Process>> codeGeneratorTestMechanism()
+{
+  using yields = std::pair<micm::Species, double>;
+  auto a = micm::Species("A");
+  auto b = micm::Species("B");
+  auto c = micm::Species("C");
+  auto d = micm::Species("D");
+  auto e = micm::Species("E");
+  micm::Phase gas_phase{ std::vector<micm::Species>{ a, b, c, d, e } };
+  auto rate = micm::ArrheniusRateConstant({ .A_ = 1.0 });
+
+  std::vector<micm::Process> processes{
+    micm::Process::create().reactants({ a, c }).products({ yields(b, 1), yields(e, 2.4) }).rate_constant(rate).phase(gas_phase),
+    micm::Process::create().reactants({ b }).products({ yields(a, 1), yields(d, 1.4) }).rate_constant(rate).phase(gas_phase),
+    micm::Process::create().reactants({ d }).products({}).rate_constant(rate).phase(gas_phase),
+    micm::Process::create().reactants({ a, a }).products({ yields(c, 1) }).rate_constant(rate).phase(gas_phase),
+    micm::Process::create().reactants({}).products({ yields(e, 0.3) }).rate_constant(rate).phase(gas_phase),
+    micm::Process::create()
+        .reactants({ b, c, d })
+        .products({ yields(a, 1), yields(c, 0.5) })
+        .rate_constant(rate)
+        .phase(gas_phase)
+  };
+  return { micm::System(micm::SystemParameters{ .gas_phase_ = gas_phase }), processes };
+}
@@ -0,0 +1,20 @@
+// Writes the generated solver kernels for the code generator test mechanism to the file given as the first argument
+#include <fstream>
+#include <iostream>
+#include <micm/solver/solver_code_generator.hpp>
+
+#include "code_generator_test_mechanism.hpp"
+
+int main(int argc, char** argv)
+{
+  if (argc != 2)
+  {
+    std::cerr << "usage: " << argv[0] << " <output header>\n";
+    return 1;
+  }
+  auto mechanism = codeGeneratorTestMechanism();
+  std::ofstream header(argv[1]);
+  header << micm::GenerateSolverSource(
+      mechanism.first, mechanism.second, micm::SolverCodeGeneratorParameters{ .namespace_ = "test_mechanism" });
+  return header ? 0 : 1;
+}
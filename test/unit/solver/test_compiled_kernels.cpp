@@ -0,0 +1,203 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <micm/solver/compiled_kernels.hpp>
+#include <micm/solver/rosenbrock.hpp>
+#include <micm/util/matrix.hpp>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "code_generator_test_mechanism.hpp"
+
+namespace
+{
+  // an empty cache directory for each test and process (with MPI, every rank runs the tests at the same time)
+  std::filesystem::path cacheDirectory(const std::string& name)
+  {
+    auto path = std::filesystem::temp_directory_path() /
+                ("micm_test_kernel_cache_" + name + "_" + std::to_string(static_cast<long>(getpid())));
+    std::filesystem::remove_all(path);
+    return path;
+  }
+
+  micm::CompiledKernelsParameters kernelParameters(const std::filesystem::path& cache_directory)
+  {
+    return micm::CompiledKernelsParameters{ .cache_directory_ = cache_directory.string(),
+                                            .compiler_ = MICM_TEST_CXX_COMPILER };
+  }
+
+  micm::Solver::SolverResult solveTestMechanism(micm::RosenbrockSolver<micm::Matrix>& solver)
+  {
+    auto state = solver.GetState();
+    for (std::size_t i_cell = 0; i_cell < state.variables_.size(); ++i_cell)
+    {
+      state.conditions_[i_cell].temperature_ = 272.5;
+      state.conditions_[i_cell].pressure_ = 101253.3;
+      for (std::size_t i = 0; i < state.variables_[i_cell].size(); ++i)
+        state.variables_[i_cell][i] = 1.0 + 0.5 * i + 0.1 * i_cell;
+    }
+    solver.UpdateState(state);
+    return solver.Solve(0.0, 1.0, state);
+  }
+}  // namespace
+
+TEST(CompiledKernels, Hash)
+{
+  EXPECT_EQ(micm::CompiledKernels::Hash(""), "cbf29ce484222325");
+  EXPECT_EQ(micm::CompiledKernels::Hash("a"), "af63dc4c8601ec8c");
+  EXPECT_NE(micm::CompiledKernels::Hash("A -> B"), micm::CompiledKernels::Hash("A -> C"));
+}
+
+TEST(CompiledKernels, CompilesAndCachesMechanism)
+{
+  auto cache_directory = cacheDirectory("compile");
+  auto mechanism = codeGeneratorTestMechanism();
+  micm::CompiledKernels kernels(mechanism.first, mechanism.second, kernelParameters(cache_directory));
+  ASSERT_TRUE(kernels.IsLoaded());
+  EXPECT_TRUE(std::filesystem::exists(kernels.LibraryPath()));
+  EXPECT_EQ(kernels.LibraryPath().parent_path(), cache_directory);
+
+  // only the library is left in the cache
+  std::size_t number_of_files = 0;
+  for (const auto& entry : std::filesystem::directory_iterator(cache_directory))
+  {
+    EXPECT_EQ(entry.path().extension(), ".so");
+    ++number_of_files;
+  }
+  EXPECT_EQ(number_of_files, 1);
+
+  // the same mechanism is loaded from the cache without compiling it again
+  auto write_time = std::filesystem::last_write_time(kernels.LibraryPath());
+  micm::CompiledKernels cached(mechanism.first, mechanism.second, kernelParameters(cache_directory));
+  EXPECT_TRUE(cached.IsLoaded());
+  EXPECT_EQ(cached.LibraryPath(), kernels.LibraryPath());
+  EXPECT_EQ(std::filesystem::last_write_time(cached.LibraryPath()), write_time);
+
+  // a different mechanism gets its own library
+  mechanism.second.pop_back();
+  micm::CompiledKernels other(mechanism.first, mechanism.second, kernelParameters(cache_directory));
+  ASSERT_TRUE(other.IsLoaded());
+  EXPECT_NE(other.LibraryPath(), kernels.LibraryPath());
+
+  std::filesystem::remove_all(cache_directory);
+}
+
+TEST(CompiledKernels, DefaultCacheDirectoryIsPerUser)
+{
+  const char* xdg_cache_home = std::getenv("XDG_CACHE_HOME");
+  const std::string saved = xdg_cache_home ? xdg_cache_home : "";
+  setenv("XDG_CACHE_HOME", "/micm/xdg", 1);
+  EXPECT_EQ(micm::CompiledKernels::DefaultCacheDirectory(), std::filesystem::path("/micm/xdg/micm"));
+  unsetenv("XDG_CACHE_HOME");
+  if (std::getenv("HOME"))
+  {
+    EXPECT_EQ(
+        micm::CompiledKernels::DefaultCacheDirectory(), std::filesystem::path(std::getenv("HOME")) / ".cache" / "micm");
+  }
+  if (xdg_cache_home)
+    setenv("XDG_CACHE_HOME", saved.c_str(), 1);
+}
+
+TEST(CompiledKernels, OnlyLoadsPrivateLibraries)
+{
+  // a new cache directory can only be written by its owner
+  auto cache_directory = cacheDirectory("private");
+  auto mechanism = codeGeneratorTestMechanism();
+  micm::CompiledKernels kernels(mechanism.first, mechanism.second, kernelParameters(cache_directory));
+  ASSERT_TRUE(kernels.IsLoaded());
+  EXPECT_EQ(std::filesystem::status(cache_directory).permissions(), std::filesystem::perms::owner_all);
+  EXPECT_TRUE(micm::CompiledKernels::IsPrivate(kernels.LibraryPath()));
+
+  // a cached library that others can write to is rebuilt
+  std::filesystem::permissions(
+      kernels.LibraryPath(), std::filesystem::perms::others_write, std::filesystem::perm_options::add);
+  EXPECT_FALSE(micm::CompiledKernels::IsPrivate(kernels.LibraryPath()));
+  micm::CompiledKernels rebuilt(mechanism.first, mechanism.second, kernelParameters(cache_directory));
+  ASSERT_TRUE(rebuilt.IsLoaded());
+  EXPECT_EQ(rebuilt.LibraryPath(), kernels.LibraryPath());
+  EXPECT_TRUE(micm::CompiledKernels::IsPrivate(rebuilt.LibraryPath()));
+
+  // a cache directory that others can write to is not used
+  std::filesystem::permissions(cache_directory, std::filesystem::perms::others_write, std::filesystem::perm_options::add);
+  micm::CompiledKernels shared(mechanism.first, mechanism.second, kernelParameters(cache_directory));
+  EXPECT_FALSE(shared.IsLoaded());
+
+  std::filesystem::remove_all(cache_directory);
+}
+
+TEST(CompiledKernels, ConcurrentBuilds)
+{
+  // solvers built at the same time in one process compile the same mechanism under different temporary names
+  auto cache_directory = cacheDirectory("concurrent");
+  auto mechanism = codeGeneratorTestMechanism();
+  std::vector<std::unique_ptr<micm::CompiledKernels>> kernels(2);
+  std::vector<std::thread> threads;
+  const auto parameters = kernelParameters(cache_directory);
+  for (auto& kernel : kernels)
+    threads.emplace_back(
+        [&]() { kernel = std::make_unique<micm::CompiledKernels>(mechanism.first, mechanism.second, parameters); });
+  for (auto& thread : threads)
+    thread.join();
+  ASSERT_TRUE(kernels[0]->IsLoaded());
+  ASSERT_TRUE(kernels[1]->IsLoaded());
+  EXPECT_EQ(kernels[0]->LibraryPath(), kernels[1]->LibraryPath());
+  std::size_t number_of_files = 0;
+  for ([[maybe_unused]] const auto& entry : std::filesystem::directory_iterator(cache_directory))
+    ++number_of_files;
+  EXPECT_EQ(number_of_files, 1);
+
+  std::filesystem::remove_all(cache_directory);
+}
+
+TEST(CompiledKernels, FallsBackWithoutCompiler)
+{
+  auto cache_directory = cacheDirectory("no_compiler");
+  auto mechanism = codeGeneratorTestMechanism();
+  auto parameters = kernelParameters(cache_directory);
+  parameters.compiler_ = "micm-compiler-that-does-not-exist";
+  micm::CompiledKernels kernels(mechanism.first, mechanism.second, parameters);
+  EXPECT_FALSE(kernels.IsLoaded());
+  EXPECT_TRUE(std::filesystem::is_empty(cache_directory));
+
+  micm::RosenbrockSolver<micm::Matrix> solver{ mechanism.first,
+                                               std::move(mechanism.second),
+                                               micm::RosenbrockSolverParameters{
+                                                   .compile_kernels_ = true, .compiled_kernels_parameters_ = parameters } };
+  EXPECT_FALSE(solver.compiled_kernels_.IsLoaded());
+  EXPECT_EQ(solveTestMechanism(solver).state_, micm::Solver::SolverState::Converged);
+
+  std::filesystem::remove_all(cache_directory);
+}
+
+TEST(CompiledKernels, RosenbrockSolverMatchesGeneralKernels)
+{
+  auto cache_directory = cacheDirectory("rosenbrock");
+  auto mechanism = codeGeneratorTestMechanism();
+  micm::RosenbrockSolver<micm::Matrix> general{ mechanism.first,
+                                                std::vector<micm::Process>(mechanism.second),
+                                                micm::RosenbrockSolverParameters{ .number_of_grid_cells_ = 3 } };
+  micm::RosenbrockSolver<micm::Matrix> compiled{ mechanism.first,
+                                                 std::move(mechanism.second),
+                                                 micm::RosenbrockSolverParameters{
+                                                     .number_of_grid_cells_ = 3,
+                                                     .compile_kernels_ = true,
+                                                     .compiled_kernels_parameters_ = kernelParameters(cache_directory) } };
+  EXPECT_FALSE(general.compiled_kernels_.IsLoaded());
+  ASSERT_TRUE(compiled.compiled_kernels_.IsLoaded());
+
+  auto general_result = solveTestMechanism(general);
+  auto compiled_result = solveTestMechanism(compiled);
+  EXPECT_EQ(general_result.state_, micm::Solver::SolverState::Converged);
+  EXPECT_EQ(compiled_result.state_, micm::Solver::SolverState::Converged);
+  EXPECT_EQ(compiled_result.stats_.accepted, general_result.stats_.accepted);
+  ASSERT_EQ(compiled_result.result_.size(), general_result.result_.size());
+  for (std::size_t i = 0; i < general_result.result_.size(); ++i)
+    EXPECT_NEAR(compiled_result.result_[i], general_result.result_[i], 1.0e-10 * std::abs(general_result.result_[i]));
+
+  std::filesystem::remove_all(cache_directory);
+}
@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+#include <mpi.h>
+
+#include <cmath>
+#include <micm/process/arrhenius_rate_constant.hpp>
+#include <micm/process/process.hpp>
+#include <micm/solver/distributed_solver.hpp>
+#include <micm/system/phase.hpp>
+#include <micm/system/system.hpp>
+#include <micm/util/matrix.hpp>
+#include <utility>
+#include <vector>
+
+using yields = std::pair<micm::Species, double>;
+
+TEST(DistributedSolver, PartitionGridCells)
+{
+  EXPECT_EQ(micm::PartitionGridCells(std::vector<double>(10, 1.0), 3), (std::vector<std::size_t>{ 0, 3, 7, 10 }));
+  EXPECT_EQ(micm::PartitionGridCells(std::vector<double>(10, 0.0), 2), (std::vector<std::size_t>{ 0, 5, 10 }));
+  EXPECT_EQ(micm::PartitionGridCells(std::vector<double>(3, 1.0), 3), (std::vector<std::size_t>{ 0, 1, 2, 3 }));
+
+  // an expensive grid cell gets a range to itself, and every range gets at least one grid cell
+  std::vector<double> cost{ 10.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0 };
+  EXPECT_EQ(micm::PartitionGridCells(cost, 2), (std::vector<std::size_t>{ 0, 1, 10 }));
+  cost = { 1.0, 1.0, 1.0, 100.0 };
+  EXPECT_EQ(micm::PartitionGridCells(cost, 3), (std::vector<std::size_t>{ 0, 2, 3, 4 }));
+
+  EXPECT_ANY_THROW(micm::PartitionGridCells(std::vector<double>(2, 1.0), 3));
+}
+
+// A -k1-> B -k2-> C in each grid cell, with the first half of the grid cells 10 times stiffer than the rest
+TEST(DistributedSolver, RebalancesStiffGridCells)
+{
+  auto a = micm::Species("A");
+  auto b = micm::Species("B");
+  auto c = micm::Species("C");
+  micm::Phase gas_phase{ std::vector<micm::Species>{ a, b, c } };
+  micm::Process r1 = micm::Process::create()
+                         .reactants({ a })
+                         .products({ yields(b, 1) })
+                         .rate_constant(micm::ArrheniusRateConstant({ .A_ = 1.0 }))
+                         .phase(gas_phase);
+  micm::Process r2 = micm::Process::create()
+                         .reactants({ b })
+                         .products({ yields(c, 1) })
+                         .rate_constant(micm::ArrheniusRateConstant({ .A_ = 1.0 }))
+                         .phase(gas_phase);
+
+  const std::size_t number_of_grid_cells = 8;
+  micm::DistributedSolver<micm::Matrix> solver{ micm::System(micm::SystemParameters{ .gas_phase_ = gas_phase }),
+                                                std::vector<micm::Process>{ r1, r2 },
+                                                micm::RosenbrockSolverParameters{ .per_cell_step_control_ = true },
+                                                micm::DistributedSolverParameters{
+                                                    .number_of_grid_cells_ = number_of_grid_cells,
+                                                    .rebalance_interval_ = 1 } };
+  int number_of_ranks;
+  MPI_Comm_size(MPI_COMM_WORLD, &number_of_ranks);
+
+  auto rate_constants = [&](std::size_t global_cell)
+  { return global_cell < number_of_grid_cells / 2 ? std::make_pair(9.0, 3.0) : std::make_pair(0.9, 0.3); };
+
+  micm::State<micm::Matrix> state = solver.GetState();
+  for (std::size_t i_cell = 0; i_cell < solver.NumberOfLocalGridCells(); ++i_cell)
+  {
+    auto k = rate_constants(solver.FirstLocalGridCell() + i_cell);
+    state.conditions_[i_cell].temperature_ = 298.15;
+    state.variables_[i_cell] = { 1.0, 0.0, 0.0 };
+    state.rate_constants_[i_cell] = { k.first, k.second };
+  }
+  const std::size_t initial_first_stiff_rank_cells = solver.NumberOfLocalGridCells();
+
+  double time = 0.0;
+  for (int i_step = 0; i_step < 3; ++i_step)
+  {
+    auto result = solver.Solve(time, time + 1.0, state);
+    EXPECT_EQ(result.state_, micm::Solver::SolverState::Converged);
+    time += 1.0;
+    state.variables_.AsVector() = result.result_;
+    EXPECT_EQ(solver.NeedsRebalance(), number_of_ranks > 1);
+    if (solver.NeedsRebalance())
+      solver.Rebalance(state);
+
+    // every grid cell is owned by exactly one rank, and its data moved with it
+    unsigned long local_cells = solver.NumberOfLocalGridCells();
+    unsigned long total_cells = 0;
+    MPI_Allreduce(&local_cells, &total_cells, 1, MPI_UNSIGNED_LONG, MPI_SUM, MPI_COMM_WORLD);
+    EXPECT_EQ(total_cells, number_of_grid_cells);
+    ASSERT_EQ(state.variables_.size(), solver.NumberOfLocalGridCells());
+    for (std::size_t i_cell = 0; i_cell < solver.NumberOfLocalGridCells(); ++i_cell)
+    {
+      auto k = rate_constants(solver.FirstLocalGridCell() + i_cell);
+      EXPECT_EQ(state.rate_constants_[i_cell][0], k.first);
+      EXPECT_EQ(state.conditions_[i_cell].temperature_, 298.15);
+      double A = std::exp(-k.first * time);
+      double B = k.first / (k.second - k.first) * (std::exp(-k.first * time) - std::exp(-k.second * time));
+      EXPECT_NEAR(state.variables_[i_cell][0], A, 1.0e-3);
+      EXPECT_NEAR(state.variables_[i_cell][1], B, 1.0e-3);
+      EXPECT_NEAR(state.variables_[i_cell][2], 1.0 - A - B, 1.0e-3);
+    }
+  }
+
+  // the rank that started with the stiff grid cells ends up with fewer of them
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  if (number_of_ranks > 1 && rank == 0)
+  {
+    EXPECT_LT(solver.NumberOfLocalGridCells(), initial_first_stiff_rank_cells);
+  }
+}
+
+// The method selected for the local solver is kept when a rebalance changes the number of local grid cells
+TEST(DistributedSolver, RebalanceKeepsTableau)
+{
+  auto a = micm::Species("A");
+  auto b = micm::Species("B");
+  micm::Phase gas_phase{ std::vector<micm::Species>{ a, b } };
+  micm::Process r1 = micm::Process::create()
+                         .reactants({ a })
+                         .products({ yields(b, 1) })
+                         .rate_constant(micm::ArrheniusRateConstant({ .A_ = 1.0 }))
+                         .phase(gas_phase);
+  micm::System system(micm::SystemParameters{ .gas_phase_ = gas_phase });
+  micm::RosenbrockSolverParameters parameters{ .per_cell_step_control_ = true };
+
+  const std::size_t number_of_grid_cells = 8;
+  micm::DistributedSolver<micm::Matrix> solver{ system,
+                                                std::vector<micm::Process>{ r1 },
+                                                parameters,
+                                                micm::DistributedSolverParameters{
+                                                    .number_of_grid_cells_ = number_of_grid_cells,
+                                                    .rebalance_interval_ = 1 } };
+  solver.LocalSolver().SetTableau<micm::Rodas4Tableau>();
+
+  // the last grid cell is much stiffer than the rest, so the grid cells are moved toward it
+  auto set_state = [&](micm::State<micm::Matrix>& state)
+  {
+    for (std::size_t i_cell = 0; i_cell < solver.NumberOfLocalGridCells(); ++i_cell)
+    {
+      state.conditions_[i_cell].temperature_ = 298.15;
+      state.variables_[i_cell] = { 1.0, 0.0 };
+      state.rate_constants_[i_cell] = { solver.FirstLocalGridCell() + i_cell + 1 == number_of_grid_cells ? 100.0 : 1.0 };
+    }
+  };
+  micm::State<micm::Matrix> state = solver.GetState();
+  set_state(state);
+  EXPECT_EQ(solver.Solve(0.0, 1.0, state).state_, micm::Solver::SolverState::Converged);
+  solver.Rebalance(state);
+  set_state(state);
+
+  EXPECT_EQ(solver.LocalSolver().parameters_.number_of_grid_cells_, solver.NumberOfLocalGridCells());
+  EXPECT_EQ(solver.LocalSolver().parameters_.stages_, micm::Rodas4Tableau::stages_);
+  EXPECT_EQ(solver.LocalSolver().workspace_.K_.size(), micm::Rodas4Tableau::stages_);
+
+  // the local solve matches a Rodas4 solver built for the new local grid cells
+  parameters.number_of_grid_cells_ = solver.NumberOfLocalGridCells();
+  micm::RosenbrockSolver<micm::Matrix> expected_solver{ system, std::vector<micm::Process>{ r1 }, parameters };
+  expected_solver.SetTableau<micm::Rodas4Tableau>();
+  auto result = solver.Solve(1.0, 2.0, state);
+  auto expected_result = expected_solver.Solve(1.0, 2.0, state);
+  EXPECT_EQ(result.state_, micm::Solver::SolverState::Converged);
+  EXPECT_EQ(result.result_, expected_result.result_);
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  MPI_Init(&argc, &argv);
+  int result = RUN_ALL_TESTS();
+  MPI_Finalize();
+  return result;
+}
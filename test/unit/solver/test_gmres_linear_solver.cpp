@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <micm/solver/gmres_linear_solver.hpp>
+#include <micm/solver/linear_solver.hpp>
+#include <micm/util/matrix.hpp>
+#include <micm/util/sparse_matrix.hpp>
+#include <micm/util/vector_matrix.hpp>
+#include <vector>
+
+#include "test_linear_solver_policy.hpp"
+
+template<class T>
+using Group3VectorMatrix = micm::VectorMatrix<T, 3>;
+
+template<template<class> class MatrixPolicy>
+void testRandomMatrix(std::size_t number_of_blocks, const std::vector<std::size_t>& species_order)
+{
+  micm::GmresWorkspace<double, MatrixPolicy> workspace;
+  std::size_t iterations =
+      testRandomMatrixSolve<MatrixPolicy, micm::GmresLinearSolver<double>>(number_of_blocks, species_order, workspace, 1.0e-9);
+  EXPECT_GT(iterations, 0);
+  EXPECT_LE(iterations, 12);
+  EXPECT_TRUE(workspace.IsConverged());
+}
+
+TEST(GmresLinearSolver, RandomMatrix)
+{
+  testRandomMatrix<micm::Matrix>(1, {});
+  testRandomMatrix<micm::Matrix>(5, {});
+  testRandomMatrix<Group3VectorMatrix>(5, {});
+}
+
+TEST(GmresLinearSolver, IncompleteFactors)
+{
+  // the ILU(0) preconditioner has no fill-in
+  const std::size_t n = 12;
+  auto A = randomMatrix(n, 2);
+  auto LU = micm::GmresLinearSolver<double>::GetLUMatrices(A);
+  EXPECT_EQ(LU.first.FlatBlockSize() + LU.second.FlatBlockSize(), A.FlatBlockSize() + n);
+}
+
+TEST(GmresLinearSolver, ReorderedMatrix)
+{
+  testRandomMatrix<micm::Matrix>(4, { 11, 3, 0, 5, 7, 1, 4, 10, 2, 9, 6, 8 });
+}
+
+TEST(GmresLinearSolver, Restarts)
+{
+  // a Krylov subspace of 2 vectors needs several restarts to converge
+  const std::size_t n = 12;
+  auto A = randomMatrix(n, 2);
+  micm::Matrix<double> b(2, n, 1.0);
+  micm::Matrix<double> x(2, n, 0.0);
+  micm::Matrix<double> x_direct(2, n, 0.0);
+  micm::LinearSolver<double> direct_solver(A);
+  direct_solver.Factor(A);
+  direct_solver.Solve<micm::Matrix>(b, x_direct);
+
+  micm::GmresLinearSolver<double> solver(A, {}, micm::GmresParameters{ .max_iterations_ = 2, .max_restarts_ = 100 });
+  auto LU = micm::GmresLinearSolver<double>::GetLUMatrices(A);
+  solver.Factor(A, LU.first, LU.second);
+  // the workspace is allocated by the first solve
+  micm::GmresWorkspace<double, micm::Matrix> workspace;
+  std::size_t iterations = solver.Solve<micm::Matrix>(b, x, A, LU.first, LU.second, workspace);
+  EXPECT_GT(iterations, 2);
+  EXPECT_TRUE(workspace.IsConverged());
+  EXPECT_EQ(workspace.max_krylov_size_, 2);
+  for (std::size_t i_block = 0; i_block < 2; ++i_block)
+    for (std::size_t i = 0; i < n; ++i)
+      EXPECT_NEAR(x[i_block][i], x_direct[i_block][i], 1.0e-9 * std::abs(x_direct[i_block][i]));
+}
+
+TEST(GmresLinearSolver, ZeroRightHandSide)
+{
+  auto A = randomMatrix(5, 2);
+  micm::Matrix<double> b(2, 5, 0.0);
+  micm::Matrix<double> x(2, 5, 1.0);
+  micm::GmresLinearSolver<double> solver(A);
+  auto LU = micm::GmresLinearSolver<double>::GetLUMatrices(A);
+  solver.Factor(A, LU.first, LU.second);
+  micm::GmresWorkspace<double, micm::Matrix> workspace;
+  EXPECT_EQ(solver.Solve<micm::Matrix>(b, x, A, LU.first, LU.second, workspace), 0);
+  EXPECT_TRUE(workspace.IsConverged());
+  for (auto& elem : x.AsVector())
+    EXPECT_EQ(elem, 0.0);
+}
+
+TEST(GmresLinearSolver, NotConverged)
+{
+  // a single iteration without restarts cannot reach the tolerance
+  const std::size_t n = 12;
+  auto A = randomMatrix(n, 2);
+  micm::Matrix<double> b(2, n, 1.0);
+  micm::Matrix<double> x(2, n, 0.0);
+  micm::GmresLinearSolver<double> solver(A, {}, micm::GmresParameters{ .max_iterations_ = 1, .max_restarts_ = 0 });
+  auto LU = micm::GmresLinearSolver<double>::GetLUMatrices(A);
+  solver.Factor(A, LU.first, LU.second);
+  micm::GmresWorkspace<double, micm::Matrix> workspace;
+  EXPECT_EQ(solver.Solve<micm::Matrix>(b, x, A, LU.first, LU.second, workspace), 1);
+  EXPECT_FALSE(workspace.IsConverged());
+}
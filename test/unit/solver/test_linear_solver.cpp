@@ -0,0 +1,314 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <functional>
+#include <micm/solver/linear_solver.hpp>
+#include <micm/util/matrix.hpp>
+#include <micm/util/sparse_matrix.hpp>
+#include <micm/util/vector_matrix.hpp>
+#include <random>
+
+#include "test_linear_solver_policy.hpp"
+
+// Multiplies each block of the sparse matrix A by the corresponding row of x
+template<template<class> class MatrixPolicy>
+MatrixPolicy<double> multiply(const micm::SparseMatrix<double>& A, const MatrixPolicy<double>& x)
+{
+  MatrixPolicy<double> b(x.size(), x[0].size(), 0.0);
+  for (std::size_t i_block = 0; i_block < A.size(); ++i_block)
+    for (std::size_t i = 0; i < A[i_block].size(); ++i)
+      for (std::size_t j = 0; j < A[i_block].size(); ++j)
+        if (!A.IsZero(i, j))
+          b[i_block][i] += A[i_block][i][j] * x[i_block][j];
+  return b;
+}
+
+template<template<class> class MatrixPolicy>
+void testRandomMatrix(std::size_t number_of_blocks)
+{
+  auto A = randomMatrix(10, number_of_blocks);
+  auto x = randomVector<MatrixPolicy>(10, number_of_blocks);
+
+  auto b = multiply<MatrixPolicy>(A, x);
+  MatrixPolicy<double> x_solved(number_of_blocks, 10, 0.0);
+
+  micm::LinearSolver<double> solver(A);
+  solver.Factor(A);
+  solver.template Solve<MatrixPolicy>(b, x_solved);
+
+  for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+    for (std::size_t i = 0; i < 10; ++i)
+      EXPECT_NEAR(x_solved[i_block][i], x[i_block][i], 1.0e-10);
+
+  // the solve can also be done in place
+  solver.template Solve<MatrixPolicy>(b, b);
+  for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+    for (std::size_t i = 0; i < 10; ++i)
+      EXPECT_NEAR(b[i_block][i], x[i_block][i], 1.0e-10);
+}
+
+template<class T>
+using Group3VectorMatrix = micm::VectorMatrix<T, 3>;
+
+TEST(LinearSolver, DenseMatrix)
+{
+  micm::SparseMatrix<double> A = micm::SparseMatrix<double>::create(3)
+                                     .with_element(0, 0)
+                                     .with_element(0, 1)
+                                     .with_element(0, 2)
+                                     .with_element(1, 0)
+                                     .with_element(1, 1)
+                                     .with_element(1, 2)
+                                     .with_element(2, 0)
+                                     .with_element(2, 1)
+                                     .with_element(2, 2);
+
+  A[0][0][0] = 2;
+  A[0][0][1] = -1;
+  A[0][0][2] = -2;
+  A[0][1][0] = -4;
+  A[0][1][1] = 6;
+  A[0][1][2] = 3;
+  A[0][2][0] = -4;
+  A[0][2][1] = -2;
+  A[0][2][2] = 8;
+
+  micm::Matrix<double> b(1, 3);
+  b[0] = { 23, 42, 9 };
+  micm::Matrix<double> x(1, 3);
+
+  micm::LinearSolver<double> solver(A);
+  solver.Factor(A);
+  solver.Solve<micm::Matrix>(b, x);
+
+  auto check = multiply<micm::Matrix>(A, x);
+  for (std::size_t i = 0; i < 3; ++i)
+    EXPECT_NEAR(check[0][i], b[0][i], 1.0e-10);
+}
+
+TEST(LinearSolver, RandomMatrix)
+{
+  testRandomMatrix<micm::Matrix>(1);
+  testRandomMatrix<micm::Matrix>(5);
+  testRandomMatrix<Group3VectorMatrix>(5);
+}
+
+TEST(LinearSolver, RefactorWithFillIn)
+{
+  // A structurally zero element that fills in during factorization must be
+  // recalculated from scratch on each call to Factor
+  auto builder = micm::SparseMatrix<double>::create(3)
+                     .with_element(0, 0)
+                     .with_element(0, 2)
+                     .with_element(1, 1)
+                     .with_element(2, 0)
+                     .with_element(2, 1)
+                     .with_element(2, 2)
+                     .with_element(1, 2);
+  micm::SparseMatrix<double> A(builder);
+  micm::LinearSolver<double> solver(A);
+
+  micm::Matrix<double> x(1, 3);
+  x[0] = { 1.0, 2.0, 3.0 };
+  for (double scale : { 1.0, 2.0, 5.0 })
+  {
+    A[0][0][0] = 4.0 * scale;
+    A[0][0][2] = 1.0;
+    A[0][1][1] = 3.0 * scale;
+    A[0][1][2] = -1.0;
+    A[0][2][0] = 2.0;
+    A[0][2][1] = 1.0;
+    A[0][2][2] = 5.0 * scale;
+    auto b = multiply<micm::Matrix>(A, x);
+    micm::Matrix<double> x_solved(1, 3);
+    solver.Factor(A);
+    solver.Solve<micm::Matrix>(b, x_solved);
+    for (std::size_t i = 0; i < 3; ++i)
+      EXPECT_NEAR(x_solved[0][i], x[0][i], 1.0e-12);
+  }
+}
+
+// The rows and columns of the factored matrix are reordered, while b and x keep the original order
+TEST(LinearSolver, ReorderedMatrix)
+{
+  auto gen_bool = std::bind(std::uniform_int_distribution<>(0, 1), std::default_random_engine());
+  auto get_double = std::bind(std::lognormal_distribution(-2.0, 2.0), std::default_random_engine());
+  const std::size_t n = 10;
+  const std::size_t number_of_blocks = 3;
+  const std::vector<std::size_t> species_order{ 3, 7, 0, 9, 1, 4, 8, 2, 6, 5 };
+  std::vector<std::size_t> row(n);
+  for (std::size_t i = 0; i < n; ++i)
+    row[species_order[i]] = i;
+
+  auto builder = micm::SparseMatrix<double>::create(n).number_of_blocks(number_of_blocks);
+  auto reordered_builder = micm::SparseMatrix<double>::create(n).number_of_blocks(number_of_blocks);
+  for (std::size_t i = 0; i < n; ++i)
+    for (std::size_t j = 0; j < n; ++j)
+      if (i == j || gen_bool())
+      {
+        builder = builder.with_element(i, j);
+        reordered_builder = reordered_builder.with_element(row[i], row[j]);
+      }
+  micm::SparseMatrix<double> A(builder);
+  micm::SparseMatrix<double> reordered_A(reordered_builder);
+  micm::Matrix<double> x(number_of_blocks, n, 0.0);
+  for (std::size_t i = 0; i < n; ++i)
+    for (std::size_t j = 0; j < n; ++j)
+      if (!A.IsZero(i, j))
+        for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+          reordered_A[i_block][row[i]][row[j]] = A[i_block][i][j] = get_double() + (i == j ? 10.0 : 0.0);
+  for (std::size_t i = 0; i < n; ++i)
+    for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+      x[i_block][i] = get_double();
+  auto b = multiply<micm::Matrix>(A, x);
+
+  micm::LinearSolver<double> solver(reordered_A, species_order);
+  solver.Factor(reordered_A);
+  micm::Matrix<double> x_solved(number_of_blocks, n, 0.0);
+  solver.Solve<micm::Matrix>(b, x_solved);
+  for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+    for (std::size_t i = 0; i < n; ++i)
+      EXPECT_NEAR(x_solved[i_block][i], x[i_block][i], 1.0e-10);
+
+  solver.Solve<micm::Matrix>(b, b);
+  for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+    for (std::size_t i = 0; i < n; ++i)
+      EXPECT_NEAR(b[i_block][i], x[i_block][i], 1.0e-10);
+}
+
+TEST(LinearSolver, ParallelLevels)
+{
+  auto gen_bool = std::bind(std::uniform_int_distribution<>(0, 4), std::default_random_engine());
+  auto get_double = std::bind(std::lognormal_distribution(-2.0, 2.0), std::default_random_engine());
+  const std::size_t n = 30;
+  const std::size_t number_of_blocks = 4;
+
+  auto builder = micm::SparseMatrix<double>::create(n).number_of_blocks(number_of_blocks);
+  for (std::size_t i = 0; i < n; ++i)
+    for (std::size_t j = 0; j < n; ++j)
+      if (i == j || gen_bool() == 0)
+        builder = builder.with_element(i, j);
+  micm::SparseMatrix<double> A(builder);
+  for (std::size_t i = 0; i < n; ++i)
+    for (std::size_t j = 0; j < n; ++j)
+      if (!A.IsZero(i, j))
+        for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+          A[i_block][i][j] = get_double() + (i == j ? 10.0 : 0.0);
+  micm::Matrix<double> x(number_of_blocks, n, 0.0);
+  for (std::size_t i = 0; i < n; ++i)
+    for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+      x[i_block][i] = get_double();
+  auto b = multiply<micm::Matrix>(A, x);
+
+  micm::LinearSolver<double> solver(A);
+  micm::LinearSolver<double> parallel_solver(A, {}, false, 4);
+  micm::Matrix<double> x_solved(number_of_blocks, n, 0.0);
+  micm::Matrix<double> x_parallel(number_of_blocks, n, 0.0);
+  solver.Factor(A);
+  solver.Solve<micm::Matrix>(b, x_solved);
+  parallel_solver.Factor(A);
+  parallel_solver.Solve<micm::Matrix>(b, x_parallel);
+  // the rows are solved with the same operations in the same order, only in a different sequence
+  EXPECT_EQ(x_parallel.AsVector(), x_solved.AsVector());
+  for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+    for (std::size_t i = 0; i < n; ++i)
+      EXPECT_NEAR(x_parallel[i_block][i], x[i_block][i], 1.0e-10 * std::abs(x[i_block][i]) + 1.0e-12);
+
+  parallel_solver.Solve<micm::Matrix>(b, b);
+  EXPECT_EQ(b.AsVector(), x_solved.AsVector());
+}
+
+TEST(LinearSolver, ParallelWideLevels)
+{
+  // an arrow matrix: every row but the last is independent in both substitutions, so the wide levels are shared
+  // among the threads and the single-row levels are run by one thread
+  const std::size_t n = 40;
+  const std::size_t number_of_blocks = 3;
+  auto builder = micm::SparseMatrix<double>::create(n).number_of_blocks(number_of_blocks);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    builder = builder.with_element(i, i).with_element(i, n - 1).with_element(n - 1, i);
+  }
+  micm::SparseMatrix<double> A(builder);
+  micm::Matrix<double> x(number_of_blocks, n, 0.0);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+    {
+      A[i_block][i][i] = 10.0 + i + i_block;
+      A[i_block][i][n - 1] = 0.1 * (i + 1);
+      A[i_block][n - 1][i] = 0.2 * (i + 1);
+      x[i_block][i] = 1.0 + 0.1 * i - 0.3 * i_block;
+    }
+  }
+  auto b = multiply<micm::Matrix>(A, x);
+
+  micm::LinearSolver<double> solver(A);
+  micm::LinearSolver<double> parallel_solver(A, {}, false, 4);
+  micm::Matrix<double> x_solved(number_of_blocks, n, 0.0);
+  micm::Matrix<double> x_parallel(number_of_blocks, n, 0.0);
+  solver.Factor(A);
+  solver.Solve<micm::Matrix>(b, x_solved);
+  parallel_solver.Factor(A);
+  parallel_solver.Solve<micm::Matrix>(b, x_parallel);
+  EXPECT_EQ(x_parallel.AsVector(), x_solved.AsVector());
+  for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+    for (std::size_t i = 0; i < n; ++i)
+      EXPECT_NEAR(x_parallel[i_block][i], x[i_block][i], 1.0e-10 * std::abs(x[i_block][i]) + 1.0e-12);
+}
+
+TEST(LinearSolver, VectorOrdering)
+{
+  // the arrow matrix of ParallelWideLevels, with 4 blocks in groups of 3, solved with vector-ordered L and U
+  using VectorSparseMatrix = micm::SparseMatrix<double, micm::SparseMatrixVectorOrdering<3>>;
+  const std::size_t n = 40;
+  const std::size_t number_of_blocks = 4;
+  auto builder = micm::SparseMatrix<double>::create(n).number_of_blocks(number_of_blocks);
+  auto vector_builder = VectorSparseMatrix::create(n).number_of_blocks(number_of_blocks);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    builder = builder.with_element(i, i).with_element(i, n - 1).with_element(n - 1, i);
+    vector_builder = vector_builder.with_element(i, i).with_element(i, n - 1).with_element(n - 1, i);
+  }
+  micm::SparseMatrix<double> A(builder);
+  VectorSparseMatrix vector_A(vector_builder);
+  micm::Matrix<double> x(number_of_blocks, n, 0.0);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+    {
+      vector_A[i_block][i][i] = A[i_block][i][i] = 10.0 + i + i_block;
+      vector_A[i_block][i][n - 1] = A[i_block][i][n - 1] = 0.1 * (i + 1);
+      vector_A[i_block][n - 1][i] = A[i_block][n - 1][i] = 0.2 * (i + 1);
+      x[i_block][i] = 1.0 + 0.1 * i - 0.3 * i_block;
+    }
+  }
+  auto b = multiply<micm::Matrix>(A, x);
+  Group3VectorMatrix<double> vector_b(number_of_blocks, n, 0.0);
+  for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+    for (std::size_t i = 0; i < n; ++i)
+      vector_b[i_block][i] = b[i_block][i];
+
+  micm::LinearSolver<double, micm::SparseMatrixVectorOrdering<3>> solver(vector_A);
+  micm::LinearSolver<double, micm::SparseMatrixVectorOrdering<3>> parallel_solver(vector_A, {}, false, 4);
+  Group3VectorMatrix<double> x_solved(number_of_blocks, n, 0.0);
+  Group3VectorMatrix<double> x_parallel(number_of_blocks, n, 0.0);
+  solver.Factor(vector_A);
+  solver.Solve<Group3VectorMatrix>(vector_b, x_solved);
+  parallel_solver.Factor(vector_A);
+  parallel_solver.Solve<Group3VectorMatrix>(vector_b, x_parallel);
+  // the padding blocks of the last group are not compared, as their zero pivots give NaN
+  for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+  {
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      EXPECT_EQ(x_parallel[i_block][i], x_solved[i_block][i]);
+      EXPECT_NEAR(x_parallel[i_block][i], x[i_block][i], 1.0e-10 * std::abs(x[i_block][i]) + 1.0e-12);
+    }
+  }
+
+  parallel_solver.Solve<Group3VectorMatrix>(vector_b, vector_b);
+  for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+    for (std::size_t i = 0; i < n; ++i)
+      EXPECT_EQ(vector_b[i_block][i], x_solved[i_block][i]);
+}
@@ -0,0 +1,82 @@
+// Random sparse systems for the tests of the linear solvers and the sparse matrix-vector product
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <functional>
+#include <micm/solver/linear_solver.hpp>
+#include <micm/util/sparse_matrix.hpp>
+#include <random>
+#include <vector>
+
+// A random sparse matrix with a dominant diagonal, which has fill-in when it is factored
+template<class SparseMatrixPolicy = micm::SparseMatrix<double>>
+SparseMatrixPolicy randomMatrix(std::size_t n, std::size_t number_of_blocks)
+{
+  auto gen_bool = std::bind(std::uniform_int_distribution<>(0, 3), std::default_random_engine());
+  auto get_double = std::bind(std::lognormal_distribution(-2.0, 1.0), std::default_random_engine());
+
+  auto builder = SparseMatrixPolicy::create(n).number_of_blocks(number_of_blocks);
+  for (std::size_t i = 0; i < n; ++i)
+    for (std::size_t j = 0; j < n; ++j)
+      if (i == j || gen_bool() == 0)
+        builder = builder.with_element(i, j);
+  SparseMatrixPolicy A(builder);
+  for (std::size_t i = 0; i < n; ++i)
+    for (std::size_t j = 0; j < n; ++j)
+      if (!A.IsZero(i, j))
+        for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+          A[i_block][i][j] = i == j ? 1.0 + 0.5 * i_block + get_double() : -get_double();
+  return A;
+}
+
+// Random values for each block (grid cell) and variable
+template<template<class> class MatrixPolicy>
+MatrixPolicy<double> randomVector(std::size_t n, std::size_t number_of_blocks)
+{
+  auto get_double = std::bind(std::lognormal_distribution(0.0, 1.0), std::default_random_engine());
+  MatrixPolicy<double> x(number_of_blocks, n, 0.0);
+  for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+    for (std::size_t i = 0; i < n; ++i)
+      x[i_block][i] = get_double();
+  return x;
+}
+
+// Solves Ax = b for a random A with a solver that refines the solution from A and its L and U factors (see
+// GmresLinearSolver and MixedPrecisionLinearSolver), and compares x with the solution of LinearSolver, for a
+// separate solution vector and in place
+// @return The number of iterations of the first solve
+template<template<class> class MatrixPolicy, class SolverPolicy, class WorkspacePolicy>
+std::size_t testRandomMatrixSolve(
+    std::size_t number_of_blocks,
+    const std::vector<std::size_t>& species_order,
+    WorkspacePolicy& workspace,
+    double tolerance)
+{
+  const std::size_t n = 12;
+  auto A = randomMatrix(n, number_of_blocks);
+  auto b = randomVector<MatrixPolicy>(n, number_of_blocks);
+
+  // the direct solution
+  micm::LinearSolver<double> direct_solver(A, species_order);
+  MatrixPolicy<double> x_direct(number_of_blocks, n, 0.0);
+  direct_solver.Factor(A);
+  direct_solver.template Solve<MatrixPolicy>(b, x_direct);
+
+  SolverPolicy solver(A, species_order);
+  auto LU = SolverPolicy::GetLUMatrices(A);
+  solver.Factor(A, LU.first, LU.second);
+  MatrixPolicy<double> x(number_of_blocks, n, 0.0);
+  std::size_t iterations = solver.template Solve<MatrixPolicy>(b, x, A, LU.first, LU.second, workspace);
+  for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+    for (std::size_t i = 0; i < n; ++i)
+      EXPECT_NEAR(x[i_block][i], x_direct[i_block][i], tolerance * std::abs(x_direct[i_block][i]));
+
+  // the solve can also be done in place, re-using the workspace
+  solver.template Solve<MatrixPolicy>(b, b, A, LU.first, LU.second, workspace);
+  for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+    for (std::size_t i = 0; i < n; ++i)
+      EXPECT_NEAR(b[i_block][i], x_direct[i_block][i], tolerance * std::abs(x_direct[i_block][i]));
+  return iterations;
+}
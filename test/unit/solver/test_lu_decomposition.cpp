@@ -1,15 +1,17 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cmath>
 #include <functional>
 #include <micm/solver/lu_decomposition.hpp>
 #include <micm/util/sparse_matrix.hpp>
 #include <random>
 
-template<class T>
+template<class T, class OrderingPolicy = micm::SparseMatrixStandardOrdering>
 void check_results(
-    const micm::SparseMatrix<T>& A,
-    const micm::SparseMatrix<T>& L,
-    const micm::SparseMatrix<T>& U,
+    const micm::SparseMatrix<T, OrderingPolicy>& A,
+    const micm::SparseMatrix<T, OrderingPolicy>& L,
+    const micm::SparseMatrix<T, OrderingPolicy>& U,
     const std::function<void(const T, const T)> f)
 {
   EXPECT_EQ(A.size(), L.size());
@@ -143,4 +145,428 @@ TEST(LuDecomposition, DiagonalOnly)
   auto LU = micm::LuDecomposition::GetLUMatrices(A);
   lud.Decompose(A, LU.first, LU.second);
   check_results<double>(A, LU.first, LU.second, [&](const double a, const double b) -> void { EXPECT_NEAR(a, b, 1.0e-5); });
-}
\ No newline at end of file
+}
+TEST(LuDecomposition, IncompleteDecomposition)
+{
+  auto gen_bool = std::bind(std::uniform_int_distribution<>(0, 2), std::default_random_engine());
+  auto get_double = std::bind(std::lognormal_distribution(-2.0, 2.0), std::default_random_engine());
+
+  auto builder = micm::SparseMatrix<double>::create(10).number_of_blocks(5);
+  for (std::size_t i = 0; i < 10; ++i)
+    for (std::size_t j = 0; j < 10; ++j)
+      if (i == j || gen_bool() == 0)
+        builder = builder.with_element(i, j);
+
+  micm::SparseMatrix<double> A(builder);
+
+  for (std::size_t i = 0; i < 10; ++i)
+    for (std::size_t j = 0; j < 10; ++j)
+      if (!A.IsZero(i, j))
+        for (std::size_t i_block = 0; i_block < 5; ++i_block)
+          A[i_block][i][j] = get_double() + (i == j ? 10.0 : 0.0);
+
+  // ILU(0): L and U keep the sparsity structure of A, and LU matches A on that structure
+  micm::LuDecomposition lud(A, true);
+  auto LU = micm::LuDecomposition::GetLUMatrices(A, true);
+  auto full_LU = micm::LuDecomposition::GetLUMatrices(A);
+  EXPECT_EQ(LU.first.FlatBlockSize() + LU.second.FlatBlockSize(), A.FlatBlockSize() + 10);
+  EXPECT_LT(LU.first.FlatBlockSize() + LU.second.FlatBlockSize(), full_LU.first.FlatBlockSize() + full_LU.second.FlatBlockSize());
+  lud.Decompose(A, LU.first, LU.second);
+  for (std::size_t i_block = 0; i_block < 5; ++i_block)
+  {
+    for (std::size_t i = 0; i < 10; ++i)
+    {
+      for (std::size_t j = 0; j < 10; ++j)
+      {
+        if (A.IsZero(i, j))
+          continue;
+        double result = 0.0;
+        for (std::size_t k = 0; k < 10; ++k)
+          if (!(LU.first.IsZero(i, k) || LU.second.IsZero(k, j)))
+            result += LU.first[i_block][i][k] * LU.second[i_block][k][j];
+        EXPECT_NEAR(result, A[i_block][i][j], 1.0e-10 * std::abs(A[i_block][i][j]) + 1.0e-12);
+      }
+    }
+  }
+}
+
+template<std::size_t L>
+void testVectorOrdering()
+{
+  using VectorSparseMatrix = micm::SparseMatrix<double, micm::SparseMatrixVectorOrdering<L>>;
+  auto gen_bool = std::bind(std::uniform_int_distribution<>(0, 1), std::default_random_engine());
+  auto get_double = std::bind(std::lognormal_distribution(-2.0, 4.0), std::default_random_engine());
+
+  auto builder = micm::SparseMatrix<double>::create(10).number_of_blocks(5);
+  auto vector_builder = VectorSparseMatrix::create(10).number_of_blocks(5);
+  for (std::size_t i = 0; i < 10; ++i)
+    for (std::size_t j = 0; j < 10; ++j)
+      if (i == j || gen_bool())
+      {
+        builder = builder.with_element(i, j);
+        vector_builder = vector_builder.with_element(i, j);
+      }
+
+  micm::SparseMatrix<double> A(builder);
+  VectorSparseMatrix vector_A(vector_builder);
+
+  for (std::size_t i = 0; i < 10; ++i)
+    for (std::size_t j = 0; j < 10; ++j)
+      if (!A.IsZero(i, j))
+        for (std::size_t i_block = 0; i_block < 5; ++i_block)
+          vector_A[i_block][i][j] = A[i_block][i][j] = get_double();
+
+  micm::LuDecomposition lud(A);
+  auto LU = micm::LuDecomposition::GetLUMatrices(A);
+  lud.Decompose(A, LU.first, LU.second);
+
+  micm::LuDecomposition vector_lud(vector_A);
+  auto vector_LU = micm::LuDecomposition::GetLUMatrices(vector_A);
+  EXPECT_EQ(vector_LU.first.FlatBlockSize(), LU.first.FlatBlockSize());
+  EXPECT_EQ(vector_LU.second.FlatBlockSize(), LU.second.FlatBlockSize());
+  vector_lud.Decompose(vector_A, vector_LU.first, vector_LU.second);
+  check_results<double, micm::SparseMatrixVectorOrdering<L>>(
+      vector_A,
+      vector_LU.first,
+      vector_LU.second,
+      [&](const double a, const double b) -> void { EXPECT_NEAR(a, b, 1.0e-5); });
+
+  // the same operations are applied to each grid cell as for the standard ordering
+  for (std::size_t i_block = 0; i_block < 5; ++i_block)
+  {
+    for (std::size_t i = 0; i < 10; ++i)
+    {
+      for (std::size_t j = 0; j < 10; ++j)
+      {
+        if (!LU.first.IsZero(i, j))
+        {
+          EXPECT_NEAR(vector_LU.first[i_block][i][j], LU.first[i_block][i][j], 1.0e-12 * std::abs(LU.first[i_block][i][j]));
+        }
+        if (!LU.second.IsZero(i, j))
+        {
+          EXPECT_NEAR(
+              vector_LU.second[i_block][i][j], LU.second[i_block][i][j], 1.0e-12 * std::abs(LU.second[i_block][i][j]));
+        }
+      }
+    }
+  }
+}
+
+TEST(LuDecomposition, VectorOrdering)
+{
+  testVectorOrdering<1>();
+  testVectorOrdering<3>();
+  testVectorOrdering<4>();
+}
+
+// A banded matrix with a few species that interact with every other species, as for large mechanisms
+// with a handful of radicals. The symbolic factorization must scale with the fill-in, not with n^3.
+TEST(LuDecomposition, LargeSparseMatrix)
+{
+  const std::size_t n = 3000;
+  auto get_double = std::bind(std::uniform_real_distribution<>(0.0, 1.0), std::default_random_engine());
+
+  auto builder = micm::SparseMatrix<double>::create(n).number_of_blocks(2);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    for (std::size_t j = (i < 3 ? 0 : i - 3); j < std::min(n, i + 4); ++j)
+      builder = builder.with_element(i, j);
+    for (std::size_t hub = n - 5; hub < n; ++hub)
+      builder = builder.with_element(i, hub).with_element(hub, i);
+  }
+  micm::SparseMatrix<double> A(builder);
+  const auto& row_start = A.RowStartVector();
+  const auto& row_ids = A.RowIdsVector();
+  for (std::size_t i_block = 0; i_block < 2; ++i_block)
+    for (std::size_t i = 0; i < n; ++i)
+      for (std::size_t id = row_start[i]; id < row_start[i + 1]; ++id)
+        A[i_block][i][row_ids[id]] = row_ids[id] == i ? 20.0 + get_double() : -get_double();
+
+  micm::LuDecomposition lud(A);
+  auto LU = micm::LuDecomposition::GetLUMatrices(A);
+  // fill-in is confined to the band and the rows and columns of the hub species
+  EXPECT_LT(LU.first.FlatBlockSize() + LU.second.FlatBlockSize(), A.FlatBlockSize() + 20 * n);
+  lud.Decompose(A, LU.first, LU.second);
+
+  // compare L U x with A x for a test vector
+  std::vector<double> x(n);
+  for (auto& elem : x)
+    elem = get_double();
+  auto product = [&](const micm::SparseMatrix<double>& M, std::size_t i_block, const std::vector<double>& v)
+  {
+    std::vector<double> result(n, 0.0);
+    for (std::size_t i = 0; i < n; ++i)
+      for (std::size_t id = M.RowStartVector()[i]; id < M.RowStartVector()[i + 1]; ++id)
+        result[i] += M[i_block][i][M.RowIdsVector()[id]] * v[M.RowIdsVector()[id]];
+    return result;
+  };
+  for (std::size_t i_block = 0; i_block < 2; ++i_block)
+  {
+    auto expected = product(A, i_block, x);
+    auto result = product(LU.first, i_block, product(LU.second, i_block, x));
+    for (std::size_t i = 0; i < n; ++i)
+      EXPECT_NEAR(result[i], expected[i], 1.0e-10 * (1.0 + std::abs(expected[i])));
+  }
+}
+
+template<class OrderingPolicy>
+void testSingularBlocks()
+{
+  auto A = micm::SparseMatrix<double, OrderingPolicy>(micm::SparseMatrix<double, OrderingPolicy>::create(3)
+                                                          .number_of_blocks(4)
+                                                          .with_element(0, 0)
+                                                          .with_element(0, 1)
+                                                          .with_element(1, 0)
+                                                          .with_element(1, 1)
+                                                          .with_element(2, 2));
+  for (std::size_t i_block = 0; i_block < 4; ++i_block)
+  {
+    A[i_block][0][0] = 2.0;
+    A[i_block][0][1] = 1.0;
+    A[i_block][1][0] = 1.0;
+    A[i_block][1][1] = 3.0;
+    A[i_block][2][2] = 1.0;
+  }
+  A[1][1][1] = 0.5;  // rows 0 and 1 are linearly dependent
+  A[2][2][2] = std::nan("");
+  A[3][1][1] = 0.5 + 1.0e-8;  // near-singular
+
+  micm::LuDecomposition lud(A);
+  auto LU = micm::LuDecomposition::GetLUMatrices(A);
+  lud.Decompose(A, LU.first, LU.second);
+  std::vector<bool> is_singular;
+  EXPECT_TRUE(micm::LuDecomposition::FindSingularBlocks(LU.second, 0.0, is_singular));
+  EXPECT_EQ(is_singular, std::vector<bool>({ false, true, true, false }));
+  EXPECT_TRUE(micm::LuDecomposition::FindSingularBlocks(LU.second, 1.0e-6, is_singular));
+  EXPECT_EQ(is_singular, std::vector<bool>({ false, true, true, true }));
+  // each block can have its own tolerance
+  EXPECT_TRUE(micm::LuDecomposition::FindSingularBlocks(LU.second, { 0.0, 0.0, 0.0, 1.0e-9 }, is_singular));
+  EXPECT_EQ(is_singular, std::vector<bool>({ false, true, true, false }));
+
+  A[1][1][1] = 3.0;
+  A[2][2][2] = 1.0;
+  A[3][1][1] = 3.0;
+  lud.Decompose(A, LU.first, LU.second);
+  EXPECT_FALSE(micm::LuDecomposition::FindSingularBlocks(LU.second, 1.0e-6, is_singular));
+  EXPECT_EQ(is_singular, std::vector<bool>(4, false));
+}
+
+TEST(LuDecomposition, SingularBlocks)
+{
+  testSingularBlocks<micm::SparseMatrixStandardOrdering>();
+  testSingularBlocks<micm::SparseMatrixVectorOrdering<3>>();
+}
+
+// Only the active blocks (or, for the vector ordering, the groups with an active block) are decomposed; the
+// L and U of the other blocks are left unchanged
+template<class OrderingPolicy>
+void testActiveBlocks(std::size_t number_of_threads)
+{
+  // the arrow matrix of ParallelWideLevels, which has a level with enough steps to run in parallel
+  const std::size_t n = 40;
+  const std::size_t number_of_blocks = 4;
+  auto builder = micm::SparseMatrix<double, OrderingPolicy>::create(n).number_of_blocks(number_of_blocks);
+  for (std::size_t i = 0; i < n; ++i)
+    builder = builder.with_element(i, i).with_element(i, n - 1).with_element(n - 1, i);
+  micm::SparseMatrix<double, OrderingPolicy> A(builder);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+    {
+      A[i_block][i][i] = 10.0 + i + i_block;
+      A[i_block][i][n - 1] = 0.1 * (i + 1);
+      A[i_block][n - 1][i] = 0.2 * (i + 1);
+    }
+  }
+
+  micm::LuDecomposition lud(A);
+  auto LU = micm::LuDecomposition::GetLUMatrices(A);
+  auto masked_LU = micm::LuDecomposition::GetLUMatrices(A);
+  std::fill(masked_LU.first.AsVector().begin(), masked_LU.first.AsVector().end(), -1.0);
+  std::fill(masked_LU.second.AsVector().begin(), masked_LU.second.AsVector().end(), -1.0);
+  lud.Decompose(A, LU.first, LU.second);
+  // only the last block is active, which is alone in the second group of 3 blocks
+  lud.Decompose(A, masked_LU.first, masked_LU.second, number_of_threads, { false, false, false, true });
+  for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+  {
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      for (std::size_t j = 0; j < n; ++j)
+      {
+        if (!LU.first.IsZero(i, j))
+        {
+          EXPECT_EQ(masked_LU.first[i_block][i][j], i_block == 3 ? LU.first[i_block][i][j] : -1.0);
+        }
+        if (!LU.second.IsZero(i, j))
+        {
+          EXPECT_EQ(masked_LU.second[i_block][i][j], i_block == 3 ? LU.second[i_block][i][j] : -1.0);
+        }
+      }
+    }
+  }
+}
+
+TEST(LuDecomposition, ActiveBlocks)
+{
+  testActiveBlocks<micm::SparseMatrixStandardOrdering>(1);
+  testActiveBlocks<micm::SparseMatrixStandardOrdering>(4);
+  testActiveBlocks<micm::SparseMatrixVectorOrdering<3>>(1);
+  testActiveBlocks<micm::SparseMatrixVectorOrdering<3>>(4);
+}
+
+TEST(LuDecomposition, Levels)
+{
+  // the steps of a diagonal matrix are independent, and each step of a dense matrix depends on the previous one
+  auto diagonal_builder = micm::SparseMatrix<double>::create(6);
+  auto dense_builder = micm::SparseMatrix<double>::create(4);
+  for (std::size_t i = 0; i < 6; ++i)
+    diagonal_builder = diagonal_builder.with_element(i, i);
+  for (std::size_t i = 0; i < 4; ++i)
+    for (std::size_t j = 0; j < 4; ++j)
+      dense_builder = dense_builder.with_element(i, j);
+  micm::LuDecomposition diagonal_lud{ micm::SparseMatrix<double>(diagonal_builder) };
+  micm::LuDecomposition dense_lud{ micm::SparseMatrix<double>(dense_builder) };
+  EXPECT_EQ(diagonal_lud.Levels().size(), 1);
+  EXPECT_EQ(diagonal_lud.Levels()[0].size(), 6);
+  EXPECT_EQ(dense_lud.Levels().size(), 4);
+
+  // two independent chains joined by a last row
+  micm::SparseMatrix<double> chains{ micm::SparseMatrix<double>::create(5)
+                                         .with_element(0, 0)
+                                         .with_element(1, 1)
+                                         .with_element(2, 0)
+                                         .with_element(2, 2)
+                                         .with_element(3, 1)
+                                         .with_element(3, 3)
+                                         .with_element(4, 2)
+                                         .with_element(4, 3)
+                                         .with_element(4, 4) };
+  micm::LuDecomposition chains_lud(chains);
+  ASSERT_EQ(chains_lud.Levels().size(), 3);
+  EXPECT_EQ(chains_lud.Levels()[0], (std::vector<std::size_t>{ 0, 1 }));
+  EXPECT_EQ(chains_lud.Levels()[1], (std::vector<std::size_t>{ 2, 3 }));
+  EXPECT_EQ(chains_lud.Levels()[2], (std::vector<std::size_t>{ 4 }));
+  auto lower_levels = micm::LuDecomposition::GetSubstitutionLevels(micm::LuDecomposition::GetLUMatrices(chains).first, true);
+  EXPECT_EQ(lower_levels, chains_lud.Levels());
+  auto upper_levels = micm::LuDecomposition::GetSubstitutionLevels(micm::LuDecomposition::GetLUMatrices(chains).second, false);
+  ASSERT_EQ(upper_levels.size(), 1);
+  EXPECT_EQ(upper_levels[0].size(), 5);
+}
+
+TEST(LuDecomposition, ParallelLevels)
+{
+  auto gen_bool = std::bind(std::uniform_int_distribution<>(0, 4), std::default_random_engine());
+  auto get_double = std::bind(std::lognormal_distribution(-2.0, 1.0), std::default_random_engine());
+  const std::size_t n = 40;
+
+  auto builder = micm::SparseMatrix<double>::create(n).number_of_blocks(3);
+  for (std::size_t i = 0; i < n; ++i)
+    for (std::size_t j = 0; j < n; ++j)
+      if (i == j || gen_bool() == 0)
+        builder = builder.with_element(i, j);
+  micm::SparseMatrix<double> A(builder);
+  for (std::size_t i = 0; i < n; ++i)
+    for (std::size_t j = 0; j < n; ++j)
+      if (!A.IsZero(i, j))
+        for (std::size_t i_block = 0; i_block < 3; ++i_block)
+          A[i_block][i][j] = get_double() + (i == j ? 10.0 : 0.0);
+
+  micm::LuDecomposition lud(A);
+  EXPECT_LT(lud.Levels().size(), n);
+  auto LU = micm::LuDecomposition::GetLUMatrices(A);
+  auto parallel_LU = micm::LuDecomposition::GetLUMatrices(A);
+  lud.Decompose(A, LU.first, LU.second);
+  lud.Decompose(A, parallel_LU.first, parallel_LU.second, 4);
+  // each element is calculated with the same operations in the same order
+  EXPECT_EQ(LU.first.AsVector(), parallel_LU.first.AsVector());
+  EXPECT_EQ(LU.second.AsVector(), parallel_LU.second.AsVector());
+  check_results<double>(
+      A, parallel_LU.first, parallel_LU.second, [&](const double a, const double b) -> void { EXPECT_NEAR(a, b, 1.0e-10); });
+}
+
+TEST(LuDecomposition, ParallelWideLevels)
+{
+  // an arrow matrix: every row but the last only depends on the last column, so the first level has n - 1
+  // steps, which are shared among the threads, and the last level has one step, which is run by one thread
+  const std::size_t n = 40;
+  auto builder = micm::SparseMatrix<double>::create(n).number_of_blocks(3);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    builder = builder.with_element(i, i).with_element(i, n - 1).with_element(n - 1, i);
+  }
+  micm::SparseMatrix<double> A(builder);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    for (std::size_t i_block = 0; i_block < 3; ++i_block)
+    {
+      A[i_block][i][i] = 10.0 + i + i_block;
+      A[i_block][i][n - 1] = 0.1 * (i + 1);
+      A[i_block][n - 1][i] = 0.2 * (i + 1);
+    }
+  }
+
+  micm::LuDecomposition lud(A);
+  const auto& levels = lud.Levels();
+  ASSERT_EQ(levels.size(), 2);
+  EXPECT_GE(levels[0].size(), micm::LuDecomposition::MIN_PARALLEL_LEVEL_SIZE);
+  EXPECT_LT(levels[1].size(), micm::LuDecomposition::MIN_PARALLEL_LEVEL_SIZE);
+  auto LU = micm::LuDecomposition::GetLUMatrices(A);
+  auto parallel_LU = micm::LuDecomposition::GetLUMatrices(A);
+  lud.Decompose(A, LU.first, LU.second);
+  lud.Decompose(A, parallel_LU.first, parallel_LU.second, 4);
+  EXPECT_EQ(LU.first.AsVector(), parallel_LU.first.AsVector());
+  EXPECT_EQ(LU.second.AsVector(), parallel_LU.second.AsVector());
+  check_results<double>(
+      A, parallel_LU.first, parallel_LU.second, [&](const double a, const double b) -> void { EXPECT_NEAR(a, b, 1.0e-10); });
+}
+
+TEST(LuDecomposition, ParallelVectorOrdering)
+{
+  // the arrow matrix of ParallelWideLevels, with 4 blocks in groups of 3
+  using VectorSparseMatrix = micm::SparseMatrix<double, micm::SparseMatrixVectorOrdering<3>>;
+  const std::size_t n = 40;
+  const std::size_t number_of_blocks = 4;
+  auto builder = VectorSparseMatrix::create(n).number_of_blocks(number_of_blocks);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    builder = builder.with_element(i, i).with_element(i, n - 1).with_element(n - 1, i);
+  }
+  VectorSparseMatrix A(builder);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+    {
+      A[i_block][i][i] = 10.0 + i + i_block;
+      A[i_block][i][n - 1] = 0.1 * (i + 1);
+      A[i_block][n - 1][i] = 0.2 * (i + 1);
+    }
+  }
+
+  micm::LuDecomposition lud(A);
+  ASSERT_EQ(lud.Levels().size(), 2);
+  EXPECT_GE(lud.Levels()[0].size(), micm::LuDecomposition::MIN_PARALLEL_LEVEL_SIZE);
+  auto LU = micm::LuDecomposition::GetLUMatrices(A);
+  auto parallel_LU = micm::LuDecomposition::GetLUMatrices(A);
+  lud.Decompose(A, LU.first, LU.second);
+  lud.Decompose(A, parallel_LU.first, parallel_LU.second, 4);
+  // the padding blocks of the last group are not compared, as their zero pivots give NaN
+  for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+  {
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      for (std::size_t j = 0; j < n; ++j)
+      {
+        if (!LU.first.IsZero(i, j))
+        {
+          EXPECT_EQ(parallel_LU.first[i_block][i][j], LU.first[i_block][i][j]);
+        }
+        if (!LU.second.IsZero(i, j))
+        {
+          EXPECT_EQ(parallel_LU.second[i_block][i][j], LU.second[i_block][i][j]);
+        }
+      }
+    }
+  }
+  check_results<double, micm::SparseMatrixVectorOrdering<3>>(
+      A, parallel_LU.first, parallel_LU.second, [&](const double a, const double b) -> void { EXPECT_NEAR(a, b, 1.0e-10); });
+}
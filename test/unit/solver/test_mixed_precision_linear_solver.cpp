@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <micm/solver/linear_solver.hpp>
+#include <micm/solver/mixed_precision_linear_solver.hpp>
+#include <micm/util/matrix.hpp>
+#include <micm/util/sparse_matrix.hpp>
+#include <micm/util/vector_matrix.hpp>
+#include <type_traits>
+#include <vector>
+
+#include "test_linear_solver_policy.hpp"
+
+template<class T>
+using Group3VectorMatrix = micm::VectorMatrix<T, 3>;
+
+template<template<class> class MatrixPolicy>
+void testRandomMatrix(std::size_t number_of_blocks, const std::vector<std::size_t>& species_order)
+{
+  micm::MixedPrecisionWorkspace<double, float, MatrixPolicy> workspace;
+  std::size_t sweeps = testRandomMatrixSolve<MatrixPolicy, micm::MixedPrecisionLinearSolver<double>>(
+      number_of_blocks, species_order, workspace, 1.0e-11);
+  EXPECT_GT(sweeps, 0);
+  EXPECT_LE(sweeps, 2);
+}
+
+TEST(MixedPrecisionLinearSolver, RandomMatrix)
+{
+  testRandomMatrix<micm::Matrix>(1, {});
+  testRandomMatrix<micm::Matrix>(5, {});
+  testRandomMatrix<Group3VectorMatrix>(5, {});
+}
+
+TEST(MixedPrecisionLinearSolver, LowPrecisionFactors)
+{
+  // the factors have the sparsity structure of the direct factorization, in float
+  auto A = randomMatrix(12, 2);
+  auto LU = micm::MixedPrecisionLinearSolver<double>::GetLUMatrices(A);
+  auto direct_LU = micm::LuDecomposition::GetLUMatrices(A);
+  static_assert(std::is_same_v<decltype(LU.first), micm::SparseMatrix<float>>);
+  EXPECT_EQ(LU.first.FlatBlockSize(), direct_LU.first.FlatBlockSize());
+  EXPECT_EQ(LU.second.FlatBlockSize(), direct_LU.second.FlatBlockSize());
+}
+
+TEST(MixedPrecisionLinearSolver, ReorderedMatrix)
+{
+  testRandomMatrix<micm::Matrix>(4, { 11, 3, 0, 5, 7, 1, 4, 10, 2, 9, 6, 8 });
+}
+
+TEST(MixedPrecisionLinearSolver, Refinement)
+{
+  // without refinement, the solution has the accuracy of the float factorization
+  const std::size_t n = 12;
+  auto A = randomMatrix(n, 2);
+  micm::Matrix<double> b(2, n, 1.0);
+  micm::Matrix<double> x_direct(2, n, 0.0);
+  micm::LinearSolver<double> direct_solver(A);
+  direct_solver.Factor(A);
+  direct_solver.Solve<micm::Matrix>(b, x_direct);
+
+  auto LU = micm::MixedPrecisionLinearSolver<double>::GetLUMatrices(A);
+  double unrefined_error = 0.0;
+  double refined_error = 0.0;
+  for (std::size_t max_refinements : { 0, 2 })
+  {
+    micm::MixedPrecisionLinearSolver<double> solver(
+        A, {}, micm::MixedPrecisionParameters{ .max_refinements_ = max_refinements, .relative_tolerance_ = 0.0 });
+    solver.Factor(A, LU.first, LU.second);
+    micm::Matrix<double> x(2, n, 0.0);
+    // the workspace is allocated by the first solve
+    micm::MixedPrecisionWorkspace<double, float, micm::Matrix> workspace;
+    EXPECT_EQ(solver.Solve<micm::Matrix>(b, x, A, LU.first, LU.second, workspace), max_refinements);
+    EXPECT_EQ(workspace.number_of_blocks_, 2);
+    double& error = max_refinements == 0 ? unrefined_error : refined_error;
+    for (std::size_t i_block = 0; i_block < 2; ++i_block)
+      for (std::size_t i = 0; i < n; ++i)
+        error = std::max(error, std::abs(x[i_block][i] - x_direct[i_block][i]) / std::abs(x_direct[i_block][i]));
+  }
+  EXPECT_GT(unrefined_error, 1.0e-12);
+  EXPECT_LT(unrefined_error, 1.0e-5);
+  EXPECT_LT(refined_error, 1.0e-12);
+}
+
+TEST(MixedPrecisionLinearSolver, ZeroRightHandSide)
+{
+  auto A = randomMatrix(5, 2);
+  micm::Matrix<double> b(2, 5, 0.0);
+  micm::Matrix<double> x(2, 5, 1.0);
+  micm::MixedPrecisionLinearSolver<double> solver(A);
+  auto LU = micm::MixedPrecisionLinearSolver<double>::GetLUMatrices(A);
+  solver.Factor(A, LU.first, LU.second);
+  micm::MixedPrecisionWorkspace<double, float, micm::Matrix> workspace(2, 5);
+  EXPECT_EQ(solver.Solve<micm::Matrix>(b, x, A, LU.first, LU.second, workspace), 0);
+  for (auto& elem : x.AsVector())
+    EXPECT_EQ(elem, 0.0);
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include <micm/solver/lu_decomposition.hpp>
+#include <micm/solver/reordering.hpp>
+#include <micm/util/sparse_matrix.hpp>
+#include <numeric>
+#include <set>
+#include <utility>
+#include <vector>
+
+using index_pairs = std::set<std::pair<std::size_t, std::size_t>>;
+
+// Number of non-zero elements in the LU factors of a matrix with the given structure and row (and column) order
+std::size_t factorSize(std::size_t n, const index_pairs& elements, const std::vector<std::size_t>& order)
+{
+  std::vector<std::size_t> row(n);
+  for (std::size_t i = 0; i < n; ++i)
+    row[order[i]] = i;
+  auto builder = micm::SparseMatrix<double>::create(n);
+  for (const auto& elem : elements)
+    builder = builder.with_element(row[elem.first], row[elem.second]);
+  for (std::size_t i = 0; i < n; ++i)
+    builder = builder.with_element(i, i);
+  micm::SparseMatrix<double> matrix{ builder };
+  auto LU = micm::LuDecomposition::GetLUMatrices(matrix);
+  return LU.first.AsVector().size() + LU.second.AsVector().size();
+}
+
+TEST(DiagonalMarkowitzReordering, ArrowMatrix)
+{
+  // every species depends on species 0 and species 0 depends on every species, which fills in the whole matrix
+  // when species 0 is eliminated first
+  const std::size_t n = 8;
+  index_pairs elements;
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    elements.insert({ i, i });
+    elements.insert({ 0, i });
+    elements.insert({ i, 0 });
+  }
+  std::vector<std::size_t> natural(n);
+  std::iota(natural.begin(), natural.end(), 0);
+
+  auto order = micm::DiagonalMarkowitzReordering(n, elements);
+  ASSERT_EQ(order.size(), n);
+  EXPECT_EQ(std::set<std::size_t>(order.begin(), order.end()).size(), n);
+  EXPECT_EQ(factorSize(n, elements, natural), n * n + n);
+  EXPECT_EQ(factorSize(n, elements, order), 3 * n - 2 + n);
+}
+
+TEST(DiagonalMarkowitzReordering, KeepsOrderWithoutFillIn)
+{
+  // a tridiagonal matrix has no fill-in, so it keeps its order
+  const std::size_t n = 6;
+  index_pairs elements;
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    elements.insert({ i, i });
+    if (i > 0)
+    {
+      elements.insert({ i, i - 1 });
+      elements.insert({ i - 1, i });
+    }
+  }
+  std::vector<std::size_t> natural(n);
+  std::iota(natural.begin(), natural.end(), 0);
+  EXPECT_EQ(micm::DiagonalMarkowitzReordering(n, elements), natural);
+  EXPECT_EQ(micm::DiagonalMarkowitzReordering(n, index_pairs{}), natural);
+}
+
+TEST(DiagonalMarkowitzReordering, UnsymmetricStructure)
+{
+  // species 0 produces all the others but does not depend on them, so eliminating it first creates no fill-in
+  const std::size_t n = 5;
+  index_pairs elements;
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    elements.insert({ i, 0 });
+    elements.insert({ i, (i + 1) % n });
+  }
+  auto order = micm::DiagonalMarkowitzReordering(n, elements);
+  std::vector<std::size_t> natural(n);
+  std::iota(natural.begin(), natural.end(), 0);
+  EXPECT_LE(factorSize(n, elements, order), factorSize(n, elements, natural));
+  EXPECT_EQ(std::set<std::size_t>(order.begin(), order.end()).size(), n);
+}
@@ -1,10 +1,1240 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <micm/process/arrhenius_rate_constant.hpp>
+#include <micm/process/process.hpp>
+#include <micm/solver/lu_decomposition.hpp>
 #include <micm/solver/rosenbrock.hpp>
 #include <micm/solver/solver.hpp>
+#include <micm/system/phase.hpp>
+#include <micm/system/system.hpp>
 #include <micm/util/matrix.hpp>
+#include <micm/util/vector_matrix.hpp>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using yields = std::pair<micm::Species, double>;
 
 TEST(ChapmanODESolver, DefaultConstructor)
 {
   micm::RosenbrockSolver<micm::Matrix> solver{};
-}
\ No newline at end of file
+}
+
+// A -k1-> B -k2-> C
+std::pair<micm::System, std::vector<micm::Process>> decayMechanism(double k1, double k2)
+{
+  auto a = micm::Species("A");
+  auto b = micm::Species("B");
+  auto c = micm::Species("C");
+
+  micm::Phase gas_phase{ std::vector<micm::Species>{ a, b, c } };
+
+  micm::Process r1 = micm::Process::create()
+                         .reactants({ a })
+                         .products({ yields(b, 1) })
+                         .rate_constant(micm::ArrheniusRateConstant({ .A_ = k1 }))
+                         .phase(gas_phase);
+
+  micm::Process r2 = micm::Process::create()
+                         .reactants({ b })
+                         .products({ yields(c, 1) })
+                         .rate_constant(micm::ArrheniusRateConstant({ .A_ = k2 }))
+                         .phase(gas_phase);
+
+  return std::make_pair(
+      micm::System(micm::SystemParameters{ .gas_phase_ = gas_phase }), std::vector<micm::Process>{ r1, r2 });
+}
+
+template<template<class> class MatrixPolicy>
+micm::RosenbrockSolver<MatrixPolicy>
+getDecaySolver(double k1, double k2, const micm::RosenbrockSolverParameters& parameters)
+{
+  auto [system, processes] = decayMechanism(k1, k2);
+  return micm::RosenbrockSolver<MatrixPolicy>{ system, std::move(processes), parameters };
+}
+
+// A radical X that reacts with every other species, so that the Jacobian fills in when X is the first species
+std::pair<micm::System, std::vector<micm::Process>> hubMechanism()
+{
+  auto x = micm::Species("X");
+  std::vector<micm::Species> species{ x };
+  for (std::size_t i = 0; i < 6; ++i)
+    species.push_back(micm::Species("S" + std::to_string(i)));
+  micm::Phase gas_phase{ species };
+  std::vector<micm::Process> processes;
+  for (std::size_t i = 1; i < species.size(); ++i)
+  {
+    processes.push_back(micm::Process::create()
+                            .reactants({ x, species[i] })
+                            .products({ yields(species[i % (species.size() - 1) + 1], 1) })
+                            .rate_constant(micm::ArrheniusRateConstant({ .A_ = 0.1 * i }))
+                            .phase(gas_phase));
+    processes.push_back(micm::Process::create()
+                            .reactants({ species[i] })
+                            .products({ yields(x, 1) })
+                            .rate_constant(micm::ArrheniusRateConstant({ .A_ = 0.05 * i }))
+                            .phase(gas_phase));
+  }
+  return std::make_pair(micm::System(micm::SystemParameters{ .gas_phase_ = gas_phase }), processes);
+}
+
+// A state for a solver with different concentrations and rate constants in each grid cell
+template<template<class> class MatrixPolicy>
+micm::State<MatrixPolicy> gridCellState(const micm::RosenbrockSolver<MatrixPolicy>& solver)
+{
+  auto state = solver.GetState();
+  for (std::size_t i_cell = 0; i_cell < solver.parameters_.number_of_grid_cells_; ++i_cell)
+  {
+    for (std::size_t i = 0; i < state.variables_[i_cell].size(); ++i)
+      state.variables_[i_cell][i] = 1.0 + 0.1 * i + 0.5 * i_cell;
+    for (std::size_t i_rxn = 0; i_rxn < state.rate_constants_[i_cell].size(); ++i_rxn)
+      state.rate_constants_[i_cell][i_rxn] = 0.05 * (i_rxn + 1) * (1.0 + 0.2 * i_cell);
+  }
+  return state;
+}
+
+// How closely a variant of a solver has to reproduce the solution of the reference solver
+struct SolutionAgreement
+{
+  double relative_tolerance_{ 0.0 };  // 0 for identical solutions
+  bool same_number_of_steps_{ true };
+  double time_end_{ 1.0 };
+};
+
+// Solves the same state with a reference solver and a variant of it, and checks that both converge and that the
+// variant reproduces the solution of each grid cell. The results are returned for any further checks.
+template<
+    template<class> class MatrixPolicy,
+    template<class> class VariantMatrixPolicy = MatrixPolicy,
+    micm::RosenbrockTableau Tableau = micm::Ros3Tableau>
+std::pair<micm::Solver::SolverResult, micm::Solver::SolverResult> expectSameSolution(
+    const std::pair<micm::System, std::vector<micm::Process>>& mechanism,
+    const micm::RosenbrockSolverParameters& reference_parameters,
+    const micm::RosenbrockSolverParameters& variant_parameters,
+    const SolutionAgreement& agreement = {})
+{
+  micm::RosenbrockSolver<MatrixPolicy> solver{ mechanism.first,
+                                               std::vector<micm::Process>(mechanism.second),
+                                               reference_parameters };
+  micm::RosenbrockSolver<VariantMatrixPolicy> variant_solver{ mechanism.first,
+                                                              std::vector<micm::Process>(mechanism.second),
+                                                              variant_parameters };
+  solver.template SetTableau<Tableau>();
+  variant_solver.template SetTableau<Tableau>();
+  auto state = gridCellState(solver);
+  auto variant_state = gridCellState(variant_solver);
+  auto result = solver.Solve(0.0, agreement.time_end_, state);
+  auto variant_result = variant_solver.Solve(0.0, agreement.time_end_, variant_state);
+  EXPECT_EQ(result.state_, micm::Solver::SolverState::Converged);
+  EXPECT_EQ(variant_result.state_, micm::Solver::SolverState::Converged);
+  if (agreement.same_number_of_steps_)
+  {
+    EXPECT_EQ(variant_result.stats_.number_of_steps, result.stats_.number_of_steps);
+  }
+  state.variables_.AsVector() = result.result_;
+  variant_state.variables_.AsVector() = variant_result.result_;
+  for (std::size_t i_cell = 0; i_cell < reference_parameters.number_of_grid_cells_; ++i_cell)
+    for (std::size_t i = 0; i < state.variables_[i_cell].size(); ++i)
+      EXPECT_NEAR(
+          variant_state.variables_[i_cell][i],
+          state.variables_[i_cell][i],
+          agreement.relative_tolerance_ * std::abs(state.variables_[i_cell][i]))
+          << "grid cell " << i_cell << " variable " << i;
+  return std::make_pair(result, variant_result);
+}
+
+// A -k1-> B -k2-> C, which has the analytical solution:
+//   A(t) = A0 exp(-k1 t)
+//   B(t) = A0 k1 / (k2 - k1) [ exp(-k1 t) - exp(-k2 t) ]
+//   C(t) = A0 - A(t) - B(t)
+TEST(RosenbrockSolver, AnalyticalFirstOrderDecay)
+{
+  const double k1 = 0.9;
+  const double k2 = 0.3;
+  auto solver = getDecaySolver<micm::Matrix>(k1, k2, { .number_of_grid_cells_ = 1 });
+
+  micm::State<micm::Matrix> state = solver.GetState();
+  state.conditions_[0].temperature_ = 298.15;
+  state.conditions_[0].pressure_ = 101325.0;
+  state.variables_[0] = { 1.0, 0.0, 0.0 };
+  solver.UpdateState(state);
+
+  const double A0 = 1.0;
+  double time = 0.0;
+  for (int i_step = 0; i_step < 10; ++i_step)
+  {
+    auto result = solver.Solve(time, time + 1.0, state);
+    EXPECT_EQ(result.state_, micm::Solver::SolverState::Converged);
+    time += 1.0;
+    state.variables_.AsVector() = result.result_;
+    double A = A0 * std::exp(-k1 * time);
+    double B = A0 * k1 / (k2 - k1) * (std::exp(-k1 * time) - std::exp(-k2 * time));
+    double C = A0 - A - B;
+    EXPECT_NEAR(state.variables_[0][0], A, 1.0e-3);
+    EXPECT_NEAR(state.variables_[0][1], B, 1.0e-3);
+    EXPECT_NEAR(state.variables_[0][2], C, 1.0e-3);
+  }
+}
+
+TEST(RosenbrockSolver, WorkspaceIsReusedAcrossSolves)
+{
+  auto solver = getDecaySolver<micm::Matrix>(0.9, 0.3, { .number_of_grid_cells_ = 2 });
+
+  EXPECT_EQ(solver.workspace_.K_.size(), solver.parameters_.stages_);
+  for (auto& K : solver.workspace_.K_)
+  {
+    EXPECT_EQ(K.size(), 2);
+    EXPECT_EQ(K[0].size(), 3);
+  }
+  EXPECT_EQ(solver.workspace_.Y_.size(), 2);
+  EXPECT_EQ(solver.workspace_.Yerror_[0].size(), 3);
+
+  micm::State<micm::Matrix> state = solver.GetState();
+  for (auto& conditions : state.conditions_)
+  {
+    conditions.temperature_ = 298.15;
+    conditions.pressure_ = 101325.0;
+  }
+  state.variables_[0] = { 1.0, 0.0, 0.0 };
+  state.variables_[1] = { 0.5, 0.2, 0.1 };
+  solver.UpdateState(state);
+
+  const double* K_data = solver.workspace_.K_[0].AsVector().data();
+  auto first = solver.Solve(0.0, 1.0, state);
+  auto second = solver.Solve(0.0, 1.0, state);
+  EXPECT_EQ(first.state_, micm::Solver::SolverState::Converged);
+  EXPECT_EQ(first.result_, second.result_);
+  EXPECT_EQ(first.stats_.number_of_steps, second.stats_.number_of_steps);
+  EXPECT_EQ(K_data, solver.workspace_.K_[0].AsVector().data());
+}
+
+TEST(RosenbrockSolver, PerCellStepControl)
+{
+  // grid cell 0 is identical to a single-cell solve, grid cell 1 is much stiffer
+  auto single_cell_solver = getDecaySolver<micm::Matrix>(0.9, 0.3, { .number_of_grid_cells_ = 1 });
+  auto per_cell_solver =
+      getDecaySolver<micm::Matrix>(0.9, 0.3, { .number_of_grid_cells_ = 2, .per_cell_step_control_ = true });
+
+  micm::State<micm::Matrix> single_cell_state = single_cell_solver.GetState();
+  single_cell_state.conditions_[0].temperature_ = 298.15;
+  single_cell_state.variables_[0] = { 1.0, 0.0, 0.0 };
+  single_cell_solver.UpdateState(single_cell_state);
+
+  micm::State<micm::Matrix> per_cell_state = per_cell_solver.GetState();
+  per_cell_state.conditions_[0].temperature_ = 298.15;
+  per_cell_state.conditions_[1].temperature_ = 298.15;
+  per_cell_state.variables_[0] = { 1.0, 0.0, 0.0 };
+  per_cell_state.variables_[1] = { 1.0, 0.0, 0.0 };
+  per_cell_solver.UpdateState(per_cell_state);
+  per_cell_state.rate_constants_[1] = { 9.0, 3.0 };
+
+  double time = 0.0;
+  for (int i_step = 0; i_step < 5; ++i_step)
+  {
+    auto single_cell_result = single_cell_solver.Solve(time, time + 1.0, single_cell_state);
+    auto per_cell_result = per_cell_solver.Solve(time, time + 1.0, per_cell_state);
+    EXPECT_EQ(single_cell_result.state_, micm::Solver::SolverState::Converged);
+    EXPECT_EQ(per_cell_result.state_, micm::Solver::SolverState::Converged);
+    EXPECT_NEAR(per_cell_result.T, time + 1.0, 1.0e-12);
+    time += 1.0;
+    single_cell_state.variables_.AsVector() = single_cell_result.result_;
+    per_cell_state.variables_.AsVector() = per_cell_result.result_;
+
+    // the stiff grid cell must not change the steps taken by the first grid cell
+    for (std::size_t i = 0; i < 3; ++i)
+      EXPECT_NEAR(per_cell_state.variables_[0][i], single_cell_state.variables_[0][i], 1.0e-12);
+    EXPECT_GE(per_cell_result.stats_.accepted, single_cell_result.stats_.accepted);
+    ASSERT_EQ(per_cell_result.cell_stats_.size(), 2);
+    EXPECT_EQ(per_cell_result.cell_stats_[0].accepted, single_cell_result.stats_.accepted);
+    EXPECT_EQ(per_cell_result.cell_stats_[0].number_of_steps, single_cell_result.stats_.number_of_steps);
+    EXPECT_GT(per_cell_result.cell_stats_[1].number_of_steps, per_cell_result.cell_stats_[0].number_of_steps);
+    auto cell_total = per_cell_result.cell_stats_[0];
+    cell_total += per_cell_result.cell_stats_[1];
+    EXPECT_EQ(cell_total.accepted, per_cell_result.stats_.accepted);
+    EXPECT_EQ(cell_total.decompositions, per_cell_result.stats_.decompositions);
+    double A = std::exp(-9.0 * time);
+    double B = 9.0 / (3.0 - 9.0) * (std::exp(-9.0 * time) - std::exp(-3.0 * time));
+    EXPECT_NEAR(per_cell_state.variables_[1][0], A, 1.0e-3);
+    EXPECT_NEAR(per_cell_state.variables_[1][1], B, 1.0e-3);
+    EXPECT_NEAR(per_cell_state.variables_[1][2], 1.0 - A - B, 1.0e-3);
+  }
+}
+
+TEST(RosenbrockSolver, PerCellWorkStopsWhenGridCellFinishes)
+{
+  // grid cell 1 is much stiffer, so it is still active after grid cell 0 reaches the end time
+  auto solver = getDecaySolver<micm::Matrix>(0.9, 0.3, { .number_of_grid_cells_ = 2, .per_cell_step_control_ = true });
+  micm::State<micm::Matrix> state = solver.GetState();
+  for (std::size_t i_cell = 0; i_cell < 2; ++i_cell)
+  {
+    state.conditions_[i_cell].temperature_ = 298.15;
+    state.variables_[i_cell] = { 1.0, 0.0, 0.0 };
+  }
+  solver.UpdateState(state);
+  state.rate_constants_[1] = { 9.0, 3.0 };
+
+  auto result = solver.Solve(0.0, 1.0, state);
+  EXPECT_EQ(result.state_, micm::Solver::SolverState::Converged);
+  const auto& easy = result.cell_stats_[0];
+  const auto& stiff = result.cell_stats_[1];
+  ASSERT_LT(easy.number_of_steps, stiff.number_of_steps);
+
+  // each grid cell is factored once per step, and not after it finishes
+  EXPECT_EQ(easy.decompositions, easy.number_of_steps);
+  EXPECT_EQ(stiff.decompositions, stiff.number_of_steps);
+  EXPECT_EQ(easy.decompositions + stiff.decompositions, result.stats_.decompositions);
+
+  // the stiff grid cell is evaluated and solved for in every iteration, the finished one is not
+  EXPECT_EQ(stiff.function_calls, result.stats_.function_calls);
+  EXPECT_EQ(stiff.jacobian_updates, result.stats_.jacobian_updates);
+  EXPECT_EQ(stiff.solves, result.stats_.solves);
+  EXPECT_LT(easy.function_calls, stiff.function_calls);
+  EXPECT_LT(easy.jacobian_updates, stiff.jacobian_updates);
+  EXPECT_LT(easy.solves, stiff.solves);
+  EXPECT_LE(easy.jacobian_updates, easy.number_of_steps);
+  EXPECT_EQ(easy.solves, easy.number_of_steps * solver.parameters_.stages_);
+}
+
+TEST(RosenbrockSolver, PerCellStepSizeTooSmall)
+{
+  // grid cell 1 never passes the error test, so its step size shrinks until it is too small
+  auto single_cell_solver = getDecaySolver<micm::Matrix>(0.9, 0.3, { .number_of_grid_cells_ = 1 });
+  auto per_cell_solver =
+      getDecaySolver<micm::Matrix>(0.9, 0.3, { .number_of_grid_cells_ = 2, .per_cell_step_control_ = true });
+
+  micm::State<micm::Matrix> single_cell_state = single_cell_solver.GetState();
+  single_cell_state.conditions_[0].temperature_ = 298.15;
+  single_cell_state.variables_[0] = { 1.0, 0.0, 0.0 };
+  single_cell_solver.UpdateState(single_cell_state);
+
+  micm::State<micm::Matrix> per_cell_state = per_cell_solver.GetState();
+  per_cell_state.conditions_[0].temperature_ = 298.15;
+  per_cell_state.conditions_[1].temperature_ = 298.15;
+  per_cell_state.variables_[0] = { 1.0, 0.0, 0.0 };
+  per_cell_state.variables_[1] = { std::numeric_limits<double>::quiet_NaN(), 0.0, 0.0 };
+  per_cell_solver.UpdateState(per_cell_state);
+
+  auto single_cell_result = single_cell_solver.Solve(0.0, 1.0, single_cell_state);
+  auto per_cell_result = per_cell_solver.Solve(0.0, 1.0, per_cell_state);
+  EXPECT_EQ(single_cell_result.state_, micm::Solver::SolverState::Converged);
+  EXPECT_EQ(per_cell_result.state_, micm::Solver::SolverState::StepSizeTooSmall);
+  ASSERT_EQ(per_cell_result.cell_states_.size(), 2);
+  EXPECT_EQ(per_cell_result.cell_states_[0], micm::Solver::SolverState::Converged);
+  EXPECT_EQ(per_cell_result.cell_states_[1], micm::Solver::SolverState::StepSizeTooSmall);
+  EXPECT_EQ(per_cell_result.cell_stats_[1].accepted, 0);
+
+  // the failed grid cell does not stop the other grid cell
+  EXPECT_EQ(per_cell_result.cell_stats_[0].accepted, single_cell_result.stats_.accepted);
+  for (std::size_t i = 0; i < 3; ++i)
+    EXPECT_NEAR(per_cell_result.result_[i], single_cell_result.result_[i], 1.0e-12);
+}
+
+template<micm::RosenbrockTableau Tableau>
+void testTableau(bool use_set_tableau)
+{
+  auto solver = getDecaySolver<micm::Matrix>(0.9, 0.3, { .number_of_grid_cells_ = 1 });
+  // the first-order error estimate of Ros2 needs many small steps while B and C are near zero
+  std::fill(solver.absolute_tolerances_.begin(), solver.absolute_tolerances_.end(), 1.0e-6);
+  solver.parameters_.max_number_of_steps_ = 1000;
+  if (use_set_tableau)
+  {
+    solver.template SetTableau<Tableau>();
+    EXPECT_EQ(solver.parameters_.stages_, Tableau::stages_);
+    EXPECT_EQ(solver.workspace_.K_.size(), Tableau::stages_);
+  }
+
+  micm::State<micm::Matrix> state = solver.GetState();
+  state.conditions_[0].temperature_ = 298.15;
+  state.variables_[0] = { 1.0, 0.0, 0.0 };
+  solver.UpdateState(state);
+
+  double time = 0.0;
+  for (int i_step = 0; i_step < 5; ++i_step)
+  {
+    auto result = use_set_tableau ? solver.Solve(time, time + 1.0, state)
+                                  : solver.template Solve<Tableau>(time, time + 1.0, state);
+    EXPECT_EQ(result.state_, micm::Solver::SolverState::Converged);
+    time += 1.0;
+    state.variables_.AsVector() = result.result_;
+    double A = std::exp(-0.9 * time);
+    double B = 0.9 / (0.3 - 0.9) * (std::exp(-0.9 * time) - std::exp(-0.3 * time));
+    EXPECT_NEAR(state.variables_[0][0], A, 1.0e-3);
+    EXPECT_NEAR(state.variables_[0][1], B, 1.0e-3);
+    EXPECT_NEAR(state.variables_[0][2], 1.0 - A - B, 1.0e-3);
+  }
+}
+
+TEST(RosenbrockSolver, Tableaux)
+{
+  static_assert(micm::Ros2Tableau::stages_ == 2);
+  static_assert(micm::Ros3Tableau::stages_ == 3);
+  static_assert(micm::Ros4Tableau::stages_ == 4);
+  static_assert(micm::Rodas3Tableau::stages_ == 4);
+  static_assert(micm::Rodas4Tableau::stages_ == 6);
+  static_assert(micm::Ros34Pw2Tableau::stages_ == 4);
+  static_assert(!micm::UsesInitialForcing<micm::Ros3Tableau>(2));
+  static_assert(micm::UsesInitialForcing<micm::Rodas3Tableau>(1));
+
+  for (bool use_set_tableau : { false, true })
+  {
+    testTableau<micm::Ros2Tableau>(use_set_tableau);
+    testTableau<micm::Ros3Tableau>(use_set_tableau);
+    testTableau<micm::Ros4Tableau>(use_set_tableau);
+    testTableau<micm::Rodas3Tableau>(use_set_tableau);
+    testTableau<micm::Rodas4Tableau>(use_set_tableau);
+    testTableau<micm::Ros34Pw2Tableau>(use_set_tableau);
+  }
+}
+
+TEST(RosenbrockSolver, DefaultTableauMatchesRos3)
+{
+  auto solver = getDecaySolver<micm::Matrix>(0.9, 0.3, { .number_of_grid_cells_ = 1 });
+  micm::State<micm::Matrix> state = solver.GetState();
+  state.conditions_[0].temperature_ = 298.15;
+  state.variables_[0] = { 1.0, 0.0, 0.0 };
+  solver.UpdateState(state);
+
+  auto default_result = solver.Solve(0.0, 1.0, state);
+  auto ros3_result = solver.Solve<micm::Ros3Tableau>(0.0, 1.0, state);
+  EXPECT_EQ(default_result.result_, ros3_result.result_);
+  EXPECT_EQ(default_result.stats_.number_of_steps, ros3_result.stats_.number_of_steps);
+}
+
+void testSetNumberOfGridCells(std::size_t number_of_threads)
+{
+  // a resized Rodas4 solver matches one built for the new number of grid cells
+  auto solver =
+      getDecaySolver<micm::Matrix>(0.9, 0.3, { .number_of_grid_cells_ = 1, .number_of_threads_ = number_of_threads });
+  auto expected_solver =
+      getDecaySolver<micm::Matrix>(0.9, 0.3, { .number_of_grid_cells_ = 3, .number_of_threads_ = number_of_threads });
+  solver.SetTableau<micm::Rodas4Tableau>();
+  expected_solver.SetTableau<micm::Rodas4Tableau>();
+  solver.SetNumberOfGridCells(3);
+  EXPECT_EQ(solver.parameters_.number_of_grid_cells_, 3);
+  EXPECT_EQ(solver.parameters_.N_, 9);
+  EXPECT_EQ(solver.parameters_.stages_, micm::Rodas4Tableau::stages_);
+  EXPECT_EQ(solver.chunk_workspaces_.size(), expected_solver.chunk_workspaces_.size());
+  if (number_of_threads == 1)
+  {
+    EXPECT_EQ(solver.workspace_.K_.size(), micm::Rodas4Tableau::stages_);
+    EXPECT_EQ(solver.workspace_.Y_.size(), 3);
+  }
+
+  micm::State<micm::Matrix> state = solver.GetState();
+  ASSERT_EQ(state.variables_.size(), 3);
+  for (std::size_t i_cell = 0; i_cell < 3; ++i_cell)
+  {
+    state.conditions_[i_cell].temperature_ = 298.15;
+    state.variables_[i_cell] = { 1.0, 0.1 * i_cell, 0.0 };
+  }
+  solver.UpdateState(state);
+
+  auto result = solver.Solve(0.0, 1.0, state);
+  auto expected_result = expected_solver.Solve(0.0, 1.0, state);
+  EXPECT_EQ(result.state_, micm::Solver::SolverState::Converged);
+  EXPECT_EQ(result.result_, expected_result.result_);
+  EXPECT_EQ(result.stats_.number_of_steps, expected_result.stats_.number_of_steps);
+}
+
+TEST(RosenbrockSolver, SetNumberOfGridCells)
+{
+  testSetNumberOfGridCells(1);
+  testSetNumberOfGridCells(2);
+}
+
+TEST(RosenbrockSolver, RejectedStepsReuseJacobian)
+{
+  // a large initial step size for a stiff system forces rejected steps
+  auto solver = getDecaySolver<micm::Matrix>(30.0, 10.0, { .number_of_grid_cells_ = 1 });
+  solver.parameters_.h_start_ = 0.5;
+  solver.parameters_.max_number_of_steps_ = 1000;
+
+  micm::State<micm::Matrix> state = solver.GetState();
+  state.conditions_[0].temperature_ = 298.15;
+  state.variables_[0] = { 1.0, 0.0, 0.0 };
+  solver.UpdateState(state);
+
+  auto result = solver.Solve(0.0, 1.0, state);
+  EXPECT_EQ(result.state_, micm::Solver::SolverState::Converged);
+  EXPECT_GT(result.stats_.number_of_steps, result.stats_.accepted);
+
+  // the jacobian is evaluated once for each accepted step, but the matrix is factored for every attempt
+  EXPECT_EQ(result.stats_.jacobian_updates, result.stats_.accepted);
+  EXPECT_EQ(result.stats_.decompositions, result.stats_.number_of_steps);
+  EXPECT_EQ(result.stats_.function_calls, result.stats_.accepted + result.stats_.number_of_steps);
+
+  double A = std::exp(-30.0);
+  double B = 30.0 / (10.0 - 30.0) * (std::exp(-30.0) - std::exp(-10.0));
+  EXPECT_NEAR(result.result_[0], A, 1.0e-3);
+  EXPECT_NEAR(result.result_[1], B, 1.0e-3);
+  EXPECT_NEAR(result.result_[2], 1.0 - A - B, 1.0e-3);
+}
+
+TEST(RosenbrockSolver, BucketByArity)
+{
+  expectSameSolution<micm::Matrix>(
+      decayMechanism(0.9, 0.3),
+      { .number_of_grid_cells_ = 2 },
+      { .number_of_grid_cells_ = 2, .bucket_by_arity_ = true },
+      { .relative_tolerance_ = 1.0e-12 });
+}
+
+template<class T>
+using Group3VectorMatrix = micm::VectorMatrix<T, 3>;
+
+template<template<class> class MatrixPolicy>
+void testGatherForcing()
+{
+  expectSameSolution<MatrixPolicy>(
+      decayMechanism(0.9, 0.3),
+      { .number_of_grid_cells_ = 4 },
+      { .number_of_grid_cells_ = 4, .gather_forcing_ = true },
+      { .relative_tolerance_ = 1.0e-12 });
+}
+
+TEST(RosenbrockSolver, GatherForcing)
+{
+  testGatherForcing<micm::Matrix>();
+  testGatherForcing<Group3VectorMatrix>();
+}
+
+// Exposes the evaluation of the forcing and Jacobian at the start of each step
+template<template<class> class MatrixPolicy>
+class ForcingTestSolver : public micm::RosenbrockSolver<MatrixPolicy>
+{
+ public:
+  explicit ForcingTestSolver(micm::RosenbrockSolver<MatrixPolicy>&& solver)
+      : micm::RosenbrockSolver<MatrixPolicy>(std::move(solver))
+  {
+  }
+  using micm::RosenbrockSolver<MatrixPolicy>::CalculateForcingAndJacobian;
+};
+
+// The forcing at the start of each step also uses the species-major kernel, which is the only one that stores
+// the rate of each reaction
+template<template<class> class MatrixPolicy>
+void testGatherInitialForcing(bool gather_forcing)
+{
+  const double k1 = 0.9;
+  const double k2 = 0.3;
+  ForcingTestSolver<MatrixPolicy> solver(
+      getDecaySolver<MatrixPolicy>(k1, k2, { .number_of_grid_cells_ = 4, .gather_forcing_ = gather_forcing }));
+  MatrixPolicy<double> rate_constants(4, 2, 0.0);
+  MatrixPolicy<double> number_densities(4, 3, 0.0);
+  for (std::size_t i_cell = 0; i_cell < 4; ++i_cell)
+  {
+    rate_constants[i_cell] = { k1, k2 };
+    number_densities[i_cell] = { 1.0 + i_cell, 0.5 * i_cell, 0.0 };
+  }
+  MatrixPolicy<double> forcing(4, 3, 0.0);
+  MatrixPolicy<double> reaction_rates(4, 2, -1.0);
+  auto jacobian = solver.workspace_.jacobian_;
+  micm::Solver::Rosenbrock_stats stats;
+  solver.CalculateForcingAndJacobian(rate_constants, number_densities, forcing, reaction_rates, jacobian, stats);
+  EXPECT_EQ(stats.function_calls, 1);
+  EXPECT_EQ(stats.jacobian_updates, 1);
+  for (std::size_t i_cell = 0; i_cell < 4; ++i_cell)
+  {
+    const double A = number_densities[i_cell][0];
+    const double B = number_densities[i_cell][1];
+    EXPECT_NEAR(forcing[i_cell][0], -k1 * A, 1.0e-12);
+    EXPECT_NEAR(forcing[i_cell][1], k1 * A - k2 * B, 1.0e-12);
+    EXPECT_NEAR(forcing[i_cell][2], k2 * B, 1.0e-12);
+    EXPECT_EQ(reaction_rates[i_cell][0], gather_forcing ? k1 * A : -1.0);
+    EXPECT_EQ(reaction_rates[i_cell][1], gather_forcing ? k2 * B : -1.0);
+  }
+}
+
+TEST(RosenbrockSolver, GatherInitialForcing)
+{
+  testGatherInitialForcing<micm::Matrix>(false);
+  testGatherInitialForcing<micm::Matrix>(true);
+  testGatherInitialForcing<Group3VectorMatrix>(false);
+  testGatherInitialForcing<Group3VectorMatrix>(true);
+}
+
+TEST(RosenbrockSolver, ReorderedJacobian)
+{
+  auto mechanism = hubMechanism();
+  const auto& [system, processes] = mechanism;
+  micm::RosenbrockSolver<micm::Matrix> solver{ system,
+                                               std::vector<micm::Process>(processes),
+                                               micm::RosenbrockSolverParameters{ .number_of_grid_cells_ = 2 } };
+  micm::RosenbrockSolver<micm::Matrix> natural_solver{ system,
+                                                       std::vector<micm::Process>(processes),
+                                                       micm::RosenbrockSolverParameters{
+                                                           .number_of_grid_cells_ = 2, .reorder_species_ = false } };
+
+  // X is moved towards the end of the Jacobian, which reduces the fill-in, and the state variables keep their order
+  EXPECT_NE(solver.species_order_.front(), 0);
+  auto LU = micm::LuDecomposition::GetLUMatrices(solver.jacobian_);
+  auto natural_LU = micm::LuDecomposition::GetLUMatrices(natural_solver.jacobian_);
+  EXPECT_LT(LU.first.FlatBlockSize() + LU.second.FlatBlockSize(), natural_LU.first.FlatBlockSize() + natural_LU.second.FlatBlockSize());
+  auto state = solver.GetState();
+  EXPECT_EQ(state.variable_map_, natural_solver.GetState().variable_map_);
+  EXPECT_EQ(state.variable_map_.at("X"), 0);
+
+  expectSameSolution<micm::Matrix>(
+      mechanism,
+      { .number_of_grid_cells_ = 2, .reorder_species_ = false },
+      { .number_of_grid_cells_ = 2 },
+      { .relative_tolerance_ = 1.0e-10 });
+}
+
+// A + M -k1-> B + M and B + N2 -k2-> A + N2 with fixed M and N2, which has the analytical solution:
+//   A(t) = A_eq + (A0 - A_eq) exp(-(a + b) t), with a = k1 [M], b = k2 [N2], and A_eq = (A0 + B0) b / (a + b)
+template<template<class> class MatrixPolicy>
+void testConstantSpecies(std::size_t number_of_threads)
+{
+  auto a = micm::Species("A");
+  auto b = micm::Species("B");
+  auto m = micm::Species("M", micm::Property("constant", "", 1.0));
+  auto n2 = micm::Species("N2", micm::Property("constant", "", 1.0));
+  micm::Phase gas_phase{ std::vector<micm::Species>{ a, m, b, n2 } };
+  std::vector<micm::Process> processes{ micm::Process::create()
+                                            .reactants({ a, m })
+                                            .products({ yields(b, 1), yields(m, 1) })
+                                            .rate_constant(micm::ArrheniusRateConstant({ .A_ = 0.4 }))
+                                            .phase(gas_phase),
+                                        micm::Process::create()
+                                            .reactants({ b, n2 })
+                                            .products({ yields(a, 1), yields(n2, 1) })
+                                            .rate_constant(micm::ArrheniusRateConstant({ .A_ = 0.1 }))
+                                            .phase(gas_phase) };
+  const std::size_t number_of_grid_cells = 3;
+  micm::RosenbrockSolver<MatrixPolicy> solver{ micm::System(micm::SystemParameters{ .gas_phase_ = gas_phase }),
+                                               std::vector<micm::Process>(processes),
+                                               micm::RosenbrockSolverParameters{
+                                                   .number_of_grid_cells_ = number_of_grid_cells,
+                                                   .number_of_threads_ = number_of_threads } };
+
+  // only A and B are integrated, and the state still holds every species
+  EXPECT_EQ(solver.integrated_species_ids_, (std::vector<std::size_t>{ 0, 2 }));
+  EXPECT_EQ(solver.absolute_tolerances_.size(), 2);
+  EXPECT_EQ(solver.jacobian_[0].size(), 2);
+  auto state = solver.GetState();
+  EXPECT_EQ(state.variables_[0].size(), 4);
+
+  for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)
+  {
+    state.conditions_[i_cell].temperature_ = 298.15;
+    state.variables_[i_cell] = { 1.0, 2.0 + i_cell, 0.5, 3.0 };
+  }
+  // the solver expects the concentrations of M and N2 in the rate constants; Process::UpdateState leaves them out
+  // and the solver's UpdateState folds them in (both only support row-ordered matrices, so the rate constants are
+  // set by hand for the others)
+  if constexpr (std::is_same_v<MatrixPolicy<double>, micm::Matrix<double>>)
+  {
+    micm::Process::UpdateState(processes, state);
+    for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)
+    {
+      EXPECT_NEAR(state.rate_constants_[i_cell][0], 0.4, 1.0e-12);
+      EXPECT_NEAR(state.rate_constants_[i_cell][1], 0.1, 1.0e-12);
+    }
+    solver.UpdateState(state);
+    for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)
+    {
+      EXPECT_NEAR(state.rate_constants_[i_cell][0], 0.4 * (2.0 + i_cell), 1.0e-12);
+      EXPECT_NEAR(state.rate_constants_[i_cell][1], 0.1 * 3.0, 1.0e-12);
+    }
+  }
+  else
+  {
+    for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)
+      state.rate_constants_[i_cell] = { 0.4 * (2.0 + i_cell), 0.1 * 3.0 };
+  }
+
+  auto result = solver.Solve(0.0, 1.0, state);
+  EXPECT_EQ(result.state_, micm::Solver::SolverState::Converged);
+  MatrixPolicy<double> Y = state.variables_;
+  Y.AsVector() = result.result_;
+  for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)
+  {
+    const double k_a = 0.4 * (2.0 + i_cell);
+    const double k_b = 0.1 * 3.0;
+    const double A_eq = 1.5 * k_b / (k_a + k_b);
+    const double A = A_eq + (1.0 - A_eq) * std::exp(-(k_a + k_b));
+    EXPECT_NEAR(Y[i_cell][0], A, 1.0e-3);
+    EXPECT_NEAR(Y[i_cell][2], 1.5 - A, 1.0e-3);
+    EXPECT_EQ(Y[i_cell][1], 2.0 + i_cell);
+    EXPECT_EQ(Y[i_cell][3], 3.0);
+  }
+}
+
+TEST(RosenbrockSolver, ConstantSpecies)
+{
+  testConstantSpecies<micm::Matrix>(1);
+  testConstantSpecies<micm::Matrix>(2);
+  testConstantSpecies<Group3VectorMatrix>(1);
+}
+
+TEST(RosenbrockSolver, JacobianVectorProduct)
+{
+  auto [system, processes] = hubMechanism();
+  const std::size_t n = system.StateSize();
+  micm::RosenbrockSolver<micm::Matrix> solver{ system, std::move(processes), micm::RosenbrockSolverParameters{} };
+  auto state = solver.GetState();
+  state.conditions_[0].temperature_ = 298.15;
+  for (std::size_t i = 0; i < n; ++i)
+    state.variables_[0][i] = 1.0 + 0.1 * i;
+  solver.UpdateState(state);
+  auto jacobian = solver.jacobian_;
+  std::fill(jacobian.AsVector().begin(), jacobian.AsVector().end(), 0.0);
+  solver.dforce_dy(state.rate_constants_, state.variables_, jacobian);
+
+  std::vector<double> vector(n);
+  for (std::size_t i = 0; i < n; ++i)
+    vector[i] = 0.5 - 0.2 * i;
+  auto product = solver.dforce_dy_times_vector(jacobian.AsVector(), vector);
+  ASSERT_EQ(product.size(), n);
+  // the rows and columns of the Jacobian are in the order of species_order_
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    double expected = 0.0;
+    for (std::size_t j = 0; j < n; ++j)
+      if (!jacobian.IsZero(i, j))
+        expected += jacobian[0][i][j] * vector[solver.species_order_[j]];
+    EXPECT_NEAR(product[solver.species_order_[i]], expected, 1.0e-12 * std::abs(expected));
+  }
+
+  // both arguments are for a single grid cell
+  EXPECT_THROW(
+      try {
+        solver.dforce_dy_times_vector(std::vector<double>(jacobian.AsVector().size() + 1, 1.0), vector);
+      } catch (const std::invalid_argument& e) {
+        EXPECT_STREQ(e.what(), "Jacobian size must match one grid cell block of the solver Jacobian");
+        throw;
+      },
+      std::invalid_argument);
+  EXPECT_THROW(
+      try { solver.dforce_dy_times_vector(jacobian.AsVector(), std::vector<double>(n - 1, 1.0)); } catch (
+          const std::invalid_argument& e) {
+        EXPECT_STREQ(e.what(), "Vector size must match the number of integrated species");
+        throw;
+      },
+      std::invalid_argument);
+}
+
+template<template<class> class MatrixPolicy>
+void testGmresLinearSolver()
+{
+  auto mechanism = hubMechanism();
+  const auto& [system, processes] = mechanism;
+  const std::size_t n = system.StateSize();
+  micm::RosenbrockSolver<MatrixPolicy> gmres_solver{
+    system,
+    std::vector<micm::Process>(processes),
+    micm::RosenbrockSolverParameters{ .number_of_grid_cells_ = 4, .gmres_linear_solver_ = true }
+  };
+  // the preconditioner has no fill-in
+  EXPECT_EQ(
+      gmres_solver.workspace_.lower_matrix_.FlatBlockSize() + gmres_solver.workspace_.upper_matrix_.FlatBlockSize(),
+      gmres_solver.jacobian_.FlatBlockSize() + n);
+
+  auto [result, gmres_result] = expectSameSolution<MatrixPolicy>(
+      mechanism,
+      { .number_of_grid_cells_ = 4 },
+      { .number_of_grid_cells_ = 4, .gmres_linear_solver_ = true },
+      { .relative_tolerance_ = 1.0e-8 });
+  EXPECT_EQ(gmres_result.stats_.unconverged_solves, 0);
+
+  // without the reordering the preconditioner is inexact, so one iteration without restarts does not converge
+  micm::RosenbrockSolver<MatrixPolicy> limited_solver{
+    system,
+    std::vector<micm::Process>(processes),
+    micm::RosenbrockSolverParameters{ .number_of_grid_cells_ = 4,
+                                      .reorder_species_ = false,
+                                      .gmres_linear_solver_ = true,
+                                      .gmres_parameters_ = { .max_iterations_ = 1, .max_restarts_ = 0 } }
+  };
+  auto limited_state = gridCellState(limited_solver);
+  auto limited_result = limited_solver.Solve(0.0, 1.0, limited_state);
+  EXPECT_GT(limited_result.stats_.unconverged_solves, 0);
+  EXPECT_LE(limited_result.stats_.unconverged_solves, limited_result.stats_.solves);
+}
+
+TEST(RosenbrockSolver, GmresLinearSolver)
+{
+  testGmresLinearSolver<micm::Matrix>();
+  testGmresLinearSolver<Group3VectorMatrix>();
+}
+
+template<template<class> class MatrixPolicy>
+void testMixedPrecisionLinearSolver()
+{
+  auto mechanism = hubMechanism();
+  const auto& [system, processes] = mechanism;
+  micm::RosenbrockSolver<MatrixPolicy> solver{ system,
+                                               std::vector<micm::Process>(processes),
+                                               micm::RosenbrockSolverParameters{ .number_of_grid_cells_ = 4 } };
+  micm::RosenbrockSolver<MatrixPolicy> mixed_solver{
+    system,
+    std::vector<micm::Process>(processes),
+    micm::RosenbrockSolverParameters{ .number_of_grid_cells_ = 4, .mixed_precision_linear_solver_ = true }
+  };
+  // only the float factors are allocated
+  EXPECT_EQ(mixed_solver.workspace_.lower_matrix_.AsVector().size(), 0);
+  EXPECT_EQ(
+      mixed_solver.workspace_.float_lower_matrix_.AsVector().size(), solver.workspace_.lower_matrix_.AsVector().size());
+
+  expectSameSolution<MatrixPolicy>(
+      mechanism,
+      { .number_of_grid_cells_ = 4 },
+      { .number_of_grid_cells_ = 4, .mixed_precision_linear_solver_ = true },
+      { .relative_tolerance_ = 1.0e-10 });
+}
+
+TEST(RosenbrockSolver, MixedPrecisionLinearSolver)
+{
+  testMixedPrecisionLinearSolver<micm::Matrix>();
+  testMixedPrecisionLinearSolver<Group3VectorMatrix>();
+}
+
+// A W-method keeps its order with a Jacobian from an earlier step, so the Jacobian can be reused across steps
+template<template<class> class MatrixPolicy>
+void testJacobianReuse(bool per_cell_step_control)
+{
+  micm::RosenbrockSolverParameters parameters{ .number_of_grid_cells_ = 2, .per_cell_step_control_ = per_cell_step_control };
+  micm::RosenbrockSolverParameters reuse_parameters = parameters;
+  reuse_parameters.max_jacobian_age_ = 10;
+  auto [result, reuse_result] = expectSameSolution<MatrixPolicy, MatrixPolicy, micm::Ros34Pw2Tableau>(
+      hubMechanism(),
+      parameters,
+      reuse_parameters,
+      { .relative_tolerance_ = 1.0e-3, .same_number_of_steps_ = false, .time_end_ = 20.0 });
+  EXPECT_LT(reuse_result.stats_.jacobian_updates, result.stats_.jacobian_updates / 2);
+
+  // the Jacobian of a linear system is constant, so it is only re-evaluated after rejected steps
+  auto decay_solver = getDecaySolver<MatrixPolicy>(
+      0.9,
+      0.3,
+      { .number_of_grid_cells_ = 2, .per_cell_step_control_ = per_cell_step_control, .max_jacobian_age_ = 1000 });
+  decay_solver.template SetTableau<micm::Ros34Pw2Tableau>();
+  auto decay_state = decay_solver.GetState();
+  decay_state.variables_[0] = { 1.0, 0.0, 0.0 };
+  decay_state.variables_[1] = { 0.5, 0.5, 0.0 };
+  decay_state.rate_constants_[0] = { 0.9, 0.3 };
+  decay_state.rate_constants_[1] = { 0.9, 0.3 };
+  auto decay_result = decay_solver.Solve(0.0, 5.0, decay_state);
+  EXPECT_EQ(decay_result.state_, micm::Solver::SolverState::Converged);
+  EXPECT_LE(decay_result.stats_.jacobian_updates, 1 + decay_result.stats_.rejected);
+  EXPECT_GT(decay_result.stats_.accepted, 1);
+
+  // other methods ignore max_jacobian_age_ and evaluate the Jacobian every step
+  static_assert(micm::IsWMethod<micm::Ros34Pw2Tableau>());
+  static_assert(!micm::IsWMethod<micm::Rodas4Tableau>());
+  reuse_parameters.max_jacobian_age_ = 1000;
+  auto [rodas_result, rodas_reuse_result] = expectSameSolution<MatrixPolicy, MatrixPolicy, micm::Rodas4Tableau>(
+      decayMechanism(0.9, 0.3), parameters, reuse_parameters, { .time_end_ = 5.0 });
+  EXPECT_GT(rodas_reuse_result.stats_.jacobian_updates, 1 + rodas_reuse_result.stats_.rejected);
+  EXPECT_EQ(rodas_reuse_result.stats_.jacobian_updates, rodas_result.stats_.jacobian_updates);
+}
+
+TEST(RosenbrockSolver, JacobianReuse)
+{
+  testJacobianReuse<micm::Matrix>(false);
+  testJacobianReuse<micm::Matrix>(true);
+  testJacobianReuse<Group3VectorMatrix>(false);
+  testJacobianReuse<Group3VectorMatrix>(true);
+}
+
+// The rows of each level of the factorization and triangular solves can be run on several threads
+template<template<class> class MatrixPolicy>
+void testParallelLinearSolver()
+{
+  // each element is calculated with the same operations in the same order
+  expectSameSolution<MatrixPolicy>(
+      hubMechanism(),
+      { .number_of_grid_cells_ = 3 },
+      { .number_of_grid_cells_ = 3, .number_of_linear_solver_threads_ = 2 });
+}
+
+TEST(RosenbrockSolver, ParallelLinearSolver)
+{
+  testParallelLinearSolver<micm::Matrix>();
+  // the threads share the rows of each level of one group of grid cells at a time
+  testParallelLinearSolver<Group3VectorMatrix>();
+
+  // the linear solver threads cannot be nested inside the threads of the grid cell chunks
+  auto [system, processes] = hubMechanism();
+  EXPECT_THROW(
+      (micm::RosenbrockSolver<micm::Matrix>{ system,
+                                             std::vector<micm::Process>(processes),
+                                             micm::RosenbrockSolverParameters{ .number_of_grid_cells_ = 4,
+                                                                               .number_of_threads_ = 2,
+                                                                               .number_of_linear_solver_threads_ = 2 } }),
+      std::invalid_argument);
+  EXPECT_NO_THROW(
+      (micm::RosenbrockSolver<micm::Matrix>{ system,
+                                             std::vector<micm::Process>(processes),
+                                             micm::RosenbrockSolverParameters{ .number_of_grid_cells_ = 4,
+                                                                               .number_of_threads_ = 2,
+                                                                               .number_of_linear_solver_threads_ = 1 } }));
+}
+
+// With a VectorMatrix, the Jacobian and its LU factors are vector-ordered, so the Jacobian terms, alpha * I - J,
+// the factorization and the triangular solves run over the grid cells of each group. Four grid cells in groups of
+// three leave two padding blocks in the last group.
+TEST(RosenbrockSolver, VectorOrderedSparseMatrices)
+{
+  static_assert(std::is_same_v<
+                micm::RosenbrockSolver<Group3VectorMatrix>::SparseMatrixOrdering,
+                micm::SparseMatrixVectorOrdering<3>>);
+  static_assert(std::is_same_v<
+                decltype(micm::RosenbrockWorkspace<Group3VectorMatrix>::lower_matrix_),
+                micm::SparseMatrix<double, micm::SparseMatrixVectorOrdering<3>>>);
+  static_assert(std::is_same_v<
+                micm::RosenbrockSolver<micm::Matrix>::SparseMatrixOrdering,
+                micm::SparseMatrixStandardOrdering>);
+
+  auto mechanism = hubMechanism();
+  const std::size_t number_of_grid_cells = 4;
+  micm::RosenbrockSolver<Group3VectorMatrix> vector_solver{
+    mechanism.first,
+    std::vector<micm::Process>(mechanism.second),
+    micm::RosenbrockSolverParameters{ .number_of_grid_cells_ = number_of_grid_cells }
+  };
+  EXPECT_EQ(vector_solver.workspace_.jacobian_.AsVector().size(), 6 * vector_solver.workspace_.jacobian_.FlatBlockSize());
+  for (bool per_cell_step_control : { false, true })
+  {
+    micm::RosenbrockSolverParameters parameters{ .number_of_grid_cells_ = number_of_grid_cells,
+                                                 .per_cell_step_control_ = per_cell_step_control };
+    auto [result, vector_result] = expectSameSolution<micm::Matrix, Group3VectorMatrix>(
+        mechanism, parameters, parameters, { .relative_tolerance_ = 1.0e-12 });
+    EXPECT_EQ(vector_result.stats_.singular, 0);
+  }
+}
+
+// An autocatalytic species (A -> 2A) has dforce_dy = k, so [alpha * I - dforce_dy] is singular when alpha = k
+template<template<class> class MatrixPolicy>
+void testSingularFactorization(bool per_cell_step_control)
+{
+  auto a = micm::Species("A");
+  micm::Phase gas_phase{ std::vector<micm::Species>{ a } };
+  micm::Process r = micm::Process::create()
+                        .reactants({ a })
+                        .products({ yields(a, 2) })
+                        .rate_constant(micm::ArrheniusRateConstant({ .A_ = 1.0 }))
+                        .phase(gas_phase);
+  micm::RosenbrockSolver<MatrixPolicy> solver{
+    micm::System(micm::SystemParameters{ .gas_phase_ = gas_phase }),
+    std::vector<micm::Process>{ r },
+    micm::RosenbrockSolverParameters{ .number_of_grid_cells_ = 2, .per_cell_step_control_ = per_cell_step_control }
+  };
+  // the first step of grid cell 0 has alpha = 1 / (h_start * gamma) = k
+  const double k = 1.0 / (solver.parameters_.h_start_ * solver.parameters_.gamma_[0]);
+  auto state = solver.GetState();
+  state.variables_[0] = { 1.0 };
+  state.variables_[1] = { 1.0 };
+  state.rate_constants_[0] = { k };
+  state.rate_constants_[1] = { 0.5 * k };
+  auto result = solver.Solve(0.0, 2.0 * solver.parameters_.h_start_, state);
+  EXPECT_EQ(result.state_, micm::Solver::SolverState::Converged);
+  EXPECT_GE(result.stats_.singular, 1);
+  // with a single species, the result holds one value per grid cell
+  for (std::size_t i_cell = 0; i_cell < 2; ++i_cell)
+  {
+    EXPECT_TRUE(std::isfinite(result.result_[i_cell]));
+    EXPECT_GT(result.result_[i_cell], 1.0);
+  }
+  if (per_cell_step_control)
+  {
+    // only grid cell 0 halves its step size and is factored again
+    EXPECT_EQ(result.cell_stats_[0].singular, 1);
+    EXPECT_EQ(result.cell_stats_[1].singular, 0);
+    EXPECT_EQ(result.cell_stats_[0].decompositions, result.cell_stats_[0].number_of_steps + 1);
+    EXPECT_EQ(result.cell_stats_[1].decompositions, result.cell_stats_[1].number_of_steps);
+    auto cell_total = result.cell_stats_[0];
+    cell_total += result.cell_stats_[1];
+    EXPECT_EQ(cell_total.decompositions, result.stats_.decompositions);
+    EXPECT_EQ(cell_total.singular, result.stats_.singular);
+  }
+}
+
+TEST(RosenbrockSolver, SingularFactorization)
+{
+  testSingularFactorization<micm::Matrix>(false);
+  testSingularFactorization<micm::Matrix>(true);
+  // a VectorMatrix solver factors and checks the pivots of groups of grid cells at once
+  testSingularFactorization<Group3VectorMatrix>(false);
+  testSingularFactorization<Group3VectorMatrix>(true);
+}
+
+// The pivot tolerance is relative to alpha = 1 / (H * gamma), so a pivot that has lost about all of the digits of
+// alpha is singular, although it is not zero
+template<template<class> class MatrixPolicy>
+void testNearSingularFactorization(bool mixed_precision)
+{
+  auto a = micm::Species("A");
+  micm::Phase gas_phase{ std::vector<micm::Species>{ a } };
+  micm::Process r = micm::Process::create()
+                        .reactants({ a })
+                        .products({ yields(a, 2) })
+                        .rate_constant(micm::ArrheniusRateConstant({ .A_ = 1.0 }))
+                        .phase(gas_phase);
+  micm::RosenbrockSolver<MatrixPolicy> solver{ micm::System(micm::SystemParameters{ .gas_phase_ = gas_phase }),
+                                               std::vector<micm::Process>{ r },
+                                               micm::RosenbrockSolverParameters{
+                                                   .mixed_precision_linear_solver_ = mixed_precision } };
+  const double alpha = 1.0 / (solver.parameters_.h_start_ * solver.parameters_.gamma_[0]);
+  auto state = solver.GetState();
+  state.variables_[0] = { 1.0 };
+  state.rate_constants_[0] = { alpha * (1.0 - 1.0e-14) };
+  auto exact_state = state;
+  auto result = solver.Solve(0.0, solver.parameters_.h_start_, state);
+  EXPECT_EQ(result.state_, micm::Solver::SolverState::Converged);
+  EXPECT_EQ(result.stats_.singular, 1);
+  EXPECT_TRUE(std::isfinite(result.result_[0]));
+
+  // a pivot with only a few correct digits is singular in float, but not in double
+  auto float_state = exact_state;
+  float_state.rate_constants_[0] = { alpha * (1.0 - 1.0e-6) };
+  auto float_result = solver.Solve(0.0, solver.parameters_.h_start_, float_state);
+  EXPECT_EQ(float_result.stats_.singular, mixed_precision ? 1 : 0);
+
+  // only an exactly zero pivot is singular without a tolerance
+  solver.parameters_.pivot_tolerance_ = 0.0;
+  auto exact_result = solver.Solve(0.0, solver.parameters_.h_start_, exact_state);
+  EXPECT_EQ(exact_result.stats_.singular, 0);
+}
+
+TEST(RosenbrockSolver, NearSingularFactorization)
+{
+  for (bool mixed_precision : { false, true })
+  {
+    testNearSingularFactorization<micm::Matrix>(mixed_precision);
+    testNearSingularFactorization<Group3VectorMatrix>(mixed_precision);
+  }
+}
+
+// A NaN rate constant gives a NaN pivot for every step size, so halving the step size never helps
+template<template<class> class MatrixPolicy>
+void testRepeatedlySingularFactorization(bool per_cell_step_control)
+{
+  auto single_cell_solver = getDecaySolver<MatrixPolicy>(0.9, 0.3, { .number_of_grid_cells_ = 1 });
+  auto solver = getDecaySolver<MatrixPolicy>(
+      0.9,
+      0.3,
+      { .number_of_grid_cells_ = 2, .per_cell_step_control_ = per_cell_step_control });
+  auto single_cell_state = single_cell_solver.GetState();
+  single_cell_state.variables_[0] = { 1.0, 0.0, 0.0 };
+  single_cell_state.rate_constants_[0] = { 0.9, 0.3 };
+  auto state = solver.GetState();
+  state.variables_[0] = { 1.0, 0.0, 0.0 };
+  state.variables_[1] = { 1.0, 0.0, 0.0 };
+  state.rate_constants_[0] = { 0.9, 0.3 };
+  state.rate_constants_[1] = { std::numeric_limits<double>::quiet_NaN(), 0.3 };
+  auto single_cell_result = single_cell_solver.Solve(0.0, 1.0, single_cell_state);
+  auto result = solver.Solve(0.0, 1.0, state);
+  EXPECT_EQ(result.state_, micm::Solver::SolverState::RepeatedlySingularMatrix);
+  EXPECT_LT(result.T, 1.0);
+  if (!per_cell_step_control)
+  {
+    // the first factorization and 5 retries with a smaller step size
+    EXPECT_EQ(result.stats_.decompositions, 6);
+    EXPECT_EQ(result.stats_.number_of_steps, 0);
+    return;
+  }
+  ASSERT_EQ(result.cell_states_.size(), 2);
+  EXPECT_EQ(result.cell_states_[0], micm::Solver::SolverState::Converged);
+  EXPECT_EQ(result.cell_states_[1], micm::Solver::SolverState::RepeatedlySingularMatrix);
+  EXPECT_EQ(result.cell_stats_[1].decompositions, 6);
+  EXPECT_EQ(result.cell_stats_[1].number_of_steps, 0);
+
+  // the failed grid cell does not stop the other grid cell
+  EXPECT_EQ(result.cell_stats_[0].decompositions, result.cell_stats_[0].number_of_steps);
+  EXPECT_EQ(result.cell_stats_[0].accepted, single_cell_result.stats_.accepted);
+  MatrixPolicy<double> Y = state.variables_;
+  Y.AsVector() = result.result_;
+  MatrixPolicy<double> single_cell_Y = single_cell_state.variables_;
+  single_cell_Y.AsVector() = single_cell_result.result_;
+  for (std::size_t i = 0; i < 3; ++i)
+    EXPECT_NEAR(Y[0][i], single_cell_Y[0][i], 1.0e-12);
+}
+
+TEST(RosenbrockSolver, RepeatedlySingularFactorization)
+{
+  testRepeatedlySingularFactorization<micm::Matrix>(false);
+  testRepeatedlySingularFactorization<micm::Matrix>(true);
+  testRepeatedlySingularFactorization<Group3VectorMatrix>(false);
+  testRepeatedlySingularFactorization<Group3VectorMatrix>(true);
+}
+
+#ifdef USE_TIMING
+TEST(RosenbrockSolver, PhaseTiming)
+{
+  auto solver = getDecaySolver<micm::Matrix>(30.0, 10.0, { .number_of_grid_cells_ = 2 });
+  solver.parameters_.h_start_ = 0.5;
+  solver.parameters_.max_number_of_steps_ = 1000;
+
+  micm::State<micm::Matrix> state = solver.GetState();
+  for (std::size_t i_cell = 0; i_cell < 2; ++i_cell)
+  {
+    state.conditions_[i_cell].temperature_ = 298.15;
+    state.variables_[i_cell] = { 1.0, 0.0, 0.0 };
+  }
+  solver.UpdateState(state);
+
+  auto result = solver.Solve(0.0, 1.0, state);
+  EXPECT_EQ(result.state_, micm::Solver::SolverState::Converged);
+
+  // every counted call is timed, and the rate constant update is reported by the next solve
+  // (the forcing evaluated together with the Jacobian is timed in the Jacobian phase)
+  const auto& timing = result.stats_.timing;
+  EXPECT_EQ(timing.update_rate_constants.calls_, 1);
+  EXPECT_EQ(timing.forcing.calls_, result.stats_.function_calls - result.stats_.jacobian_updates);
+  EXPECT_EQ(timing.jacobian.calls_, result.stats_.jacobian_updates);
+  EXPECT_EQ(timing.decomposition.calls_, result.stats_.decompositions);
+  EXPECT_EQ(timing.solve.calls_, result.stats_.solves);
+  EXPECT_EQ(timing.error_norm.calls_, result.stats_.number_of_steps);
+  EXPECT_GT(timing.decomposition.wall_time_.count(), 0);
+  EXPECT_EQ(solver.stats_.timing.solve.calls_, result.stats_.solves);
+
+  result = solver.Solve(1.0, 2.0, state);
+  EXPECT_EQ(result.stats_.timing.update_rate_constants.calls_, 0);
+  EXPECT_EQ(result.stats_.timing.forcing.calls_, result.stats_.function_calls - result.stats_.jacobian_updates);
+}
+#endif
+
+template<template<class> class MatrixPolicy>
+void testChunkedSolve(bool per_cell_step_control)
+{
+  // 5 grid cells are split into chunks of 2, 2, and 1 grid cells
+  auto serial_solver = getDecaySolver<MatrixPolicy>(
+      0.9,
+      0.3,
+      { .number_of_grid_cells_ = 5, .per_cell_step_control_ = per_cell_step_control });
+  auto chunked_solver = getDecaySolver<MatrixPolicy>(
+      0.9,
+      0.3,
+      { .number_of_grid_cells_ = 5, .per_cell_step_control_ = per_cell_step_control, .number_of_threads_ = 3 });
+  EXPECT_EQ(chunked_solver.chunk_workspaces_.size(), 3);
+  EXPECT_EQ(chunked_solver.chunk_workspaces_[0].Y_.size(), 2);
+  EXPECT_EQ(chunked_solver.chunk_workspaces_[1].Y_.size(), 2);
+  EXPECT_EQ(chunked_solver.chunk_workspaces_[2].Y_.size(), 1);
+
+  micm::State<MatrixPolicy> state = serial_solver.GetState();
+  for (auto& conditions : state.conditions_)
+    conditions.temperature_ = 298.15;
+  serial_solver.UpdateState(state);
+  std::vector<std::pair<double, double>> k(5);
+  for (std::size_t i_cell = 0; i_cell < 5; ++i_cell)
+  {
+    k[i_cell] = { 0.9 * (i_cell + 1), 0.3 * (i_cell + 1) };
+    state.rate_constants_[i_cell][0] = k[i_cell].first;
+    state.rate_constants_[i_cell][1] = k[i_cell].second;
+    state.variables_[i_cell][0] = 1.0;
+    state.variables_[i_cell][1] = 0.0;
+    state.variables_[i_cell][2] = 0.0;
+  }
+
+  auto serial_result = serial_solver.Solve(0.0, 1.0, state);
+  auto chunked_result = chunked_solver.Solve(0.0, 1.0, state);
+  EXPECT_EQ(serial_result.state_, micm::Solver::SolverState::Converged);
+  EXPECT_EQ(chunked_result.state_, micm::Solver::SolverState::Converged);
+  EXPECT_NEAR(chunked_result.T, 1.0, 1.0e-12);
+  EXPECT_EQ(chunked_result.result_.size(), serial_result.result_.size());
+
+  MatrixPolicy<double> serial_Y = state.variables_;
+  MatrixPolicy<double> chunked_Y = state.variables_;
+  serial_Y.AsVector() = serial_result.result_;
+  chunked_Y.AsVector() = chunked_result.result_;
+  for (std::size_t i_cell = 0; i_cell < 5; ++i_cell)
+  {
+    double A = std::exp(-k[i_cell].first);
+    double B = k[i_cell].first / (k[i_cell].second - k[i_cell].first) *
+               (std::exp(-k[i_cell].first) - std::exp(-k[i_cell].second));
+    EXPECT_NEAR(chunked_Y[i_cell][0], A, 1.0e-3);
+    EXPECT_NEAR(chunked_Y[i_cell][1], B, 1.0e-3);
+    EXPECT_NEAR(chunked_Y[i_cell][2], 1.0 - A - B, 1.0e-3);
+    // grid cells with independent step control do not depend on how they are chunked
+    if (per_cell_step_control)
+    {
+      for (std::size_t i = 0; i < 3; ++i)
+        EXPECT_NEAR(chunked_Y[i_cell][i], serial_Y[i_cell][i], 1.0e-12);
+      EXPECT_EQ(chunked_result.cell_stats_[i_cell].number_of_steps, serial_result.cell_stats_[i_cell].number_of_steps);
+    }
+  }
+}
+
+TEST(RosenbrockSolver, ChunkedSolve)
+{
+  testChunkedSolve<micm::Matrix>(false);
+  testChunkedSolve<micm::Matrix>(true);
+}
+
+template<template<class> class MatrixPolicy>
+class ErrorNormTestSolver : public micm::RosenbrockSolver<MatrixPolicy>
+{
+ public:
+  using micm::RosenbrockSolver<MatrixPolicy>::RosenbrockSolver;
+  using micm::RosenbrockSolver<MatrixPolicy>::ErrorNorm;
+  using micm::RosenbrockSolver<MatrixPolicy>::CellErrorNorms;
+};
+
+template<template<class> class MatrixPolicy>
+void testErrorNorm()
+{
+  auto a = micm::Species("A", micm::Property("absolute tolerance", "", 1.0e-3));
+  auto b = micm::Species("B");
+  auto c = micm::Species("C", micm::Property("absolute tolerance", "", 1.0e-6));
+  micm::Phase gas_phase{ std::vector<micm::Species>{ a, b, c } };
+  micm::Process r1 = micm::Process::create()
+                         .reactants({ a })
+                         .products({ yields(b, 1) })
+                         .rate_constant(micm::ArrheniusRateConstant({ .A_ = 1.0 }))
+                         .phase(gas_phase);
+
+  const std::size_t number_of_grid_cells = 5;
+  ErrorNormTestSolver<MatrixPolicy> solver{ micm::System(micm::SystemParameters{ .gas_phase_ = gas_phase }),
+                                            std::vector<micm::Process>{ r1 },
+                                            micm::RosenbrockSolverParameters{ .absolute_tolerance_ = 1.0e-8,
+                                                                              .number_of_grid_cells_ = number_of_grid_cells } };
+  EXPECT_EQ(solver.absolute_tolerances_, (std::vector<double>{ 1.0e-3, 1.0e-8, 1.0e-6 }));
+
+  MatrixPolicy<double> Y(number_of_grid_cells, 3);
+  MatrixPolicy<double> Ynew(number_of_grid_cells, 3);
+  MatrixPolicy<double> errors(number_of_grid_cells, 3);
+  double sum = 0.0;
+  std::vector<double> cell_sums(number_of_grid_cells, 0.0);
+  for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)
+  {
+    for (std::size_t i_species = 0; i_species < 3; ++i_species)
+    {
+      Y[i_cell][i_species] = 0.1 * (i_cell + 1) * (i_species + 1);
+      Ynew[i_cell][i_species] = -0.2 * (i_cell + 1) + 0.05 * i_species;
+      errors[i_cell][i_species] = 1.0e-5 * (i_cell + 2) * (i_species + 3);
+      double scale = solver.absolute_tolerances_[i_species] +
+                     solver.parameters_.relative_tolerance_ *
+                         std::max(std::abs(Y[i_cell][i_species]), std::abs(Ynew[i_cell][i_species]));
+      double ratio = errors[i_cell][i_species] / scale;
+      sum += ratio * ratio;
+      cell_sums[i_cell] += ratio * ratio;
+    }
+  }
+  // padding in the last block of a vector-ordered matrix must not contribute to the norm
+  for (auto& elem : errors.AsVector())
+    if (elem == 0.0)
+      elem = 1.0e10;
+
+  EXPECT_NEAR(solver.ErrorNorm(Y, Ynew, errors), std::sqrt(sum / (number_of_grid_cells * 3)), 1.0e-10);
+  std::vector<double> norms(number_of_grid_cells);
+  solver.CellErrorNorms(Y, Ynew, errors, std::vector<bool>(number_of_grid_cells, true), norms);
+  for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)
+    EXPECT_NEAR(norms[i_cell], std::sqrt(cell_sums[i_cell] / 3), 1.0e-10);
+
+  // the norm is bounded from below
+  for (auto& elem : errors.AsVector())
+    elem = 0.0;
+  EXPECT_EQ(solver.ErrorNorm(Y, Ynew, errors), 1.0e-10);
+}
+
+TEST(RosenbrockSolver, ErrorNorm)
+{
+  testErrorNorm<micm::Matrix>();
+  testErrorNorm<Group3VectorMatrix>();
+}
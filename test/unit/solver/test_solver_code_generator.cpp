@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include <micm/solver/rosenbrock.hpp>
+#include <micm/solver/solver_code_generator.hpp>
+#include <micm/util/matrix.hpp>
+#include <string>
+#include <test_mechanism_kernels.hpp>
+#include <vector>
+
+#include "code_generator_test_mechanism.hpp"
+
+TEST(SolverCodeGenerator, DoubleLiteral)
+{
+  EXPECT_EQ(micm::DoubleLiteral(1.0), "1.0");
+  EXPECT_EQ(micm::DoubleLiteral(-2.0), "-2.0");
+  EXPECT_EQ(micm::DoubleLiteral(0.5), "0.5");
+  EXPECT_EQ(std::stod(micm::DoubleLiteral(2.4)), 2.4);
+  EXPECT_EQ(std::stod(micm::DoubleLiteral(1.0e-30)), 1.0e-30);
+}
+
+TEST(SolverCodeGenerator, Sizes)
+{
+  auto mechanism = codeGeneratorTestMechanism();
+  micm::RosenbrockSolver<micm::Matrix> solver{ mechanism.first,
+                                               std::move(mechanism.second),
+                                               micm::RosenbrockSolverParameters{} };
+  auto LU = micm::LuDecomposition::GetLUMatrices(solver.jacobian_);
+  EXPECT_EQ(test_mechanism::number_of_species, 5);
+  EXPECT_EQ(test_mechanism::number_of_reactions, 6);
+  EXPECT_EQ(test_mechanism::jacobian_size, solver.jacobian_.FlatBlockSize());
+  EXPECT_EQ(test_mechanism::lower_size, LU.first.FlatBlockSize());
+  EXPECT_EQ(test_mechanism::upper_size, LU.second.FlatBlockSize());
+}
+
+// The generated kernels are compiled into this test and compared with the general ones
+TEST(SolverCodeGenerator, MatchesGeneralKernels)
+{
+  const std::size_t number_of_grid_cells = 3;
+  auto mechanism = codeGeneratorTestMechanism();
+  micm::RosenbrockSolver<micm::Matrix> solver{ mechanism.first,
+                                               std::move(mechanism.second),
+                                               micm::RosenbrockSolverParameters{
+                                                   .number_of_grid_cells_ = number_of_grid_cells } };
+  const std::size_t n = test_mechanism::number_of_species;
+
+  micm::Matrix<double> rate_constants(number_of_grid_cells, test_mechanism::number_of_reactions);
+  micm::Matrix<double> state(number_of_grid_cells, n);
+  for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)
+  {
+    for (std::size_t i_rxn = 0; i_rxn < test_mechanism::number_of_reactions; ++i_rxn)
+      rate_constants[i_cell][i_rxn] = 0.5 + 0.3 * i_rxn + 0.1 * i_cell;
+    for (std::size_t i = 0; i < n; ++i)
+      state[i_cell][i] = 1.0 + 0.2 * i + 0.7 * i_cell;
+  }
+
+  micm::Matrix<double> forcing(number_of_grid_cells, n, 0.0);
+  std::vector<double> generated_forcing(number_of_grid_cells * n, 0.0);
+  solver.process_set_.AddForcingTerms<micm::Matrix>(rate_constants, state, forcing);
+  test_mechanism::AddForcingTerms(
+      rate_constants.AsVector().data(), state.AsVector().data(), generated_forcing.data(), number_of_grid_cells);
+  for (std::size_t i = 0; i < generated_forcing.size(); ++i)
+    EXPECT_NEAR(generated_forcing[i], forcing.AsVector()[i], 1.0e-12 * std::abs(forcing.AsVector()[i]));
+
+  auto& jacobian = solver.jacobian_;
+  std::fill(jacobian.AsVector().begin(), jacobian.AsVector().end(), 0.0);
+  std::vector<double> generated_jacobian(jacobian.AsVector().size(), 0.0);
+  solver.process_set_.AddJacobianTerms<micm::Matrix>(rate_constants, state, jacobian);
+  test_mechanism::AddJacobianTerms(
+      rate_constants.AsVector().data(), state.AsVector().data(), generated_jacobian.data(), number_of_grid_cells);
+  for (std::size_t i = 0; i < generated_jacobian.size(); ++i)
+    EXPECT_NEAR(generated_jacobian[i], jacobian.AsVector()[i], 1.0e-12 * std::abs(jacobian.AsVector()[i]));
+
+  // factor and solve [alpha * I - J] x = b
+  auto A = jacobian;
+  for (auto& elem : A.AsVector())
+    elem = -elem;
+  for (std::size_t i_cell = 0; i_cell < number_of_grid_cells; ++i_cell)
+    for (std::size_t i = 0; i < n; ++i)
+      A[i_cell][i][i] += 10.0;
+  auto LU = micm::LuDecomposition::GetLUMatrices(A);
+  solver.linear_solver_.Factor(A, LU.first, LU.second);
+  std::vector<double> generated_L(LU.first.AsVector().size(), 0.0);
+  std::vector<double> generated_U(LU.second.AsVector().size(), 0.0);
+  test_mechanism::Decompose(A.AsVector().data(), generated_L.data(), generated_U.data(), number_of_grid_cells);
+  for (std::size_t i = 0; i < generated_L.size(); ++i)
+    EXPECT_NEAR(generated_L[i], LU.first.AsVector()[i], 1.0e-12 * std::abs(LU.first.AsVector()[i]));
+  for (std::size_t i = 0; i < generated_U.size(); ++i)
+    EXPECT_NEAR(generated_U[i], LU.second.AsVector()[i], 1.0e-12 * std::abs(LU.second.AsVector()[i]));
+
+  micm::Matrix<double> x(number_of_grid_cells, n);
+  solver.linear_solver_.Solve<micm::Matrix>(state, x, LU.first, LU.second);
+  std::vector<double> generated_x = state.AsVector();
+  test_mechanism::Solve(generated_x.data(), generated_x.data(), generated_L.data(), generated_U.data(), number_of_grid_cells);
+  for (std::size_t i = 0; i < generated_x.size(); ++i)
+    EXPECT_NEAR(generated_x[i], x.AsVector()[i], 1.0e-12 * std::abs(x.AsVector()[i]));
+}
+
+TEST(SolverCodeGenerator, StraightLineCode)
+{
+  auto mechanism = codeGeneratorTestMechanism();
+  std::string source = micm::GenerateSolverSource(mechanism.first, mechanism.second);
+  EXPECT_NE(source.find("namespace micm_generated"), std::string::npos);
+  // A + C -> B + 2.4 E and the self-reaction A + A -> C
+  EXPECT_NE(source.find("const double r0 = k[0] * y[0] * y[2];"), std::string::npos);
+  EXPECT_NE(source.find("const double r3 = k[3] * y[0] * y[0];"), std::string::npos);
+  // an emission has no reactants
+  EXPECT_NE(source.find("const double r4 = k[4];"), std::string::npos);
+  // no index arrays are read in the generated kernels
+  EXPECT_EQ(source.find("_ids"), std::string::npos);
+}
+
+TEST(SolverCodeGenerator, ConstantSpecies)
+{
+  auto a = micm::Species("A");
+  auto m = micm::Species("M", micm::Property("constant", "", 1.0));
+  auto b = micm::Species("B");
+  micm::Phase gas_phase{ std::vector<micm::Species>{ a, m, b } };
+  std::vector<micm::Process> processes{ micm::Process::create()
+                                            .reactants({ a, m })
+                                            .products({ std::make_pair(b, 1.0), std::make_pair(m, 1.0) })
+                                            .rate_constant(micm::ArrheniusRateConstant({ .A_ = 0.4 }))
+                                            .phase(gas_phase) };
+  std::string source =
+      micm::GenerateSolverSource(micm::System(micm::SystemParameters{ .gas_phase_ = gas_phase }), processes);
+  // M is folded into the rate constant and only A and B are integrated
+  EXPECT_NE(source.find("number_of_species = 2;"), std::string::npos);
+  EXPECT_NE(source.find("const double r0 = k[0] * y[0];"), std::string::npos);
+  EXPECT_NE(source.find("f[1] += + r0;"), std::string::npos);
+}
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <micm/solver/sparse_matrix_vector_product.hpp>
+#include <micm/util/matrix.hpp>
+#include <micm/util/sparse_matrix.hpp>
+#include <micm/util/vector_matrix.hpp>
+#include <vector>
+
+#include "test_linear_solver_policy.hpp"
+
+template<class T>
+using Group3VectorMatrix = micm::VectorMatrix<T, 3>;
+
+template<class T>
+using Group3SparseVectorMatrix = micm::SparseMatrix<T, micm::SparseMatrixVectorOrdering<3>>;
+
+template<template<class> class MatrixPolicy, class SparseMatrixPolicy>
+void testRandomProduct(std::size_t number_of_blocks, const std::vector<std::size_t>& variable_order)
+{
+  const std::size_t n = 6;
+  auto A = randomMatrix<SparseMatrixPolicy>(n, number_of_blocks);
+  auto x = randomVector<MatrixPolicy>(n, number_of_blocks);
+  MatrixPolicy<double> y(number_of_blocks, n, 0.0);
+
+  micm::SparseMatrixVectorProduct<MatrixPolicy>(A, x, y, variable_order);
+
+  // row (and column) i of A is variable variable_order[i] of x and y
+  for (std::size_t i_block = 0; i_block < number_of_blocks; ++i_block)
+  {
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      double expected = 0.0;
+      for (std::size_t j = 0; j < n; ++j)
+        if (!A.IsZero(i, j))
+          expected += A[i_block][i][j] * x[i_block][variable_order.empty() ? j : variable_order[j]];
+      EXPECT_NEAR(y[i_block][variable_order.empty() ? i : variable_order[i]], expected, 1.0e-12 * std::abs(expected));
+    }
+  }
+}
+
+TEST(SparseMatrixVectorProduct, StandardOrdering)
+{
+  testRandomProduct<micm::Matrix, micm::SparseMatrix<double>>(1, {});
+  testRandomProduct<micm::Matrix, micm::SparseMatrix<double>>(5, {});
+  testRandomProduct<Group3VectorMatrix, micm::SparseMatrix<double>>(5, {});
+}
+
+TEST(SparseMatrixVectorProduct, VectorOrdering)
+{
+  testRandomProduct<Group3VectorMatrix, Group3SparseVectorMatrix<double>>(1, {});
+  testRandomProduct<Group3VectorMatrix, Group3SparseVectorMatrix<double>>(5, {});
+}
+
+TEST(SparseMatrixVectorProduct, ReorderedMatrix)
+{
+  const std::vector<std::size_t> variable_order{ 3, 0, 5, 1, 4, 2 };
+  testRandomProduct<micm::Matrix, micm::SparseMatrix<double>>(4, variable_order);
+  testRandomProduct<Group3VectorMatrix, Group3SparseVectorMatrix<double>>(4, variable_order);
+}
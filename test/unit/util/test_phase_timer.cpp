@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <micm/util/phase_timer.hpp>
+#include <thread>
+
+TEST(PhaseTimer, AccumulatesScopes)
+{
+  micm::PhaseTime phase{};
+  for (int i = 0; i < 3; ++i)
+  {
+    micm::ScopedPhaseTimer timer(phase);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(phase.calls_, 3);
+  EXPECT_GE(phase.wall_time_, std::chrono::milliseconds(3));
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+  EXPECT_GT(phase.cycles_, 0);
+#endif
+}
+
+TEST(PhaseTimer, AddPhaseTimes)
+{
+  micm::PhaseTime a{ .wall_time_ = std::chrono::nanoseconds(10), .cycles_ = 20, .calls_ = 1 };
+  micm::PhaseTime b{ .wall_time_ = std::chrono::nanoseconds(5), .cycles_ = 7, .calls_ = 2 };
+  a += b;
+  EXPECT_EQ(a.wall_time_, std::chrono::nanoseconds(15));
+  EXPECT_EQ(a.cycles_, 27);
+  EXPECT_EQ(a.calls_, 3);
+}
+
+TEST(PhaseTimer, TimePhaseMacro)
+{
+  micm::PhaseTime phase{};
+  {
+    MICM_TIME_PHASE(phase);
+  }
+#ifdef USE_TIMING
+  EXPECT_EQ(phase.calls_, 1);
+#else
+  EXPECT_EQ(phase.calls_, 0);
+#endif
+}
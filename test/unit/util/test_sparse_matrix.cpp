@@ -481,6 +481,56 @@ TEST(SparseMatrix, MultiBlockMatrix)
       std::invalid_argument);
 }
 
+TEST(SparseMatrix, VectorOrderedMultiBlockMatrix)
+{
+  auto builder = micm::SparseMatrix<int, micm::SparseMatrixVectorOrdering<2>>::create(4)
+                     .with_element(0, 1)
+                     .with_element(3, 2)
+                     .with_element(2, 3)
+                     .with_element(2, 1)
+                     .initial_value(24)
+                     .number_of_blocks(3);
+  // 0 X 0 0
+  // 0 0 0 0
+  // 0 X 0 X
+  // 0 0 X 0
+
+  // the last group of blocks is padded
+  EXPECT_EQ(builder.NumberOfElements(), 4 * 4);
+
+  micm::SparseMatrix<int, micm::SparseMatrixVectorOrdering<2>> matrix{ builder };
+
+  EXPECT_EQ(matrix.GroupVectorSize(), 2);
+  EXPECT_EQ(matrix.FlatBlockSize(), 4);
+  EXPECT_EQ(matrix.size(), 3);
+  EXPECT_EQ(matrix.AsVector().size(), 16);
+  EXPECT_EQ(matrix.VectorIndex(0, 0, 1), 0);
+  EXPECT_EQ(matrix.VectorIndex(1, 0, 1), 1);
+  EXPECT_EQ(matrix.VectorIndex(0, 2, 3), 4);
+  EXPECT_EQ(matrix.VectorIndex(1, 2, 3), 5);
+  EXPECT_EQ(matrix.VectorIndex(2, 2, 1), 10);
+  EXPECT_EQ(matrix.VectorIndex(2, 3, 2), 14);
+
+  matrix[1][2][3] = 45;
+  EXPECT_EQ(matrix.AsVector()[5], 45);
+  EXPECT_EQ(matrix[1][2][3], 45);
+  EXPECT_EQ(matrix[0][2][3], 24);
+  EXPECT_EQ(matrix[2][2][3], 24);
+
+  EXPECT_THROW(
+      try { std::size_t elem = matrix.VectorIndex(3, 0, 1); } catch (const std::invalid_argument& e) {
+        EXPECT_STREQ(e.what(), "SparseMatrix element out of range");
+        throw;
+      },
+      std::invalid_argument);
+  EXPECT_THROW(
+      try { matrix[1][1][1] = 2; } catch (const std::invalid_argument& e) {
+        EXPECT_STREQ(e.what(), "SparseMatrix zero element access not allowed");
+        throw;
+      },
+      std::invalid_argument);
+}
+
 TEST(SparseMatrixBuilder, BadConfiguration)
 {
   EXPECT_THROW(